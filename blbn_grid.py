@@ -0,0 +1,356 @@
+#!/usr/bin/python
+'''
+blbn_grid.py
+
+Runs a grid of blbn_learner experiments (networks x policies x folds) read
+from a manifest, keeping up to N learner processes running at a time.
+
+  python blbn_grid.py blbn_grid.json -j 8
+  python blbn_grid.py blbn_grid.json -j 8 -n        (print the jobs only)
+
+The manifest is a JSON object:
+
+  {
+    "learner": "./blbn_learner",        learner executable
+    "data": "./data",                   data folder (one folder per data set)
+    "results": "./results",             results folder
+    "prior": "uniform",
+    "fold_count": 10,
+    "run": "1",                         run folder name: a number or a date
+                                        such as "2013-04-22" (default "1")
+    "options": ["-l", "incremental"],   extra learner options (optional)
+    "networks": [ {"network": "ChestClinic", "dataset": "ChestClinic",
+                   "target": "TbOrCa", "budget": 100}, ... ],
+    "policies": ["rr", "rsfl", ...]
+  }
+
+Every (network, policy, fold) is one job:
+
+  learner -e local -m <data>/<network>/<network>.dne
+          -d <data>/<dataset>/<dataset>.cas.<fold>
+          -v <data>/<dataset>/<dataset>.cas.<fold>v
+          -f <fold> -k <fold_count> -b <budget> -t <target> -p <policy>
+          -r <prior> <options> -o <job folder>
+
+writing the four <structure>.choice.<structure>.graph.csv.<fold> files into
+
+  <results>/m=<network>.d=<dataset>.t=<target>.p=<policy>.r=<prior>.b=<budget>.k=<fold_count>/<run>/
+
+which is where blbn_wilcoxon_1to1.py and the merge_folds_*.rb scripts look
+for them (the merge scripts need the run folder to be named by digits and
+dashes, as earlier runs were).  A job runs in a scratch folder next to the job folder, and its
+graph files are moved into the job folder only if the learner succeeds and
+every file has a row per purchase (budget + 1 rows, budget for bl and MBbl),
+so jobs whose graph files already have those rows are complete and are
+skipped (the grid can be stopped and rerun).
+
+Policies are checked against the names blbn_learner accepts before any job
+starts.  The names empg and MBempg (used by blbn_wilcoxon_1to1.py) run the
+learner's merpg and MBmerpg policies, keeping their own results folders.
+
+Jobs are started longest first.  The expected time of a job is the time the
+same (network, policy) took in earlier runs (recorded in
+<results>/grid.tsv), or else an estimate from the budget, the number of
+training cases and the policy.  The wall time, peak resident set size, and
+exit status of every job are appended to <results>/grid.tsv, and the
+learner's output to <job folder>/learner.log.<fold>.  The peak resident set
+size is the largest VmHWM read from /proc/<pid>/status while the learner runs
+(max_rss_source "sampled").  A job sampled fewer than two times (or where
+/proc is unavailable) records ru_maxrss instead (max_rss_source "rusage"),
+which also counts this script's memory at the time the learner was forked.
+'''
+
+from __future__ import print_function
+
+import json
+import os
+import re
+import shutil
+import subprocess
+import sys
+import time
+
+structures = ["naive.choice.naive", "naive.choice.Bayesian",
+              "Bayesian.choice.Bayesian", "Bayesian.choice.naive"]
+
+# Relative cost of one purchase for each policy (the lookahead policies score
+# every (case, node, state) candidate with a relearned network per purchase)
+policy_weights = {"sfl": 400.0, "gsfl": 400.0, "rsfl": 100.0, "grsfl": 100.0,
+                  "MBsfl": 200.0, "MBrsfl": 50.0, "MBgrsfl": 50.0,
+                  "cheating": 200.0, "MBcheating": 100.0,
+                  "merpg": 4.0, "empg": 4.0, "dsep": 4.0, "dsepw1": 4.0, "dsepw2": 4.0,
+                  "MBmerpg": 2.0, "MBempg": 2.0, "MBdsep": 2.0, "MBdsepw1": 2.0, "MBdsepw2": 2.0}
+default_weight = 1.0
+
+# Policies blbn_learner accepts, and the other names used for them
+learner_policies = ["bl", "random", "rr", "br", "sfl", "rsfl", "gsfl", "grsfl",
+                    "merpg", "dsep", "dsepw1", "dsepw2", "cheating"]
+learner_policies = learner_policies + ["MB" + policy for policy in learner_policies]
+policy_aliases = {"empg": "merpg", "MBempg": "MBmerpg"}
+
+log_columns = ["network", "dataset", "target", "policy", "fold", "budget",
+               "status", "wall_seconds", "max_rss_kb", "max_rss_source", "finished"]
+
+
+class Job:
+    def __init__(self, manifest, entry, policy, fold):
+        self.network = entry["network"]
+        self.dataset = entry.get("dataset", self.network)
+        self.target = entry["target"]
+        self.budget = int(entry.get("budget", 100))
+        self.policy = policy
+        self.learner_policy = policy_aliases.get(policy, policy)
+        self.fold = fold
+        self.key = (self.network, self.dataset, self.target, self.policy, str(self.budget))
+
+        data = manifest.get("data", "./data")
+        fold_count = int(manifest.get("fold_count", 10))
+        prior = manifest.get("prior", "uniform")
+        self.model = os.path.join(data, self.network, self.network + ".dne")
+        self.cases = os.path.join(data, self.dataset, self.dataset + ".cas." + str(fold))
+        self.folder = os.path.join(manifest.get("results", "./results"),
+                                   "m=" + self.network + ".d=" + self.dataset + ".t=" + self.target
+                                   + ".p=" + policy + ".r=" + prior + ".b=" + str(self.budget)
+                                   + ".k=" + str(fold_count), str(manifest.get("run", "1")))
+        self.scratch = os.path.join(os.path.dirname(self.folder), "grid.partial." + str(fold))
+        self.learner = manifest.get("learner", "./blbn_learner")
+        self.args = [self.learner,
+                     "-e", "local", "-m", self.model, "-d", self.cases, "-v", self.cases + "v",
+                     "-f", str(fold), "-k", str(fold_count), "-b", str(self.budget),
+                     "-t", self.target, "-p", self.learner_policy, "-r", prior] \
+            + [str(option) for option in manifest.get("options", [])] \
+            + ["-o", self.scratch]
+        self.estimate = 0.0
+        self.process = None
+        self.started = 0.0
+        self.executable = None
+        self.max_rss = 0
+        self.rss_samples = 0
+
+    def outputs(self, folder):
+        return [os.path.join(folder, structure + ".graph.csv." + str(self.fold))
+                for structure in structures]
+
+    def complete(self, folder):
+        '''
+        returns whether every graph file of the job in folder has a row per
+        purchase (the baselines write no row for the empty purchase)
+        '''
+        rows = self.budget + (0 if self.learner_policy in ("bl", "MBbl") else 1)
+        for path in self.outputs(folder):
+            if count_rows(path) < rows:
+                return False
+        return True
+
+    def done(self):
+        return self.complete(self.folder)
+
+
+def count_rows(path):
+    '''
+    returns the number of non-empty lines in a file, or 0 if it does not exist
+    '''
+    try:
+        with open(path) as row_file:
+            return sum(1 for line in row_file if line.strip())
+    except IOError:
+        return 0
+
+
+def count_cases(path):
+    '''
+    returns the number of cases in a case file (its lines except the header)
+    '''
+    try:
+        with open(path) as case_file:
+            return max(sum(1 for line in case_file) - 1, 1)
+    except IOError:
+        return 1
+
+
+def read_times(log_path):
+    '''
+    returns the mean wall time of the successful jobs of every
+    (network, dataset, target, policy, budget) in the job log
+    '''
+    totals = {}
+    if os.path.isfile(log_path):
+        with open(log_path) as log_file:
+            for line in log_file:
+                items = line.rstrip("\n").split("\t")
+                if len(items) != len(log_columns) or items[0] == log_columns[0] or items[6] != "0":
+                    continue
+                key = (items[0], items[1], items[2], items[3], items[5])
+                total, count = totals.get(key, (0.0, 0))
+                totals[key] = (total + float(items[7]), count + 1)
+    return dict((key, total / count) for key, (total, count) in totals.items())
+
+
+def read_max_rss(pid, executable):
+    '''
+    returns the peak resident set size (kB) of a running process, or 0 if
+    it cannot be read or the process is not yet running executable
+    '''
+    try:
+        if os.readlink("/proc/" + str(pid) + "/exe") != executable:
+            return 0
+        with open("/proc/" + str(pid) + "/status") as status_file:
+            for line in status_file:
+                if line.startswith("VmHWM:"):
+                    return int(line.split()[1])
+    except (IOError, OSError, ValueError):
+        pass
+    return 0
+
+
+def read_jobs(manifest):
+    jobs = []
+    for entry in manifest["networks"]:
+        for policy in manifest["policies"]:
+            for fold in range(int(manifest.get("fold_count", 10))):
+                jobs.append(Job(manifest, entry, policy, fold))
+    return jobs
+
+
+def start(job, log_path):
+    if os.path.isdir(job.scratch):
+        shutil.rmtree(job.scratch)
+    os.makedirs(job.scratch)
+    if not os.path.isdir(job.folder):
+        os.makedirs(job.folder)
+    with open(os.path.join(job.folder, "learner.log." + str(job.fold)), "w") as output:
+        job.process = subprocess.Popen(job.args, stdout=output, stderr=subprocess.STDOUT)
+    job.started = time.time()
+    job.executable = os.path.realpath(job.learner)
+
+
+def finish(job, status, usage, log_path):
+    '''
+    moves the graph files of a successful job into its folder and appends
+    the job's wall time and peak memory to the job log
+    '''
+    wall = time.time() - job.started
+    rss_source = "sampled"
+    if job.rss_samples < 2:
+        job.max_rss = usage.ru_maxrss
+        rss_source = "rusage"
+    if status == 0:
+        if not job.complete(job.scratch):
+            status = -1000 # the learner exited without writing all of its results
+        if status == 0:
+            for structure in structures:
+                name = structure + ".graph.csv." + str(job.fold)
+                os.rename(os.path.join(job.scratch, name), os.path.join(job.folder, name))
+            shutil.rmtree(job.scratch)
+    write_header = not os.path.isfile(log_path)
+    with open(log_path, "a") as log_file:
+        if write_header:
+            log_file.write("\t".join(log_columns) + "\n")
+        log_file.write("\t".join([job.network, job.dataset, job.target, job.policy, str(job.fold),
+                                  str(job.budget), str(status), "%.3f" % wall, str(job.max_rss), rss_source,
+                                  time.strftime("%Y-%m-%d %H:%M:%S")]) + "\n")
+    return status
+
+
+def run(jobs, worker_count, log_path):
+    '''
+    runs the jobs (longest first) with at most worker_count learners at a
+    time, and returns the number of jobs that failed
+    '''
+    pending = list(jobs)
+    running = {}
+    failures = 0
+    finished = 0
+    while pending or running:
+        while pending and len(running) < worker_count:
+            job = pending.pop(0)
+            start(job, log_path)
+            running[job.process.pid] = job
+        pid, wait_status, usage = os.wait4(-1, os.WNOHANG)
+        if pid == 0:
+            for job in running.values():
+                rss = read_max_rss(job.process.pid, job.executable)
+                if rss > 0:
+                    job.max_rss = max(job.max_rss, rss)
+                    job.rss_samples += 1
+            time.sleep(0.05)
+            continue
+        job = running.pop(pid, None)
+        if job is None:
+            continue
+        if os.WIFEXITED(wait_status):
+            status = os.WEXITSTATUS(wait_status)
+        else:
+            status = -os.WTERMSIG(wait_status)
+        status = finish(job, status, usage, log_path)
+        finished += 1
+        if status != 0:
+            failures += 1
+        print("[%d/%d] %s %s fold %d: %s in %.1fs, %d KB" % (finished, len(jobs), job.network, job.policy, job.fold,
+                                                          "done" if status == 0 else "FAILED (%d)" % status,
+                                                          time.time() - job.started, job.max_rss))
+        sys.stdout.flush()
+    return failures
+
+
+def main():
+    arguments = sys.argv[1:]
+    worker_count = 1
+    dry_run = False
+    manifest_path = None
+    while arguments:
+        argument = arguments.pop(0)
+        if argument == "-j" and arguments:
+            worker_count = int(arguments.pop(0))
+        elif argument == "-n":
+            dry_run = True
+        else:
+            manifest_path = argument
+    if manifest_path is None or worker_count < 1:
+        print("Usage: blbn_grid.py <manifest> [-j <worker_count>] [-n]")
+        sys.exit(1)
+
+    with open(manifest_path) as manifest_file:
+        manifest = json.load(manifest_file)
+    results = manifest.get("results", "./results")
+    log_path = os.path.join(results, "grid.tsv")
+
+    if not re.match(r"^[0-9-]+$", str(manifest.get("run", "1"))):
+        print("Error: The run folder name must be a number or a date. Exiting.")
+        sys.exit(1)
+
+    for policy in manifest["policies"]:
+        if policy_aliases.get(policy, policy) not in learner_policies:
+            print("Error: blbn_learner has no policy " + policy + ". Exiting.")
+            sys.exit(1)
+
+    jobs = read_jobs(manifest)
+    todo = [job for job in jobs if not job.done()]
+
+    # Longest first: recorded times of the same experiment, or else an estimate
+    times = read_times(log_path)
+    for job in todo:
+        if job.key in times:
+            job.estimate = times[job.key]
+        else:
+            job.estimate = job.budget * count_cases(job.cases) * policy_weights.get(job.learner_policy, default_weight) * 1e-4
+    todo.sort(key=lambda job: -job.estimate)
+
+    print("%d jobs, %d complete, %d to run with %d workers" % (len(jobs), len(jobs) - len(todo), len(todo), worker_count))
+    if dry_run:
+        for job in todo:
+            print("%10.1f  %s" % (job.estimate, " ".join(job.args)))
+        return
+    sys.stdout.flush()
+
+    if not os.path.isdir(results):
+        os.makedirs(results)
+
+    failures = run(todo, worker_count, log_path)
+    if failures > 0:
+        print("%d jobs failed (see %s)" % (failures, log_path))
+        sys.exit(1)
+
+
+if __name__ == '__main__':
+    main()
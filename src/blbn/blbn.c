@@ -22,6 +22,12 @@
 #include "blbn.h"
 #include <stdlib.h>
 
+// Expensive Netica operations made by the library (see blbn_counters_t)
+blbn_counters_t blbn_counters;
+
+// Binary case stores mapped by this process (see blbn_case_store_open)
+blbn_case_store_t *blbn_case_stores = NULL;
+
 /*
  * Print error number and message if there is an error in the global variable env
  * */
@@ -112,9 +118,11 @@ blbn_state_t* blbn_init_state (char* type_net, char* choice_type_net, char *data
 
 			// Set Netica network data structures
 			state->prior_net = CopyNet_bn (state->orig_net, GetNetName_bn (net), env, "no_visual");
+			blbn_counters.net_copies++;
 
 			// Set Netica network data structures
 			state->work_net = CopyNet_bn (state->orig_net, GetNetName_bn (net), env, "no_visual");
+			blbn_counters.net_copies++;
 
 			// Get statically-ordered list (keep it around for reference throughout execution of program)
 			nodes = GetNetNodes_bn (net);
@@ -143,6 +151,9 @@ blbn_state_t* blbn_init_state (char* type_net, char* choice_type_net, char *data
 				}
 			}
 
+			// Hash the node names and map the static node indices to the nodes of the working network
+			blbn_util_index_nodes (state);
+
 			// Find target node index
 			for (i = 0; i < state->node_count; ++i) {
 				if (strcasecmp(state->nodes[i],target_node_name) != 0){
@@ -166,74 +177,108 @@ blbn_state_t* blbn_init_state (char* type_net, char* choice_type_net, char *data
 				}
 			}
 
-			// Count number of cases
-			state->case_count = 0;
-			case_posn = FIRST_CASE;
-			while (1) {
-				RetractNetFindings_bn (net); // Retracts all findings from net
-				ReadNetFindings_bn (&case_posn, data_stream, nodes, NULL, NULL); // Set findings
-				if (case_posn == NO_MORE_CASES)
-					break;
-				++state->case_count;
-				case_posn = NEXT_CASE;
-			}
-			printf ("Case count: %d\n", state->case_count);
-
-			// Allocate space for state meta-data
-			state->state = (int **) malloc (state->node_count * sizeof (int *)); // n states (columns)
-			for (i = 0; i < state->node_count; i++) {
-				state->state[i] = (int *) malloc (state->case_count * sizeof (int)); // m cases (rows)
-			}
-
-			// Allocate space for property flag meta-data
-			state->flags = (unsigned int **) malloc (state->node_count * sizeof (unsigned int *)); // n states (columns)
-			for (i = 0; i < state->node_count; i++) {
-				state->flags[i] = (unsigned int *) malloc (state->case_count * sizeof (unsigned int)); // m cases (rows)
-			}
+			// Encode validation cases once (they are tested after every purchase and lookahead)
+			state->validation = blbn_validation_init (state, net, validation_stream);
+
+			// Map the cases from the binary case store converted from the data
+			// file if there is a current one, or else read the data file (the
+			// data matrices are node-major unless changed by caller)
+			state->layout = BLBN_LAYOUT_NODE_MAJOR;
+			if (!blbn_case_store_load_states (state, data_filepath)) {
+				// Count number of cases
+				state->case_count = 0;
+				case_posn = FIRST_CASE;
+				while (1) {
+					RetractNetFindings_bn (net); // Retracts all findings from net
+					ReadNetFindings_bn (&case_posn, data_stream, nodes, NULL, NULL); // Set findings
+					if (case_posn == NO_MORE_CASES)
+						break;
+					++state->case_count;
+					case_posn = NEXT_CASE;
+				}
+				printf ("Case count: %d\n", state->case_count);
+
+				// Allocate space for state meta-data
+				state->state = (int *) malloc ((size_t) state->node_count * state->case_count * sizeof (int) + 1); // n states by m cases
+
+				// Initialize working copy of data set and book-keeping meta-data
+				case_posn = FIRST_CASE;
+				j = 0; // used to count number of cases
+				while (1) {
+					RetractNetFindings_bn (net); // Retracts all findings from net
+					ReadNetFindings_bn (&case_posn, data_stream, nodes, NULL, NULL); // Set findings
+					if (case_posn == NO_MORE_CASES)
+						break;
 
-			// Initialize working copy of data set and book-keeping meta-data
-			case_posn = FIRST_CASE;
-			j = 0; // used to count number of cases
-			while (1) {
-				RetractNetFindings_bn (net); // Retracts all findings from net
-				ReadNetFindings_bn (&case_posn, data_stream, nodes, NULL, NULL); // Set findings
-				if (case_posn == NO_MORE_CASES)
-					break;
-
-				// Gets the current state of nodes
-				for (i = 0; i < state->node_count; i++) {
-					state->state[i][j] = GetNodeFinding_bn (NthNode_bn (nodes, i)); // Initialize state from Netica stream_ns
-
-					// Initialize flags for target and non-target node findings in cases
-					if (i == state->target) {
-						state->flags[i][j] = 0x00000000 | BLBN_METADATA_FLAG_TARGET; // Initialize flags to zeros (i.e., not purchased, not target)
-					} else {
-						state->flags[i][j] = 0x00000000; // Initialize flags to zeros (i.e., not purchased, not target)
+					// Gets the current state of nodes
+					for (i = 0; i < state->node_count; i++) {
+						BLBN_STATE (state, i, j) = GetNodeFinding_bn (NthNode_bn (nodes, i)); // Initialize state from Netica stream_ns
 					}
+					++j;
+					case_posn = NEXT_CASE;
+					// TODO: CHKERR
 				}
-				++j;
-				case_posn = NEXT_CASE;
-				// TODO: CHKERR
 			}
 
-			// Allocate space for cost meta-data
-			state->cost = (unsigned int **) malloc (state->node_count * sizeof (unsigned int *)); // n states (columns)
-			for (i = 0; i < state->node_count; i++) {
-				state->cost[i] = (unsigned int *) malloc (state->case_count * sizeof (unsigned int)); // m cases (rows)
+			// Allocate space for property flag meta-data (all flags cleared), and
+			// initialize flags for target node findings in cases
+			state->flags = blbn_flags_new (state->node_count, state->case_count);
+			for (j = 0; j < state->case_count; j++) {
+				blbn_set_finding_target (state, state->target, j);
 			}
 
+			// Allocate space for cost meta-data
+			state->cost = (unsigned int *) malloc ((size_t) state->node_count * state->case_count * sizeof (unsigned int) + 1); // n states by m cases
+
 			// Initialize cost meta-data
 			for (i = 0; i < state->node_count; i++) {
 				for (j = 0; j < state->case_count; j++) {
-					state->cost[i][j] = 1;
+					BLBN_COST (state, i, j) = 1;
 				}
 			}
 
 			// Initialize budget
 			state->budget = budget;
 
-			// Initialize select action sequence
-			state->sel_action_seq = NULL;
+			// Initialize select action sequence (empty)
+			state->sel_actions.actions  = NULL;
+			state->sel_actions.length   = 0;
+			state->sel_actions.capacity = 0;
+
+			// Initialize learning method (full EM relearn unless changed by caller)
+			state->learn_mode           = BLBN_LEARN_EM;
+			state->learn_tolerance      = BLBN_INCREMENTAL_TOLERANCE;
+			state->learn_max_sweeps     = BLBN_INCREMENTAL_MAX_SWEEPS;
+			state->learn_check_interval = BLBN_INCREMENTAL_CHECK_INTERVAL;
+			state->suff_stats           = NULL;
+
+			// No posteriors are cached for the initial network
+			state->net_version = 1;
+			state->posteriors  = NULL;
+
+			// The network structure is encoded on first use
+			state->graph = NULL;
+			state->dsep_memo = NULL;
+
+			// Score lookahead policies serially unless changed by caller
+			state->worker_count = 1;
+
+			// Rescore every case for SFL unless changed by caller
+			state->sfl_mode = BLBN_SFL_EXACT;
+			state->sfl_lazy = NULL;
+
+			// Score every candidate unless changed by caller
+			state->prune_mode = BLBN_PRUNE_NONE;
+			state->prune = NULL;
+
+			// Relearn leave-one-out networks with EM unless changed by caller
+			state->loo_mode = BLBN_LOO_RELEARN;
+			state->loo_sweeps = BLBN_LOO_DOWNDATE_SWEEPS;
+			state->loo = NULL;
+
+			// Actions are not streamed to or from another learner unless changed by caller
+			state->action_out_fd = -1;
+			state->action_in_fd  = -1;
 
 			// Allocate space for nodes to be considered (Markov Blanket or all nodes except target node)
 			state->nodes_consider = (int*) malloc (state->node_count * sizeof (int));
@@ -261,7 +306,7 @@ blbn_state_t* blbn_init_state (char* type_net, char* choice_type_net, char *data
 				state->nodes_consider[0] = state->node_count - 1;
 				int cur_index = 0;
 				int index = 1;
-				for (cur_index=0; cur_index< state->node_count-1;cur_index++){
+				for (cur_index=0; cur_index< state->node_count;cur_index++){
 					if (cur_index!=state->target){
 							state->nodes_consider[index] = cur_index;
 							//printf("%d %d \n",index, state->nodes_consider[index]);
@@ -280,7 +325,6 @@ blbn_state_t* blbn_init_state (char* type_net, char* choice_type_net, char *data
 /*free the space for state*/
 void blbn_free_state (blbn_state_t *state) {
 	int i;
-	blbn_select_action_t *action = NULL;
 
 	if (state != NULL) {
 		// Free node names
@@ -288,39 +332,48 @@ void blbn_free_state (blbn_state_t *state) {
 			free (state->nodes [i]);
 		}
 		free (state->nodes);
+		free (state->name_table);
+		free (state->state_counts);
+		free (state->work_nodes);
+		blbn_evidence_free (state->evidence);
 
 		// Free space occupied by state meta-data
-		for (i = 0; i < state->node_count; i++) {
-			free (state->state[i]); // m cases (rows)
+		if (state->case_store != NULL) {
+			blbn_case_store_release (state->case_store); // states are mapped
+		} else {
+			free (state->state);
 		}
-		free (state->state); // n states (columns)
 
 		// Free space occupied by flag meta-data
-		for (i = 0; i < state->node_count; i++) {
-			free (state->flags[i]); // m cases (rows)
-		}
-		free (state->flags); // n states (columns)
+		blbn_flags_free (state->flags);
 
 		// Free space occupied by cost meta-data
-		for (i = 0; i < state->node_count; i++) {
-			free (state->cost[i]); // m cases (rows)
-		}
-		free (state->cost); // n states (columns)
+		free (state->cost);
+
+		// Free space occupied by the incremental learner's statistics
+		blbn_suff_stats_free (state);
+
+		// Free space occupied by cached posteriors
+		blbn_posterior_cache_free (state->posteriors, state->case_count);
+
+		// Free space occupied by the encoded network structure
+		blbn_graph_free (state->graph);
+		blbn_dsep_memo_free (state->dsep_memo);
+
+		// Free space occupied by stale SFL scores
+		blbn_sfl_lazy_free (state->sfl_lazy);
+
+		// Free space occupied by the candidate pruning sets
+		blbn_prune_free (state->prune);
+
+		// Free space occupied by the leave-one-out networks and counts
+		blbn_loo_free (state->loo, state->case_count);
+
+		// Free space occupied by the encoded validation set
+		blbn_validation_free (state->validation);
+
 		// Free space occupied by Netica structures
-		action = state->sel_action_seq;
-		i = 0;
-		while (action != NULL) {
-			if (action->next != NULL) { // this is not the tail, b/c has next action
-				//printf ("deleting action %d\n", i);
-				action = action->next;
-				free (action->prev);
-				action->prev = NULL;
-			} else { // this is the tail action, so just delete the action
-				//free (action);
-				action = NULL;
-			}
-			i++;
-		}
+		free (state->sel_actions.actions);
 
 		// Finally, free the structure
 		free (state);
@@ -372,8 +425,8 @@ void blbn_set_uniform_prior (blbn_state_t *state, double experience) {
 	}
 
 	// Replace working network with the prior network
-	DeleteNet_bn (state->work_net);
-	state->work_net = CopyNet_bn (state->prior_net, GetNetName_bn (state->prior_net), env, "no_visual");
+	blbn_set_work_net (state, CopyNet_bn (state->prior_net, GetNetName_bn (state->prior_net), env, "no_visual"));
+	blbn_counters.net_copies++;
 
 	DeleteNodeList_bn (nodes);
 }
@@ -385,23 +438,11 @@ void blbn_set_uniform_prior (blbn_state_t *state, double experience) {
  */
 void blbn_assert_node_finding (blbn_state_t *state, int node_index, int state_index) {
 
-	char *node_name = NULL;
-	node_bn *node = NULL;
-
 	if (state != NULL) {
 		if (state->work_net != NULL) {
-			// Get the node by with the specified index
-			node_name = blbn_get_node_name (state, node_index);
-			node = GetNodeNamed_bn (node_name, state->work_net);
-
-			// Retract node findings (if any)
-			RetractNodeFindings_bn (node);
-
 			// Assert the state as the finding for the node with the specified index
-			//node_state = blbn_get_finding (state, node_index, case_index);
-			if (state_index != -1) {
-				EnterFinding_bn (node, state_index);
-			}
+			// (or retract the node's finding if state_index is -1)
+			blbn_evidence_set (state->evidence, node_index, state_index);
 		}
 	}
 }
@@ -413,18 +454,14 @@ void blbn_assert_node_finding (blbn_state_t *state, int node_index, int state_in
  */
 int blbn_has_finding_set (blbn_state_t *state, unsigned node_index) {
 	node_bn *node;
-	char *node_name = NULL;
 	state_bn node_finding = NO_FINDING;
 	if (state != NULL) {
 		if (blbn_is_valid_node (state, node_index)) {
-			node_name = blbn_get_node_name (state, node_index);
-			if (node_name) {
-				node = GetNodeNamed_bn (node_name, state->work_net);
-				if (node != NULL) {
-					node_finding = GetNodeFinding_bn (node); // Get finding for specified node (if any)
-					if (node_finding >= 0) { // Check if the specified node has a finding
-						return 1; // Return true if node has a finding (i.e., it has been instantiated with or assigned a value)
-					}
+			node = BLBN_WORK_NODE (state, node_index);
+			if (node != NULL) {
+				node_finding = GetNodeFinding_bn (node); // Get finding for specified node (if any)
+				if (node_finding >= 0) { // Check if the specified node has a finding
+					return 1; // Return true if node has a finding (i.e., it has been instantiated with or assigned a value)
 				}
 			}
 		}
@@ -439,7 +476,7 @@ int blbn_has_finding_set (blbn_state_t *state, unsigned node_index) {
  */
 void blbn_retract_findings (blbn_state_t *state) {
 	if (state != NULL) {
-		RetractNetFindings_bn (state->work_net);
+		blbn_evidence_retract (state->evidence);
 	}
 }
 
@@ -455,6 +492,117 @@ void blbn_learn_targets (blbn_state_t *state, double ess) {
 
 }
 
+/**
+ * Allocates the flag bit vectors for the specified number of nodes and cases
+ * (with every flag cleared).
+ */
+blbn_flags_t* blbn_flags_new (unsigned int node_count, unsigned int case_count) {
+	blbn_flags_t *flags = (blbn_flags_t *) calloc (1, sizeof (blbn_flags_t));
+	int p;
+
+	flags->node_count = node_count;
+	flags->case_count = case_count;
+	flags->node_words = (case_count + 63) / 64;
+	flags->case_words = (node_count + 63) / 64;
+	for (p = 0; p < BLBN_FLAG_PLANES; p++) {
+		flags->by_node[p] = (uint64_t *) calloc (node_count * flags->node_words + 1, sizeof (uint64_t));
+		flags->by_case[p] = (uint64_t *) calloc (case_count * flags->case_words + 1, sizeof (uint64_t));
+		flags->node_counts[p] = (unsigned int *) calloc (node_count + 1, sizeof (unsigned int));
+		flags->case_counts[p] = (unsigned int *) calloc (case_count + 1, sizeof (unsigned int));
+	}
+	flags->case_versions = (unsigned int *) calloc (case_count + 1, sizeof (unsigned int));
+
+	return flags;
+}
+
+void blbn_flags_free (blbn_flags_t *flags) {
+	int p;
+
+	if (flags != NULL) {
+		for (p = 0; p < BLBN_FLAG_PLANES; p++) {
+			free (flags->by_node[p]);
+			free (flags->by_case[p]);
+			free (flags->node_counts[p]);
+			free (flags->case_counts[p]);
+		}
+		free (flags->case_versions);
+		free (flags);
+	}
+}
+
+/**
+ * Returns the flag in the specified plane (BLBN_FLAG_TARGET, ...) of the
+ * finding for the specified node and case.
+ */
+char blbn_flags_get (const blbn_flags_t *flags, int plane, unsigned int node_index, unsigned int case_index) {
+	return (flags->by_node[plane][node_index * flags->node_words + case_index / 64] >> (case_index % 64)) & 0x01;
+}
+
+/**
+ * Sets (or clears) the flag in the specified plane of the finding for the
+ * specified node and case, updating both bit vectors, the counts and the
+ * version of the case.  Setting the target or purchased flag also updates the
+ * available plane.
+ */
+void blbn_flags_set (blbn_flags_t *flags, int plane, unsigned int node_index, unsigned int case_index, char value) {
+	uint64_t *word = &flags->by_node[plane][node_index * flags->node_words + case_index / 64];
+	uint64_t bit = (uint64_t) 1 << (case_index % 64);
+
+	if (((*word & bit) != 0) != (value != 0)) {
+		*word ^= bit;
+		flags->by_case[plane][case_index * flags->case_words + node_index / 64] ^= (uint64_t) 1 << (node_index % 64);
+		flags->case_versions[case_index]++;
+		if (value) {
+			flags->node_counts[plane][node_index]++;
+			flags->case_counts[plane][case_index]++;
+			flags->total_counts[plane]++;
+		} else {
+			flags->node_counts[plane][node_index]--;
+			flags->case_counts[plane][case_index]--;
+			flags->total_counts[plane]--;
+		}
+	}
+
+	if (plane == BLBN_FLAG_TARGET || plane == BLBN_FLAG_PURCHASED) {
+		blbn_flags_set (flags, BLBN_FLAG_AVAILABLE, node_index, case_index,
+			blbn_flags_get (flags, BLBN_FLAG_TARGET, node_index, case_index) || blbn_flags_get (flags, BLBN_FLAG_PURCHASED, node_index, case_index));
+	}
+}
+
+/**
+ * Returns a version of all flags: the sum of the case versions, which changes
+ * whenever any flag changes.
+ */
+unsigned long blbn_flags_version (const blbn_flags_t *flags) {
+	unsigned long version = 0;
+	int j;
+
+	for (j = 0; j < flags->case_count; j++) {
+		version += flags->case_versions[j];
+	}
+	return version;
+}
+
+/**
+ * Returns the number of nodes in the specified case that have the flag plane
+ * set and (unless not_plane is negative) the flag not_plane cleared.
+ */
+unsigned int blbn_flags_count_in_case (const blbn_flags_t *flags, int plane, int not_plane, unsigned int case_index) {
+	const uint64_t *words = &flags->by_case[plane][case_index * flags->case_words];
+	const uint64_t *not_words = (not_plane >= 0 ? &flags->by_case[not_plane][case_index * flags->case_words] : NULL);
+	unsigned int count = 0;
+	int w;
+
+	if (not_words == NULL) {
+		return flags->case_counts[plane][case_index];
+	}
+	for (w = 0; w < flags->case_words; w++) {
+		count += __builtin_popcountll (words[w] & ~not_words[w]);
+	}
+
+	return count;
+}
+
 char blbn_is_valid_node (blbn_state_t *state, unsigned int node_index) {
 	if (node_index < state->node_count) {
 		return 0x01;
@@ -478,14 +626,14 @@ char blbn_is_valid_finding (blbn_state_t *state, unsigned int node_index, unsign
 
 char blbn_is_target_finding (blbn_state_t *state, unsigned int node_index, unsigned int case_index) {
 	if (blbn_is_valid_finding (state, node_index, case_index)) {
-		return ((state->flags[node_index][case_index] & BLBN_METADATA_FLAG_TARGET) == BLBN_METADATA_FLAG_TARGET ? 0x01 : 0x00);
+		return blbn_flags_get (state->flags, BLBN_FLAG_TARGET, node_index, case_index);
 	}
 	return 0x00;
 }
 
 char blbn_is_purchased_finding (blbn_state_t *state, unsigned int node_index, unsigned int case_index) {
 	if (blbn_is_valid_finding (state, node_index, case_index)) {
-		return ((state->flags[node_index][case_index] & BLBN_METADATA_FLAG_PURCHASED) == BLBN_METADATA_FLAG_PURCHASED ? 0x01 : 0x00);
+		return blbn_flags_get (state->flags, BLBN_FLAG_PURCHASED, node_index, case_index);
 	}
 	return 0x00;
 }
@@ -494,10 +642,7 @@ char blbn_is_purchased_finding (blbn_state_t *state, unsigned int node_index, un
 char blbn_is_available_finding (blbn_state_t *state, unsigned int node_index, unsigned int case_index) {
 	if (state != NULL) {
 		if (blbn_is_valid_finding (state, node_index, case_index)) {
-			//if (blbn_is_target_finding (state, node_index, case_index) || blbn_is_purchased_finding (state, node_index, case_index)) {
-			if (blbn_is_target_finding (state, node_index, case_index) || blbn_is_purchased_finding (state, node_index, case_index)) {
-				return 0x01;
-			}
+			return blbn_flags_get (state->flags, BLBN_FLAG_AVAILABLE, node_index, case_index);
 		}
 	}
 	return 0x00;
@@ -505,176 +650,111 @@ char blbn_is_available_finding (blbn_state_t *state, unsigned int node_index, un
 
 char blbn_is_learned_finding (blbn_state_t *state, unsigned int node_index, unsigned int case_index) {
 	if (blbn_is_valid_finding (state, node_index, case_index)) {
-		return ((state->flags[node_index][case_index] & BLBN_METADATA_FLAG_LEARNED) == BLBN_METADATA_FLAG_LEARNED ? 0x01 : 0x00);
+		return blbn_flags_get (state->flags, BLBN_FLAG_LEARNED, node_index, case_index);
 	}
 	return 0x00;
 }
 
 char blbn_has_cases_available (blbn_state_t *state, unsigned int node_index) {
-	int i;
 	if (state != NULL) {
 		if (blbn_is_valid_node (state, node_index)) {
-			for (i = 0; i < state->case_count; ++i) {
-				//printf ("case %d avail?: %d\n", i, blbn_is_available_finding (state, node_index, i));
-				if (blbn_is_available_finding (state, node_index, i)) {
-					return 0x01;
-				}
-			}
+			return (state->flags->node_counts[BLBN_FLAG_AVAILABLE][node_index] > 0 ? 0x01 : 0x00);
 		}
 	}
 	return 0x00;
 }
 
 char blbn_has_findings_available_in_case (blbn_state_t *state, unsigned int case_index) {
-	int i;
 	if (state != NULL) {
 		if (blbn_is_valid_case (state, case_index)) {
-			for (i = 0; i < state->node_count; ++i) {
-				if (blbn_is_available_finding (state, i, case_index)) {
-					return 0x01;
-				}
-			}
+			return (state->flags->case_counts[BLBN_FLAG_AVAILABLE][case_index] > 0 ? 0x01 : 0x00);
 		}
 	}
 	return 0x00;
 }
 
 char blbn_has_findings_learned_in_case (blbn_state_t *state, unsigned int case_index) {
-	int i;
 	if (state != NULL) {
 		if (blbn_is_valid_case (state, case_index)) {
-			for (i = 0; i < state->node_count; ++i) {
-				if (blbn_is_learned_finding (state, i, case_index)) {
-					return 0x01;
-				}
-			}
+			return (state->flags->case_counts[BLBN_FLAG_LEARNED][case_index] > 0 ? 0x01 : 0x00);
 		}
 	}
 	return 0x00;
 }
 
 char blbn_has_cases_purchased (blbn_state_t *state, unsigned int node_index) {
-	int i;
 	if (state != NULL) {
 		if (blbn_is_valid_node (state, node_index)) {
-			for (i = 0; i < state->case_count; ++i) {
-				if (blbn_is_purchased_finding (state, node_index, i)) {
-					return 0x01;
-				}
-			}
+			return (state->flags->node_counts[BLBN_FLAG_PURCHASED][node_index] > 0 ? 0x01 : 0x00);
 		}
 	}
 	return 0x00;
 }
 
 char blbn_has_cases_not_purchased (blbn_state_t *state, unsigned int node_index) {
-	int i;
 	if (state != NULL) {
 		if (blbn_is_valid_node (state, node_index)) {
-			for (i = 0; i < state->case_count; ++i) {
-				if (!blbn_is_purchased_finding (state, node_index, i)) {
-					return 0x01;
-				}
-			}
+			return (state->flags->node_counts[BLBN_FLAG_PURCHASED][node_index] < state->case_count ? 0x01 : 0x00);
 		}
 	}
 	return 0x00;
 }
 
 char blbn_has_cases_learned (blbn_state_t *state, unsigned int node_index) {
-	int i;
 	if (state != NULL) {
 		if (blbn_is_valid_node (state, node_index)) {
-			for (i = 0; i < state->case_count; ++i) {
-				if (blbn_is_learned_finding (state, node_index, i)) {
-					return 0x01;
-				}
-			}
+			return (state->flags->node_counts[BLBN_FLAG_LEARNED][node_index] > 0 ? 0x01 : 0x00);
 		}
 	}
 	return 0x00;
 }
 
 char blbn_has_cases_not_learned (blbn_state_t *state, unsigned int node_index) {
-	int i;
 	if (state != NULL) {
 		if (blbn_is_valid_node (state, node_index)) {
-			for (i = 0; i < state->case_count; ++i) {
-				if (!blbn_is_learned_finding (state, node_index, i)) {
-					return 0x01;
-				}
-			}
+			return (state->flags->node_counts[BLBN_FLAG_LEARNED][node_index] < state->case_count ? 0x01 : 0x00);
 		}
 	}
 	return 0x00;
 }
 
 char blbn_has_findings_learned (blbn_state_t *state, unsigned int case_index) {
-	int i;
 	if (state != NULL) {
 		if (blbn_is_valid_case (state, case_index)) {
-			for (i = 0; i < state->node_count; ++i) {
-				if (blbn_is_learned_finding (state, i, case_index)) {
-					return 0x01;
-				}
-			}
+			return (state->flags->case_counts[BLBN_FLAG_LEARNED][case_index] > 0 ? 0x01 : 0x00);
 		}
 	}
 	return 0x00;
 }
 
 char blbn_has_findings_not_learned (blbn_state_t *state, unsigned int case_index) {
-	int i;
 	if (state != NULL) {
 		if (blbn_is_valid_case (state, case_index)) {
-			for (i = 0; i < state->node_count; ++i) {
-				if (!blbn_is_learned_finding (state, i, case_index)) {
-					return 0x01;
-				}
-			}
+			return (state->flags->case_counts[BLBN_FLAG_LEARNED][case_index] < state->node_count ? 0x01 : 0x00);
 		}
 	}
 	return 0x00;
 }
 
 char blbn_has_findings_available_not_learned (blbn_state_t *state, unsigned int case_index) {
-	int i;
 	if (state != NULL) {
 		if (blbn_is_valid_case (state, case_index)) {
-			for (i = 0; i < state->node_count; ++i) {
-				if (blbn_is_available_finding (state, i, case_index)) {
-					if (!blbn_is_learned_finding (state, i, case_index)) {
-						return 0x01;
-					}
-				}
-			}
+			return (blbn_flags_count_in_case (state->flags, BLBN_FLAG_AVAILABLE, BLBN_FLAG_LEARNED, case_index) > 0 ? 0x01 : 0x00);
 		}
 	}
 	return 0x00;
 }
 
 char blbn_has_findings_purchased (blbn_state_t *state) {
-	int i;
 	if (state != NULL) {
-		for (i = 0; i < state->case_count; ++i) {
-			if (blbn_has_findings_purchased_in_case (state, i)) {
-				return 0x01;
-			}
-		}
+		return (state->flags->total_counts[BLBN_FLAG_PURCHASED] > 0 ? 0x01 : 0x00);
 	}
 	return 0x00;
 }
 
 char blbn_has_findings_available (blbn_state_t *state) {
-	int i,j;
 	if (state != NULL) {
-		for (j = 0; j < state->case_count; ++j) {
-			for (i = 0; i < state->node_count; ++i) {
-				if (blbn_is_purchased_finding (state, i, j) || blbn_is_target_finding (state, i, j)) {
-					return 0x01;
-				}
-			}
-		}
+		return (state->flags->total_counts[BLBN_FLAG_AVAILABLE] > 0 ? 0x01 : 0x00);
 	}
 	return 0x00;
 }
@@ -684,54 +764,32 @@ char blbn_has_findings_available (blbn_state_t *state) {
  * finding for the target node.
  */
 char blbn_has_findings_not_available (blbn_state_t *state) {
-	int i,j;
 	if (state != NULL) {
-		for (j = 0; j < state->case_count; ++j) {
-			for (i = 0; i < state->node_count; ++i) {
-				if (!blbn_is_purchased_finding (state, i, j) && !blbn_is_target_finding (state, i, j)) {
-					return 0x01;
-				}
-			}
-		}
+		return (state->flags->total_counts[BLBN_FLAG_AVAILABLE] < (unsigned long) state->node_count * state->case_count ? 0x01 : 0x00);
 	}
 	return 0x00;
 }
 
 char blbn_has_findings_not_purchased (blbn_state_t *state) {
-	int i;
 	if (state != NULL) {
-		for (i = 0; i < state->case_count; ++i) {
-			if (blbn_has_findings_not_purchased_in_case (state, i)) {
-				return 0x01;
-			}
-		}
+		return (state->flags->total_counts[BLBN_FLAG_PURCHASED] < (unsigned long) state->node_count * state->case_count ? 0x01 : 0x00);
 	}
 	return 0x00;
 }
 
 char blbn_has_findings_purchased_in_case (blbn_state_t *state, unsigned int case_index) {
-	int i;
 	if (state != NULL) {
 		if (blbn_is_valid_case (state, case_index)) {
-			for (i = 0; i < state->node_count; ++i) {
-				if (blbn_is_purchased_finding (state, i, case_index)) {
-					return 0x01;
-				}
-			}
+			return (state->flags->case_counts[BLBN_FLAG_PURCHASED][case_index] > 0 ? 0x01 : 0x00);
 		}
 	}
 	return 0x00;
 }
 
 char blbn_has_findings_not_purchased_in_case (blbn_state_t *state, unsigned int case_index) {
-	int i;
 	if (state != NULL) {
 		if (blbn_is_valid_case (state, case_index)) {
-			for (i = 0; i < state->node_count; ++i) {
-				if (!blbn_is_purchased_finding (state, i, case_index)) {
-					return 0x01;
-				}
-			}
+			return (state->flags->case_counts[BLBN_FLAG_PURCHASED][case_index] < state->node_count ? 0x01 : 0x00);
 		}
 	}
 	return 0x00;
@@ -739,7 +797,7 @@ char blbn_has_findings_not_purchased_in_case (blbn_state_t *state, unsigned int
 
 int blbn_get_finding (blbn_state_t *state, unsigned int node_index, unsigned int case_index) {
 	if (node_index < state->node_count && case_index < state->case_count) {
-		return state->state [node_index][case_index];
+		return BLBN_STATE (state, node_index, case_index);
 	}
 	return -1;
 }
@@ -757,9 +815,13 @@ char* blbn_get_node_name (blbn_state_t *state, unsigned int node_index) {
  * Returns node index from static ordering in meta-data structure with the
  * specified name.  If the name isn't in the list, then -1 is returned.
  */
-int blbn_get_node_by_name (blbn_state_t *state, char *name) {
+int blbn_get_node_by_name (blbn_state_t *state, const char *name) {
+	unsigned int mask = state->name_table_size - 1;
+	unsigned int slot;
 	int i;
-	for (i = 0; i < state->node_count; i++) {
+
+	for (slot = blbn_util_hash_name (name) & mask; state->name_table[slot] != 0; slot = (slot + 1) & mask) {
+		i = state->name_table[slot] - 1;
 		if (strcmp (state->nodes[i], name) == 0) {
 			return i;
 		}
@@ -767,39 +829,211 @@ int blbn_get_node_by_name (blbn_state_t *state, char *name) {
 	return -1;
 }
 
+/**
+ * Returns the FNV-1a hash of a node name.
+ */
+unsigned int blbn_util_hash_name (const char *name) {
+	unsigned int hash = 2166136261u;
+
+	for (; *name != '\0'; name++) {
+		hash ^= (unsigned char) *name;
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+/**
+ * Builds the node name hash table used by blbn_get_node_by_name and the
+ * state counts from the static node names, and allocates and fills the
+ * handle table of the working network (see blbn_set_work_net).
+ */
+void blbn_util_index_nodes (blbn_state_t *state) {
+	unsigned int mask;
+	unsigned int slot;
+	int i;
+
+	state->name_table_size = 8;
+	while (state->name_table_size < 2 * (unsigned int) state->node_count) {
+		state->name_table_size *= 2;
+	}
+	mask = state->name_table_size - 1;
+	state->name_table = (int *) calloc (state->name_table_size, sizeof (int));
+	state->state_counts = (int *) malloc ((state->node_count + 1) * sizeof (int));
+	state->work_nodes = (node_bn **) malloc ((state->node_count + 1) * sizeof (node_bn *));
+	for (i = 0; i < state->node_count; i++) {
+		for (slot = blbn_util_hash_name (state->nodes[i]) & mask; state->name_table[slot] != 0; slot = (slot + 1) & mask);
+		state->name_table[slot] = i + 1;
+		state->work_nodes[i] = GetNodeNamed_bn (state->nodes[i], state->work_net);
+		state->state_counts[i] = GetNodeNumberStates_bn (state->work_nodes[i]);
+	}
+	state->evidence = blbn_evidence_new (state, state->work_net);
+}
+
+/**
+ * Replaces the working network with the specified network (deleting the
+ * previous one), and rebuilds the handle table that maps every static node
+ * index to its node in the new network, so the per-case and per-node loops
+ * address nodes by index instead of looking them up by name.  Every
+ * replacement of state->work_net goes through here.
+ */
+void blbn_set_work_net (blbn_state_t *state, net_bn *net) {
+	int i;
+
+	if (state->work_net != NULL && state->work_net != net) {
+		DeleteNet_bn (state->work_net);
+	}
+	state->work_net = net;
+
+	// NOTE: THIS IS IMPORTANT!
+	DeleteNodeList_bn (state->nodelist);
+	state->nodelist = DupNodeList_bn (GetNetNodes_bn (net));
+
+	for (i = 0; i < state->node_count; i++) {
+		state->work_nodes[i] = GetNodeNamed_bn (state->nodes[i], net);
+	}
+	blbn_evidence_free (state->evidence);
+	state->evidence = blbn_evidence_new (state, net);
+	blbn_work_net_changed (state);
+}
+
+/**
+ * Allocates an evidence manager for the specified network.  The findings
+ * already on the network are unknown to it, so the first findings applied
+ * replace them all.
+ */
+blbn_evidence_t* blbn_evidence_new (blbn_state_t *state, net_bn *net) {
+	blbn_evidence_t *evidence = (blbn_evidence_t *) calloc (1, sizeof (blbn_evidence_t));
+	int i;
+
+	evidence->net = net;
+	evidence->node_count = state->node_count;
+	evidence->nodes = (node_bn **) malloc ((state->node_count + 1) * sizeof (node_bn *));
+	evidence->entered = (int *) malloc ((state->node_count + 1) * sizeof (int));
+	evidence->pending = (int *) malloc ((state->node_count + 1) * sizeof (int));
+	for (i = 0; i < state->node_count; i++) {
+		evidence->nodes[i] = GetNodeNamed_bn (state->nodes[i], net);
+		evidence->entered[i] = NO_FINDING;
+	}
+	evidence->valid = 0;
+
+	return evidence;
+}
+
+void blbn_evidence_free (blbn_evidence_t *evidence) {
+	if (evidence != NULL) {
+		free (evidence->nodes);
+		free (evidence->entered);
+		free (evidence->pending);
+		free (evidence);
+	}
+}
+
+/**
+ * Makes findings (indexed by static node index, negative for no finding)
+ * the findings of the network, retracting and entering only the findings
+ * that differ from those entered before.  Consecutive evidence vectors of
+ * the same case usually differ in one or two findings, and findings that
+ * don't change leave the network's propagation valid.
+ */
+void blbn_evidence_apply (blbn_evidence_t *evidence, const int *findings) {
+	int finding;
+	int i;
+
+	if (!evidence->valid) {
+		blbn_evidence_retract (evidence);
+	}
+	for (i = 0; i < evidence->node_count; i++) {
+		finding = (findings[i] >= 0 ? findings[i] : NO_FINDING);
+		if (finding != evidence->entered[i]) {
+			if (finding != NO_FINDING) {
+				EnterFinding_bn (evidence->nodes[i], finding);
+				blbn_counters.findings_entered++;
+			} else {
+				RetractNodeFindings_bn (evidence->nodes[i]);
+			}
+			evidence->entered[i] = finding;
+		}
+	}
+}
+
+/**
+ * Changes the finding of one node (negative for no finding), leaving the
+ * other findings entered.
+ */
+void blbn_evidence_set (blbn_evidence_t *evidence, int node_index, int finding) {
+	if (!evidence->valid) {
+		blbn_evidence_retract (evidence);
+	}
+	finding = (finding >= 0 ? finding : NO_FINDING);
+	if (finding != evidence->entered[node_index]) {
+		if (finding != NO_FINDING) {
+			EnterFinding_bn (evidence->nodes[node_index], finding);
+			blbn_counters.findings_entered++;
+		} else {
+			RetractNodeFindings_bn (evidence->nodes[node_index]);
+		}
+		evidence->entered[node_index] = finding;
+	}
+}
+
+/**
+ * Retracts every finding of the network.
+ */
+void blbn_evidence_retract (blbn_evidence_t *evidence) {
+	int i;
+
+	RetractNetFindings_bn (evidence->net);
+	for (i = 0; i < evidence->node_count; i++) {
+		evidence->entered[i] = NO_FINDING;
+	}
+	evidence->valid = 1;
+}
+
+/**
+ * Retracts every finding of the specified network, through the evidence
+ * manager of the working network if it is the working network.
+ */
+void blbn_util_retract_net_findings (blbn_state_t *state, net_bn *net) {
+	if (net == state->work_net) {
+		blbn_evidence_retract (state->evidence);
+	} else {
+		RetractNetFindings_bn (net);
+	}
+}
+
 void blbn_set_finding_target (blbn_state_t *state, unsigned int node_index, unsigned int case_index) {
 	if (blbn_is_valid_finding (state, node_index, case_index)) {
-		state->flags[node_index][case_index] |= BLBN_METADATA_FLAG_TARGET;
+		blbn_flags_set (state->flags, BLBN_FLAG_TARGET, node_index, case_index, 0x01);
 	}
 }
 
 void blbn_set_finding_not_target (blbn_state_t *state, unsigned int node_index, unsigned int case_index) {
 	if (blbn_is_valid_finding (state, node_index, case_index)) {
-		state->flags[node_index][case_index] &= ~BLBN_METADATA_FLAG_TARGET;
+		blbn_flags_set (state->flags, BLBN_FLAG_TARGET, node_index, case_index, 0x00);
 	}
 }
 
 void blbn_set_finding_purchased (blbn_state_t *state, unsigned int node_index, unsigned int case_index) {
 	if (blbn_is_valid_finding (state, node_index, case_index)) {
-		state->flags[node_index][case_index] |= BLBN_METADATA_FLAG_PURCHASED;
+		blbn_flags_set (state->flags, BLBN_FLAG_PURCHASED, node_index, case_index, 0x01);
 	}
 }
 
 void blbn_set_finding_not_purchased (blbn_state_t *state, unsigned int node_index, unsigned int case_index) {
 	if (blbn_is_valid_finding (state, node_index, case_index)) {
-		state->flags[node_index][case_index] &= ~BLBN_METADATA_FLAG_PURCHASED;
+		blbn_flags_set (state->flags, BLBN_FLAG_PURCHASED, node_index, case_index, 0x00);
 	}
 }
 
 void blbn_set_finding_learned (blbn_state_t *state, unsigned int node_index, unsigned int case_index) {
 	if (blbn_is_valid_finding (state, node_index, case_index)) {
-		state->flags[node_index][case_index] |= BLBN_METADATA_FLAG_LEARNED;
+		blbn_flags_set (state->flags, BLBN_FLAG_LEARNED, node_index, case_index, 0x01);
 	}
 }
 
 void blbn_set_finding_not_learned (blbn_state_t *state, unsigned int node_index, unsigned int case_index) {
 	if (blbn_is_valid_finding (state, node_index, case_index)) {
-		state->flags[node_index][case_index] &= ~BLBN_METADATA_FLAG_LEARNED;
+		blbn_flags_set (state->flags, BLBN_FLAG_LEARNED, node_index, case_index, 0x00);
 	}
 }
 
@@ -811,31 +1045,41 @@ void blbn_set_finding_not_learned (blbn_state_t *state, unsigned int node_index,
  */
 void blbn_set_node_finding_if_available (blbn_state_t *state, int node_index, int case_index) {
 
-	char *node_name = NULL;
-	node_bn *node = NULL;
-	int node_state = -1; // NOTE: typedef state_bn int; (so using int is fine)
-
 	if (state != NULL) {
 		if (state->work_net != NULL) {
-			// Get the node:
-			// 1. Get node name by indexing into mmodel
-			// 2. Get node by name from net_bn, if prev. step succeeded
-			// 3. Set state of node
-			node_name = blbn_get_node_name (state, node_index);
-			node = GetNodeNamed_bn (node_name, state->work_net);
-
-			RetractNodeFindings_bn (node); // Retract node findings
-
-			// Get the state from the data set
-			if (blbn_is_available_finding (state, node_index, case_index)) { // Checks if finding is available (target or purchased)
-				node_state = blbn_get_finding (state, node_index, case_index);
-				if (node_state != -1) {
-					// Set the state of the node to that in the data set (if available, purchased or free)
-					EnterFinding_bn (node, node_state);
-				}
-			}
+			// Set the state of the node to that in the data set (if available, purchased or free)
+			blbn_evidence_set (state->evidence, node_index, blbn_get_available_finding (state, node_index, case_index));
+		}
+	}
+}
+
+/**
+ * Returns the finding of the specified node in the specified case if it is
+ * available (a target or purchased finding with a known value), or -1.
+ */
+int blbn_get_available_finding (blbn_state_t *state, int node_index, int case_index) {
+	if (blbn_is_available_finding (state, node_index, case_index)) { // Checks if finding is available (target or purchased)
+		return blbn_get_finding (state, node_index, case_index);
+	}
+	return -1;
+}
+
+/**
+ * Returns true if every parent of the specified node has a finding in
+ * findings (a vector of findings indexed by static node index).
+ */
+char blbn_util_parents_in_findings (blbn_state_t *state, int node_index, const int *findings) {
+	int p;
+
+	if (state->graph == NULL) {
+		state->graph = blbn_graph_new (state);
+	}
+	for (p = state->graph->parent_offset[node_index]; p < state->graph->parent_offset[node_index + 1]; p++) {
+		if (findings[state->graph->parents[p]] < 0) {
+			return 0x00;
 		}
 	}
+	return 0x01;
 }
 
 
@@ -846,30 +1090,17 @@ void blbn_set_node_finding_if_available (blbn_state_t *state, int node_index, in
  */
 void blbn_assert_node_finding_for_case (blbn_state_t *state, int node_index, int case_index, int state_index) {
 
-	char *node_name = NULL;
-	node_bn *node = NULL;
-
 	if (state != NULL) {
 		if (state->work_net != NULL) {
-			// Get the node by with the specified index
-			node_name = blbn_get_node_name (state, node_index);
-			node = GetNodeNamed_bn (node_name, state->work_net);
-
-			// Retract node findings (if any)
-			RetractNodeFindings_bn (node);
-
 			// Assert the state as the finding for the node with the specified index
-			//node_state = blbn_get_finding (state, node_index, case_index);
-			if (state_index != -1) {
-				EnterFinding_bn (node, state_index);
-			}
+			// (or retract the node's finding if state_index is -1)
+			blbn_evidence_set (state->evidence, node_index, state_index);
 		}
 	}
 }
 
 char blbn_has_parents_with_findings (blbn_state_t *state, int node_index, int case_index) {
 
-	char *node_name = NULL;
 	node_bn *node = NULL;
 	node_bn *parent = NULL;
 	nodelist_bn *parents = NULL;
@@ -883,8 +1114,7 @@ char blbn_has_parents_with_findings (blbn_state_t *state, int node_index, int ca
 	*/
 
 	// Get the node
-	node_name = blbn_get_node_name (state, node_index);
-	node = GetNodeNamed_bn (node_name, state->work_net);
+	node = BLBN_WORK_NODE (state, node_index);
 
 	// Get node's parents
 	parents = GetNodeParents_bn (node);
@@ -912,29 +1142,35 @@ char blbn_has_parents_with_findings (blbn_state_t *state, int node_index, int ca
 
 /**
  * Sets available findings in the specified case.
+ *
+ * The blbn_set_net_findings_* functions build the findings of the case in
+ * state->evidence->pending and apply them to the working network as
+ * differences from the findings entered before (see blbn_evidence_apply),
+ * instead of retracting every finding and entering them all again.
  */
 void blbn_set_net_findings (blbn_state_t *state, int case_index) {
 
+	int *findings = state->evidence->pending;
 	int i;
 
-	RetractNetFindings_bn (state->work_net); // Retracts all findings from net
-
 	for (i = 0; i < state->node_count; ++i) {
-		blbn_set_node_finding_if_available (state, i, case_index);
+		findings[i] = blbn_get_available_finding (state, i, case_index);
 	}
+	blbn_evidence_apply (state->evidence, findings);
 }
 
 void blbn_set_net_findings_learned (blbn_state_t *state, int case_index) {
 
+	int *findings = state->evidence->pending;
 	int i;
 
-	RetractNetFindings_bn (state->work_net); // Retracts all findings from net
-
 	for (i = 0; i < state->node_count; ++i) {
+		findings[i] = -1;
 		if (blbn_is_learned_finding (state, i, case_index)) {
-			blbn_set_node_finding_if_available (state, i, case_index);
+			findings[i] = blbn_get_available_finding (state, i, case_index);
 		}
 	}
+	blbn_evidence_apply (state->evidence, findings);
 }
 
 /**
@@ -943,62 +1179,66 @@ void blbn_set_net_findings_learned (blbn_state_t *state, int case_index) {
  */
 void blbn_set_net_findings_learned_except_target (blbn_state_t *state, int case_index) {
 
+	int *findings = state->evidence->pending;
 	int i;
 
-	RetractNetFindings_bn (state->work_net); // Retracts all findings from net
-
 	for (i = 0; i < state->node_count; ++i) {
+		findings[i] = -1;
 		if (blbn_is_learned_finding (state, i, case_index)) {
 			if (!blbn_is_target_finding(state, i, case_index)) {
-				blbn_set_node_finding_if_available (state, i, case_index);
+				findings[i] = blbn_get_available_finding (state, i, case_index);
 			}
 		}
 	}
+	blbn_evidence_apply (state->evidence, findings);
 }
 
+/**
+ * Sets the learned findings of the case whose parents all have findings.
+ * The nodes are visited in static order, so a parent counts only if its own
+ * finding was set before the node's.
+ */
 void blbn_set_net_findings_learned_with_parents (blbn_state_t *state, int case_index) {
 
+	int *findings = state->evidence->pending;
 	int i;
 
-	RetractNetFindings_bn (state->work_net); // Retracts all findings from net
-
 	for (i = 0; i < state->node_count; ++i) {
+		findings[i] = -1;
 		if (blbn_is_learned_finding (state, i, case_index)) {
-			printf ("<< %d >> ", blbn_has_parents_with_findings (state, i, case_index));
-			if (blbn_has_parents_with_findings (state, i, case_index)) {
-				blbn_set_node_finding_if_available (state, i, case_index);
+			printf ("<< %d >> ", blbn_util_parents_in_findings (state, i, findings));
+			if (blbn_util_parents_in_findings (state, i, findings)) {
+				findings[i] = blbn_get_available_finding (state, i, case_index);
 			}
 		}
 	}
 	printf ("\n");
+	blbn_evidence_apply (state->evidence, findings);
 }
 
 void blbn_set_net_findings_available (blbn_state_t *state, int case_index) {
 
-	int i;
-
-	RetractNetFindings_bn (state->work_net); // Retracts all findings from net
-
-	for (i = 0; i < state->node_count; ++i) {
-		if (blbn_is_available_finding (state, i, case_index)) { // Checks if finding is available (target or purchased)
-			blbn_set_node_finding_if_available (state, i, case_index);
-		}
-	}
+	blbn_set_net_findings (state, case_index);
 }
 
+/**
+ * Sets the available findings of the case whose parents all have findings
+ * (in static order, as blbn_set_net_findings_learned_with_parents).
+ */
 void blbn_set_net_findings_available_with_parents (blbn_state_t *state, int case_index) {
 
+	int *findings = state->evidence->pending;
 	int i;
 
-	RetractNetFindings_bn (state->work_net); // Retracts all findings from net
-
 	for (i = 0; i < state->node_count; ++i) {
+		findings[i] = -1;
 		if (blbn_is_available_finding (state, i, case_index)) { // Checks if finding is available (target or purchased)
-			if (blbn_has_parents_with_findings (state, i, case_index)) {
-				blbn_set_node_finding_if_available (state, i, case_index);
+			if (blbn_util_parents_in_findings (state, i, findings)) {
+				findings[i] = blbn_get_available_finding (state, i, case_index);
 			}
 		}
 	}
+	blbn_evidence_apply (state->evidence, findings);
 }
 
 void blbn_set_prior_belief_state (blbn_state_t *state) {
@@ -1009,11 +1249,9 @@ void blbn_set_prior_belief_state (blbn_state_t *state) {
 void blbn_restore_prior_network (blbn_state_t *state) {
 	if (state != NULL) {
 		if (state->work_net != NULL && state->prior_net != NULL) {
-			DeleteNet_bn (state->work_net); // Deletes working copy of the network
-
-			state->work_net = CopyNet_bn (state->prior_net, GetNetName_bn (state->prior_net), env, "no_visual"); // Create new working copy of network from original network
-			// NOTE: THIS IS IMPORTANT!
-			state->nodelist = DupNodeList_bn (GetNetNodes_bn (state->work_net));
+			// Replace the working copy of the network with a new copy of the prior network
+			blbn_set_work_net (state, CopyNet_bn (state->prior_net, GetNetName_bn (state->prior_net), env, "no_visual"));
+			blbn_counters.net_copies++;
 			//printf("here 4!\n");
 		}
 	}
@@ -1099,30 +1337,20 @@ void blbn_revise_by_case_findings_v2 (blbn_state_t *state, int case_index) {
  */
 void blbn_learn_case_v1 (blbn_state_t *state, int case_index) {
 
-	int i, j;
-	nodelist_bn *nodes = NULL;
-	node_bn *node = NULL;
+	int j;
 	state_bn *node_finding = NULL;
-	char *node_name = NULL;
 
 	if (state != NULL) {
 		if (state->work_net != NULL) {
-			nodes = GetNetNodes_bn (state->work_net);
-
 			printf ("STORY> Updating with case %d: ", case_index);
 
 			// Set findings available (purchased or targets)
 			blbn_set_net_findings_available_with_parents (state, case_index);
 
 			// Set state of node to "learned"
-			for (i = 0; i < LengthNodeList_bn (nodes); i++) {
-				node = NthNode_bn (nodes, i);
-				node_finding = GetNodeFinding_bn (node);
+			for (j = 0; j < state->node_count; j++) {
+				node_finding = GetNodeFinding_bn (BLBN_WORK_NODE (state, j));
 				if (node_finding >= 0) {
-					node_name = GetNodeName_bn (node);
-
-					j = blbn_get_node_by_name (state, node_name);
-
 					if (blbn_is_available_finding (state, j, case_index) && !blbn_is_learned_finding (state, j, case_index)) {
 						blbn_set_finding_learned (state, j, case_index);
 						printf ("[%d] ", j);
@@ -1133,6 +1361,7 @@ void blbn_learn_case_v1 (blbn_state_t *state, int case_index) {
 
 			// Revise CPTs
 			ReviseCPTsByFindings_bn (GetNetNodes_bn (state->work_net), 0, 1.0); // Learn (not unlearn) --- Update CPTs of network based on findings on the network
+			blbn_work_net_changed (state);
 		}
 	}
 }
@@ -1151,21 +1380,16 @@ void blbn_learn_case_v2 (blbn_state_t *state, int case_index) {
 	caseposn_bn casepon;
 	caseset_cs  *caseset   = NULL; // Case set where temporary case output will be read into
 	nodelist_bn *nodes     = NULL;
-	node_bn     *node      = NULL;
 	state_bn *node_finding = NULL;
-	char *node_name        = NULL;
 	learner_bn  *learner   = NULL;
 
 	// Get list of network's nodes
 	nodes = GetNetNodes_bn (state->work_net);
 
 	// Set state of node to "not learned"
-	for (i = 0; i < LengthNodeList_bn (nodes); i++) {
-		node = NthNode_bn (nodes, i);
-		node_finding = GetNodeFinding_bn (node);
+	for (j = 0; j < state->node_count; j++) {
+		node_finding = GetNodeFinding_bn (BLBN_WORK_NODE (state, j));
 		if (node_finding >= 0) {
-			node_name = GetNodeName_bn (node);
-			j = blbn_get_node_by_name (state, node_name);
 			if (blbn_is_available_finding (state, j, case_index)) {
 				blbn_set_finding_learned (state, j, case_index);
 				if (BLBN_STDOUT)
@@ -1199,15 +1423,18 @@ void blbn_learn_case_v2 (blbn_state_t *state, int case_index) {
 	// Load case in temporary *.cas file into new case set (contains only that single case)
 	//tmp_case = NewCaseset_cs ("./temp_case.cas", env); // TODO: Update to env
 	caseset = NewCaseset_cs (NULL, env); // TODO: Update to env
+	blbn_counters.stream_bytes += blbn_stream_length (casefile);
 	AddFileToCaseset_cs (caseset, casefile, 1.0, NULL);
 
-	RetractNetFindings_bn (state->work_net);
+	blbn_evidence_retract (state->evidence);
 
 	// Create learner using EM learning method (updates CPTs in EM style)
 	learner = NewLearner_bn (EM_LEARNING, NULL, env); // TODO: Update to env
 
 	// Learn cases using EM learner and temporary case file
 	LearnCPTs_bn (learner, nodes, caseset, 1.0); // Degree must be greater than zero
+	blbn_counters.em_runs++;
+	blbn_work_net_changed (state);
 
 	// Cleanup for function call
 	DeleteLearner_bn (learner);
@@ -1247,14 +1474,12 @@ void blbn_learn_case_v2_cumulative (blbn_state_t *state, int case_index) {
 	// Create learner using EM method (NewLearner_bn)
 	// Learn cases using EM learner and saved CAS file (LearnCPTs_bn)
 
-	int i,j;
+	int j;
 	stream_ns   *casefile = NULL; // Used as temporary output location for case
 	caseposn_bn casepon;
 	caseset_cs  *caseset  = NULL; // Case set where temporary case output will be read into
 	nodelist_bn *nodes    = NULL;
-	node_bn     *node     = NULL;
 	state_bn *node_finding = NULL;
-	char *node_name = NULL;
 	learner_bn  *learner  = NULL;
 
 	// Get list of network's nodes
@@ -1267,14 +1492,9 @@ void blbn_learn_case_v2_cumulative (blbn_state_t *state, int case_index) {
 	//printf ("Updating with case %d: ", case_index);
 
 	// Set state of node to "learned"
-	for (i = 0; i < LengthNodeList_bn (nodes); i++) {
-		node = NthNode_bn (nodes, i);
-		node_finding = GetNodeFinding_bn (node);
+	for (j = 0; j < state->node_count; j++) {
+		node_finding = GetNodeFinding_bn (BLBN_WORK_NODE (state, j));
 		if (node_finding >= 0) {
-			node_name = GetNodeName_bn (node);
-
-			j = blbn_get_node_by_name (state, node_name);
-
 			if (blbn_is_available_finding (state, j, case_index) && !blbn_is_learned_finding (state, j, case_index)) {
 				blbn_set_finding_learned (state, j, case_index);
 				//fprintf (log_fp, "[%d] ", j);
@@ -1291,15 +1511,18 @@ void blbn_learn_case_v2_cumulative (blbn_state_t *state, int case_index) {
 	// Load case in temporary *.cas file into new case set (contains only that single case)
 	//tmp_case = NewCaseset_cs ("./temp_case.cas", env); // TODO: Update to env
 	caseset = NewCaseset_cs (NULL, env); // TODO: Update to env
+	blbn_counters.stream_bytes += blbn_stream_length (casefile);
 	AddFileToCaseset_cs (caseset, casefile, 1.0, NULL);
 
-	RetractNetFindings_bn(state->work_net);
+	blbn_evidence_retract (state->evidence);
 
 	// Create learner using EM learning method (updates CPTs in EM style)
 	learner = NewLearner_bn (EM_LEARNING, NULL, env); // TODO: Update to env
 
 	// Learn cases using EM learner and temporary case file
 	LearnCPTs_bn (learner, nodes, caseset, 1.0);
+	blbn_counters.em_runs++;
+	blbn_work_net_changed (state);
 
 	// Cleanup for function call
 	DeleteLearner_bn (learner);
@@ -1313,9 +1536,7 @@ void blbn_unlearn_case_v1 (blbn_state_t *state, int case_index) {
 
 	int i, j;
 	nodelist_bn *nodes = NULL;
-	node_bn *node = NULL;
 	state_bn *node_finding = NULL;
-	char *node_name = NULL;
 
 	if (state != NULL) {
 		if (state->work_net != NULL) {
@@ -1333,14 +1554,9 @@ void blbn_unlearn_case_v1 (blbn_state_t *state, int case_index) {
 			printf (" >>>>>\n");
 
 			// Set state of node to "not learned"
-			for (i = 0; i < LengthNodeList_bn (nodes); i++) {
-				node = NthNode_bn (nodes, i);
-				node_finding = GetNodeFinding_bn (node);
+			for (j = 0; j < state->node_count; j++) {
+				node_finding = GetNodeFinding_bn (BLBN_WORK_NODE (state, j));
 				if (node_finding >= 0) {
-					node_name = GetNodeName_bn (node);
-
-					j = blbn_get_node_by_name (state, node_name);
-
 					if (blbn_is_learned_finding (state, j, case_index)) {
 						blbn_set_finding_not_learned (state, j, case_index);
 						printf ("<%d> ", j);
@@ -1351,6 +1567,7 @@ void blbn_unlearn_case_v1 (blbn_state_t *state, int case_index) {
 
 			// Revise CPTs
 			ReviseCPTsByFindings_bn (GetNetNodes_bn (state->work_net), 0, -1.0); // Learn (not unlearn) --- Update CPTs of network based on findings on the network
+			blbn_work_net_changed (state);
 		}
 	}
 }
@@ -1374,9 +1591,7 @@ void blbn_unlearn_case_v2 (blbn_state_t *state, int case_index) {
 	caseposn_bn casepon;
 	caseset_cs  *caseset   = NULL; // Case set where temporary case output will be read into
 	nodelist_bn *nodes     = NULL;
-	node_bn     *node      = NULL;
 	state_bn *node_finding = NULL;
-	char *node_name        = NULL;
 	learner_bn  *learner   = NULL;
 
 	// Get list of network's nodes
@@ -1388,14 +1603,9 @@ void blbn_unlearn_case_v2 (blbn_state_t *state, int case_index) {
 	blbn_set_net_findings_learned (state, case_index);
 
 	// Set state of node to "not learned"
-	for (i = 0; i < LengthNodeList_bn (nodes); i++) {
-		node = NthNode_bn (nodes, i);
-		node_finding = GetNodeFinding_bn (node);
+	for (j = 0; j < state->node_count; j++) {
+		node_finding = GetNodeFinding_bn (BLBN_WORK_NODE (state, j));
 		if (node_finding >= 0) {
-			node_name = GetNodeName_bn (node);
-
-			j = blbn_get_node_by_name (state, node_name);
-
 			if (blbn_is_learned_finding (state, j, case_index)) {
 				blbn_set_finding_not_learned (state, j, case_index);
 			}
@@ -1420,20 +1630,22 @@ void blbn_unlearn_case_v2 (blbn_state_t *state, int case_index) {
 	blbn_restore_prior_network (state);
 	// Get list of network's nodes
 	nodes = GetNetNodes_bn (state->work_net); // NOTE: THIS IS IMPORTANT!
-	state->nodelist = DupNodeList_bn (nodes);
 
 	// Load case in temporary *.cas file into new case set (contains only that single case)
 	//tmp_case = NewCaseset_cs ("./temp_case.cas", env); // TODO: Update to env
 	caseset = NewCaseset_cs (NULL, env); // TODO: Update to env
+	blbn_counters.stream_bytes += blbn_stream_length (casefile);
 	AddFileToCaseset_cs (caseset, casefile, 1.0, NULL);
 
-	RetractNetFindings_bn (state->work_net);
+	blbn_evidence_retract (state->evidence);
 
 	// Create learner using EM learning method (updates CPTs in EM style)
 	learner = NewLearner_bn (EM_LEARNING, NULL, env); // TODO: Update to env
 
 	// Learn cases using EM learner and temporary case file
 	LearnCPTs_bn (learner, nodes, caseset, 1.0); // Degree must be greater than zero
+	blbn_counters.em_runs++;
+	blbn_work_net_changed (state);
 
 	// Cleanup for function call
 	DeleteLearner_bn (learner);
@@ -1442,380 +1654,1501 @@ void blbn_unlearn_case_v2 (blbn_state_t *state, int case_index) {
 }
 
 /**
- * Returns an array of both the error rate and logarithmic loss for the
- * working network.
+ * Returns the number of entries (parent configurations times node states) in
+ * the CPT of the specified node.
  */
-double* blbn_get_test_rates (blbn_state_t *state) {
+unsigned int blbn_util_node_table_size (node_bn *node) {
+	const nodelist_bn *parents = GetNodeParents_bn (node);
+	unsigned int size = GetNodeNumberStates_bn (node);
+	int i;
 
-	double* test_rates = NULL;
+	for (i = 0; i < LengthNodeList_bn (parents); i++) {
+		size *= GetNodeNumberStates_bn (NthNode_bn (parents, i));
+	}
 
-	test_rates = (double *) malloc (2 * sizeof (double));
+	return size;
+}
 
-	nodelist_bn* unobserved_nodes = NewNodeList2_bn (0, state->work_net);
-	nodelist_bn* test_nodes       = NewNodeList2_bn (0, state->work_net);
-	node_bn*     test_node        = GetNodeNamed_bn (blbn_get_node_name (state, state->target), state->work_net); // node_bn* test_node = GetNodeNamed_bn ("Cancer", net);
+/**
+ * Advances parent_states to the next configuration of the parents (the last
+ * parent varies fastest, which is the order of Netica's CPTs).  Returns 0
+ * after the last configuration has been visited.
+ */
+int blbn_util_next_parent_states (const nodelist_bn *parents, state_bn *parent_states) {
+	int i;
 
-	// Add test nodes
-	AddNodeToList_bn (test_node, test_nodes, LAST_ENTRY);
+	for (i = LengthNodeList_bn (parents) - 1; i >= 0; i--) {
+		if (++parent_states[i] < GetNodeNumberStates_bn (NthNode_bn (parents, i))) {
+			return 1;
+		}
+		parent_states[i] = 0;
+	}
 
-	// Add unobserved nodes, if any (these are the other nodes not known during diagnosis/classification)
-	/*
-	e.g., AddNodeToList_bn (GetNodeNamed_bn ("Tuberculosis", net), unobsv_nodes, LAST_ENTRY);
-	e.g., AddNodeToList_bn (GetNodeNamed_bn ("Bronchitis", net), unobsv_nodes, LAST_ENTRY);
-	e.g., AddNodeToList_bn (GetNodeNamed_bn ("TbOrCa", net), unobsv_nodes, LAST_ENTRY);
-	*/
+	return 0;
+}
 
-	RetractNetFindings_bn (state->work_net); // IMPORTANT: Otherwise any findings will be part of tests !!
-	CompileNet_bn (state->work_net);
+/**
+ * Reads the expected counts (probability times experience) of every entry in
+ * the CPT of the specified node into counts.  Nodes without an experience
+ * table are treated as having an experience of one per parent configuration.
+ */
+void blbn_util_get_node_counts (node_bn *node, double *counts) {
+	const nodelist_bn *parents = GetNodeParents_bn (node);
+	int parent_count = LengthNodeList_bn (parents);
+	int state_count = GetNodeNumberStates_bn (node);
+	state_bn *parent_states = (state_bn *) calloc (parent_count + 1, sizeof (state_bn));
+	const prob_bn *probs = NULL;
+	double experience;
+	int k;
+
+	do {
+		probs = GetNodeProbs_bn (node, parent_states);
+		experience = GetNodeExperience_bn (node, parent_states);
+		if (!(experience >= 0.0)) { // negative or UNDEF_DBL (no experience table)
+			experience = 1.0;
+		}
+		for (k = 0; k < state_count; k++) {
+			counts[k] = (probs != NULL ? probs[k] : 1.0 / state_count) * experience;
+		}
+		counts += state_count;
+	} while (blbn_util_next_parent_states (parents, parent_states));
+
+	free (parent_states);
+}
 
-	tester_bn* tester = NewNetTester_bn (test_nodes, unobserved_nodes, -1);
+/**
+ * Writes expected counts back into the CPT and experience table of the
+ * specified node (the inverse of blbn_util_get_node_counts).  A parent
+ * configuration without any counts gets a uniform distribution.
+ */
+void blbn_util_set_node_counts (node_bn *node, const double *counts) {
+	const nodelist_bn *parents = GetNodeParents_bn (node);
+	int parent_count = LengthNodeList_bn (parents);
+	int state_count = GetNodeNumberStates_bn (node);
+	state_bn *parent_states = (state_bn *) calloc (parent_count + 1, sizeof (state_bn));
+	prob_bn *probs = (prob_bn *) malloc (state_count * sizeof (prob_bn));
+	double experience;
+	int k;
+
+	do {
+		experience = 0.0;
+		for (k = 0; k < state_count; k++) {
+			experience += counts[k];
+		}
+		for (k = 0; k < state_count; k++) {
+			probs[k] = (experience > 0.0 ? counts[k] / experience : 1.0 / state_count);
+		}
+		SetNodeProbs_bn (node, parent_states, probs);
+		SetNodeExperience_bn (node, parent_states, experience);
+		counts += state_count;
+	} while (blbn_util_next_parent_states (parents, parent_states));
+
+	free (probs);
+	free (parent_states);
+}
 
-	// Test with the validatio nset
-	TestWithCaseset_bn (tester, state->validation_caseset);
+/**
+ * Reads the expected counts of every node in the specified network into the
+ * flattened counts array (laid out according to stats->offset).
+ */
+void blbn_util_get_net_counts (blbn_state_t *state, net_bn *net, double *counts) {
+	const nodelist_bn *nodes = GetNetNodes_bn (net);
+	int i;
 
-	// Store error rates
-	test_rates[0] = GetTestErrorRate_bn (tester, test_node);
-	test_rates[1] = GetTestLogLoss_bn (tester, test_node);
+	for (i = 0; i < state->node_count; i++) {
+		blbn_util_get_node_counts (NthNode_bn (nodes, i), &counts[state->suff_stats->offset[i]]);
+	}
+}
 
-	DeleteNetTester_bn (tester);
-	DeleteNodeList_bn (unobserved_nodes);
-	DeleteNodeList_bn(test_nodes);
+/**
+ * Writes the expected counts of the incremental learner back into the CPTs of
+ * the working network.
+ */
+void blbn_util_set_net_counts (blbn_state_t *state) {
+	const nodelist_bn *nodes = GetNetNodes_bn (state->work_net);
+	int i;
 
-	return test_rates;
+	for (i = 0; i < state->node_count; i++) {
+		blbn_util_set_node_counts (NthNode_bn (nodes, i), &state->suff_stats->counts[state->suff_stats->offset[i]]);
+	}
 }
 
-double blbn_get_error_rate (blbn_state_t *state) {
+/**
+ * Learns the learned findings of the specified case into the specified
+ * network using at most max_iterations iterations of Netica's EM_LEARNING
+ * algorithm, starting from (and adding to) the network's present CPTs.
+ */
+void blbn_util_net_learn_case_em (blbn_state_t *state, net_bn *net, int case_index, int max_iterations) {
+	stream_ns   *casefile  = NULL; // Used as temporary output location for case
+	caseset_cs  *caseset   = NULL; // Case set where temporary case output will be read into
+	learner_bn  *learner   = NULL;
 
-	double error_rate = 1.0;
+	// Write the learned findings of the case to memory
+	casefile = NewMemoryStream_ns ("incremental.cas", env, NULL);
+	blbn_set_net_findings_learned (state, case_index);
+	WriteNetFindings_bn (GetNetNodes_bn (state->work_net), casefile, case_index, 1.0);
 
-	//net_bn* net = ReadNet_bn (NewFileStream_ns ("./data/Alarm/Alarm.dne", env, NULL), NO_VISUAL_INFO);
-	nodelist_bn* unobserved_nodes = NewNodeList2_bn (0, state->work_net);
-	nodelist_bn*   test_nodes = NewNodeList2_bn (0, state->work_net);
-	node_bn* test_node = GetNodeNamed_bn (blbn_get_node_name (state, state->target), state->work_net); // node_bn* test_node = GetNodeNamed_bn ("Cancer", net);
+	caseset = NewCaseset_cs (NULL, env);
+	blbn_counters.stream_bytes += blbn_stream_length (casefile);
+	AddFileToCaseset_cs (caseset, casefile, 1.0, NULL);
 
-	// Add test nodes
-	AddNodeToList_bn (test_node, test_nodes, LAST_ENTRY);
+	blbn_util_retract_net_findings (state, net);
 
-	// Add unobserved nodes, if any (these are the other nodes not known during diagnosis/classification)
-	/*
-	e.g., AddNodeToList_bn (GetNodeNamed_bn ("Tuberculosis", net), unobsv_nodes, LAST_ENTRY);
-	e.g., AddNodeToList_bn (GetNodeNamed_bn ("Bronchitis", net), unobsv_nodes, LAST_ENTRY);
-	e.g., AddNodeToList_bn (GetNodeNamed_bn ("TbOrCa", net), unobsv_nodes, LAST_ENTRY);
-	*/
+	// Create learner using EM learning method, bounded to the specified number of iterations
+	learner = NewLearner_bn (EM_LEARNING, NULL, env);
+	SetLearnerMaxIters_bn (learner, max_iterations);
 
-	RetractNetFindings_bn (state->work_net); // IMPORTANT: Otherwise any findings will be part of tests !!
-	CompileNet_bn (state->work_net);
+	LearnCPTs_bn (learner, GetNetNodes_bn (net), caseset, 1.0); // Degree must be greater than zero
+	blbn_counters.em_runs++;
 
-	tester_bn* tester = NewNetTester_bn (test_nodes, unobserved_nodes, -1);
+	DeleteLearner_bn (learner);
+	DeleteCaseset_cs (caseset);
+	DeleteStream_ns  (casefile);
 
-	//stream_ns* casefile = NewFileStream_ns ("./data/Alarm/Alarm.cas", env, NULL);
-	//caseset_cs* caseset = NewCaseset_cs ("AlarmCases", env);
-	//AddFileToCaseset_cs (state->caseset, state->casefile, 1.0, NULL);
-	TestWithCaseset_bn (tester, state->validation_caseset);
+	blbn_util_retract_net_findings (state, net);
+}
 
-	//PrintConfusionMatrix (tester, test_node); // defined in example for GetTestConfusion_bn
-	error_rate = GetTestErrorRate_bn (tester, test_node);
-	//printf ("Error rate       = %f %\n", 100 * GetTestErrorRate_bn (tester, test_node));
+/**
+ * Allocates the sufficient statistics used by the incremental learner.  The
+ * expected counts are initialized from the prior network, so this must be
+ * called before any case has been learned incrementally.
+ */
+blbn_suff_stats_t* blbn_suff_stats_init (blbn_state_t *state) {
+	blbn_suff_stats_t *stats = NULL;
+	const nodelist_bn *nodes = GetNetNodes_bn (state->prior_net);
+	int i;
 
-	DeleteNetTester_bn (tester);
-	DeleteNodeList_bn (unobserved_nodes);
-	DeleteNodeList_bn(test_nodes);
+	stats = (blbn_suff_stats_t *) malloc (sizeof (blbn_suff_stats_t));
+	stats->offset = (unsigned int *) malloc ((state->node_count + 1) * sizeof (unsigned int));
 
-	return error_rate;
-}
+	stats->offset[0] = 0;
+	for (i = 0; i < state->node_count; i++) {
+		stats->offset[i + 1] = stats->offset[i] + blbn_util_node_table_size (NthNode_bn (nodes, i));
+	}
+	stats->entry_count = stats->offset[state->node_count];
 
-double blbn_get_log_loss (blbn_state_t *state) {
+	stats->prior_counts = (double *) malloc (stats->entry_count * sizeof (double));
+	stats->fixed_counts = (double *) malloc (stats->entry_count * sizeof (double));
+	stats->counts       = (double *) malloc (stats->entry_count * sizeof (double));
+	stats->case_counts  = (double **) calloc (state->case_count, sizeof (double *));
+	stats->revisions    = 0;
 
-	double log_loss = DBL_MAX;
+	state->suff_stats = stats;
 
-	//net_bn* net = ReadNet_bn (NewFileStream_ns ("./data/Alarm/Alarm.dne", env, NULL), NO_VISUAL_INFO);
-	nodelist_bn* unobserved_nodes = NewNodeList2_bn (0, state->work_net);
-	nodelist_bn*   test_nodes = NewNodeList2_bn (0, state->work_net);
-	node_bn* test_node = GetNodeNamed_bn (blbn_get_node_name (state, state->target), state->work_net); // node_bn* test_node = GetNodeNamed_bn ("Cancer", net);
+	blbn_util_get_net_counts (state, state->prior_net, stats->prior_counts);
+	memcpy (stats->fixed_counts, stats->prior_counts, stats->entry_count * sizeof (double));
+	memcpy (stats->counts, stats->prior_counts, stats->entry_count * sizeof (double));
 
-	// Add test nodes
-	AddNodeToList_bn (test_node, test_nodes, LAST_ENTRY);
+	return stats;
+}
 
-	// Add unobserved nodes, if any (these are the other nodes not known during diagnosis/classification)
-	/*
-	e.g., AddNodeToList_bn (GetNodeNamed_bn ("Tuberculosis", net), unobsv_nodes, LAST_ENTRY);
-	e.g., AddNodeToList_bn (GetNodeNamed_bn ("Bronchitis", net), unobsv_nodes, LAST_ENTRY);
-	e.g., AddNodeToList_bn (GetNodeNamed_bn ("TbOrCa", net), unobsv_nodes, LAST_ENTRY);
-	*/
+void blbn_suff_stats_free (blbn_state_t *state) {
+	int j;
 
-	RetractNetFindings_bn (state->work_net); // IMPORTANT: Otherwise any findings will be part of tests !!
-	CompileNet_bn (state->work_net);
+	if (state->suff_stats != NULL) {
+		for (j = 0; j < state->case_count; j++) {
+			free (state->suff_stats->case_counts[j]);
+		}
+		free (state->suff_stats->case_counts);
+		free (state->suff_stats->counts);
+		free (state->suff_stats->fixed_counts);
+		free (state->suff_stats->prior_counts);
+		free (state->suff_stats->offset);
+		free (state->suff_stats);
+		state->suff_stats = NULL;
+	}
+}
 
-	tester_bn* tester = NewNetTester_bn (test_nodes, unobserved_nodes, -1);
+/**
+ * Returns 1 if every finding of the specified case is learned, in which case
+ * its expected counts don't depend on the parameters of the network.
+ */
+int blbn_suff_stats_is_complete (blbn_state_t *state, int case_index) {
+	return (state->flags->case_counts[BLBN_FLAG_LEARNED][case_index] == state->node_count);
+}
 
-	//stream_ns* casefile = NewFileStream_ns ("./data/Alarm/Alarm.cas", env, NULL);
-	//caseset_cs* caseset = NewCaseset_cs ("AlarmCases", env);
-	//AddFileToCaseset_cs (state->caseset, state->casefile, 1.0, NULL);
-	TestWithCaseset_bn (tester, state->validation_caseset);
+/**
+ * Computes the expected counts of the learned findings of the specified case
+ * under the parameters of the working network with a single EM iteration
+ * for that case alone.  The working network's CPTs are left with the case's
+ * counts added.
+ */
+double* blbn_suff_stats_estimate_case (blbn_state_t *state, int case_index) {
+	blbn_suff_stats_t *stats = state->suff_stats;
+	double *net_counts = NULL;
+	double *delta = NULL;
+	int e;
 
-	//PrintConfusionMatrix (tester, test_node); // defined in example for GetTestConfusion_bn
-	log_loss = GetTestLogLoss_bn (tester, test_node);
-	//printf ("Error rate       = %f %\n", 100 * GetTestErrorRate_bn (tester, test_node));
-	//printf ("Logarithmic loss = %f\n", GetTestLogLoss_bn (tester, test_node));
+	net_counts = (double *) malloc (stats->entry_count * sizeof (double));
+	blbn_util_get_net_counts (state, state->work_net, net_counts);
 
-	DeleteNetTester_bn (tester);
-	DeleteNodeList_bn (unobserved_nodes);
-	DeleteNodeList_bn(test_nodes);
+	blbn_util_net_learn_case_em (state, state->work_net, case_index, 1);
 
-	return log_loss;
+	delta = (double *) malloc (stats->entry_count * sizeof (double));
+	blbn_util_get_net_counts (state, state->work_net, delta);
+	for (e = 0; e < stats->entry_count; e++) {
+		delta[e] -= net_counts[e];
+	}
+	free (net_counts);
+	return delta;
 }
 
-double blbn_util_get_log_loss (blbn_state_t *state, net_bn *net) {
+/**
+ * Removes the expected counts contributed by the specified learned case from
+ * the sufficient statistics (without writing them to the working network):
+ * the counts kept for a complete case, or the counts of any other case under
+ * the present parameters (which is its contribution once the refinement has
+ * converged).
+ */
+void blbn_suff_stats_remove_case (blbn_state_t *state, int case_index) {
+	blbn_suff_stats_t *stats = state->suff_stats;
+	double *delta = stats->case_counts[case_index];
+	int e;
 
-	double log_loss = DBL_MAX;
+	if (delta != NULL) {
+		for (e = 0; e < stats->entry_count; e++) {
+			stats->fixed_counts[e] -= delta[e];
+		}
+		stats->case_counts[case_index] = NULL;
+	} else {
+		delta = blbn_suff_stats_estimate_case (state, case_index);
+	}
+	for (e = 0; e < stats->entry_count; e++) {
+		stats->counts[e] -= delta[e];
+	}
+	free (delta);
+}
 
-	//net_bn* net = ReadNet_bn (NewFileStream_ns ("./data/Alarm/Alarm.dne", env, NULL), NO_VISUAL_INFO);
-	nodelist_bn* unobserved_nodes = NewNodeList2_bn (0, net);
-	nodelist_bn*   test_nodes = NewNodeList2_bn (0, net);
-	node_bn* test_node = GetNodeNamed_bn (blbn_get_node_name (state, state->target), net); // node_bn* test_node = GetNodeNamed_bn ("Cancer", net);
+/**
+ * Adds the expected counts of the specified learned case under the present
+ * parameters to the sufficient statistics (and the working network).  The
+ * counts of a complete case are kept, so the case can be removed again
+ * later; the counts of the other cases are re-estimated by
+ * blbn_suff_stats_refine.
+ */
+void blbn_suff_stats_add_case (blbn_state_t *state, int case_index) {
+	blbn_suff_stats_t *stats = state->suff_stats;
+	double *delta = NULL;
+	int e;
 
-	// Add test nodes
-	AddNodeToList_bn (test_node, test_nodes, LAST_ENTRY);
+	delta = blbn_suff_stats_estimate_case (state, case_index);
+	for (e = 0; e < stats->entry_count; e++) {
+		stats->counts[e] += delta[e];
+	}
+	if (blbn_suff_stats_is_complete (state, case_index)) {
+		for (e = 0; e < stats->entry_count; e++) {
+			stats->fixed_counts[e] += delta[e];
+		}
+		stats->case_counts[case_index] = delta;
+	} else {
+		free (delta);
+	}
+}
 
-	// Add unobserved nodes, if any (these are the other nodes not known during diagnosis/classification)
-	/*
-	e.g., AddNodeToList_bn (GetNodeNamed_bn ("Tuberculosis", net), unobsv_nodes, LAST_ENTRY);
-	e.g., AddNodeToList_bn (GetNodeNamed_bn ("Bronchitis", net), unobsv_nodes, LAST_ENTRY);
-	e.g., AddNodeToList_bn (GetNodeNamed_bn ("TbOrCa", net), unobsv_nodes, LAST_ENTRY);
-	*/
+/**
+ * Warm-started EM: re-estimates the expected counts of every learned case
+ * that has unlearned findings until they converge.  Each sweep is one EM
+ * iteration over those cases (one LearnCPTs_bn call), starting from the
+ * parameters of the previous revision, and the new counts are the counts of
+ * the prior and of the complete cases (stats->fixed_counts) plus the counts
+ * the sweep estimated.  The sweeps stop when the expected counts change by
+ * less than BLBN_INCREMENTAL_EM_TOLERANCE per case, or after
+ * state->learn_max_sweeps sweeps.
+ */
+void blbn_suff_stats_refine (blbn_state_t *state) {
+	blbn_suff_stats_t *stats = state->suff_stats;
+	const nodelist_bn *nodes = GetNetNodes_bn (state->work_net);
+	stream_ns   *casefile = NULL;
+	caseset_cs  *caseset  = NULL;
+	learner_bn  *learner  = NULL;
+	double *net_counts = NULL; // counts of the working network before the sweep
+	double *counts = NULL; // counts after the sweep
+	double change;
+	unsigned int sweep;
+	int case_count = 0;
+	int j, e;
+
+	// Write the findings of the cases to re-estimate once for every sweep
+	casefile = NewMemoryStream_ns ("incremental.cas", env, NULL);
+	for (j = 0; j < state->case_count; j++) {
+		if (blbn_has_findings_learned_in_case (state, j) && !blbn_suff_stats_is_complete (state, j)) {
+			blbn_set_net_findings_learned (state, j);
+			WriteNetFindings_bn (nodes, casefile, j, 1.0);
+			case_count++;
+		}
+	}
+	blbn_evidence_retract (state->evidence);
+	if (case_count == 0) {
+		DeleteStream_ns (casefile);
+		return;
+	}
+
+	caseset = NewCaseset_cs (NULL, env);
+	blbn_counters.stream_bytes += blbn_stream_length (casefile);
+	AddFileToCaseset_cs (caseset, casefile, 1.0, NULL);
 
-	RetractNetFindings_bn (net); // IMPORTANT: Otherwise any findings will be part of tests !!
-	CompileNet_bn (net);
+	learner = NewLearner_bn (EM_LEARNING, NULL, env);
+	SetLearnerMaxIters_bn (learner, 1);
 
-	tester_bn* tester = NewNetTester_bn (test_nodes, unobserved_nodes, -1);
+	net_counts = (double *) malloc (stats->entry_count * sizeof (double));
+	counts = (double *) malloc (stats->entry_count * sizeof (double));
 
-	//stream_ns* casefile = NewFileStream_ns ("./data/Alarm/Alarm.cas", env, NULL);
-	//caseset_cs* caseset = NewCaseset_cs ("AlarmCases", env);
-	//AddFileToCaseset_cs (state->caseset, state->casefile, 1.0, NULL);
-	TestWithCaseset_bn (tester, state->validation_caseset);
+	for (sweep = 0; sweep < state->learn_max_sweeps; sweep++) {
+		blbn_util_get_net_counts (state, state->work_net, net_counts);
+		LearnCPTs_bn (learner, nodes, caseset, 1.0); // Degree must be greater than zero
+		blbn_counters.em_runs++;
+		blbn_util_get_net_counts (state, state->work_net, counts);
 
-	//PrintConfusionMatrix (tester, test_node); // defined in example for GetTestConfusion_bn
-	log_loss = GetTestLogLoss_bn (tester, test_node);
-	//printf ("Error rate       = %f %\n", 100 * GetTestErrorRate_bn (tester, test_node));
-	//printf ("Logarithmic loss = %f\n", GetTestLogLoss_bn (tester, test_node));
+		change = 0.0;
+		for (e = 0; e < stats->entry_count; e++) {
+			counts[e] = stats->fixed_counts[e] + (counts[e] - net_counts[e]);
+			change += fabs (counts[e] - stats->counts[e]);
+		}
+		memcpy (stats->counts, counts, stats->entry_count * sizeof (double));
+		blbn_util_set_net_counts (state);
 
-	DeleteNetTester_bn (tester);
-	DeleteNodeList_bn (unobserved_nodes);
-	DeleteNodeList_bn(test_nodes);
+		if (change / case_count < BLBN_INCREMENTAL_EM_TOLERANCE) {
+			break;
+		}
+	}
 
-	return log_loss;
+	free (counts);
+	free (net_counts);
+	DeleteLearner_bn (learner);
+	DeleteCaseset_cs (caseset);
+	DeleteStream_ns  (casefile);
 }
 
 /**
- * Learn all using BLBN library routines.
+ * Recomputes the counts of the complete cases, and takes the parameters of
+ * the working network as the present ones, e.g., after the working network
+ * was replaced by a full EM relearn.
  */
-void blbn_learn_baseline (blbn_state_t *state, FILE* graph_fp) {
-	int i, j;
+void blbn_suff_stats_rebuild (blbn_state_t *state) {
+	blbn_suff_stats_t *stats = state->suff_stats;
+	int j, e;
 
-	double *test_rates = NULL;
-	
-	if (state != NULL) {
-		if (state->work_net != NULL) {
+	memcpy (stats->fixed_counts, stats->prior_counts, stats->entry_count * sizeof (double));
+	blbn_util_get_net_counts (state, state->work_net, stats->counts);
 
-			// Set all as "purchased"
-			for (i = 0; i < state->node_count; i++) {
-				for (j = 0; j < state->case_count; j++) {
-					blbn_set_finding_purchased (state, i, j);
-				}
-			}
+	for (j = 0; j < state->case_count; j++) {
+		free (stats->case_counts[j]);
+		stats->case_counts[j] = NULL;
 
-			// Learn purchased findings (which will be all findings since they
-			// were just marked as "purchased")
-			for (i = 0; i < state->case_count; i++) {
-				blbn_revise_by_case_findings_v2 (state, i);
-				//printf ("HELLO %d\n", i);
+		if (blbn_has_findings_learned_in_case (state, j) && blbn_suff_stats_is_complete (state, j)) {
+			stats->case_counts[j] = blbn_suff_stats_estimate_case (state, j);
+			for (e = 0; e < stats->entry_count; e++) {
+				stats->fixed_counts[e] += stats->case_counts[j][e];
 			}
-		}
 
-		// Test network to get error rate and log loss to assess effect of selected action
-		test_rates = blbn_get_test_rates (state);
-
-		// Write results to file
-		for (i = 0; i < state->budget; ++i) {
-			fprintf (graph_fp, "%i\t%d\t%d\t%f\t%f\t0\n", i, -1, -1, test_rates[0], test_rates[1]);
+			// Restore the tables of the working network
+			blbn_util_set_net_counts (state);
 		}
-		fflush (graph_fp);
-
-		free (test_rates);
 	}
 }
 
+/**
+ * Compares the log loss of the incrementally-learned working network with
+ * that of a network relearned from the prior network with the full EM
+ * algorithm (as done by blbn_learn_case_v2).  If they differ by more than
+ * state->learn_tolerance, the relearned network replaces the working
+ * network and the sufficient statistics are rebuilt from it.
+ */
+void blbn_suff_stats_check (blbn_state_t *state) {
+	net_bn *relearned_net = NULL;
+	double incremental_log_loss;
+	double relearned_log_loss;
 
-void blbn_learn_MBbaseline (blbn_state_t *state, FILE* graph_fp) {
-
-	int i, j;
-
-	double *test_rates = NULL;
-
-	if (state != NULL) {
-		if (state->work_net != NULL) {
-
-			// Set all as "purchased"
-			for (i = 0; i < state->nodes_consider[0]; i++) {
-				for (j = 0; j < state->case_count; j++) {
-
-					int ii = state->nodes_consider[i+1];
-					blbn_set_finding_purchased (state, ii, j);
-				}
-			}
-
-
-			// Learn purchased findings (which will be all findings since they
-			// were just marked as "purchased")
-			for (i = 0; i < state->case_count; i++) {
-				blbn_revise_by_case_findings_v2 (state, i);
-				//printf ("HELLO %d\n", i);
-			}
-		}
+	relearned_net = blbn_util_copy_net_unlearn_case (state, -1);
 
-		// Test network to get error rate and log loss to assess effect of selected action
-		test_rates = blbn_get_test_rates (state);
+	incremental_log_loss = blbn_util_get_log_loss (state, state->work_net);
+	relearned_log_loss   = blbn_util_get_log_loss (state, relearned_net);
 
-		// Write results to file
-		for (i = 0; i < state->budget; ++i) {
-			fprintf (graph_fp, "%i\t%d\t%d\t%f\t%f\t0\n", i, -1, -1, test_rates[0], test_rates[1]);
-		}
-		fflush (graph_fp);
+	if (fabs (incremental_log_loss - relearned_log_loss) > state->learn_tolerance) {
+		printf ("Incremental learner drifted from EM (log loss %f vs. %f); relearning.\n", incremental_log_loss, relearned_log_loss);
 
-		free (test_rates);
+		blbn_set_work_net (state, relearned_net);
+		blbn_suff_stats_rebuild (state);
+	} else {
+		DeleteNet_bn (relearned_net);
 	}
 }
 
-int blbn_get_minimum_cost (blbn_state_t *state) {
+/**
+ * Incremental counterpart of blbn_unlearn_case_v2.  Rather than relearning
+ * every other learned case from the prior network, the expected counts
+ * contributed by the specified case are subtracted from the per-node
+ * sufficient statistics and the affected CPTs are rewritten.
+ */
+void blbn_unlearn_case_v3 (blbn_state_t *state, int case_index) {
 	int i;
-	int cost, min_cost;
 
-	min_cost = -1;
-	for (i = 0; i < state->node_count; ++i) {
-		cost = blbn_get_minimum_cost_in_node (state, i);
-		if (min_cost == -1 || cost < min_cost) {
-			min_cost = cost;
-		}
+	if (state->suff_stats == NULL) {
+		blbn_suff_stats_init (state);
 	}
 
-	return min_cost;
-}
-
-int blbn_get_minimum_cost_in_node (blbn_state_t *state, unsigned int node_index) {
-	int i;
-	int cost, min_cost;
+	if (blbn_has_findings_learned_in_case (state, case_index)) {
+		blbn_suff_stats_remove_case (state, case_index);
+		blbn_util_set_net_counts (state);
+		blbn_work_net_changed (state);
+	}
 
-	min_cost = -1;
-	for (i = 0; i < state->case_count; ++i) {
-		cost = state->cost[node_index][i];
-		if (min_cost == -1 || cost < min_cost) {
-			min_cost = cost;
+	// Set state of node to "not learned"
+	for (i = 0; i < state->node_count; i++) {
+		if (blbn_is_learned_finding (state, i, case_index)) {
+			blbn_set_finding_not_learned (state, i, case_index);
 		}
 	}
-
-	return min_cost;
 }
 
-int blbn_get_minimum_cost_in_case (blbn_state_t *state, unsigned int case_index) {
+/**
+ * Incremental counterpart of blbn_learn_case_v2.  The expected counts of the
+ * specified case are added to the per-node sufficient statistics, and EM is
+ * then continued from the present parameters until the counts of the cases
+ * with unlearned findings converge (see blbn_suff_stats_refine), which takes
+ * fewer iterations than EM from the prior network.  Every
+ * state->learn_check_interval revisions the result is also compared against
+ * a full EM relearn, which is adopted if the log losses differ by more than
+ * state->learn_tolerance (an interval of 1 checks every revision, at the
+ * cost of a full relearn per revision).
+ */
+void blbn_learn_case_v3 (blbn_state_t *state, int case_index) {
 	int i;
-	int cost, min_cost;
 
-	min_cost = -1;
-	for (i = 0; i < state->node_count; ++i) {
-		cost = state->cost[i][case_index];
-		if (min_cost == -1 || cost < min_cost) {
-			min_cost = cost;
+	if (state->suff_stats == NULL) {
+		blbn_suff_stats_init (state);
+	}
+
+	// Set state of node to "learned"
+	for (i = 0; i < state->node_count; i++) {
+		if (blbn_is_available_finding (state, i, case_index)) {
+			blbn_set_finding_learned (state, i, case_index);
 		}
 	}
 
-	return min_cost;
+	blbn_suff_stats_add_case (state, case_index);
+	blbn_suff_stats_refine (state);
+	blbn_work_net_changed (state);
+
+	if (state->learn_check_interval > 0 && ++state->suff_stats->revisions >= state->learn_check_interval) {
+		state->suff_stats->revisions = 0;
+		blbn_suff_stats_check (state);
+	}
 }
 
 /**
- * Returns pointer to first action in list or NULL.
+ * Same as blbn_revise_by_case_findings_v2, but uses the incremental learner
+ * (blbn_unlearn_case_v3 and blbn_learn_case_v3).
  */
-blbn_select_action_t* blbn_get_action_head (blbn_state_t *state) {
-	blbn_select_action_t *head_action = NULL; // last action in list
-	if (state != NULL) {
-		if (state->sel_action_seq != NULL) {
-			head_action = state->sel_action_seq;
+void blbn_revise_by_case_findings_v3 (blbn_state_t *state, int case_index) {
+
+	if (blbn_has_findings_available_not_learned (state, case_index)) {
+		// Unlearn case with previously-known values
+		if (blbn_has_findings_learned (state, case_index)) {
+			blbn_unlearn_case_v3 (state, case_index);
+		}
+
+		// Learn case with all available findings
+		if (blbn_has_findings_available_not_learned (state, case_index)) {
+			blbn_learn_case_v3 (state, case_index);
 		}
 	}
-	return head_action;
 }
 
 /**
- * Returns pointer to action at specified index in list or NULL.
+ * Revises the working network with the available findings of the specified
+ * case using the learning method selected by state->learn_mode.
  */
-blbn_select_action_t* blbn_get_action (blbn_state_t *state, unsigned int index) {
-	blbn_select_action_t *action_at_index = NULL; // last action in list
-	int i;
-	if (state != NULL) {
-		if (state->sel_action_seq != NULL) {
-			i = 0;
-			action_at_index = state->sel_action_seq;
-			while (action_at_index != NULL) {
-				if (i == index) {
-					//return action_at_index;
-					break;
-				}
-				action_at_index = action_at_index->next;
-				i++;
-			}
-		}
+void blbn_revise_by_case_findings (blbn_state_t *state, int case_index) {
+	if (state->learn_mode == BLBN_LEARN_INCREMENTAL) {
+		blbn_revise_by_case_findings_v3 (state, case_index);
+	} else {
+		blbn_revise_by_case_findings_v2 (state, case_index);
 	}
-	return action_at_index;
 }
 
 /**
- * Returns pointer to last action in list or NULL.
+ * Marks every available finding of every case learned and learns all of the
+ * cases into the working network at once.  This replaces calling
+ * blbn_revise_by_case_findings for every case in turn, which (with EM)
+ * relearns all of the previously learned cases from the prior network for
+ * each case, with a single pass over the data.  When every finding of every
+ * case is known the CPTs are counted directly (see
+ * blbn_learn_all_cases_counting), otherwise all of the cases are learned
+ * with one EM run (see blbn_learn_all_cases_em).  The incremental learner
+ * already revises one case at a time, so it learns the cases in turn.
  */
-blbn_select_action_t* blbn_get_action_tail (blbn_state_t *state) {
-	blbn_select_action_t *tail_action = NULL; // last action in list
-	if (state != NULL) {
-		if (state->sel_action_seq != NULL) {
-			tail_action = state->sel_action_seq;
-			while (tail_action->next != NULL) {
-				tail_action = tail_action->next;
-			}
+void blbn_learn_all_cases (blbn_state_t *state) {
+	int i, j;
+	int complete = 1; // every finding of every case is available and known
+
+	if (state->learn_mode == BLBN_LEARN_INCREMENTAL) {
+		for (j = 0; j < state->case_count; j++) {
+			blbn_revise_by_case_findings (state, j);
+		}
+		return;
+	}
+
+	// Mark the findings learned as blbn_learn_case_v2 does (available findings with known values)
+	for (j = 0; j < state->case_count; j++) {
+		for (i = 0; i < state->node_count; i++) {
+			if (blbn_is_available_finding (state, i, j) && blbn_get_finding (state, i, j) != -1) {
+				blbn_set_finding_learned (state, i, j);
+			} else {
+				complete = 0;
+			}
+		}
+	}
+
+	if (complete) {
+		blbn_learn_all_cases_counting (state);
+	} else {
+		blbn_learn_all_cases_em (state);
+	}
+}
+
+/**
+ * Relearns the working network from the prior network with a single EM run
+ * over the learned findings of every case (the network blbn_learn_case_v2
+ * leaves after the last case has been learned).
+ */
+void blbn_learn_all_cases_em (blbn_state_t *state) {
+	int i;
+	stream_ns   *casefile = NULL; // Used as temporary output location for the cases
+	caseset_cs  *caseset  = NULL; // Case set where the cases will be read into
+	const nodelist_bn *nodes = NULL;
+	learner_bn  *learner  = NULL;
+
+	nodes = GetNetNodes_bn (state->work_net);
+
+	// Write the learned findings of every case to memory
+	casefile = NewMemoryStream_ns ("learn_all.cas", env, NULL);
+	for (i = 0; i < state->case_count; ++i) {
+		if (blbn_has_findings_learned_in_case (state, i)) {
+			blbn_set_net_findings_learned (state, i);
+			WriteNetFindings_bn (nodes, casefile, i, 1.0);
+		}
+	}
+
+	blbn_restore_prior_network (state);
+	nodes = GetNetNodes_bn (state->work_net); // NOTE: THIS IS IMPORTANT!
+	caseset = NewCaseset_cs (NULL, env);
+	blbn_counters.stream_bytes += blbn_stream_length (casefile);
+	AddFileToCaseset_cs (caseset, casefile, 1.0, NULL);
+
+	blbn_evidence_retract (state->evidence);
+
+	learner = NewLearner_bn (EM_LEARNING, NULL, env);
+	LearnCPTs_bn (learner, nodes, caseset, 1.0); // Degree must be greater than zero
+	blbn_counters.em_runs++;
+	blbn_work_net_changed (state);
+
+	DeleteLearner_bn (learner);
+	DeleteCaseset_cs (caseset);
+	DeleteStream_ns  (casefile);
+}
+
+/**
+ * Counts the family configurations of the cases in one slice of the data
+ * into result (a partial table of every node's counts, laid out according
+ * to arg->offset).  Every finding of every case must be known.
+ */
+void blbn_util_count_cases_item (blbn_state_t *state, int item, void *arg, double *result) {
+	blbn_count_arg_t *count = (blbn_count_arg_t *) arg;
+	int first = (int) ((long) state->case_count * item / count->slice_count);
+	int last = (int) ((long) state->case_count * (item + 1) / count->slice_count);
+	int config;
+	int i, j, p;
+
+	memset (result, 0, count->offset[state->node_count] * sizeof (double));
+	for (j = first; j < last; j++) {
+		for (i = 0; i < state->node_count; i++) {
+			config = 0;
+			for (p = 0; p < count->parent_counts[i]; p++) {
+				config = config * count->state_counts[count->parents[i][p]] + BLBN_STATE (state, count->parents[i][p], j);
+			}
+			result[count->offset[i] + config * count->state_counts[i] + BLBN_STATE (state, i, j)] += 1.0;
+		}
+	}
+}
+
+/**
+ * Relearns the working network from the prior network by counting the
+ * findings of every case, which is what EM converges to (in its first
+ * iteration) when no finding is missing: each CPT entry becomes the prior's
+ * expected count plus the number of cases with that family configuration.
+ * The cases are split into one slice per worker, each slice is counted into
+ * its own partial table (in parallel if state->worker_count > 1), and the
+ * partial tables are added to the prior counts at the end.
+ */
+void blbn_learn_all_cases_counting (blbn_state_t *state) {
+	blbn_count_arg_t count;
+	const nodelist_bn *nodes = NULL;
+	const nodelist_bn *parents = NULL;
+	double *counts = NULL;
+	double *partial_counts = NULL;
+	unsigned int entry_count, e;
+	int i, p, w;
+
+	blbn_restore_prior_network (state);
+	nodes = GetNetNodes_bn (state->work_net);
+
+	count.slice_count = (state->worker_count > 1 ? state->worker_count : 1);
+	count.offset = (unsigned int *) malloc ((state->node_count + 1) * sizeof (unsigned int));
+	count.state_counts = (int *) malloc (state->node_count * sizeof (int));
+	count.parent_counts = (int *) malloc (state->node_count * sizeof (int));
+	count.parents = (int **) malloc (state->node_count * sizeof (int *));
+	count.offset[0] = 0;
+	for (i = 0; i < state->node_count; i++) {
+		parents = GetNodeParents_bn (NthNode_bn (nodes, i));
+		count.offset[i + 1] = count.offset[i] + blbn_util_node_table_size (NthNode_bn (nodes, i));
+		count.state_counts[i] = GetNodeNumberStates_bn (NthNode_bn (nodes, i));
+		count.parent_counts[i] = LengthNodeList_bn (parents);
+		count.parents[i] = (int *) malloc ((count.parent_counts[i] + 1) * sizeof (int));
+		for (p = 0; p < count.parent_counts[i]; p++) {
+			count.parents[i][p] = blbn_get_node_by_name (state, GetNodeName_bn (NthNode_bn (parents, p)));
+		}
+	}
+	entry_count = count.offset[state->node_count];
+
+	partial_counts = (double *) malloc ((size_t) count.slice_count * entry_count * sizeof (double));
+	blbn_parallel_for (state, count.slice_count, entry_count, blbn_util_count_cases_item, &count, partial_counts);
+
+	// Add the partial tables to the prior counts and write them into the CPTs
+	counts = (double *) malloc (entry_count * sizeof (double));
+	for (i = 0; i < state->node_count; i++) {
+		blbn_util_get_node_counts (NthNode_bn (nodes, i), &counts[count.offset[i]]);
+	}
+	for (w = 0; w < count.slice_count; w++) {
+		for (e = 0; e < entry_count; e++) {
+			counts[e] += partial_counts[(size_t) w * entry_count + e];
+		}
+	}
+	for (i = 0; i < state->node_count; i++) {
+		blbn_util_set_node_counts (NthNode_bn (nodes, i), &counts[count.offset[i]]);
+	}
+	blbn_work_net_changed (state);
+
+	for (i = 0; i < state->node_count; i++) {
+		free (count.parents[i]);
+	}
+	free (count.parents);
+	free (count.parent_counts);
+	free (count.state_counts);
+	free (count.offset);
+	free (partial_counts);
+	free (counts);
+}
+
+/**
+ * Returns a hash of the findings of a validation case.
+ */
+unsigned int blbn_util_hash_findings (const int *findings, int count) {
+	unsigned int hash = 2166136261u;
+	int i;
+
+	for (i = 0; i < count; i++) {
+		hash ^= (unsigned int) (findings[i] + 1);
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+/**
+ * Reads the validation cases and groups them by evidence pattern (the
+ * findings on every node except the target), counting the cases with each
+ * target state per pattern.  Cases without a target value are skipped, as
+ * TestWithCaseset_bn does.
+ */
+blbn_validation_t* blbn_validation_init (blbn_state_t *state, net_bn *net, stream_ns *validation_stream) {
+	blbn_validation_t *validation = NULL;
+	const nodelist_bn *nodes = GetNetNodes_bn (net);
+	node_bn *target_node = NthNode_bn (nodes, state->target);
+	int n = state->node_count;
+	int *findings = NULL;
+	unsigned int *buckets = NULL; // open-addressing hash of patterns (pattern index + 1, 0 = empty)
+	unsigned int bucket_count = 64;
+	unsigned int capacity = 64;
+	unsigned int case_capacity = 64;
+	unsigned int slot, p, q;
+	caseposn_bn case_posn;
+	double freq, weight, weight_total = 0.0, count_total = 0.0;
+	int i, target_state, k;
+
+	validation = (blbn_validation_t *) calloc (1, sizeof (blbn_validation_t));
+	validation->target_state_count = k = GetNodeNumberStates_bn (target_node);
+	validation->findings = (int *) malloc (capacity * n * sizeof (int));
+	validation->target_counts = (double *) malloc (capacity * k * sizeof (double));
+	validation->case_patterns = (unsigned int *) malloc (case_capacity * sizeof (unsigned int));
+	validation->case_states = (int *) malloc (case_capacity * sizeof (int));
+	validation->case_weights = (double *) malloc (case_capacity * sizeof (double));
+	findings = (int *) malloc (n * sizeof (int));
+	buckets = (unsigned int *) calloc (bucket_count, sizeof (unsigned int));
+
+	case_posn = FIRST_CASE;
+	while (1) {
+		RetractNetFindings_bn (net);
+		freq = 1.0;
+		ReadNetFindings_bn (&case_posn, validation_stream, nodes, NULL, &freq);
+		if (case_posn == NO_MORE_CASES)
+			break;
+		case_posn = NEXT_CASE;
+
+		target_state = GetNodeFinding_bn (target_node);
+		if (target_state < 0) {
+			continue;
+		}
+		for (i = 0; i < n; i++) {
+			findings[i] = (i == state->target ? -1 : GetNodeFinding_bn (NthNode_bn (nodes, i)));
+		}
+
+		// Find the pattern, or add it
+		slot = blbn_util_hash_findings (findings, n) & (bucket_count - 1);
+		while (buckets[slot] != 0 && memcmp (&validation->findings[(buckets[slot] - 1) * n], findings, n * sizeof (int)) != 0) {
+			slot = (slot + 1) & (bucket_count - 1);
+		}
+		if (buckets[slot] == 0) {
+			p = validation->pattern_count++;
+			if (p == capacity) {
+				capacity *= 2;
+				validation->findings = (int *) realloc (validation->findings, capacity * n * sizeof (int));
+				validation->target_counts = (double *) realloc (validation->target_counts, capacity * k * sizeof (double));
+			}
+			memcpy (&validation->findings[p * n], findings, n * sizeof (int));
+			memset (&validation->target_counts[p * k], 0, k * sizeof (double));
+			buckets[slot] = p + 1;
+
+			// Keep the hash at most half full
+			if (2 * validation->pattern_count > bucket_count) {
+				free (buckets);
+				bucket_count *= 2;
+				buckets = (unsigned int *) calloc (bucket_count, sizeof (unsigned int));
+				for (q = 0; q < validation->pattern_count; q++) {
+					slot = blbn_util_hash_findings (&validation->findings[q * n], n) & (bucket_count - 1);
+					while (buckets[slot] != 0) {
+						slot = (slot + 1) & (bucket_count - 1);
+					}
+					buckets[slot] = q + 1;
+				}
+			}
+		} else {
+			p = buckets[slot] - 1;
+		}
+
+		weight = (freq > 0.0 ? freq : 1.0);
+		validation->target_counts[p * k + target_state] += weight;
+		if (validation->case_count == case_capacity) {
+			case_capacity *= 2;
+			validation->case_patterns = (unsigned int *) realloc (validation->case_patterns, case_capacity * sizeof (unsigned int));
+			validation->case_states = (int *) realloc (validation->case_states, case_capacity * sizeof (int));
+			validation->case_weights = (double *) realloc (validation->case_weights, case_capacity * sizeof (double));
+		}
+		validation->case_patterns[validation->case_count] = p;
+		validation->case_states[validation->case_count] = target_state;
+		validation->case_weights[validation->case_count] = weight;
+		validation->case_count++;
+		weight_total += weight;
+	}
+	RetractNetFindings_bn (net);
+
+	// Every case counted must be in exactly one pattern (the counts sum to
+	// case_count when the cases are unweighted)
+	for (p = 0; p < validation->pattern_count * k; p++) {
+		count_total += validation->target_counts[p];
+	}
+	if (fabs (count_total - weight_total) > 1e-9 * (weight_total + 1.0)) {
+		printf ("Error: validation patterns hold %f of %f case weights. Exiting.\n", count_total, weight_total);
+		exit (1);
+	}
+
+	printf ("Validation case count: %d (%d evidence patterns)\n", validation->case_count, validation->pattern_count);
+
+	free (buckets);
+	free (findings);
+
+	return validation;
+}
+
+/**
+ * Writes the cases of a case file (read with the nodes of net) to a binary
+ * case store at filepath (see blbn_cbin_header_t).  The file is written under
+ * a temporary name and renamed, so readers never map a partial store.
+ * Returns the number of cases written, or -1 on error.
+ */
+int blbn_case_store_write (const char *filepath, net_bn *net, stream_ns *data_stream) {
+	const nodelist_bn *nodes = GetNetNodes_bn (net);
+	int n = LengthNodeList_bn (nodes);
+	int case_count = 0;
+	int capacity = 1024;
+	int32_t *rows = NULL; // [case * n + node] as read
+	int32_t *codes = NULL; // [node * case_count + case] as stored
+	uint32_t *state_counts = NULL;
+	blbn_cbin_header_t header;
+	caseposn_bn case_posn;
+	char *temp_filepath = NULL;
+	const char *name = NULL;
+	static const char padding[8] = { 0 };
+	FILE *fp = NULL;
+	int i, j, ok;
+
+	// Read the cases
+	rows = (int32_t *) malloc (capacity * n * sizeof (int32_t));
+	case_posn = FIRST_CASE;
+	while (1) {
+		RetractNetFindings_bn (net);
+		ReadNetFindings_bn (&case_posn, data_stream, nodes, NULL, NULL);
+		if (case_posn == NO_MORE_CASES || GetError_ns (env, ERROR_ERR, NULL))
+			break;
+		if (case_count == capacity) {
+			capacity *= 2;
+			rows = (int32_t *) realloc (rows, capacity * n * sizeof (int32_t));
+		}
+		for (i = 0; i < n; i++) {
+			rows[case_count * n + i] = GetNodeFinding_bn (NthNode_bn (nodes, i));
+			if (rows[case_count * n + i] < 0) {
+				rows[case_count * n + i] = BLBN_CBIN_MISSING;
+			}
+		}
+		case_count++;
+		case_posn = NEXT_CASE;
+	}
+	RetractNetFindings_bn (net);
+	if (GetError_ns (env, ERROR_ERR, NULL)) {
+		free (rows);
+		return -1;
+	}
+
+	// Store the cases by node
+	codes = (int32_t *) malloc ((size_t) n * case_count * sizeof (int32_t) + 1);
+	for (i = 0; i < n; i++) {
+		for (j = 0; j < case_count; j++) {
+			codes[(size_t) i * case_count + j] = rows[j * n + i];
+		}
+	}
+	free (rows);
+
+	memset (&header, 0, sizeof (header));
+	memcpy (header.magic, BLBN_CBIN_MAGIC, sizeof (header.magic));
+	header.node_count = n;
+	header.case_count = case_count;
+	state_counts = (uint32_t *) malloc ((n + 1) * sizeof (uint32_t));
+	for (i = 0; i < n; i++) {
+		state_counts[i] = GetNodeNumberStates_bn (NthNode_bn (nodes, i));
+		header.names_size += strlen (GetNodeName_bn (NthNode_bn (nodes, i))) + 1;
+	}
+	header.codes_offset = (sizeof (header) + n * sizeof (uint32_t) + header.names_size + 7) & ~7u;
+
+	temp_filepath = (char *) malloc (strlen (filepath) + 32);
+	sprintf (temp_filepath, "%s.%d.tmp", filepath, (int) getpid ());
+	fp = fopen (temp_filepath, "wb");
+	ok = (fp != NULL);
+	if (ok) {
+		ok = ok && fwrite (&header, sizeof (header), 1, fp) == 1;
+		ok = ok && fwrite (state_counts, sizeof (uint32_t), n, fp) == n;
+		for (i = 0; i < n && ok; i++) {
+			name = GetNodeName_bn (NthNode_bn (nodes, i));
+			ok = fwrite (name, 1, strlen (name) + 1, fp) == strlen (name) + 1;
+		}
+		ok = ok && fwrite (padding, 1, header.codes_offset - (sizeof (header) + n * sizeof (uint32_t) + header.names_size), fp) == header.codes_offset - (sizeof (header) + n * sizeof (uint32_t) + header.names_size);
+		ok = ok && fwrite (codes, sizeof (int32_t), (size_t) n * case_count, fp) == (size_t) n * case_count;
+		ok = (fclose (fp) == 0) && ok;
+	}
+	ok = ok && rename (temp_filepath, filepath) == 0;
+	if (!ok) {
+		remove (temp_filepath);
+	}
+
+	free (temp_filepath);
+	free (state_counts);
+	free (codes);
+
+	return (ok ? case_count : -1);
+}
+
+/**
+ * Maps the binary case store at filepath, or returns the mapping this
+ * process already has of it.  Returns NULL if the file cannot be mapped or is
+ * not a valid case store, including one with a state code outside the states
+ * of its node.  Release the store with blbn_case_store_release.
+ */
+blbn_case_store_t* blbn_case_store_open (const char *filepath) {
+	blbn_case_store_t *store = NULL;
+	const blbn_cbin_header_t *header = NULL;
+	struct stat file_stat;
+	void *map = NULL;
+	const char *names = NULL;
+	size_t offset;
+	int32_t code;
+	int fd;
+	unsigned int i, c;
+
+	for (store = blbn_case_stores; store != NULL; store = store->next) {
+		if (strcmp (store->filepath, filepath) == 0) {
+			store->references++;
+			return store;
+		}
+	}
+
+	fd = open (filepath, O_RDONLY);
+	if (fd < 0) {
+		return NULL;
+	}
+	if (fstat (fd, &file_stat) != 0 || file_stat.st_size < (off_t) sizeof (blbn_cbin_header_t)) {
+		close (fd);
+		return NULL;
+	}
+	map = mmap (NULL, file_stat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close (fd);
+	if (map == MAP_FAILED) {
+		return NULL;
+	}
+
+	// Validate the header and the sizes of the sections
+	header = (const blbn_cbin_header_t *) map;
+	names = (const char *) map + sizeof (blbn_cbin_header_t) + header->node_count * sizeof (uint32_t);
+	if (memcmp (header->magic, BLBN_CBIN_MAGIC, sizeof (header->magic)) != 0
+			|| header->codes_offset % 8 != 0
+			|| sizeof (blbn_cbin_header_t) + (size_t) header->node_count * sizeof (uint32_t) + header->names_size > header->codes_offset
+			|| header->codes_offset + (size_t) header->node_count * header->case_count * sizeof (int32_t) > (size_t) file_stat.st_size
+			|| header->names_size == 0 || names[header->names_size - 1] != '\0') {
+		munmap (map, file_stat.st_size);
+		return NULL;
+	}
+
+	store = (blbn_case_store_t *) calloc (1, sizeof (blbn_case_store_t));
+	store->filepath = strdup (filepath);
+	store->map = map;
+	store->map_size = file_stat.st_size;
+	store->node_count = header->node_count;
+	store->case_count = header->case_count;
+	store->state_counts = (const uint32_t *) ((const char *) map + sizeof (blbn_cbin_header_t));
+	store->node_names = (const char **) malloc ((header->node_count + 1) * sizeof (char *));
+	offset = 0;
+	for (i = 0; i < header->node_count; i++) {
+		if (offset >= header->names_size) {
+			free (store->node_names);
+			free (store->filepath);
+			free (store);
+			munmap (map, file_stat.st_size);
+			return NULL;
+		}
+		store->node_names[i] = names + offset;
+		offset += strlen (names + offset) + 1;
+	}
+	store->codes = (const int32_t *) ((const char *) map + header->codes_offset);
+
+	// Every code must be a state of its node (or missing), since the states
+	// index the counts and CPTs of the node without further checks
+	for (i = 0; i < header->node_count; i++) {
+		for (c = 0; c < header->case_count; c++) {
+			code = store->codes[(size_t) i * header->case_count + c];
+			if (code != BLBN_CBIN_MISSING && (code < 0 || (uint32_t) code >= store->state_counts[i])) {
+				break;
+			}
+		}
+		if (c < header->case_count) {
+			free (store->node_names);
+			free (store->filepath);
+			free (store);
+			munmap (map, file_stat.st_size);
+			return NULL;
+		}
+	}
+
+	store->references = 1;
+	store->next = blbn_case_stores;
+	blbn_case_stores = store;
+
+	return store;
+}
+
+void blbn_case_store_release (blbn_case_store_t *store) {
+	blbn_case_store_t **link = NULL;
+
+	if (store != NULL && --store->references == 0) {
+		for (link = &blbn_case_stores; *link != NULL; link = &(*link)->next) {
+			if (*link == store) {
+				*link = store->next;
+				break;
+			}
+		}
+		munmap (store->map, store->map_size);
+		free (store->node_names);
+		free (store->filepath);
+		free (store);
+	}
+}
+
+/**
+ * Sets the case count and states of the state from the binary case store
+ * converted from the data file (data_filepath with BLBN_CBIN_SUFFIX), if it
+ * exists, is not older than the data file, and has the nodes of the state's
+ * net with the same state counts.  The states point into the mapping if the
+ * store has the nodes in the same order and the layout is node-major, and
+ * are copied otherwise.
+ * Returns 1 if the states were set, and 0 if the data file must be read.
+ */
+int blbn_case_store_load_states (blbn_state_t *state, const char *data_filepath) {
+	blbn_case_store_t *store = NULL;
+	char *filepath = NULL;
+	struct stat data_stat, store_stat;
+	int *columns = NULL; // [node] column of the node in the store
+	int in_order = 1;
+	int i, c;
+
+	state->case_store = NULL;
+
+	filepath = (char *) malloc (strlen (data_filepath) + strlen (BLBN_CBIN_SUFFIX) + 1);
+	sprintf (filepath, "%s%s", data_filepath, BLBN_CBIN_SUFFIX);
+	if (stat (data_filepath, &data_stat) == 0 && stat (filepath, &store_stat) == 0 && store_stat.st_mtime >= data_stat.st_mtime) {
+		store = blbn_case_store_open (filepath);
+		if (store == NULL) {
+			printf ("Case store %s is not valid; reading the data file\n", filepath);
+		}
+	}
+	free (filepath);
+	if (store == NULL) {
+		return 0;
+	}
+
+	// Match the nodes of the net to the nodes of the store by name
+	columns = (int *) malloc ((state->node_count + 1) * sizeof (int));
+	for (i = 0; i < state->node_count && store->node_count == state->node_count; i++) {
+		columns[i] = -1;
+		for (c = 0; c < store->node_count; c++) {
+			if (strcmp (store->node_names[(i + c) % store->node_count], state->nodes[i]) == 0) {
+				columns[i] = (i + c) % store->node_count;
+				break;
+			}
+		}
+		if (columns[i] < 0 || store->state_counts[columns[i]] != GetNodeNumberStates_bn (NthNode_bn (state->nodelist, i))) {
+			break;
+		}
+		in_order = in_order && (columns[i] == i);
+	}
+	if (store->node_count != state->node_count || i < state->node_count) {
+		printf ("Case store %s%s does not match the net; reading the data file\n", data_filepath, BLBN_CBIN_SUFFIX);
+		free (columns);
+		blbn_case_store_release (store);
+		return 0;
+	}
+
+	state->case_count = store->case_count;
+	printf ("Case count: %d (mapped from %s%s)\n", state->case_count, data_filepath, BLBN_CBIN_SUFFIX);
+
+	if (in_order && state->layout == BLBN_LAYOUT_NODE_MAJOR) {
+		// The codes of the store are the states, shared read-only
+		state->state = (int *) store->codes;
+		state->case_store = store;
+	} else {
+		state->state = (int *) malloc ((size_t) state->node_count * state->case_count * sizeof (int) + 1); // n states by m cases
+		for (i = 0; i < state->node_count; i++) {
+			for (c = 0; c < state->case_count; c++) {
+				BLBN_STATE (state, i, c) = store->codes[(size_t) columns[i] * store->case_count + c];
+			}
+		}
+		blbn_case_store_release (store);
+	}
+	free (columns);
+
+	return 1;
+}
+
+/**
+ * Changes the layout of the data matrices (state->state and state->cost) to
+ * BLBN_LAYOUT_NODE_MAJOR or BLBN_LAYOUT_CASE_MAJOR.  Node-major suits
+ * workloads that scan the cases of a node (the lookahead policies), and
+ * case-major those that scan the nodes of a case (setting findings, case
+ * queries); for large data sets the scan then stays within a few cache lines.
+ * States mapped from a case store are copied if the layout changes.
+ */
+void blbn_set_data_layout (blbn_state_t *state, int layout) {
+	size_t cells = (size_t) state->node_count * state->case_count;
+	size_t node_major, case_major;
+	int *states = NULL;
+	unsigned int *costs = NULL;
+	int i, j;
+
+	if (layout == state->layout) {
+		return;
+	}
+
+	states = (int *) malloc (cells * sizeof (int) + 1);
+	costs = (unsigned int *) malloc (cells * sizeof (unsigned int) + 1);
+	for (i = 0; i < state->node_count; i++) {
+		for (j = 0; j < state->case_count; j++) {
+			node_major = (size_t) i * state->case_count + j;
+			case_major = (size_t) j * state->node_count + i;
+			if (layout == BLBN_LAYOUT_CASE_MAJOR) {
+				states[case_major] = state->state[node_major];
+				costs[case_major] = state->cost[node_major];
+			} else {
+				states[node_major] = state->state[case_major];
+				costs[node_major] = state->cost[case_major];
+			}
+		}
+	}
+	state->layout = layout;
+
+	if (state->case_store != NULL) {
+		blbn_case_store_release (state->case_store);
+		state->case_store = NULL;
+	} else {
+		free (state->state);
+	}
+	free (state->cost);
+	state->state = states;
+	state->cost = costs;
+}
+
+void blbn_validation_free (blbn_validation_t *validation) {
+	if (validation != NULL) {
+		free (validation->findings);
+		free (validation->target_counts);
+		free (validation->case_patterns);
+		free (validation->case_states);
+		free (validation->case_weights);
+		free (validation);
+	}
+}
+
+/**
+ * Computes the error rate (test_rates[0]) and logarithmic loss
+ * (test_rates[1]) of the target node of the specified network over the
+ * encoded validation set, like a net tester: the findings of each evidence
+ * pattern are entered (only those that differ from the previous pattern) and
+ * the target's beliefs are computed once, in double precision with the
+ * native engine (blbn_engine_node_beliefs).  The cases are then scored in
+ * file order with the beliefs of their patterns, so the sums are the same as
+ * a net tester's.
+ */
+void blbn_util_get_test_rates (blbn_state_t *state, net_bn *net, double *test_rates) {
+	blbn_validation_t *validation = state->validation;
+	int n = state->node_count;
+	int k = validation->target_state_count;
+	blbn_evidence_t *evidence = NULL; // findings entered on net (patterns are applied as differences)
+	const int *findings = NULL;
+	const prob_bn *float_beliefs = NULL;
+	double *beliefs = NULL; // [pattern * k + state] beliefs of the target
+	int *predicted = NULL; // [pattern] most probable target state (-1 if the findings are inconsistent)
+	double *correct = NULL; // [state] weight of the cases of each state that were predicted
+	double weight, belief, tested = 0.0, correct_total = 0.0, log_loss = 0.0;
+	unsigned int c;
+	int p, s, actual;
+
+	evidence = (net == state->work_net ? state->evidence : blbn_evidence_new (state, net));
+	beliefs = (double *) malloc ((validation->pattern_count * k + 1) * sizeof (double));
+	predicted = (int *) malloc ((validation->pattern_count + 1) * sizeof (int));
+	correct = (double *) calloc (k, sizeof (double));
+
+	blbn_evidence_retract (evidence); // IMPORTANT: Otherwise any findings will be part of tests !!
+	CompileNet_bn (net);
+	blbn_counters.compiles++;
+
+	for (p = 0; p < validation->pattern_count; p++) {
+		findings = &validation->findings[p * n];
+		blbn_evidence_apply (evidence, findings);
+
+		predicted[p] = -1;
+		if (blbn_engine_node_beliefs != NULL) {
+			if (blbn_engine_node_beliefs (evidence->nodes[state->target], &beliefs[p * k]) != 0) {
+				ClearErrors_ns (env, ERROR_ERR);
+				continue;
+			}
+		} else {
+			float_beliefs = GetNodeBeliefs_bn (evidence->nodes[state->target]);
+			if (float_beliefs == NULL || GetError_ns (env, ERROR_ERR, NULL)) { // inconsistent findings
+				ClearErrors_ns (env, ERROR_ERR);
+				continue;
+			}
+			for (s = 0; s < k; s++) {
+				beliefs[p * k + s] = float_beliefs[s];
+			}
+		}
+
+		predicted[p] = 0;
+		for (s = 1; s < k; s++) {
+			if (beliefs[p * k + s] > beliefs[p * k + predicted[p]]) {
+				predicted[p] = s;
+			}
+		}
+	}
+
+	for (c = 0; c < validation->case_count; c++) {
+		p = validation->case_patterns[c];
+		if (predicted[p] < 0) {
+			continue;
+		}
+		actual = validation->case_states[c];
+		weight = validation->case_weights[c];
+		belief = beliefs[p * k + actual];
+		if (predicted[p] == actual) {
+			correct[actual] += weight;
+		}
+		log_loss += weight * (belief > 0.0 ? -log (belief) : -log (DBL_MIN));
+		tested += weight;
+	}
+	for (s = 0; s < k; s++) {
+		correct_total += correct[s];
+	}
+
+	blbn_evidence_retract (evidence);
+
+	test_rates[0] = (tested > 0.0 ? 1.0 - correct_total / tested : 1.0);
+	test_rates[1] = (tested > 0.0 ? log_loss / tested : DBL_MAX);
+
+	free (correct);
+	free (predicted);
+	free (beliefs);
+	if (evidence != state->evidence) {
+		blbn_evidence_free (evidence);
+	}
+}
+
+/**
+ * Returns an array of both the error rate and logarithmic loss for the
+ * working network.
+ */
+double* blbn_get_test_rates (blbn_state_t *state) {
+
+	double* test_rates = NULL;
+
+	test_rates = (double *) malloc (2 * sizeof (double));
+
+	blbn_util_get_test_rates (state, state->work_net, test_rates);
+
+	return test_rates;
+}
+
+double blbn_get_error_rate (blbn_state_t *state) {
+
+	double test_rates[2];
+
+	blbn_util_get_test_rates (state, state->work_net, test_rates);
+
+	return test_rates[0];
+}
+
+double blbn_get_log_loss (blbn_state_t *state) {
+
+	double test_rates[2];
+
+	blbn_util_get_test_rates (state, state->work_net, test_rates);
+
+	return test_rates[1];
+}
+
+double blbn_util_get_log_loss (blbn_state_t *state, net_bn *net) {
+
+	double test_rates[2];
+
+	blbn_util_get_test_rates (state, net, test_rates);
+
+	return test_rates[1];
+}
+
+/**
+ * Learn all using BLBN library routines.
+ */
+void blbn_learn_baseline (blbn_state_t *state, FILE* graph_fp) {
+	int i, j;
+
+	double *test_rates = NULL;
+	
+	if (state != NULL) {
+		if (state->work_net != NULL) {
+
+			// Set all as "purchased"
+			for (i = 0; i < state->node_count; i++) {
+				for (j = 0; j < state->case_count; j++) {
+					blbn_set_finding_purchased (state, i, j);
+				}
+			}
+
+			// Learn purchased findings (which will be all findings since they
+			// were just marked as "purchased") in one pass
+			blbn_learn_all_cases (state);
+		}
+
+		// Test network to get error rate and log loss to assess effect of selected action
+		test_rates = blbn_get_test_rates (state);
+
+		// Write results to file
+		for (i = 0; i < state->budget; ++i) {
+			fprintf (graph_fp, "%i\t%d\t%d\t%f\t%f\t0\n", i, -1, -1, test_rates[0], test_rates[1]);
+		}
+		fflush (graph_fp);
+
+		free (test_rates);
+	}
+}
+
+
+void blbn_learn_MBbaseline (blbn_state_t *state, FILE* graph_fp) {
+
+	int i, j;
+
+	double *test_rates = NULL;
+
+	if (state != NULL) {
+		if (state->work_net != NULL) {
+
+			// Set all as "purchased"
+			for (i = 0; i < state->nodes_consider[0]; i++) {
+				for (j = 0; j < state->case_count; j++) {
+
+					int ii = state->nodes_consider[i+1];
+					blbn_set_finding_purchased (state, ii, j);
+				}
+			}
+
+
+			// Learn purchased findings (which will be all findings since they
+			// were just marked as "purchased") in one pass
+			blbn_learn_all_cases (state);
+		}
+
+		// Test network to get error rate and log loss to assess effect of selected action
+		test_rates = blbn_get_test_rates (state);
+
+		// Write results to file
+		for (i = 0; i < state->budget; ++i) {
+			fprintf (graph_fp, "%i\t%d\t%d\t%f\t%f\t0\n", i, -1, -1, test_rates[0], test_rates[1]);
+		}
+		fflush (graph_fp);
+
+		free (test_rates);
+	}
+}
+
+int blbn_get_minimum_cost (blbn_state_t *state) {
+	int i;
+	int cost, min_cost;
+
+	min_cost = -1;
+	for (i = 0; i < state->node_count; ++i) {
+		cost = blbn_get_minimum_cost_in_node (state, i);
+		if (min_cost == -1 || cost < min_cost) {
+			min_cost = cost;
+		}
+	}
+
+	return min_cost;
+}
+
+int blbn_get_minimum_cost_in_node (blbn_state_t *state, unsigned int node_index) {
+	int i;
+	int cost, min_cost;
+
+	min_cost = -1;
+	for (i = 0; i < state->case_count; ++i) {
+		cost = BLBN_COST (state, node_index, i);
+		if (min_cost == -1 || cost < min_cost) {
+			min_cost = cost;
+		}
+	}
+
+	return min_cost;
+}
+
+int blbn_get_minimum_cost_in_case (blbn_state_t *state, unsigned int case_index) {
+	int i;
+	int cost, min_cost;
+
+	min_cost = -1;
+	for (i = 0; i < state->node_count; ++i) {
+		cost = BLBN_COST (state, i, case_index);
+		if (min_cost == -1 || cost < min_cost) {
+			min_cost = cost;
+		}
+	}
+
+	return min_cost;
+}
+
+/**
+ * Returns pointer to first action in list or NULL.  Pointers to actions in
+ * the list are valid until the next action is appended.
+ */
+blbn_select_action_t* blbn_get_action_head (blbn_state_t *state) {
+	return blbn_get_action (state, 0);
+}
+
+/**
+ * Returns pointer to action at specified index in list or NULL.
+ */
+blbn_select_action_t* blbn_get_action (blbn_state_t *state, unsigned int index) {
+	if (state != NULL) {
+		if (index < state->sel_actions.length) {
+			return &state->sel_actions.actions[index];
 		}
 	}
-	return tail_action;
+	return NULL;
 }
 
 /**
  * Returns pointer to last action in list or NULL.
  */
-int blbn_count_actions (blbn_state_t *state) {
-	blbn_select_action_t *tail_action = NULL; // last action in list
-	int count = 0;
+blbn_select_action_t* blbn_get_action_tail (blbn_state_t *state) {
 	if (state != NULL) {
-		if (state->sel_action_seq != NULL) {
-			count = 0;
-			tail_action = state->sel_action_seq;
-			++count;
-			while (tail_action->next != NULL) {
-				tail_action = tail_action->next;
-				++count;
-			}
+		if (state->sel_actions.length > 0) {
+			return &state->sel_actions.actions[state->sel_actions.length - 1];
 		}
 	}
+	return NULL;
+}
 
-	return count;
+/**
+ * Returns the number of actions in list.
+ */
+int blbn_count_actions (blbn_state_t *state) {
+	return (state != NULL ? state->sel_actions.length : 0);
+}
+
+/**
+ * Appends a copy of the specified action to the list (doubling the capacity
+ * of the list when it is full) and returns a pointer to the copy.
+ */
+blbn_select_action_t* blbn_append_action (blbn_state_t *state, const blbn_select_action_t *action) {
+	blbn_action_list_t *list = &state->sel_actions;
+
+	if (list->length == list->capacity) {
+		list->capacity = (list->capacity > 0 ? 2 * list->capacity : 64);
+		list->actions = (blbn_select_action_t *) realloc (list->actions, list->capacity * sizeof (blbn_select_action_t));
+	}
+	list->actions[list->length] = *action;
+
+	return &list->actions[list->length++];
+}
+
+/**
+ * Positions iter at the first action of the specified list.
+ */
+void blbn_action_iter_init (blbn_action_iter_t *iter, const blbn_action_list_t *list) {
+	iter->list = list;
+	iter->position = 0;
+}
+
+/**
+ * Returns the next action of the iterator's list, or NULL after the last.
+ */
+const blbn_select_action_t* blbn_action_iter_next (blbn_action_iter_t *iter) {
+	if (iter->list == NULL || iter->position >= iter->list->length) {
+		return NULL;
+	}
+	return &iter->list->actions[iter->position++];
 }
 
 /*
  * Learn a naive or Bayesian network, return the set of (instance, feature) choices
  * */
-blbn_select_action_t* blbn_learn1(blbn_state_t *state, int policy, FILE* graph_fp, FILE* log_fp) {
+const blbn_action_list_t* blbn_learn1(blbn_state_t *state, int policy, FILE* graph_fp, FILE* log_fp) {
 
 	int i;
-	blbn_select_action_t *prev_action = NULL;
 	blbn_select_action_t *curr_action = NULL;
 	int minimum_cost;
-	time_t selection_begin_time;
-	time_t selection_end_time;
-	double selection_time;
+	long begin_ns, selected_ns, revised_ns; // monotonic clock at the start of each phase of an iteration
+	blbn_counters_t counters_begin; // counters at the start of an iteration
 	// double *test_rate = NULL; // [0] = error rate, [1] = log loss
 	double *test_rates = NULL;
 	//printf ("place 1!\n");
@@ -1828,20 +3161,22 @@ blbn_select_action_t* blbn_learn1(blbn_state_t *state, int policy, FILE* graph_f
 	//------------------------------------------------------------------------------
 
 	i = 0;
+	counters_begin = blbn_counters;
+	begin_ns = blbn_now_ns ();
+
 	// Test network to get error rate and log loss to assess effect of selected action
 	test_rates = blbn_get_test_rates (state);
 
 	state->last_log_loss = state->curr_log_loss;
 	state->curr_log_loss = state->curr_log_loss;
 
-	selection_time = 0.0;
-
 	if (graph_fp==NULL){
 		printf("graph file is NULL. Exiting ... \n");
 		exit(1);
 	}
 
-	fprintf (graph_fp, "%i\t%d\t%d\t%f\t%f\t%f\n", i, -1, -1, test_rates[0], test_rates[1], selection_time);
+	blbn_write_graph_row (graph_fp, i, -1, -1, test_rates, begin_ns, begin_ns, begin_ns, blbn_now_ns (), &counters_begin);
+	free (test_rates);
 
 	//------------------------------------------------------------------------------
 	// Learn a model from data using selection policy
@@ -1856,7 +3191,8 @@ blbn_select_action_t* blbn_learn1(blbn_state_t *state, int policy, FILE* graph_f
 		//printf ("DEBUG: blbn_has_findings_not_available(state): %d\n", blbn_has_findings_available (state));
 
 		// Select next action using an action selection policy
-		selection_begin_time = time (NULL);
+		counters_begin = blbn_counters;
+		begin_ns = blbn_now_ns ();
 
 		if (policy == BLBN_POLICY_RANDOM) {
 			//printf("policy is rr!\n");
@@ -1904,27 +3240,28 @@ blbn_select_action_t* blbn_learn1(blbn_state_t *state, int policy, FILE* graph_f
 			break;
 		}
 
-		// Add action to list of actions
-		prev_action = blbn_get_action_tail (state);
-		if (prev_action == NULL) {
-			curr_action->prev = NULL;
-			curr_action->next = NULL;
-			state->sel_action_seq = curr_action;
-		} else {
-			prev_action->next = curr_action;
-			curr_action->prev = prev_action;
-			curr_action->next = NULL;
-		}
+		selected_ns = blbn_now_ns ();
+
+		// Add action to list of actions (the list keeps a copy)
+		blbn_append_action (state, curr_action);
+		free (curr_action);
+		curr_action = blbn_get_action_tail (state);
 
 		printf ("selection %d: node %d, case %d\n", i, curr_action->node_index, curr_action->case_index);
 
+		// Hand the action to the follower (pipelined mode)
+		if (state->action_out_fd >= 0) {
+			blbn_write_action (state->action_out_fd, curr_action);
+		}
+
 		// Mark selected finding as purchased
 		blbn_set_finding_purchased (state, curr_action->node_index, curr_action->case_index);
 
 		// Reduce budget by cost of purchased item
-		state->budget -= state->cost[curr_action->node_index][curr_action->case_index];
+		state->budget -= BLBN_COST (state, curr_action->node_index, curr_action->case_index);
 
-		blbn_revise_by_case_findings_v2 (state, curr_action->case_index);
+		blbn_revise_by_case_findings (state, curr_action->case_index);
+		revised_ns = blbn_now_ns ();
 
 		// Test network to get error rate and log loss to assess effect of selected action
 		test_rates = blbn_get_test_rates (state);
@@ -1932,11 +3269,8 @@ blbn_select_action_t* blbn_learn1(blbn_state_t *state, int policy, FILE* graph_f
 		state->last_log_loss = state->curr_log_loss;
 		state->curr_log_loss = test_rates[1];
 
-		selection_end_time = time (NULL);
-		selection_time = difftime (selection_end_time, selection_begin_time);
-
 		// Write iteration data to log file for graphing
-		fprintf (graph_fp, "%i\t%d\t%d\t%f\t%f\t%f\n", i, curr_action->node_index, curr_action->case_index, test_rates[0], test_rates[1], selection_time);
+		blbn_write_graph_row (graph_fp, i, curr_action->node_index, curr_action->case_index, test_rates, begin_ns, selected_ns, revised_ns, blbn_now_ns (), &counters_begin);
 		//printf ("%i\t%d\t%d\t%f\t%f\t%f\n", i, curr_action->node_index, curr_action->case_index, error_rate, log_loss, selection_time);
 
 		free (test_rates);
@@ -1953,18 +3287,140 @@ blbn_select_action_t* blbn_learn1(blbn_state_t *state, int policy, FILE* graph_f
 		++i;
 	}
 	printf ("Finished!\n");
-	return state->sel_action_seq;
+	return &state->sel_actions;
+}
+
+/**
+ * Writes the node, case and filter node indices of the specified action to
+ * the file descriptor fd (a pipe to a follower in pipelined mode).  Each
+ * action is written with a single write of less than PIPE_BUF bytes, so it is
+ * never interleaved or split.
+ */
+void blbn_write_action (int fd, const blbn_select_action_t *action) {
+	unsigned int record[3];
+
+	record[0] = action->node_index;
+	record[1] = action->case_index;
+	record[2] = action->filter_node_index;
+	if (write (fd, record, sizeof (record)) != sizeof (record)) {
+		printf ("Error: Could not write action to follower.\n");
+	}
+}
+
+/**
+ * Reads the next action written by blbn_write_action from the file descriptor
+ * fd into action, blocking until the leader has selected it.  Returns 0 when
+ * the leader has finished (end of file).
+ */
+int blbn_read_action (int fd, blbn_select_action_t *action) {
+	unsigned int record[3];
+	size_t length = 0;
+	ssize_t count;
+
+	while (length < sizeof (record)) {
+		count = read (fd, (char *) record + length, sizeof (record) - length);
+		if (count <= 0) {
+			return 0;
+		}
+		length += count;
+	}
+
+	action->node_index = record[0];
+	action->case_index = record[1];
+	action->filter_node_index = record[2];
+
+	return 1;
+}
+
+/**
+ * Returns the current time of the monotonic clock in nanoseconds.
+ */
+long blbn_now_ns () {
+	struct timespec now;
+
+	clock_gettime (CLOCK_MONOTONIC, &now);
+	return (long) now.tv_sec * 1000000000L + now.tv_nsec;
+}
+
+/**
+ * Returns the number of bytes written to the specified memory stream.
+ */
+long blbn_stream_length (stream_ns *stream) {
+	long length = 0;
+
+	GetStreamContents_ns (stream, &length);
+	return length;
+}
+
+/**
+ * Sets diff to the counts made between the snapshots begin and end of
+ * blbn_counters.
+ */
+void blbn_counters_diff (blbn_counters_t *diff, const blbn_counters_t *end, const blbn_counters_t *begin) {
+	diff->em_runs = end->em_runs - begin->em_runs;
+	diff->net_copies = end->net_copies - begin->net_copies;
+	diff->compiles = end->compiles - begin->compiles;
+	diff->findings_entered = end->findings_entered - begin->findings_entered;
+	diff->stream_bytes = end->stream_bytes - begin->stream_bytes;
+	diff->candidates_scored = end->candidates_scored - begin->candidates_scored;
+	diff->candidates_pruned = end->candidates_pruned - begin->candidates_pruned;
+}
+
+/**
+ * Adds counters to sum.
+ */
+void blbn_counters_add (blbn_counters_t *sum, const blbn_counters_t *counters) {
+	sum->em_runs += counters->em_runs;
+	sum->net_copies += counters->net_copies;
+	sum->compiles += counters->compiles;
+	sum->findings_entered += counters->findings_entered;
+	sum->stream_bytes += counters->stream_bytes;
+	sum->candidates_scored += counters->candidates_scored;
+	sum->candidates_pruned += counters->candidates_pruned;
+}
+
+/**
+ * Writes the row of iteration i to the graph file.  The tab separated columns
+ * are:
+ *
+ *   1-3   iteration, selected node index and case index (-1 for iteration 0)
+ *   4-5   error rate and log loss on the validation set
+ *   6     wall clock time of the iteration in seconds
+ *   7-9   nanoseconds spent selecting the action, relearning the network
+ *         (blbn_revise_by_case_findings) and testing it (blbn_get_test_rates)
+ *   10-14 EM runs, net copies, compiles, findings entered and bytes written to
+ *         memory streams during the iteration (see blbn_counters_t)
+ *   15-16 candidates scored and candidate evaluations saved by pruning
+ *         during the iteration (see blbn_prune_t)
+ *
+ * The phases start at begin_ns, selected_ns and revised_ns and the iteration
+ * ends at evaluated_ns; counters_begin is blbn_counters at begin_ns.
+ */
+void blbn_write_graph_row (FILE *graph_fp, int i, int node_index, int case_index, const double *test_rates, long begin_ns, long selected_ns, long revised_ns, long evaluated_ns, const blbn_counters_t *counters_begin) {
+	blbn_counters_t counts;
+
+	blbn_counters_diff (&counts, &blbn_counters, counters_begin);
+	fprintf (graph_fp, "%i\t%d\t%d\t%f\t%f\t%f\t%ld\t%ld\t%ld\t%lu\t%lu\t%lu\t%lu\t%lu\t%lu\t%lu\n", i, node_index, case_index,
+			test_rates[0], test_rates[1], (evaluated_ns - begin_ns) / 1e9,
+			selected_ns - begin_ns, revised_ns - selected_ns, evaluated_ns - revised_ns,
+			counts.em_runs, counts.net_copies, counts.compiles, counts.findings_entered, counts.stream_bytes,
+			counts.candidates_scored, counts.candidates_pruned);
 }
 
 /*
- * Learn a naive or Bayesian network based on give (instance, feature) choices
+ * Learn a naive or Bayesian network based on give (instance, feature) choices.
+ * If state->action_in_fd is set, the choices are read from it as the leader
+ * makes them (pipelined mode) instead of from following_actions.
  */
-void blbn_learn2(blbn_state_t *state, FILE* graph_fp, FILE* log_fp, blbn_select_action_t* following_action_seq) {
-	blbn_select_action_t *prev_action = NULL;
+void blbn_learn2(blbn_state_t *state, FILE* graph_fp, FILE* log_fp, blbn_action_iter_t* following_actions) {
+	blbn_select_action_t received_action; // action read from the leader (pipelined mode)
+	const blbn_select_action_t *following_action = NULL;
+	blbn_select_action_t *curr_action = NULL;
 	int minimum_cost;
-	time_t selection_begin_time;
-	time_t selection_end_time;
-	double selection_time;
+	long begin_ns, selected_ns, revised_ns; // monotonic clock at the start of each phase of an iteration
+	blbn_counters_t counters_begin = blbn_counters; // counters at the start of an iteration
+
+	begin_ns = blbn_now_ns ();
 
 	// Test network to get error rate and log loss to assess effect of selected action
 	double* test_rates = blbn_get_test_rates (state);
@@ -1972,9 +3428,9 @@ void blbn_learn2(blbn_state_t *state, FILE* graph_fp, FILE* log_fp, blbn_select_
 	state->last_log_loss = state->curr_log_loss;
 	state->curr_log_loss = state->curr_log_loss;
 
-	selection_time = 0.0;
 	int i=0;
-	fprintf (graph_fp, "%i\t%d\t%d\t%f\t%f\t%f\n", i, -1, -1, test_rates[0], test_rates[1], selection_time);
+	blbn_write_graph_row (graph_fp, i, -1, -1, test_rates, begin_ns, begin_ns, begin_ns, blbn_now_ns (), &counters_begin);
+	free (test_rates);
 
 	//------------------------------------------------------------------------------
 	// Learn a model from data using selection policy
@@ -1988,33 +3444,26 @@ void blbn_learn2(blbn_state_t *state, FILE* graph_fp, FILE* log_fp, blbn_select_
 
 		//printf ("DEBUG: blbn_has_findings_not_available(state): %d\n", blbn_has_findings_available (state));
 
-		// Select next action using an action selection policy
-		selection_begin_time = time (NULL);
+		// Select next action using an action selection policy (the time spent waiting for the leader in pipelined mode)
+		counters_begin = blbn_counters;
+		begin_ns = blbn_now_ns ();
+
+		if (state->action_in_fd >= 0) {
+			following_action = (blbn_read_action (state->action_in_fd, &received_action) ? &received_action : NULL);
+		} else {
+			following_action = (following_actions != NULL ? blbn_action_iter_next (following_actions) : NULL);
+		}
 
-		if (following_action_seq == NULL) {
+		if (following_action == NULL) {
 			printf("action is null!");
 			// Could not take any action using the specified policy for some reason for some reason, so break learning loop.
 			break;
 		}
 
-		blbn_select_action_t* curr_action = (blbn_select_action_t *) malloc (sizeof (blbn_select_action_t));
-		curr_action->prev = NULL; // no previous action (this is the first action)
-		curr_action->next = NULL; // no next action (this is the newest action)
-		curr_action->node_index = following_action_seq->node_index;
-		curr_action->case_index = following_action_seq->case_index;
-		curr_action->filter_node_index = following_action_seq->filter_node_index;
+		selected_ns = blbn_now_ns ();
 
 		// Add action to list of actions
-		prev_action = blbn_get_action_tail (state);
-		if (prev_action == NULL) {
-			curr_action->prev = NULL;
-			curr_action->next = NULL;
-			state->sel_action_seq = curr_action;
-		} else {
-			prev_action->next = curr_action;
-			curr_action->prev = prev_action;
-			curr_action->next = NULL;
-		}
+		curr_action = blbn_append_action (state, following_action);
 
 		printf ("selection %d: node %d, case %d\n", i, curr_action->node_index, curr_action->case_index);
 
@@ -2022,10 +3471,11 @@ void blbn_learn2(blbn_state_t *state, FILE* graph_fp, FILE* log_fp, blbn_select_
 		blbn_set_finding_purchased (state, curr_action->node_index, curr_action->case_index);
 
 		// Reduce budget by cost of purchased item
-		state->budget -= state->cost[curr_action->node_index][curr_action->case_index];
+		state->budget -= BLBN_COST (state, curr_action->node_index, curr_action->case_index);
 
 		//blbn_revise_by_case_findings_v0 (state, curr_action->case_index);
-		blbn_revise_by_case_findings_v2 (state, curr_action->case_index);
+		blbn_revise_by_case_findings (state, curr_action->case_index);
+		revised_ns = blbn_now_ns ();
 
 		// Test network to get error rate and log loss to assess effect of selected action
 		test_rates = blbn_get_test_rates (state);
@@ -2033,11 +3483,8 @@ void blbn_learn2(blbn_state_t *state, FILE* graph_fp, FILE* log_fp, blbn_select_
 		state->last_log_loss = state->curr_log_loss;
 		state->curr_log_loss = test_rates[1];
 
-		selection_end_time = time (NULL);
-		selection_time = difftime (selection_end_time, selection_begin_time);
-
 		// Write iteration data to log file for graphing
-		fprintf (graph_fp, "%i\t%d\t%d\t%f\t%f\t%f\n", i, curr_action->node_index, curr_action->case_index, test_rates[0], test_rates[1], selection_time);
+		blbn_write_graph_row (graph_fp, i, curr_action->node_index, curr_action->case_index, test_rates, begin_ns, selected_ns, revised_ns, blbn_now_ns (), &counters_begin);
 		//printf ("%i\t%d\t%d\t%f\t%f\t%f\n", i, curr_action->node_index, curr_action->case_index, error_rate, log_loss, selection_time);
 
 		free (test_rates);
@@ -2050,7 +3497,6 @@ void blbn_learn2(blbn_state_t *state, FILE* graph_fp, FILE* log_fp, blbn_select_
 		// Flush output files
 		fflush (graph_fp);
 
-		following_action_seq = following_action_seq->next;
 		// Increment loop/selection counter
 		++i;
 	}
@@ -2065,21 +3511,10 @@ void blbn_learn2(blbn_state_t *state, FILE* graph_fp, FILE* log_fp, blbn_select_
 */
 blbn_select_action_t* blbn_select_next_random (blbn_state_t *state) {
 
-		blbn_select_action_t *prev_action = NULL;
 		blbn_select_action_t *curr_action = NULL;
 
-		// Move to the most recent previous select action
-		prev_action = state->sel_action_seq;
-		if (prev_action != NULL) {
-			while (prev_action->next != NULL) {
-				prev_action = prev_action->next;
-			}
-		}
-
 		// Allocate space for current selection and initialize structure
 		curr_action = (blbn_select_action_t *) malloc (sizeof (blbn_select_action_t));
-		curr_action->prev = NULL; // no previous action (this is the first action)
-		curr_action->next = NULL; // no next action (this is the newest action)
 
 		if (curr_action != NULL) {
 
@@ -2115,19 +3550,11 @@ blbn_select_action_t* blbn_select_next_rr (blbn_state_t *state) {
 	blbn_select_action_t *prev_action = NULL;
 	blbn_select_action_t *curr_action = NULL;
 
-	// Move to the most recent previous select action
-	prev_action = state->sel_action_seq;
-	//printf("previous action: %s\n", prev_action);
-	if (prev_action != NULL) {
-		while (prev_action->next != NULL) {
-			prev_action = prev_action->next;
-		}
-	}
+	// Most recent previous select action
+	prev_action = blbn_get_action_tail (state);
 
 	// Allocate space for current selection and initialize structure
 	curr_action = (blbn_select_action_t *) malloc (sizeof (blbn_select_action_t));
-	curr_action->prev = NULL; // no previous action (this is the first action)
-	curr_action->next = NULL; // no next action (this is the newest action)
 
 	if (curr_action != NULL) {
 			//printf("First time selection!\n");
@@ -2194,18 +3621,11 @@ blbn_select_action_t* blbn_select_next_br (blbn_state_t *state) {
 	blbn_select_action_t *prev_action = NULL;
 	blbn_select_action_t *curr_action = NULL;
 
-	// Move to the most recent previous select action
-	prev_action = state->sel_action_seq;
-	if (prev_action != NULL) {
-		while (prev_action->next != NULL) {
-			prev_action = prev_action->next;
-		}
-	}
+	// Most recent previous select action
+	prev_action = blbn_get_action_tail (state);
 
 	// Allocate space for current selection and initialize structure
 	curr_action = (blbn_select_action_t *) malloc (sizeof (blbn_select_action_t));
-	curr_action->prev = NULL; // no previous action (this is the first action)
-	curr_action->next = NULL; // no next action (this is the newest action)
 
 	if (curr_action != NULL) {
 
@@ -2267,12 +3687,10 @@ blbn_select_action_t* blbn_select_next_br (blbn_state_t *state) {
 int blbn_count_node_states (blbn_state_t *state, int node_index) {
 
 	int count = -1;
-	node_bn *node = NULL;
 
 	if (state != NULL) {
 		if (blbn_is_valid_node (state, node_index)) {
-			node = NthNode_bn (state->nodelist, node_index);
-			count = GetNodeNumberStates_bn (node);
+			count = state->state_counts[node_index];
 		}
 	}
 
@@ -2280,19 +3698,113 @@ int blbn_count_node_states (blbn_state_t *state, int node_index) {
 }
 
 double blbn_get_node_belief (blbn_state_t *state, int node_index, int state_index) {
-	RetractNetFindings_bn(state->work_net);
-	char *node_name = blbn_get_node_name (state, node_index);
-	node_bn* node = GetNodeNamed_bn (node_name, state->work_net);
-	char *state_name = GetNodeStateName_bn (node, state_index);
-	state_bn node_state = GetStateNamed_bn (state_name, node);
-	RetractNetFindings_bn(state->work_net);
-	return GetNodeBeliefs_bn (node) [node_state];
+	node_bn* node = BLBN_WORK_NODE (state, node_index);
+	blbn_evidence_retract (state->evidence);
+	return GetNodeBeliefs_bn (node) [state_index];
+}
+
+/**
+ * Records that the CPTs of the working network have changed (the network was
+ * relearned or replaced), which invalidates every cached posterior.
+ */
+void blbn_work_net_changed (blbn_state_t *state) {
+	state->net_version++;
+}
+
+/**
+ * Allocates an empty posterior cache for the working network of the
+ * specified state.
+ */
+blbn_posterior_cache_t* blbn_posterior_cache_new (blbn_state_t *state) {
+	blbn_posterior_cache_t *cache = (blbn_posterior_cache_t *) calloc (1, sizeof (blbn_posterior_cache_t));
+	int i;
+
+	cache->state_offset = (unsigned int *) malloc ((state->node_count + 1) * sizeof (unsigned int));
+	cache->state_offset[0] = 0;
+	for (i = 0; i < state->node_count; i++) {
+		cache->state_offset[i + 1] = cache->state_offset[i] + blbn_count_node_states (state, i);
+	}
+	cache->cases = (blbn_posterior_t *) calloc (state->case_count, sizeof (blbn_posterior_t));
+
+	return cache;
+}
+
+void blbn_posterior_cache_free (blbn_posterior_cache_t *cache, unsigned int case_count) {
+	int j;
+
+	if (cache != NULL) {
+		for (j = 0; j < case_count; j++) {
+			free (cache->cases[j].beliefs);
+			free (cache->cases[j].target_beliefs);
+		}
+		free (cache->cases);
+		free (cache->state_offset);
+		free (cache);
+	}
+}
+
+/**
+ * Returns the beliefs of every node of the working network given the learned
+ * findings of the specified case.
+ *
+ * The beliefs are computed with a single propagation and cached until the
+ * working network changes (state->net_version) or a flag of the case changes
+ * (flags->case_versions), so the beliefs of cases whose evidence is unchanged
+ * are reused by every query until the network is relearned.  The
+ * target beliefs given each node state (see
+ * blbn_get_target_belief_given_node_state) are computed on demand.
+ */
+const blbn_posterior_t* blbn_get_case_posteriors (blbn_state_t *state, int case_index) {
+	blbn_posterior_cache_t *cache;
+	blbn_posterior_t *posterior;
+	unsigned int entry_count;
+	const prob_bn *beliefs;
+	node_bn *node;
+	int i, k;
+
+	if (state->posteriors == NULL) {
+		state->posteriors = blbn_posterior_cache_new (state);
+	}
+	cache = state->posteriors;
+	posterior = &cache->cases[case_index];
+
+	if (posterior->net_version == state->net_version && posterior->case_version == state->flags->case_versions[case_index]) {
+		cache->hits++;
+		return posterior;
+	}
+	cache->misses++;
+
+	entry_count = cache->state_offset[state->node_count];
+	if (posterior->beliefs == NULL) {
+		posterior->beliefs        = (double *) malloc (entry_count * sizeof (double));
+		posterior->target_beliefs = (double *) malloc (entry_count * sizeof (double));
+	}
+
+	// Set all learned findings in the specified case
+	blbn_set_net_findings_learned (state, case_index);
+
+	for (i = 0; i < state->node_count; i++) {
+		node = BLBN_WORK_NODE (state, i);
+		beliefs = GetNodeBeliefs_bn (node);
+		for (k = cache->state_offset[i]; k < cache->state_offset[i + 1]; k++) {
+			posterior->beliefs[k] = beliefs[k - cache->state_offset[i]];
+			posterior->target_beliefs[k] = -1.0;
+		}
+	}
+
+	// The findings stay entered (state->evidence tracks them), so the next
+	// lookup in the same case only applies the findings that differ
+
+	posterior->net_version  = state->net_version;
+	posterior->case_version = state->flags->case_versions[case_index];
+
+	return posterior;
 }
 
 /**
  * Computes the probability that the specified node in the specified case
- * is in the specified state, given all available findings (i.e., all
- * purchased findings and the target finding).
+ * is in the specified state, given all learned findings in the case (read
+ * from the posterior cache).
  *
  * @param state A BLBN library state object.
  * @param node_index The index of a node in the network.
@@ -2302,61 +3814,110 @@ double blbn_get_node_belief (blbn_state_t *state, int node_index, int state_inde
  * @return The computed probability.
  */
 double blbn_get_node_state_probability_given_learned_states (blbn_state_t *state, int node_index, int case_index, int state_index) {
+	const blbn_posterior_t *posterior = blbn_get_case_posteriors (state, case_index);
 
-	char *node_name = NULL;
-	node_bn *node = NULL;
-	char *state_name = NULL;
-	state_bn node_state;
-	double probability;
-
-	// Set all learned findings in the specified case
-	blbn_set_net_findings_learned (state, case_index);
-
-	node_name = blbn_get_node_name (state, node_index);
-	node = GetNodeNamed_bn (node_name, state->work_net);
-	state_name = GetNodeStateName_bn (node, state_index);
-	node_state = GetStateNamed_bn (state_name, node);
-
-	// Calculate the probability that the specified node is in the specified
-	// state given the present findings.
-	probability = GetNodeBeliefs_bn (node) [node_state];
-
-	// Retract network findings
-	RetractNetFindings_bn(state->work_net);
-
-	return probability;
+	return posterior->beliefs[state->posteriors->state_offset[node_index] + state_index];
 }
 
 /**
  * Computes the likelihood of the correct label for the specified case given
- * the learned findings in the case.
+ * the learned findings in the case (read from the posterior cache).
  */
 double blbn_get_target_node_belief_given_learned (blbn_state_t *state, int case_index) {
-	char *node_name = NULL;
-	node_bn *node = NULL;
-	int state_index = -1;
-	char *state_name = NULL;
-	state_bn node_state;
-	double probability;
+	const blbn_posterior_t *posterior = blbn_get_case_posteriors (state, case_index);
 
-	// Set all learned findings in the specified case
-	blbn_set_net_findings_learned (state, case_index);
+	return posterior->beliefs[state->posteriors->state_offset[state->target] + BLBN_STATE (state, state->target, case_index)];
+}
 
-	node_name = blbn_get_node_name (state, state->target);
-	node = GetNodeNamed_bn (node_name, state->work_net);
+/**
+ * Computes the joint beliefs of the target and the specified node given the
+ * learned findings of the specified case other than the target, indexed
+ * joint[target state * node states + node state].
+ *
+ * With the native engine the joint is computed with one propagation
+ * (blbn_engine_joint_beliefs); with Netica it is assembled from one
+ * propagation for the node's beliefs and one per node state for the target's
+ * beliefs.  Returns 0 on success, -1 if the findings are inconsistent.
+ */
+int blbn_get_target_joint_beliefs (blbn_state_t *state, int node_index, int case_index, double *joint) {
+	node_bn *target_node = BLBN_WORK_NODE (state, state->target);
+	node_bn *node = BLBN_WORK_NODE (state, node_index);
+	int target_state_count = GetNodeNumberStates_bn (target_node);
+	int node_state_count = GetNodeNumberStates_bn (node);
+	const prob_bn *beliefs = NULL;
+	double *node_beliefs = NULL;
+	int result = 0;
+	int t, k;
+
+	// Set known findings in case except for target
+	blbn_set_net_findings_learned_except_target (state, case_index);
+
+	if (blbn_engine_joint_beliefs != NULL) {
+		result = blbn_engine_joint_beliefs (target_node, node, joint);
+	} else {
+		node_beliefs = (double *) malloc (node_state_count * sizeof (double));
+		beliefs = GetNodeBeliefs_bn (node);
+		if (beliefs == NULL) { // inconsistent findings
+			result = -1;
+		} else {
+			for (k = 0; k < node_state_count; k++) {
+				node_beliefs[k] = beliefs[k];
+			}
+			for (k = 0; k < node_state_count; k++) {
+				for (t = 0; t < target_state_count; t++) {
+					joint[t * node_state_count + k] = 0.0;
+				}
+				if (node_beliefs[k] > 0.0) {
+					blbn_evidence_set (state->evidence, node_index, k);
+					beliefs = GetNodeBeliefs_bn (target_node);
+					for (t = 0; t < target_state_count && beliefs != NULL; t++) {
+						joint[t * node_state_count + k] = beliefs[t] * node_beliefs[k];
+					}
+				}
+			}
+		}
+		free (node_beliefs);
+	}
+	ClearErrors_ns (env, ERROR_ERR);
 
-	state_index = state->state[state->target][case_index];
-	state_name = GetNodeStateName_bn (node, state_index);
-	node_state = GetStateNamed_bn (state_name, node);
+	// The findings stay entered (state->evidence tracks them), so the other
+	// candidates of the case reuse the propagation
 
-	// Calculate the probability that the specified node is in the specified
-	// state given the present findings.
-	probability = GetNodeBeliefs_bn (node) [node_state];
+	return result;
+}
 
-	// Retract network findings
-	RetractNetFindings_bn(state->work_net);
+/**
+ * Computes the likelihood of the correct label for the specified case given
+ * the learned findings in the case other than the target and the finding that
+ * the specified node is in the specified state.  The likelihoods for every
+ * state of the node are computed together from the joint beliefs of the
+ * target and the node (blbn_get_target_joint_beliefs), and cached with the
+ * case's other posteriors.  Like beliefs, they have prob_bn precision.
+ */
+double blbn_get_target_belief_given_node_state (blbn_state_t *state, int node_index, int case_index, int state_index) {
+	blbn_posterior_t *posterior = (blbn_posterior_t *) blbn_get_case_posteriors (state, case_index);
+	unsigned int offset = state->posteriors->state_offset[node_index];
+	int node_state_count = state->posteriors->state_offset[node_index + 1] - offset;
+	int target_state_count = state->posteriors->state_offset[state->target + 1] - state->posteriors->state_offset[state->target];
+	int label = BLBN_STATE (state, state->target, case_index);
+	double *joint = NULL;
+	double sum;
+	int t, k;
+
+	if (posterior->target_beliefs[offset + state_index] < 0.0) {
+		joint = (double *) calloc (target_state_count * node_state_count, sizeof (double));
+		blbn_get_target_joint_beliefs (state, node_index, case_index, joint);
+		for (k = 0; k < node_state_count; ++k) {
+			sum = 0.0;
+			for (t = 0; t < target_state_count; t++) {
+				sum += joint[t * node_state_count + k];
+			}
+			posterior->target_beliefs[offset + k] = (sum > 0.0 ? (prob_bn) (joint[label * node_state_count + k] / sum) : 0.0);
+		}
+		free (joint);
+	}
 
-	return probability;
+	return posterior->target_beliefs[offset + state_index];
 }
 
 /**
@@ -2364,23 +3925,16 @@ double blbn_get_target_node_belief_given_learned (blbn_state_t *state, int case_
  * the learned findings in the case.
  */
 double blbn_get_target_node_belief_given_findings (blbn_state_t *state, int case_index) {
-	char *node_name = NULL;
 	node_bn *node = NULL;
 	int state_index = -1;
-	char *state_name = NULL;
-	state_bn node_state;
 	double probability;
 
-	node_name = blbn_get_node_name (state, state->target);
-	node = GetNodeNamed_bn (node_name, state->work_net);
-
-	state_index = state->state[state->target][case_index];
-	state_name = GetNodeStateName_bn (node, state_index);
-	node_state = GetStateNamed_bn (state_name, node);
+	node = BLBN_WORK_NODE (state, state->target);
+	state_index = BLBN_STATE (state, state->target, case_index);
 
 	// Calculate the probability that the specified node is in the specified
 	// state given the present findings.
-	probability = GetNodeBeliefs_bn (node) [node_state];
+	probability = GetNodeBeliefs_bn (node) [state_index];
 
 	return probability;
 }
@@ -2391,31 +3945,15 @@ double blbn_get_target_node_belief_given_findings (blbn_state_t *state, int case
  */
 blbn_select_action_t* blbn_select_next_sfl (blbn_state_t *state) {
 
-	blbn_select_action_t *prev_action = NULL;
 	blbn_select_action_t *curr_action = NULL;
 
-	int i,j;
-
 	int random_case_index = -1;
 
-	double min_exp_loss = DBL_MAX;
 	int min_exp_loss_node_index = -1;
 	int min_exp_loss_case_index = -1;
 
-	double *sfl_values;
-
-	// Move to the most recent previous select action
-	prev_action = state->sel_action_seq;
-	if (prev_action != NULL) {
-		while (prev_action->next != NULL) {
-			prev_action = prev_action->next;
-		}
-	}
-
 	// Allocate space for current selection and initialize structure
 	curr_action = (blbn_select_action_t *) malloc (sizeof (blbn_select_action_t));
-	curr_action->prev = NULL; // no previous action (this is the first action)
-	curr_action->next = NULL; // no next action (this is the newest action)
 
 	if (curr_action != NULL) {
 		//printf("\nEntering choosing (case, node) of SFL\n");
@@ -2425,32 +3963,10 @@ blbn_select_action_t* blbn_select_next_sfl (blbn_state_t *state) {
 		// smallest SFL value.
 		//------------------------------------------------------------------------------
 
-		for (j = 0; j < state->case_count; ++j) {
-			//printf("j=%d\n",j);
-
-			// Get SFL values for row
-			sfl_values = blbn_util_sfl_row (state, j);
-
-			//printf("Number state nodes consider %d\n", state->nodes_consider[0]);
-			// Get minimum SFL value for row
-			int ii=0;
-			for (ii = 0; ii < state->nodes_consider[0]; ii++) {
-				i = state->nodes_consider[ii+1];
-
-				// Check scores for values that are not for the target node or nodes that are already purchased
-				if (!blbn_is_available_finding (state, i, j)) {
-					// Update minimum if necessary
-					//printf("sfl_values= %f\n", sfl_values[ii]);
-					if (sfl_values[ii] < min_exp_loss) {
-						min_exp_loss = sfl_values[ii];
-						min_exp_loss_node_index = i;
-						min_exp_loss_case_index = j;
-					}
-				}
-			}
-
-			// Free SFL values for row
-			free (sfl_values);
+		if (state->sfl_mode == BLBN_SFL_LAZY) {
+			blbn_util_sfl_min_lazy (state, &min_exp_loss_node_index, &min_exp_loss_case_index);
+		} else {
+			blbn_util_sfl_min (state, &min_exp_loss_node_index, &min_exp_loss_case_index, NULL, NULL);
 		}
 
 		// <TEMPORARY>
@@ -2481,8 +3997,8 @@ blbn_select_action_t* blbn_select_next_sfl (blbn_state_t *state) {
 
 		// TODO: Handle the case when there is no random finding not purchased with the specified label in the node!
 
-		//curr_action->case_index = blbn_get_random_finding_not_purchased_in_node_with_label (state, curr_action->node_index, state->state[state->target][curr_action->case_index]);
-		random_case_index = blbn_get_random_finding_not_purchased_in_node_with_label (state, min_exp_loss_node_index, state->state[state->target][min_exp_loss_case_index]);
+		//curr_action->case_index = blbn_get_random_finding_not_purchased_in_node_with_label (state, curr_action->node_index, BLBN_STATE (state, state->target, curr_action->case_index));
+		random_case_index = blbn_get_random_finding_not_purchased_in_node_with_label (state, min_exp_loss_node_index, BLBN_STATE (state, state->target, min_exp_loss_case_index));
 		// TODO: Print random_case_index to log file and check log when crashes on PF?
 		if (random_case_index != -1) {
 			curr_action->case_index = random_case_index;
@@ -2500,7 +4016,6 @@ blbn_select_action_t* blbn_select_next_sfl (blbn_state_t *state) {
  */
 blbn_select_action_t* blbn_select_next_gsfl (blbn_state_t *state) {
 
-	blbn_select_action_t *prev_action = NULL;
 	blbn_select_action_t *curr_action = NULL;
 
 	int i,j;
@@ -2511,18 +4026,8 @@ blbn_select_action_t* blbn_select_next_gsfl (blbn_state_t *state) {
 
 	double **sfl_values;
 
-	// Move to the most recent previous select action
-	prev_action = state->sel_action_seq;
-	if (prev_action != NULL) {
-		while (prev_action->next != NULL) {
-			prev_action = prev_action->next;
-		}
-	}
-
 	// Allocate space for current selection and initialize structure
 	curr_action = (blbn_select_action_t *) malloc (sizeof (blbn_select_action_t));
-	curr_action->prev = NULL; // no previous action (this is the first action)
-	curr_action->next = NULL; // no next action (this is the newest action)
 
 	if (curr_action != NULL) {
 
@@ -2574,16 +4079,11 @@ blbn_select_action_t* blbn_select_next_gsfl (blbn_state_t *state) {
  */
 blbn_select_action_t* blbn_select_next_rsfl (blbn_state_t *state, int K, double tao) {
 
-	blbn_select_action_t *prev_action = NULL;
 	blbn_select_action_t *curr_action = NULL;
 
-	int i,j,n,p;
-
-	double **sfl_values = NULL;
+	int i;
 
-	int candidate_count        = 0;
-	double *candidate_exp_loss = NULL;
-	int **candidate_actions    = NULL;
+	blbn_candidate_heap_t *candidates = NULL;
 	double *candidate_prob     = NULL;
 	double candidate_prob_sum  = 0;
 
@@ -2591,103 +4091,27 @@ blbn_select_action_t* blbn_select_next_rsfl (blbn_state_t *state, int K, double
 	double random_selection_sum = 0;
 
 	// Allocate space to store probability of selecting candidate actions
-	candidate_prob = (double *) malloc (K * sizeof (double));
-
-	// Initialize probabilities of selection candidate actions
-	for (i = 0; i < K; ++i) {
-		candidate_prob[i] = DBL_MAX;
-	}
-
-	// Allocate space to store expected loss of candidate actions
-	candidate_exp_loss = (double *) malloc (K * sizeof (double));
+	candidate_prob = (double *) malloc ((K + 1) * sizeof (double));
 
-	// Initialize expected loss of candidate actions
-	for (i = 0; i < K; ++i) {
-		candidate_exp_loss[i] = DBL_MAX;
-	}
-
-	// Allocate space to store candidate actions
-	candidate_actions = (int **) malloc (K * sizeof (int *));
-	for (i = 0;  i < K;  ++i) {
-		candidate_actions[i] = (int *) malloc (2 * sizeof (int));
-
-		// Initialize candidate actions
-		for (j = 0; j < 2; ++j) {
-			candidate_actions[i][j] = -1;
-		}
-	}
-
-	// Move to the most recent previous select action
-	prev_action = state->sel_action_seq;
-	if (prev_action != NULL) {
-		while (prev_action->next != NULL) {
-			prev_action = prev_action->next;
-		}
-	}
+	// Allocate space to store the candidate actions with the lowest expected loss
+	candidates = blbn_candidate_heap_new (K);
 
 	// Allocate space for current selection and initialize structure
 	curr_action = (blbn_select_action_t *) malloc (sizeof (blbn_select_action_t));
-	curr_action->prev = NULL; // no previous action (this is the first action)
-	curr_action->next = NULL; // no next action (this is the newest action)
 
 	if (curr_action != NULL) {
 
-		// Get SFL values for rows and columns
-		sfl_values = blbn_util_sfl (state);
-
-		for (j = 0; j < state->case_count; ++j) {
-
-			// Get minimum SFL value for row
-			//for (i = 0; i < state->node_count; ++i) {
-			int ii=0;
-			for (ii=0; ii<state->nodes_consider[0];ii++){
-				i = state->nodes_consider[1+ii];
-				// Check scores for values that are not for the target node or nodes that are already purchased
-				if (!blbn_is_available_finding (state, i, j)) {
-
-					// Place candidate solution (if its loss is low enough)
-					for (n = 0; n < K; ++n) {
-						if (sfl_values[ii][j] < candidate_exp_loss[n]) {
-
-							// Shift elements to the right of the list
-							for (p = K - 1; p > n; --p) {
-								candidate_exp_loss[p]    = candidate_exp_loss[p - 1];
-								candidate_actions [p][0] = candidate_actions [p - 1][0];
-								candidate_actions [p][1] = candidate_actions [p - 1][1];
-							}
-
-							// Store new candidate into previous candidate's location
-							candidate_exp_loss[n] = sfl_values[ii][j];
-							candidate_actions[n][0] = i;
-							candidate_actions[n][1] = j;
-
-							// Count this element (if not reached desired number of candidates)
-							if (candidate_count < K) {
-								++candidate_count;
-							}
-
-							break;
-						}
-					}
-				}
-			}
-		}
-
-		// Free SFL values for rows and columns
-//		for (i = 0; i < state->node_count; ++i) {
-		int ii=0;
-		for (ii=0; ii<state->nodes_consider[0];ii++){
-			free (sfl_values[ii]);
-		}
-		free (sfl_values);
+		// Keep the K findings for sale with the lowest SFL values
+		blbn_util_sfl_top (state, candidates);
+		blbn_candidate_heap_sort (candidates);
 
 		// Calculate RSFL probability vector
 		candidate_prob_sum = 0;
-		for (i = 0; i < candidate_count; ++i) {
-			candidate_prob[i] = exp ((-1.0 * candidate_exp_loss[i]) / tao);
+		for (i = 0; i < candidates->count; ++i) {
+			candidate_prob[i] = exp ((-1.0 * candidates->entries[i].score) / tao);
 			candidate_prob_sum += candidate_prob[i];
 		}
-		for (i = 0; i < candidate_count; ++i) {
+		for (i = 0; i < candidates->count; ++i) {
 			candidate_prob[i] /= candidate_prob_sum;
 		}
 
@@ -2695,12 +4119,12 @@ blbn_select_action_t* blbn_select_next_rsfl (blbn_state_t *state, int K, double
 
 		// Randomly select the (node,case) pair from which a random instance from node with the label of thise pair will be purchased
 		random_selection_sum = 0.0;
-		for (i = 0; i < candidate_count; ++i) {
+		for (i = 0; i < candidates->count; ++i) {
 			random_selection_sum += candidate_prob[i];
 			if (random_selection < random_selection_sum) {
 
 				// Store node index of action
-				curr_action->node_index = candidate_actions[i][0];
+				curr_action->node_index = candidates->entries[i].node_index;
 
 				// NOTE: In (non-generalized) RSFL, the feature with with the lowest loss is
 				//       selected, but the instance is selected randomly from that feature
@@ -2709,7 +4133,7 @@ blbn_select_action_t* blbn_select_next_rsfl (blbn_state_t *state, int K, double
 				// NOTE: The selected (node,case) pair will always be available, which
 				//       implies that there will always be at least one case for the node that
 				//       is available for purchase.
-				curr_action->case_index = candidate_actions[i][1];
+				curr_action->case_index = candidates->entries[i].case_index;
 
 				//printf ("CHOSE: (%d,%d) with LOSS = %f\n", curr_action->node_index, curr_action->case_index);
 				break;
@@ -2717,7 +4141,7 @@ blbn_select_action_t* blbn_select_next_rsfl (blbn_state_t *state, int K, double
 		}
 
 		// Select random non-purchased case uniformly at random from selected node
-		curr_action->case_index = blbn_get_random_finding_not_purchased_in_node_with_label (state, curr_action->node_index, state->state[state->target][curr_action->case_index]);
+		curr_action->case_index = blbn_get_random_finding_not_purchased_in_node_with_label (state, curr_action->node_index, BLBN_STATE (state, state->target, curr_action->case_index));
 
 		//	printf ("CHOSE: (%d,%d)\n", curr_action->node_index, curr_action->case_index);
 	}
@@ -2725,14 +4149,8 @@ blbn_select_action_t* blbn_select_next_rsfl (blbn_state_t *state, int K, double
 	// Free candidate probabilities
 	free (candidate_prob);
 
-	// Free probabilities of selection candidate actions
-	free (candidate_exp_loss);
-
-	// Free space to store candidate actions
-	for (i = 0;  i < K;  ++i) {
-		free (candidate_actions[i]);
-	}
-	free (candidate_actions);
+	// Free candidate actions
+	blbn_candidate_heap_free (candidates);
 
 	return curr_action;
 }
@@ -2744,120 +4162,39 @@ blbn_select_action_t* blbn_select_next_rsfl (blbn_state_t *state, int K, double
  */
 blbn_select_action_t* blbn_select_next_grsfl (blbn_state_t *state, int K, double tao) {
 
-	blbn_select_action_t *prev_action = NULL;
 	blbn_select_action_t *curr_action = NULL;
 
-	int i,j,n,p;
-	int kount = 0;
+	int i;
 
-	double *candidate_exp_loss = NULL;
-	int **candidate_actions    = NULL;
+	blbn_candidate_heap_t *candidates = NULL;
 	double *candidate_prob     = NULL;
 	double candidate_prob_sum  = 0;
 
 	double random_selection = 0;
 	double random_selection_sum = 0;
 
-	double **sfl_values = NULL;
-
 	// Allocate space to store probability of selecting candidate actions
-	candidate_prob = (double *) malloc (K * sizeof (double));
-
-	// Initialize probabilities of selection candidate actions
-	for (i = 0; i < K; ++i) {
-		candidate_prob[i] = DBL_MAX;
-	}
-
-	// Allocate space to store expected loss of candidate actions
-	candidate_exp_loss = (double *) malloc (K * sizeof (double));
-
-	// Initialize expected loss of candidate actions
-	for (i = 0; i < K; ++i) {
-		candidate_exp_loss[i] = DBL_MAX;
-	}
+	candidate_prob = (double *) malloc ((K + 1) * sizeof (double));
 
-	// Allocate space to store candidate actions
-	candidate_actions = (int **) malloc (K * sizeof (int *));
-	for (i = 0;  i < K;  ++i) {
-		candidate_actions[i] = (int *) malloc (2 * sizeof (int));
-
-		// Initialize candidate actions
-		for (j = 0; j < 2; ++j) {
-			candidate_actions[i][j] = -1;
-		}
-	}
-
-	// Move to the most recent previous select action
-	prev_action = state->sel_action_seq;
-	if (prev_action != NULL) {
-		while (prev_action->next != NULL) {
-			prev_action = prev_action->next;
-		}
-	}
+	// Allocate space to store the candidate actions with the lowest expected loss
+	candidates = blbn_candidate_heap_new (K);
 
 	// Allocate space for current selection and initialize structure
 	curr_action = (blbn_select_action_t *) malloc (sizeof (blbn_select_action_t));
-	curr_action->prev = NULL; // no previous action (this is the first action)
-	curr_action->next = NULL; // no next action (this is the newest action)
 
 	if (curr_action != NULL) {
 
-		// Get SFL values for rows and columns
-		sfl_values = blbn_util_sfl (state);
-
-		for (j = 0; j < state->case_count; ++j) {
-
-			// Get minimum SFL value for row
-			//for (i = 0; i < state->node_count; ++i) {
-			int ii=0;
-			for (ii=0; ii<state->nodes_consider[0];ii++){
-				i = state->nodes_consider[1+ii];
-				// Check scores for values that are not for the target node or nodes that are already purchased
-				if (!blbn_is_available_finding (state, i, j)) {
-
-					// Place candidate solution (if its loss is low enough)
-					for (n = 0; n < K; ++n) {
-						if (sfl_values[ii][j] < candidate_exp_loss[n]) {
-
-							// Shift elements to the right of the list
-							for (p = K - 1; p > n; --p) {
-								candidate_exp_loss[p]    = candidate_exp_loss[p - 1];
-								candidate_actions [p][0] = candidate_actions [p - 1][0];
-								candidate_actions [p][1] = candidate_actions [p - 1][1];
-							}
-
-							// Store new candidate into previous candidate's location
-							candidate_exp_loss[n] = sfl_values[ii][j];
-							candidate_actions[n][0] = i;
-							candidate_actions[n][1] = j;
-
-							// Count this element (if not reached desired number of candidates)
-							if (kount < K) {
-								++kount;
-							}
-
-							break;
-						}
-					}
-				}
-			}
-		}
-
-		// Free SFL values for rows and columns
-		//for (i = 0; i < state->node_count; ++i) {
-		int ii=0;
-		for (ii=0; ii<state->nodes_consider[0];ii++){
-			free (sfl_values[ii]);
-		}
-		free (sfl_values);
+		// Keep the K findings for sale with the lowest SFL values
+		blbn_util_sfl_top (state, candidates);
+		blbn_candidate_heap_sort (candidates);
 
 		// Calculate RSFL probability vector
 		candidate_prob_sum = 0;
-		for (i = 0; i < kount; ++i) {
-			candidate_prob[i] = exp ((-1.0 * candidate_exp_loss[i]) / tao);
+		for (i = 0; i < candidates->count; ++i) {
+			candidate_prob[i] = exp ((-1.0 * candidates->entries[i].score) / tao);
 			candidate_prob_sum += candidate_prob[i];
 		}
-		for (i = 0; i < kount; ++i) {
+		for (i = 0; i < candidates->count; ++i) {
 			candidate_prob[i] /= candidate_prob_sum;
 		}
 
@@ -2866,11 +4203,11 @@ blbn_select_action_t* blbn_select_next_grsfl (blbn_state_t *state, int K, double
 
 		// Select the random action
 		random_selection_sum = 0.0;
-		for (i = 0; i < kount; ++i) {
+		for (i = 0; i < candidates->count; ++i) {
 			random_selection_sum += candidate_prob[i];
 			if (random_selection < random_selection_sum) {
-				curr_action->node_index = candidate_actions[i][0];
-				curr_action->case_index = candidate_actions[i][1];
+				curr_action->node_index = candidates->entries[i].node_index;
+				curr_action->case_index = candidates->entries[i].case_index;
 //				printf ("CHOSE: (%d,%d) with LOSS = %f\n", curr_action->node_index, curr_action->case_index);
 				break;
 			}
@@ -2881,14 +4218,8 @@ blbn_select_action_t* blbn_select_next_grsfl (blbn_state_t *state, int K, double
 	// Free candidate probabilities
 	free (candidate_prob);
 
-	// Free probabilities of selection candidate actions
-	free (candidate_exp_loss);
-
-	// Free space to store candidate actions
-	for (i = 0;  i < K;  ++i) {
-		free (candidate_actions[i]);
-	}
-	free (candidate_actions);
+	// Free candidate actions
+	blbn_candidate_heap_free (candidates);
 
 	return curr_action;
 }
@@ -2899,7 +4230,6 @@ blbn_select_action_t* blbn_select_next_grsfl (blbn_state_t *state, int K, double
  */
 blbn_select_action_t* blbn_select_next_merpg (blbn_state_t *state) {
 
-	blbn_select_action_t *prev_action = NULL;
 	blbn_select_action_t *curr_action = NULL;
 
 	int i,j;
@@ -2908,18 +4238,8 @@ blbn_select_action_t* blbn_select_next_merpg (blbn_state_t *state) {
 
 	double **gain_values;
 
-	// Move to the most recent previous select action
-	prev_action = state->sel_action_seq;
-	if (prev_action != NULL) {
-		while (prev_action->next != NULL) {
-			prev_action = prev_action->next;
-		}
-	}
-
 	// Allocate space for current selection and initialize structure
 	curr_action = (blbn_select_action_t *) malloc (sizeof (blbn_select_action_t));
-	curr_action->prev = NULL; // no previous action (this is the first action)
-	curr_action->next = NULL; // no next action (this is the newest action)
 
 	if (curr_action != NULL) {
 
@@ -3054,58 +4374,431 @@ int blbn_get_d_separated_nodes (blbn_state_t *state, unsigned int node_index, in
 }
 
 /**
- * Returns the number of nodes d-separated from the node wit the specified
- * index.
+ * Returns the number of nodes d-separated from the node wit the specified
+ * index.
+ */
+int blbn_get_d_separated_node_count (blbn_state_t *state, unsigned int node_index) {
+
+	int i;
+	int d_separated_node_candidate_count = 0;
+	int d_separated_node_count = 0;
+
+	// Get a list of all of the node in the network
+	//const nodelist_bn *d_separated_node_candidates = GetNetNodes_bn (state->work_net); // Initialize node list with all nodes in the network
+	const nodelist_bn *d_separated_node_candidates = DupNodeList_bn(GetNetNodes_bn (state->work_net));
+
+	// Get the node with the specified node index
+	node_bn *d_separated_node = NthNode_bn (d_separated_node_candidates, node_index); // Get specified node from static node list
+
+	// TODO: Clear network findings?  Make this optional?  Clearing the findings may affect which nodes are d-separated from the node with the specified node index.
+		// NOTE: No, assume that findings that should be cleared were cleared before calling this function.
+
+	// TODO: Add parameter to specify the "instantiated" nodes in the network?
+		// NOTE: No, assume that the nodes that should be instantiated are instantiated before calling this function.
+
+	// Find all the nodes that are d-connected with node, subtract them from the
+	// specified node list, and exclude the specified node from the node list.
+	// The remaining nodes will be those that are d-separated from the
+	// specified node.
+	GetRelatedNodes_bn (d_separated_node_candidates, "d_connected,subtract", d_separated_node); // Subtract node of interest and all nodes in the relation (d-connected) to the specified node of interest
+
+	// NOTE: At this point, the node list d_separated contains the nodes d-separated from the specified node of interest
+
+	// Iterate through list of d-separation candidate nodes and remove all
+	// instantiated nodes.  This list of candidate nodes includes all
+	// d-separated nodes as well as some instantiated nodes, which are also
+	// d-separated, strictly speaking, since they do not influence the conditional
+	// probability table (CPT) of the d-separated node.  These instantiated
+	// nodes are removed because they are typically considered the d-separating
+	// nodes, not d-separated nodes (i.e., they actually cause the d-separation).
+//	printf ("DEBUG: Adding candidate d-sep node to d-sep node list: { ");
+	d_separated_node_candidate_count = LengthNodeList_bn (d_separated_node_candidates);
+	for (i = 0; i < d_separated_node_candidate_count; ++i) {
+		// Check if node has been instantiated (i.e., check if it has a finding)
+		if (GetNodeFinding_bn (NthNode_bn (d_separated_node_candidates, i)) >= 0) { // Check if there are no findings for node
+			continue; // If node has been instantiated, do not add it to the list of d-separated nodes
+		}
+
+		// The node has not been instantiated, so add it to the list of d-separated nodes
+		++d_separated_node_count;
+	}
+
+	DeleteNodeList_bn (d_separated_node_candidates);
+	//printf("Number of d-separations is : %d\n", d_separated_node_count);
+	return d_separated_node_count;
+}
+
+/**
+ * Encodes the structure of the working network (which does not change during
+ * a run) as adjacency arrays, and computes the ancestors of every node.
+ */
+blbn_graph_t* blbn_graph_new (blbn_state_t *state) {
+	blbn_graph_t *graph = (blbn_graph_t *) calloc (1, sizeof (blbn_graph_t));
+	const nodelist_bn *nodes = GetNetNodes_bn (state->work_net);
+	const nodelist_bn *parents = NULL;
+	int n = state->node_count;
+	int *fill = NULL;
+	int i, j, p, w, link_count = 0, changed;
+
+	graph->node_count = n;
+	graph->words = (n + 63) / 64;
+	graph->parent_offset = (int *) calloc (n + 1, sizeof (int));
+	graph->child_offset = (int *) calloc (n + 1, sizeof (int));
+	for (i = 0; i < n; i++) {
+		link_count += LengthNodeList_bn (GetNodeParents_bn (NthNode_bn (nodes, i)));
+	}
+	graph->parents = (int *) malloc ((link_count + 1) * sizeof (int));
+	graph->children = (int *) malloc ((link_count + 1) * sizeof (int));
+
+	// Parents in the order of the net, then children by counting
+	for (i = 0; i < n; i++) {
+		parents = GetNodeParents_bn (NthNode_bn (nodes, i));
+		graph->parent_offset[i + 1] = graph->parent_offset[i];
+		for (j = 0; j < LengthNodeList_bn (parents); j++) {
+			p = blbn_get_node_by_name (state, (char *) GetNodeName_bn (NthNode_bn (parents, j)));
+			graph->parents[graph->parent_offset[i + 1]++] = p;
+			graph->child_offset[p + 1]++;
+		}
+	}
+	for (i = 0; i < n; i++) {
+		graph->child_offset[i + 1] += graph->child_offset[i];
+	}
+	fill = (int *) malloc ((n + 1) * sizeof (int));
+	memcpy (fill, graph->child_offset, n * sizeof (int));
+	for (i = 0; i < n; i++) {
+		for (j = graph->parent_offset[i]; j < graph->parent_offset[i + 1]; j++) {
+			graph->children[fill[graph->parents[j]]++] = i;
+		}
+	}
+	free (fill);
+
+	// Ancestors: each node's set is itself plus its parents' sets (iterated to a fixed point)
+	graph->ancestors = (uint64_t *) calloc ((size_t) n * graph->words + 1, sizeof (uint64_t));
+	for (i = 0; i < n; i++) {
+		graph->ancestors[i * graph->words + i / 64] |= (uint64_t) 1 << (i % 64);
+	}
+	do {
+		changed = 0;
+		for (i = 0; i < n; i++) {
+			for (j = graph->parent_offset[i]; j < graph->parent_offset[i + 1]; j++) {
+				p = graph->parents[j];
+				for (w = 0; w < graph->words; w++) {
+					if (graph->ancestors[p * graph->words + w] & ~graph->ancestors[i * graph->words + w]) {
+						graph->ancestors[i * graph->words + w] |= graph->ancestors[p * graph->words + w];
+						changed = 1;
+					}
+				}
+			}
+		}
+	} while (changed);
+
+	graph->visited_up = (uint64_t *) calloc (graph->words + 1, sizeof (uint64_t));
+	graph->visited_down = (uint64_t *) calloc (graph->words + 1, sizeof (uint64_t));
+	graph->stack = (int *) malloc ((4 * link_count + 1) * sizeof (int));
+
+	return graph;
+}
+
+void blbn_graph_free (blbn_graph_t *graph) {
+	if (graph != NULL) {
+		free (graph->parent_offset);
+		free (graph->parents);
+		free (graph->child_offset);
+		free (graph->children);
+		free (graph->ancestors);
+		free (graph->visited_up);
+		free (graph->visited_down);
+		free (graph->stack);
+		free (graph);
+	}
+}
+
+/**
+ * Sets evidence (a node bit vector) to the findings of the specified case
+ * with a value whose flag is set in the specified plane.  For
+ * BLBN_FLAG_AVAILABLE these are the nodes blbn_set_net_findings would
+ * instantiate.
+ */
+void blbn_dsep_case_evidence (blbn_state_t *state, int case_index, int plane, uint64_t *evidence) {
+	const uint64_t *available = &state->flags->by_case[plane][case_index * state->flags->case_words];
+	uint64_t bits;
+	int w, i;
+
+	for (w = 0; w < state->flags->case_words; w++) {
+		evidence[w] = available[w];
+		for (bits = available[w]; bits != 0; bits &= bits - 1) {
+			i = w * 64 + __builtin_ctzll (bits);
+			if (BLBN_STATE (state, i, case_index) == -1) {
+				evidence[w] &= ~((uint64_t) 1 << (i % 64));
+			}
+		}
+	}
+}
+
+/**
+ * Sets evidence_ancestors to the nodes with a descendant (or themselves) in
+ * evidence.
+ */
+void blbn_dsep_evidence_ancestors (const blbn_graph_t *graph, const uint64_t *evidence, uint64_t *evidence_ancestors) {
+	uint64_t bits;
+	int w, v, i;
+
+	memset (evidence_ancestors, 0, graph->words * sizeof (uint64_t));
+	for (w = 0; w < graph->words; w++) {
+		for (bits = evidence[w]; bits != 0; bits &= bits - 1) {
+			v = w * 64 + __builtin_ctzll (bits);
+			for (i = 0; i < graph->words; i++) {
+				evidence_ancestors[i] |= graph->ancestors[v * graph->words + i];
+			}
+		}
+	}
+}
+
+/**
+ * Returns the number of nodes without evidence that are d-separated from the
+ * node with the specified index given the evidence nodes (a node bit vector,
+ * with evidence_ancestors from blbn_dsep_evidence_ancestors).  This is the
+ * count blbn_get_d_separated_node_count computes with GetRelatedNodes_bn,
+ * computed with the "Bayes ball" over the adjacency arrays instead: the ball
+ * starts upwards from the node, passes through nodes without evidence, and
+ * bounces from a child back to the other parents of nodes that are evidence
+ * ancestors (active v-structures).  The nodes the ball reached are left in
+ * graph->visited_up and graph->visited_down.
+ */
+int blbn_dsep_count (blbn_graph_t *graph, int node_index, const uint64_t *evidence, const uint64_t *evidence_ancestors) {
+	int *stack = graph->stack;
+	int top = 0;
+	int index, up, observed, j, w;
+	int count = graph->node_count;
+	uint64_t bit;
+
+	memset (graph->visited_up, 0, graph->words * sizeof (uint64_t));
+	memset (graph->visited_down, 0, graph->words * sizeof (uint64_t));
+
+	stack[top++] = 2 * node_index + 1; // start by going up from node
+	while (top > 0) {
+		top--;
+		index = stack[top] / 2;
+		up = stack[top] % 2;
+		bit = (uint64_t) 1 << (index % 64);
+
+		if ((up ? graph->visited_up : graph->visited_down)[index / 64] & bit) {
+			continue;
+		}
+		(up ? graph->visited_up : graph->visited_down)[index / 64] |= bit;
+		observed = ((evidence[index / 64] & bit) != 0);
+
+		if (up && !observed) {
+			// Arrived from a child: continue to parents and children
+			for (j = graph->parent_offset[index]; j < graph->parent_offset[index + 1]; j++) {
+				stack[top++] = 2 * graph->parents[j] + 1;
+			}
+			for (j = graph->child_offset[index]; j < graph->child_offset[index + 1]; j++) {
+				stack[top++] = 2 * graph->children[j];
+			}
+		} else if (!up) {
+			// Arrived from a parent
+			if (!observed) {
+				for (j = graph->child_offset[index]; j < graph->child_offset[index + 1]; j++) {
+					stack[top++] = 2 * graph->children[j];
+				}
+			}
+			if (evidence_ancestors[index / 64] & bit) {
+				// Active v-structure: continue to the other parents
+				for (j = graph->parent_offset[index]; j < graph->parent_offset[index + 1]; j++) {
+					stack[top++] = 2 * graph->parents[j] + 1;
+				}
+			}
+		}
+	}
+
+	// Nodes without evidence that the ball did not reach
+	for (w = 0; w < graph->words; w++) {
+		count -= __builtin_popcountll (evidence[w] | graph->visited_up[w] | graph->visited_down[w]);
+	}
+	return count;
+}
+
+/**
+ * Returns a hash of a node bit vector.
+ */
+unsigned int blbn_util_hash_words (const uint64_t *words, int count) {
+	unsigned int hash = 2166136261u;
+	int i;
+
+	for (i = 0; i < count; i++) {
+		hash ^= (unsigned int) (words[i] ^ (words[i] >> 32));
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+blbn_dsep_memo_t* blbn_dsep_memo_new (unsigned int words) {
+	blbn_dsep_memo_t *memo = (blbn_dsep_memo_t *) calloc (1, sizeof (blbn_dsep_memo_t));
+
+	memo->words = words;
+	memo->capacity = 64;
+	memo->patterns = (uint64_t *) malloc (memo->capacity * words * sizeof (uint64_t));
+	memo->counts = (int *) malloc (memo->capacity * sizeof (int));
+	memo->reached = (uint64_t *) malloc (memo->capacity * 2 * words * sizeof (uint64_t));
+	memo->bucket_count = 128;
+	memo->buckets = (unsigned int *) calloc (memo->bucket_count, sizeof (unsigned int));
+
+	return memo;
+}
+
+void blbn_dsep_memo_free (blbn_dsep_memo_t *memo) {
+	if (memo != NULL) {
+		free (memo->patterns);
+		free (memo->counts);
+		free (memo->reached);
+		free (memo->buckets);
+		free (memo);
+	}
+}
+
+/**
+ * Returns the bucket of the pattern, or of the empty slot where it belongs.
+ */
+unsigned int blbn_dsep_memo_slot (const blbn_dsep_memo_t *memo, const uint64_t *pattern) {
+	unsigned int slot = blbn_util_hash_words (pattern, memo->words) & (memo->bucket_count - 1);
+
+	while (memo->buckets[slot] != 0 && memcmp (&memo->patterns[(memo->buckets[slot] - 1) * memo->words], pattern, memo->words * sizeof (uint64_t)) != 0) {
+		slot = (slot + 1) & (memo->bucket_count - 1);
+	}
+	return slot;
+}
+
+/**
+ * Returns the index of the pattern in the memo, or -1 if it has none.
+ */
+int blbn_dsep_memo_find (blbn_dsep_memo_t *memo, const uint64_t *pattern) {
+	unsigned int slot = blbn_dsep_memo_slot (memo, pattern);
+
+	if (memo->buckets[slot] == 0) {
+		memo->misses++;
+		return -1;
+	}
+	memo->hits++;
+	return memo->buckets[slot] - 1;
+}
+
+/**
+ * Memoizes a pattern that blbn_dsep_memo_find did not find, with the count
+ * and the nodes reached by the blbn_dsep_count query just made on graph for
+ * it.  Returns the index of the pattern.
+ */
+int blbn_dsep_memo_add (blbn_dsep_memo_t *memo, const uint64_t *pattern, int count, const blbn_graph_t *graph) {
+	unsigned int slot = blbn_dsep_memo_slot (memo, pattern);
+	unsigned int p = memo->pattern_count++;
+	uint64_t *reached = NULL;
+	int w;
+
+	if (p == memo->capacity) {
+		memo->capacity *= 2;
+		memo->patterns = (uint64_t *) realloc (memo->patterns, memo->capacity * memo->words * sizeof (uint64_t));
+		memo->counts = (int *) realloc (memo->counts, memo->capacity * sizeof (int));
+		memo->reached = (uint64_t *) realloc (memo->reached, memo->capacity * 2 * memo->words * sizeof (uint64_t));
+	}
+	memcpy (&memo->patterns[p * memo->words], pattern, memo->words * sizeof (uint64_t));
+	memo->counts[p] = count;
+	reached = &memo->reached[p * 2 * memo->words];
+	for (w = 0; w < memo->words; w++) {
+		reached[w] = graph->visited_up[w] | graph->visited_down[w];
+		reached[memo->words + w] = graph->visited_down[w];
+	}
+	memo->buckets[slot] = p + 1;
+
+	// Keep the hash at most half full
+	if (2 * memo->pattern_count > memo->bucket_count) {
+		free (memo->buckets);
+		memo->bucket_count *= 2;
+		memo->buckets = (unsigned int *) calloc (memo->bucket_count, sizeof (unsigned int));
+		for (p = 0; p < memo->pattern_count; p++) {
+			slot = blbn_util_hash_words (&memo->patterns[p * memo->words], memo->words) & (memo->bucket_count - 1);
+			while (memo->buckets[slot] != 0) {
+				slot = (slot + 1) & (memo->bucket_count - 1);
+			}
+			memo->buckets[slot] = p + 1;
+		}
+		p = memo->pattern_count - 1;
+	}
+	return p;
+}
+
+/**
+ * Allocates the candidate pruning scratch vectors of the state (see
+ * blbn_prune_t).  A node that is d-separated from the target given the
+ * learned findings of the case other than the target (see
+ * blbn_prune_target_reached) does not change the target belief whatever its
+ * state, so the MERPG scores of all such nodes in the case are equal, and
+ * only the first is evaluated.
  */
-int blbn_get_d_separated_node_count (blbn_state_t *state, unsigned int node_index) {
+blbn_prune_t* blbn_prune_new (blbn_state_t *state) {
+	blbn_prune_t *prune = (blbn_prune_t *) calloc (1, sizeof (blbn_prune_t));
+	blbn_graph_t *graph = NULL;
 
-	int i;
-	int d_separated_node_candidate_count = 0;
-	int d_separated_node_count = 0;
+	if (state->graph == NULL) {
+		state->graph = blbn_graph_new (state);
+	}
+	graph = state->graph;
 
-	// Get a list of all of the node in the network
-	//const nodelist_bn *d_separated_node_candidates = GetNetNodes_bn (state->work_net); // Initialize node list with all nodes in the network
-	const nodelist_bn *d_separated_node_candidates = DupNodeList_bn(GetNetNodes_bn (state->work_net));
+	prune->evidence            = (uint64_t *) calloc (2 * graph->words + 1, sizeof (uint64_t));
+	prune->evidence_ancestors  = prune->evidence + graph->words;
 
-	// Get the node with the specified node index
-	node_bn *d_separated_node = NthNode_bn (d_separated_node_candidates, node_index); // Get specified node from static node list
+	return prune;
+}
 
-	// TODO: Clear network findings?  Make this optional?  Clearing the findings may affect which nodes are d-separated from the node with the specified node index.
-		// NOTE: No, assume that findings that should be cleared were cleared before calling this function.
+void blbn_prune_free (blbn_prune_t *prune) {
+	if (prune != NULL) {
+		free (prune->evidence);
+		free (prune);
+	}
+}
 
-	// TODO: Add parameter to specify the "instantiated" nodes in the network?
-		// NOTE: No, assume that the nodes that should be instantiated are instantiated before calling this function.
+/**
+ * Returns the candidate pruning vectors of the state, allocating them on
+ * first use, or NULL if candidates are not pruned.
+ */
+blbn_prune_t* blbn_prune_get (blbn_state_t *state) {
+	if (state->prune_mode == BLBN_PRUNE_NONE) {
+		return NULL;
+	}
+	if (state->prune == NULL) {
+		state->prune = blbn_prune_new (state);
+	}
+	return state->prune;
+}
 
-	// Find all the nodes that are d-connected with node, subtract them from the
-	// specified node list, and exclude the specified node from the node list.
-	// The remaining nodes will be those that are d-separated from the
-	// specified node.
-	GetRelatedNodes_bn (d_separated_node_candidates, "d_connected,subtract", d_separated_node); // Subtract node of interest and all nodes in the relation (d-connected) to the specified node of interest
+/**
+ * Returns the nodes (a node bit vector) d-connected to the target given the
+ * learned findings of the specified case other than the target, or NULL if
+ * candidates are not pruned.  The Bayes ball is memoized in state->dsep_memo
+ * like the counts of the dsep policies; the vector is valid until the next
+ * pattern is added to the memo.
+ */
+const uint64_t* blbn_prune_target_reached (blbn_state_t *state, int case_index) {
+	blbn_prune_t *prune = blbn_prune_get (state);
+	blbn_graph_t *graph = state->graph;
+	int pattern, count;
 
-	// NOTE: At this point, the node list d_separated contains the nodes d-separated from the specified node of interest
+	if (prune == NULL) {
+		return NULL;
+	}
+	if (state->dsep_memo == NULL) {
+		state->dsep_memo = blbn_dsep_memo_new (graph->words);
+	}
 
-	// Iterate through list of d-separation candidate nodes and remove all
-	// instantiated nodes.  This list of candidate nodes includes all
-	// d-separated nodes as well as some instantiated nodes, which are also
-	// d-separated, strictly speaking, since they do not influence the conditional
-	// probability table (CPT) of the d-separated node.  These instantiated
-	// nodes are removed because they are typically considered the d-separating
-	// nodes, not d-separated nodes (i.e., they actually cause the d-separation).
-//	printf ("DEBUG: Adding candidate d-sep node to d-sep node list: { ");
-	d_separated_node_candidate_count = LengthNodeList_bn (d_separated_node_candidates);
-	for (i = 0; i < d_separated_node_candidate_count; ++i) {
-		// Check if node has been instantiated (i.e., check if it has a finding)
-		if (GetNodeFinding_bn (NthNode_bn (d_separated_node_candidates, i)) >= 0) { // Check if there are no findings for node
-			continue; // If node has been instantiated, do not add it to the list of d-separated nodes
-		}
+	blbn_dsep_case_evidence (state, case_index, BLBN_FLAG_LEARNED, prune->evidence);
+	prune->evidence[state->target / 64] &= ~((uint64_t) 1 << (state->target % 64));
 
-		// The node has not been instantiated, so add it to the list of d-separated nodes
-		++d_separated_node_count;
+	pattern = blbn_dsep_memo_find (state->dsep_memo, prune->evidence);
+	if (pattern < 0) {
+		blbn_dsep_evidence_ancestors (graph, prune->evidence, prune->evidence_ancestors);
+		count = blbn_dsep_count (graph, state->target, prune->evidence, prune->evidence_ancestors);
+		pattern = blbn_dsep_memo_add (state->dsep_memo, prune->evidence, count, graph);
 	}
-
-	DeleteNodeList_bn (d_separated_node_candidates);
-	//printf("Number of d-separations is : %d\n", d_separated_node_count);
-	return d_separated_node_count;
+	return &state->dsep_memo->reached[pattern * 2 * graph->words];
 }
 
 /* return the indexes of the nodes in the Markov blanket. node_index is the index of the target node.*/
@@ -3229,7 +4922,6 @@ int blbn_get_node_index (blbn_state_t *state, char* node_name) {
  */
 blbn_select_action_t* blbn_select_next_merpgdsep (blbn_state_t *state) {
 
-	blbn_select_action_t *prev_action = NULL;
 	blbn_select_action_t *curr_action = NULL;
 
 	int i,j;
@@ -3240,18 +4932,8 @@ blbn_select_action_t* blbn_select_next_merpgdsep (blbn_state_t *state) {
 	double **gain_values;
 	int **dsep_values;
 
-	// Move to the most recent previous select action
-	prev_action = state->sel_action_seq;
-	if (prev_action != NULL) {
-		while (prev_action->next != NULL) {
-			prev_action = prev_action->next;
-		}
-	}
-
 	// Allocate space for current selection and initialize structure
 	curr_action = (blbn_select_action_t *) malloc (sizeof (blbn_select_action_t));
-	curr_action->prev = NULL; // no previous action (this is the first action)
-	curr_action->next = NULL; // no next action (this is the newest action)
 
 	if (curr_action != NULL) {
 
@@ -3350,7 +5032,6 @@ blbn_select_action_t* blbn_select_next_merpgdsep (blbn_state_t *state) {
  */
 blbn_select_action_t* blbn_select_next_merpgdsepw1 (blbn_state_t *state) {
 
-	blbn_select_action_t *prev_action = NULL;
 	blbn_select_action_t *curr_action = NULL;
 
 	int i,j;
@@ -3361,18 +5042,8 @@ blbn_select_action_t* blbn_select_next_merpgdsepw1 (blbn_state_t *state) {
 	double **gain_values;
 	int **dsep_values;
 
-	// Move to the most recent previous select action
-	prev_action = state->sel_action_seq;
-	if (prev_action != NULL) {
-		while (prev_action->next != NULL) {
-			prev_action = prev_action->next;
-		}
-	}
-
 	// Allocate space for current selection and initialize structure
 	curr_action = (blbn_select_action_t *) malloc (sizeof (blbn_select_action_t));
-	curr_action->prev = NULL; // no previous action (this is the first action)
-	curr_action->next = NULL; // no next action (this is the newest action)
 
 	if (curr_action != NULL) {
 
@@ -3471,7 +5142,6 @@ blbn_select_action_t* blbn_select_next_merpgdsepw1 (blbn_state_t *state) {
  */
 blbn_select_action_t* blbn_select_next_merpgdsepw2 (blbn_state_t *state) {
 
-	blbn_select_action_t *prev_action = NULL;
 	blbn_select_action_t *curr_action = NULL;
 
 	int i,j;
@@ -3481,18 +5151,8 @@ blbn_select_action_t* blbn_select_next_merpgdsepw2 (blbn_state_t *state) {
 	double **gain_values;
 	int **dsep_values;
 
-	// Move to the most recent previous select action
-	prev_action = state->sel_action_seq;
-	if (prev_action != NULL) {
-		while (prev_action->next != NULL) {
-			prev_action = prev_action->next;
-		}
-	}
-
 	// Allocate space for current selection and initialize structure
 	curr_action = (blbn_select_action_t *) malloc (sizeof (blbn_select_action_t));
-	curr_action->prev = NULL; // no previous action (this is the first action)
-	curr_action->next = NULL; // no next action (this is the newest action)
 
 	if (curr_action != NULL) {
 
@@ -3590,7 +5250,6 @@ blbn_select_action_t* blbn_select_next_merpgdsepw2 (blbn_state_t *state) {
  */
 blbn_select_action_t* blbn_select_next_cheating (blbn_state_t *state, FILE* log_fp) {
 
-	blbn_select_action_t *prev_action = NULL;
 	blbn_select_action_t *curr_action = NULL;
 
 	int i,j;
@@ -3599,18 +5258,8 @@ blbn_select_action_t* blbn_select_next_cheating (blbn_state_t *state, FILE* log_
 
 	double **gain_values;
 
-	// Move to the most recent previous select action
-	prev_action = state->sel_action_seq;
-	if (prev_action != NULL) {
-		while (prev_action->next != NULL) {
-			prev_action = prev_action->next;
-		}
-	}
-
 	// Allocate space for current selection and initialize structure
 	curr_action = (blbn_select_action_t *) malloc (sizeof (blbn_select_action_t));
-	curr_action->prev = NULL; // no previous action (this is the first action)
-	curr_action->next = NULL; // no next action (this is the newest action)
 
 	if (curr_action != NULL) {
 
@@ -3723,7 +5372,7 @@ int blbn_get_random_finding_not_purchased_in_node_with_label (blbn_state_t *stat
 		i = rand () % count;
 
 		// Starting at the random selection, iterate over the remaining non-purchased findings until one is found in an instance where the target state is equal to the specified target state
-		while (state->state[state->target][i] != target_state) {
+		while (BLBN_STATE (state, state->target, i) != target_state) {
 			i = (i + 1) % count;
 		}
 
@@ -3736,7 +5385,9 @@ int blbn_get_random_finding_not_purchased_in_node_with_label (blbn_state_t *stat
 
 /**
  * Copies the specified network and returns a pointer to the copy.  Does not
- * modify original network.  Returns NULL if cannot copy.
+ * modify original network.  Returns NULL if cannot copy.  With the native
+ * engine the copy is a copy-on-write snapshot (tables and the compiled
+ * junction tree are shared until modified), so lookahead copies are cheap.
  */
 net_bn* blbn_util_copy_net (blbn_state_t *state, net_bn* net) {
 	net_bn *copied_net = NULL;
@@ -3745,6 +5396,7 @@ net_bn* blbn_util_copy_net (blbn_state_t *state, net_bn* net) {
 
 		// Copy the network
 		copied_net = CopyNet_bn (net, GetNetName_bn (net), env, "no_visual");
+		blbn_counters.net_copies++;
 
 	}
 
@@ -3755,9 +5407,38 @@ net_bn* blbn_util_copy_net (blbn_state_t *state, net_bn* net) {
  * Copies the working network in the blbn_state_t structure and unlearns the
  * specified case.  Returns pointer to copied network.  Original network is
  * not modified.
+ *
+ * With state->loo_mode BLBN_LOO_RELEARN the network is relearned from the
+ * prior network (blbn_loo_relearn), except that every case without learned
+ * findings gets a copy of the same network relearned from all learned cases
+ * (blbn_loo_shared_net), so a selection relearns once per learned case plus
+ * once instead of once per case.  With BLBN_LOO_DOWNDATE the case's expected
+ * counts are subtracted from those of the working network instead
+ * (blbn_loo_downdate).  A negative case_index relearns every learned case.
  */
 net_bn* blbn_util_copy_net_unlearn_case (blbn_state_t *state, int case_index) {
 
+	if (state == NULL) {
+		return NULL;
+	}
+	if (case_index < 0) {
+		return blbn_loo_relearn (state, case_index);
+	}
+	if (state->loo_mode == BLBN_LOO_DOWNDATE) {
+		return blbn_loo_downdate (state, case_index);
+	}
+	if (!blbn_has_findings_learned_in_case (state, case_index)) {
+		return blbn_util_copy_net (state, (net_bn *) blbn_loo_shared_net (state));
+	}
+	return blbn_loo_relearn (state, case_index);
+}
+
+/**
+ * Relearns the learned cases other than the specified case with EM from the
+ * prior network.  Returns the new network.
+ */
+net_bn* blbn_loo_relearn (blbn_state_t *state, int case_index) {
+
 	int i;
 	net_bn* copied_net = NULL;
 
@@ -3829,6 +5510,7 @@ net_bn* blbn_util_copy_net_unlearn_case (blbn_state_t *state, int case_index) {
 
 		// Load case in temporary *.cas file into new case set (contains only that single case)
 		caseset = NewCaseset_cs (NULL, env);
+		blbn_counters.stream_bytes += blbn_stream_length (casefile);
 		AddFileToCaseset_cs (caseset, casefile, 1.0, NULL);
 
 		// Retract findings from copied network (before learning)
@@ -3839,6 +5521,7 @@ net_bn* blbn_util_copy_net_unlearn_case (blbn_state_t *state, int case_index) {
 
 		// Learn cases using EM learner and temporary case file
 		LearnCPTs_bn (learner, nodes, caseset, 1.0); // Degree must be greater than zero
+		blbn_counters.em_runs++;
 
 		// Free allocated structures from memory
 		DeleteLearner_bn (learner);
@@ -3859,6 +5542,260 @@ net_bn* blbn_util_copy_net_unlearn_case (blbn_state_t *state, int case_index) {
 	return NULL;
 }
 
+blbn_loo_t* blbn_loo_new (blbn_state_t *state) {
+	blbn_loo_t *loo = (blbn_loo_t *) calloc (1, sizeof (blbn_loo_t));
+	const nodelist_bn *nodes = GetNetNodes_bn (state->prior_net);
+	int i;
+
+	loo->offset = (unsigned int *) malloc ((state->node_count + 1) * sizeof (unsigned int));
+	loo->offset[0] = 0;
+	for (i = 0; i < state->node_count; i++) {
+		loo->offset[i + 1] = loo->offset[i] + blbn_util_node_table_size (NthNode_bn (nodes, i));
+	}
+	loo->entry_count = loo->offset[state->node_count];
+	loo->case_counts = (double **) calloc (state->case_count, sizeof (double *));
+	loo->case_net_versions = (unsigned long *) calloc (state->case_count, sizeof (unsigned long));
+	loo->case_versions = (unsigned int *) calloc (state->case_count, sizeof (unsigned int));
+
+	return loo;
+}
+
+void blbn_loo_free (blbn_loo_t *loo, unsigned int case_count) {
+	int j;
+
+	if (loo != NULL) {
+		if (loo->shared_net != NULL) {
+			DeleteNet_bn (loo->shared_net);
+		}
+		for (j = 0; j < case_count; j++) {
+			free (loo->case_counts[j]);
+		}
+		free (loo->case_counts);
+		free (loo->case_net_versions);
+		free (loo->case_versions);
+		free (loo->prior_counts);
+		free (loo->net_counts);
+		free (loo->offset);
+		free (loo);
+	}
+}
+
+/**
+ * Returns the leave-one-out networks of the state, allocating them on first
+ * use.
+ */
+blbn_loo_t* blbn_loo_get (blbn_state_t *state) {
+	if (state->loo == NULL) {
+		state->loo = blbn_loo_new (state);
+	}
+	return state->loo;
+}
+
+/**
+ * Reads the expected counts of every node in the specified network into
+ * counts (laid out according to loo->offset).
+ */
+void blbn_loo_get_net_counts (blbn_loo_t *loo, net_bn *net, double *counts) {
+	const nodelist_bn *nodes = GetNetNodes_bn (net);
+	int i;
+
+	for (i = 0; i < LengthNodeList_bn (nodes); i++) {
+		blbn_util_get_node_counts (NthNode_bn (nodes, i), &counts[loo->offset[i]]);
+	}
+}
+
+/**
+ * Returns the network relearned from every learned case, which is the
+ * leave-one-out network of every case without learned findings.  It is
+ * relearned when the working network or any flag changed since it was
+ * learned.
+ */
+const net_bn* blbn_loo_shared_net (blbn_state_t *state) {
+	blbn_loo_t *loo = blbn_loo_get (state);
+	unsigned long flags_version = blbn_flags_version (state->flags);
+
+	if (loo->shared_net == NULL || loo->shared_net_version != state->net_version || loo->shared_flags_version != flags_version) {
+		if (loo->shared_net != NULL) {
+			DeleteNet_bn (loo->shared_net);
+		}
+		loo->shared_net = blbn_loo_relearn (state, -1);
+		loo->shared_net_version = state->net_version;
+		loo->shared_flags_version = flags_version;
+	}
+	return loo->shared_net;
+}
+
+/**
+ * Returns the expected counts the specified case contributes to the working
+ * network, or NULL if it has no learned findings.
+ *
+ * The working network is (a fixed point of EM, with either learner, so it
+ * is) the prior plus the expected counts of every learned case under its own
+ * parameters, and the case's counts are computed with a single EM iteration
+ * for the case alone on a copy of the working network.  They are kept until
+ * the working network or the case's flags change.
+ */
+const double* blbn_loo_case_counts (blbn_state_t *state, int case_index) {
+	blbn_loo_t *loo = blbn_loo_get (state);
+	net_bn *net = NULL;
+	double *counts = NULL;
+	int e;
+
+	if (!blbn_has_findings_learned_in_case (state, case_index)) {
+		return NULL;
+	}
+
+	if (loo->net_counts_version != state->net_version) {
+		if (loo->net_counts == NULL) {
+			loo->net_counts = (double *) malloc (loo->entry_count * sizeof (double));
+		}
+		blbn_loo_get_net_counts (loo, state->work_net, loo->net_counts);
+		loo->net_counts_version = state->net_version;
+	}
+
+	counts = loo->case_counts[case_index];
+	if (counts == NULL || loo->case_net_versions[case_index] != state->net_version || loo->case_versions[case_index] != state->flags->case_versions[case_index]) {
+		if (counts == NULL) {
+			counts = loo->case_counts[case_index] = (double *) malloc (loo->entry_count * sizeof (double));
+		}
+		net = blbn_util_copy_net (state, state->work_net);
+		blbn_util_net_learn_case_em (state, net, case_index, 1);
+		blbn_loo_get_net_counts (loo, net, counts);
+		DeleteNet_bn (net);
+		for (e = 0; e < loo->entry_count; e++) {
+			counts[e] -= loo->net_counts[e];
+		}
+		loo->case_net_versions[case_index] = state->net_version;
+		loo->case_versions[case_index] = state->flags->case_versions[case_index];
+	}
+	return counts;
+}
+
+/**
+ * Sets the CPTs of the specified network from expected counts laid out
+ * according to loo->offset.
+ */
+void blbn_loo_set_net_counts (blbn_loo_t *loo, net_bn *net, const double *counts) {
+	const nodelist_bn *nodes = GetNetNodes_bn (net);
+	int i;
+
+	for (i = 0; i < LengthNodeList_bn (nodes); i++) {
+		blbn_util_set_node_counts (NthNode_bn (nodes, i), &counts[loo->offset[i]]);
+	}
+}
+
+/**
+ * Returns a copy of the working network without the specified case, derived
+ * by subtracting the case's expected counts (blbn_loo_case_counts) from
+ * those of the working network, with the counts of the prior network as a
+ * floor.  The counts of the other cases are those they have under the
+ * working network's parameters rather than under the leave-one-out
+ * parameters, so the downdated network is only a starting point for EM
+ * over the other learned cases.  Each sweep is one EM iteration (one
+ * LearnCPTs_bn call, whose counts less those it started from are added to
+ * the prior's), and the sweeps stop when the expected counts change by less
+ * than BLBN_LOO_EM_TOLERANCE per case, or after state->loo_sweeps sweeps.
+ * A case without learned findings gets a copy of the working network.
+ */
+net_bn* blbn_loo_downdate (blbn_state_t *state, int case_index) {
+	blbn_loo_t *loo = blbn_loo_get (state);
+	const double *case_counts = blbn_loo_case_counts (state, case_index);
+	stream_ns   *casefile = NULL;
+	caseset_cs  *caseset  = NULL;
+	learner_bn  *learner  = NULL;
+	net_bn *net = NULL;
+	double *counts = NULL;
+	double *sweep_counts = NULL;
+	double change;
+	int case_count = 0;
+	int sweep, j, e;
+
+	net = blbn_util_copy_net (state, state->work_net);
+	RetractNetFindings_bn (net);
+	if (case_counts == NULL) {
+		return net;
+	}
+
+	if (loo->prior_counts == NULL) {
+		loo->prior_counts = (double *) malloc (loo->entry_count * sizeof (double));
+		blbn_loo_get_net_counts (loo, state->prior_net, loo->prior_counts);
+	}
+
+	counts = (double *) malloc (loo->entry_count * sizeof (double));
+	for (e = 0; e < loo->entry_count; e++) {
+		counts[e] = loo->net_counts[e] - case_counts[e];
+		if (counts[e] < loo->prior_counts[e]) {
+			counts[e] = loo->prior_counts[e]; // Guard against round-off below the prior
+		}
+	}
+	blbn_loo_set_net_counts (loo, net, counts);
+
+	if (state->loo_sweeps > 0) {
+		// Write the findings of the other learned cases once for every sweep
+		casefile = NewMemoryStream_ns ("lookahead.cas", env, NULL);
+		for (j = 0; j < state->case_count; j++) {
+			if (j != case_index && blbn_has_findings_learned_in_case (state, j)) {
+				blbn_set_net_findings_available (state, j);
+				WriteNetFindings_bn (GetNetNodes_bn (state->work_net), casefile, j, 1.0);
+				case_count++;
+			}
+		}
+		blbn_evidence_retract (state->evidence);
+
+		caseset = NewCaseset_cs (NULL, env);
+		blbn_counters.stream_bytes += blbn_stream_length (casefile);
+		AddFileToCaseset_cs (caseset, casefile, 1.0, NULL);
+
+		learner = NewLearner_bn (EM_LEARNING, NULL, env);
+		SetLearnerMaxIters_bn (learner, 1);
+
+		sweep_counts = (double *) malloc (loo->entry_count * sizeof (double));
+		for (sweep = 0; sweep < state->loo_sweeps; sweep++) {
+			LearnCPTs_bn (learner, GetNetNodes_bn (net), caseset, 1.0); // Degree must be greater than zero
+			blbn_counters.em_runs++;
+			blbn_loo_get_net_counts (loo, net, sweep_counts);
+			change = 0.0;
+			for (e = 0; e < loo->entry_count; e++) {
+				sweep_counts[e] = loo->prior_counts[e] + (sweep_counts[e] - counts[e]);
+				change += fabs (sweep_counts[e] - counts[e]);
+				counts[e] = sweep_counts[e];
+			}
+			blbn_loo_set_net_counts (loo, net, counts);
+			if (case_count == 0 || change / case_count < BLBN_LOO_EM_TOLERANCE) {
+				break;
+			}
+		}
+		RetractNetFindings_bn (net);
+
+		free (sweep_counts);
+		DeleteLearner_bn (learner);
+		DeleteCaseset_cs (caseset);
+		DeleteStream_ns  (casefile);
+	}
+
+	free (counts);
+
+	return net;
+}
+
+/**
+ * Computes what blbn_util_copy_net_unlearn_case needs for every case under
+ * the present working network (the shared network, or the expected counts
+ * of every learned case), so that worker processes forked by
+ * blbn_parallel_for inherit them instead of each computing their own.
+ */
+void blbn_loo_prepare (blbn_state_t *state) {
+	int j;
+
+	if (state->loo_mode == BLBN_LOO_DOWNDATE) {
+		for (j = 0; j < state->case_count; j++) {
+			blbn_loo_case_counts (state, j);
+		}
+	} else {
+		blbn_loo_shared_net (state);
+	}
+}
+
 /**
  * Learns the specified case using Netica's EM_LEARNING algorithm using the
  * specified net_bn network.  This does not perform any unlearning before
@@ -3905,16 +5842,18 @@ void blbn_util_net_learn_case (blbn_state_t *state, net_bn* net, int case_index)
 
 		// Load case in temporary *.cas file into new case set (contains only that single case)
 		caseset = NewCaseset_cs (NULL, env);
+		blbn_counters.stream_bytes += blbn_stream_length (casefile);
 		AddFileToCaseset_cs (caseset, casefile, 1.0, NULL);
 
 		// Retract findings from copied network (before learning)
-		RetractNetFindings_bn (net);
+		blbn_util_retract_net_findings (state, net);
 
 		// Create learner using EM learning method (updates CPTs in EM style)
 		learner = NewLearner_bn (EM_LEARNING, NULL, env);
 
 		// Learn cases using EM learner and temporary case file
 		LearnCPTs_bn (learner, nodes, caseset, 1.0); // Degree must be greater than zero
+		blbn_counters.em_runs++;
 
 		// Free allocated structures from memory
 		DeleteLearner_bn (learner);
@@ -3922,10 +5861,36 @@ void blbn_util_net_learn_case (blbn_state_t *state, net_bn* net, int case_index)
 		DeleteStream_ns  (casefile);
 
 		// Retract findings from copied network (after learning)
-		RetractNetFindings_bn (net);
+		blbn_util_retract_net_findings (state, net);
 	}
 }
 
+/**
+ * Learns one complete observation of the family of the specified node: adds
+ * one count for node_state to the CPT column of the parent configuration
+ * parent_states (the closed form of the Dirichlet update that EM_LEARNING
+ * applies to a node whose family is fully observed).  Nodes without an
+ * experience table are treated as having an experience of one.
+ */
+void blbn_util_learn_family_case (node_bn *node, const state_bn *parent_states, state_bn node_state) {
+	int state_count = GetNodeNumberStates_bn (node);
+	prob_bn *probs = (prob_bn *) malloc (state_count * sizeof (prob_bn));
+	const prob_bn *column = GetNodeProbs_bn (node, parent_states);
+	double experience = GetNodeExperience_bn (node, parent_states);
+	int k;
+
+	if (!(experience >= 0.0)) { // negative or UNDEF_DBL (no experience table)
+		experience = 1.0;
+	}
+	for (k = 0; k < state_count; k++) {
+		probs[k] = ((column != NULL ? column[k] : 1.0 / state_count) * experience + (k == node_state ? 1.0 : 0.0)) / (experience + 1.0);
+	}
+	SetNodeProbs_bn (node, parent_states, probs);
+	SetNodeExperience_bn (node, parent_states, experience + 1.0);
+
+	free (probs);
+}
+
 /**
  * This routine updates the learned network by learning from the specified
  * case (i.e., the case with index case_index) with the specified node
@@ -3936,84 +5901,297 @@ void blbn_util_net_learn_case (blbn_state_t *state, net_bn* net, int case_index)
  * available findings as well as the specified "lookahead" state will be
  * learned.
  *
+ * Nodes whose family (the node and its parents) is fully observed in the case
+ * are updated directly with blbn_util_learn_family_case.  Only the remaining
+ * nodes are learned with the EM_LEARNING algorithm (and no learner is created
+ * at all if every family is complete).  Since the closed form update is the
+ * fixed point EM reaches for those nodes, and the E-step for the other nodes
+ * then sees the same CPTs, this gives the same network as learning every node
+ * with EM.
+ *
  * Notes:
  * - This algorithm does not perform any unlearning (specifically, it doesn't
  *   perform unlearning before learning).
  */
 void blbn_util_net_learn_case_with_lookahead (blbn_state_t *state, net_bn* net, int node_index, int case_index, int state_index) {
 
-	node_bn *lookahead_node = NULL;
+	node_bn *node = NULL;
+	const nodelist_bn *parents = NULL;
+	state_bn *parent_states = NULL;
+	state_bn node_finding;
+	int i, j;
+
+	stream_ns   *casefile  = NULL; // Used as temporary output location for case
+	caseposn_bn casepon;
+	caseset_cs  *caseset   = NULL; // Case set where temporary case output will be read into
+	const nodelist_bn *work_nodes = NULL;
+	const nodelist_bn *nodes = NULL;
+	nodelist_bn *em_nodes  = NULL; // Nodes whose family is not fully observed
+	learner_bn  *learner   = NULL;
+
+	if (state != NULL) {
+
+		work_nodes = GetNetNodes_bn (state->work_net);
+		nodes = GetNetNodes_bn (net);
+
+		//------------------------------------------------------------------------------
+		// Set available findings of case to be learned (and the lookahead finding)
+		//------------------------------------------------------------------------------
+
+		// Sets the findings in the case that have been learned
+		blbn_set_net_findings_available (state, case_index);
+
+		// Set the lookahead node's state
+		blbn_evidence_set (state->evidence, node_index, state_index);
+
+		//------------------------------------------------------------------------------
+		// Learn complete families directly
+		//------------------------------------------------------------------------------
+
+		em_nodes = NewNodeList2_bn (0, net);
+		parent_states = (state_bn *) malloc ((state->node_count + 1) * sizeof (state_bn));
+
+		for (i = 0; i < LengthNodeList_bn (work_nodes); i++) {
+			node = NthNode_bn (work_nodes, i);
+			node_finding = GetNodeFinding_bn (node);
+			parents = GetNodeParents_bn (node);
+			for (j = 0; node_finding >= 0 && j < LengthNodeList_bn (parents); j++) {
+				parent_states[j] = GetNodeFinding_bn (NthNode_bn (parents, j));
+				if (parent_states[j] < 0) {
+					node_finding = NO_FINDING;
+				}
+			}
+
+			if (node_finding >= 0) {
+				blbn_util_learn_family_case (NthNode_bn (nodes, i), parent_states, node_finding);
+			} else {
+				AddNodeToList_bn (NthNode_bn (nodes, i), em_nodes, LAST_ENTRY);
+			}
+		}
+
+		free (parent_states);
+
+		//------------------------------------------------------------------------------
+		// Learn the incomplete families with EM
+		//------------------------------------------------------------------------------
+
+		if (LengthNodeList_bn (em_nodes) > 0) {
+
+			// Writes the findings to a temporary *.cas file in memory (including lookahead)
+			casefile = NewMemoryStream_ns ("available_with_lookahead.cas", env, NULL);
+			casepon = WriteNetFindings_bn (work_nodes, casefile, case_index, 1.0);
+
+			// Load case in temporary *.cas file into new case set (contains only that single case)
+			caseset = NewCaseset_cs (NULL, env);
+			blbn_counters.stream_bytes += blbn_stream_length (casefile);
+			AddFileToCaseset_cs (caseset, casefile, 1.0, NULL);
+
+			// Retract findings from copied network (before learning)
+			blbn_util_retract_net_findings (state, net);
+
+			// Create learner using EM learning method (updates CPTs in EM style)
+			learner = NewLearner_bn (EM_LEARNING, NULL, env);
+
+			// Learn cases using EM learner and temporary case file
+			LearnCPTs_bn (learner, em_nodes, caseset, 1.0); // Degree must be greater than zero
+			blbn_counters.em_runs++;
+
+			// Free allocated structures from memory
+			DeleteLearner_bn (learner);
+			DeleteCaseset_cs (caseset);
+			DeleteStream_ns  (casefile);
+		}
+
+		DeleteNodeList_bn (em_nodes);
+
+		// Retract findings from copied network (after learning)
+		blbn_util_retract_net_findings (state, net);
+	}
+}
+
+/**
+ * Runs fn for every item in [0, item_count) and stores the result_count
+ * values computed for item i in results[i * result_count ...].
+ *
+ * When state->worker_count is greater than one, the items are distributed
+ * over that many processes (the calling process and worker_count - 1 forked
+ * children).  Netica environments can't be shared between threads, so each
+ * worker is a process with its own copy of the networks, streams and
+ * scratch state.  Workers claim items one at a time from a shared counter
+ * (so faster workers take more items) and write their values into a shared
+ * result matrix.  Every item is computed by exactly one worker from the same
+ * inputs, so the results do not depend on the number of workers.  Items that
+ * a failed worker did not complete are recomputed by the calling process.
+ * The blbn_counters of the workers are added to those of the calling process.
+ */
+void blbn_parallel_for (blbn_state_t *state, int item_count, int result_count, blbn_work_fn_t fn, void *arg, double *results) {
+	int i, w;
+	int worker_count;
+	size_t result_size, shared_size;
+	char *shared = NULL;
+	double *shared_results = NULL;
+	blbn_counters_t *worker_counters = NULL;
+	blbn_counters_t counters_begin;
+	int *next_item = NULL;
+	char *done = NULL;
+	pid_t *workers = NULL;
+
+	worker_count = (state->worker_count < item_count ? state->worker_count : item_count);
+
+	if (worker_count <= 1) {
+		for (i = 0; i < item_count; i++) {
+			fn (state, i, arg, &results[i * result_count]);
+		}
+		return;
+	}
+
+	// Shared memory: result matrix and worker counters, followed by the next-item counter and completion flags
+	result_size = (size_t) item_count * result_count * sizeof (double) + worker_count * sizeof (blbn_counters_t);
+	shared_size = result_size + sizeof (int) + item_count;
+	shared = (char *) mmap (NULL, shared_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (shared == MAP_FAILED) {
+		for (i = 0; i < item_count; i++) {
+			fn (state, i, arg, &results[i * result_count]);
+		}
+		return;
+	}
+	shared_results = (double *) shared;
+	worker_counters = (blbn_counters_t *) &shared_results[item_count * result_count];
+	next_item = (int *) (shared + result_size);
+	done = shared + result_size + sizeof (int);
+
+	// Flush buffered output so it isn't written again by the workers
+	fflush (NULL);
+
+	workers = (pid_t *) malloc (worker_count * sizeof (pid_t));
+	for (w = 1; w < worker_count; w++) {
+		workers[w] = fork ();
+		if (workers[w] == 0) {
+			counters_begin = blbn_counters;
+			while ((i = __sync_fetch_and_add (next_item, 1)) < item_count) {
+				fn (state, i, arg, &shared_results[i * result_count]);
+				done[i] = 1;
+			}
+			blbn_counters_diff (&worker_counters[w], &blbn_counters, &counters_begin);
+			_exit (0);
+		}
+	}
+
+	// The calling process is worker 0
+	while ((i = __sync_fetch_and_add (next_item, 1)) < item_count) {
+		fn (state, i, arg, &shared_results[i * result_count]);
+		done[i] = 1;
+	}
+
+	for (w = 1; w < worker_count; w++) {
+		if (workers[w] > 0) {
+			waitpid (workers[w], NULL, 0);
+			blbn_counters_add (&blbn_counters, &worker_counters[w]);
+		}
+	}
+
+	for (i = 0; i < item_count; i++) {
+		if (done[i]) {
+			memcpy (&results[i * result_count], &shared_results[i * result_count], result_count * sizeof (double));
+		} else {
+			fn (state, i, arg, &results[i * result_count]);
+		}
+	}
+
+	free (workers);
+	munmap (shared, shared_size);
+}
 
-	stream_ns   *casefile  = NULL; // Used as temporary output location for case
-	caseposn_bn casepon;
-	caseset_cs  *caseset   = NULL; // Case set where temporary case output will be read into
-	nodelist_bn *nodes     = NULL;
-	learner_bn  *learner   = NULL;
+/**
+ * Returns the SFL score (the expected log loss after purchasing the finding)
+ * of the node with index node_index in the case with index case_index, where
+ * lookahead_base_net is the working network with that case unlearned.
+ * Returns DBL_MAX if the finding is already available.
+ */
+double blbn_util_sfl_score (blbn_state_t *state, net_bn *lookahead_base_net, int node_index, int case_index) {
 
-	if (state != NULL) {
+	int k = 0;
+	int node_state_count = 0;
 
-		//------------------------------------------------------------------------------
-		// Unlearn findings
-		//------------------------------------------------------------------------------
+	net_bn *lookahead_net = NULL;
 
-		nodes = GetNetNodes_bn (state->work_net);
+	double sfl_value = DBL_MAX; // Initialize SFL score to "infinite"
+	double exp_loss;
+	double state_prob;
 
-		// Create a temporary *.cas file in memory
-		casefile = NewMemoryStream_ns ("available_with_lookahead.cas", env, NULL);
+	// Check if node i in case j is NOT a target and is NOT already purchased
+	// i.e., only compute SFL score if it is available for purchase
+	if (!blbn_is_available_finding (state, node_index, case_index)) {
 
-		//------------------------------------------------------------------------------
-		// Write available findings of case to be learned.
-		//------------------------------------------------------------------------------
+		blbn_counters.candidates_scored++;
+		node_state_count = blbn_count_node_states (state, node_index);
 
-		// Sets the findings in the case that have been learned
-		RetractNetFindings_bn (state->work_net);
-		blbn_set_net_findings_available (state, case_index);
-		//blbn_set_net_findings_learned (state, case_index);
+		for (k = 0; k < node_state_count; ++k) {
 
-		// Set the lookahead node's state
-		lookahead_node = NthNode_bn (nodes, node_index);
-		//lookahead_node = GetNodeNamed_bn (blbn_get_node_name (state, node_index), state->work_net);
-		//RetractNetFindings_bn (state->work_net);
+			// Copy base lookahead network for this particular lookahead
+			lookahead_net = blbn_util_copy_net (state, lookahead_base_net);
+			blbn_util_net_learn_case_with_lookahead (state, lookahead_net, node_index, case_index, k);
 
-		RetractNodeFindings_bn (lookahead_node); // Retract node findings
+			// Get loss of lookahead network
+			exp_loss = blbn_util_get_log_loss (state, lookahead_net);
 
-		// Get the state from the data set
-		//node_state = blbn_get_finding (state, node_index, case_index);
-		EnterFinding_bn (lookahead_node, state_index);
-		//EnterFinding_bn (lookahead_node, lookahead_state_index);
-		//blbn_set_node_finding (state, lookahead_node_index, lookahead_state_index);
+			// Get probability of network (probability of state k)
+			state_prob = blbn_get_node_state_probability_given_learned_states (state, node_index, case_index, k);
 
-		// Writes the findings to memory (including lookahead)
-		casepon = WriteNetFindings_bn (nodes, casefile, case_index, 1.0);
+			if (k == 0) {
+				sfl_value = exp_loss * state_prob;
+			} else {
+				sfl_value += exp_loss * state_prob;
+			}
 
-		//------------------------------------------------------------------------------
-		// Learn the "to learn" cases that were written to memory
-		//------------------------------------------------------------------------------
+			// Deletes copy of the lookahead network
+			DeleteNet_bn (lookahead_net);
+		}
+	}
 
-		// Get list of network's nodes
-		nodes = GetNetNodes_bn (net);
+	return sfl_value;
+}
 
-		// Load case in temporary *.cas file into new case set (contains only that single case)
-		caseset = NewCaseset_cs (NULL, env);
-		AddFileToCaseset_cs (caseset, casefile, 1.0, NULL);
+/**
+ * Work function for blbn_util_sfl_row: scores the item-th considered node in
+ * the case whose lookahead base network is passed as arg.
+ */
+void blbn_util_sfl_row_item (blbn_state_t *state, int item, void *arg, double *result) {
+	blbn_sfl_row_arg_t *row = (blbn_sfl_row_arg_t *) arg;
 
-		// Retract findings from copied network (before learning)
-		RetractNetFindings_bn (net);
+	result[0] = blbn_util_sfl_score (state, row->lookahead_base_net, state->nodes_consider[item + 1], row->case_index);
+}
 
-		// Create learner using EM learning method (updates CPTs in EM style)
-		learner = NewLearner_bn (EM_LEARNING, NULL, env);
+/**
+ * Work function for blbn_util_sfl: scores every considered node in the
+ * item-th case.
+ */
+void blbn_util_sfl_case_item (blbn_state_t *state, int item, void *arg, double *result) {
+	net_bn *lookahead_base_net = NULL;
+	int ii;
 
-		// Learn cases using EM learner and temporary case file
-		LearnCPTs_bn (learner, nodes, caseset, 1.0); // Degree must be greater than zero
+	for (ii = 0; ii < state->nodes_consider[0]; ii++) {
+		result[ii] = DBL_MAX;
+	}
 
-		// Free allocated structures from memory
-		DeleteLearner_bn (learner);
-		DeleteCaseset_cs (caseset);
-		DeleteStream_ns  (casefile);
+	// Cases without any finding for sale keep "infinite" scores
+	for (ii = 0; ii < state->nodes_consider[0]; ii++) {
+		if (!blbn_is_available_finding (state, state->nodes_consider[ii + 1], item)) {
+			break;
+		}
+	}
+	if (ii == state->nodes_consider[0]) {
+		return;
+	}
 
-		// Retract findings from copied network (after learning)
-		RetractNetFindings_bn (net);
+	// Copy base network from which to perform lookahead for this case
+	lookahead_base_net = blbn_util_copy_net_unlearn_case (state, item);
+
+	for (ii = 0; ii < state->nodes_consider[0]; ii++) {
+		result[ii] = blbn_util_sfl_score (state, lookahead_base_net, state->nodes_consider[ii + 1], item);
 	}
+
+	DeleteNet_bn (lookahead_base_net);
 }
 
 /**
@@ -4022,139 +6200,398 @@ void blbn_util_net_learn_case_with_lookahead (blbn_state_t *state, net_bn* net,
 double* blbn_util_sfl_row (blbn_state_t *state, int case_index) {
 
 	double *sfl_values = NULL;
-	int i = 0, k = 0;
-	int node_state_count = 0;
-
-	net_bn *lookahead_base_net = NULL;
-	net_bn *lookahead_net = NULL;
-
-	double sfl_value;
-	double exp_loss;
-	double state_prob;
+	blbn_sfl_row_arg_t row;
 
 	// Initialize SFL values
 	sfl_values = (double * ) malloc (state->nodes_consider[0] * sizeof(double));
 
 	// Copy base network from which to perform lookahead for this case
-	lookahead_base_net = blbn_util_copy_net_unlearn_case (state, case_index);
+	row.case_index = case_index;
+	row.lookahead_base_net = blbn_util_copy_net_unlearn_case (state, case_index);
 
-	//for (i = 0; i < state->node_count; ++i) {
-	int ii=0;
-	for (ii=0; ii<state->nodes_consider[0];ii++){
-		i = state->nodes_consider[ii+1];
-		node_state_count = blbn_count_node_states (state, i);
+	// Score the considered nodes (in parallel if state->worker_count > 1)
+	blbn_parallel_for (state, state->nodes_consider[0], 1, blbn_util_sfl_row_item, &row, sfl_values);
 
-		sfl_values[ii] = DBL_MAX; // Initialize SFL score to "infinite"
+	DeleteNet_bn (row.lookahead_base_net);
 
-		// Check if node i in case case_index is NOT a target and is NOT already purchased
-		// i.e., only compute SFL score if it is available for purchase
-		if (!blbn_is_available_finding (state, i, case_index)) {
-		//if (!blbn_is_purchased_finding(state, i, case_index)) {
-			for (k = 0; k < node_state_count; ++k) {
+	return sfl_values;
+}
+
+/**
+ * Returns an array with the SFL score for each node in the specified case.
+ */
+double** blbn_util_sfl (blbn_state_t *state) {
+
+	double **sfl_values = NULL;
+	double *case_values = NULL;
+	int i = 0, j = 0;
+
+	// Initialize SFL values
+	sfl_values = (double **) malloc (state->node_count * sizeof (double *));
+	for (i = 0; i < state->nodes_consider[0]; ++i) {
+		sfl_values[i] = (double *) malloc (state->case_count*sizeof(double));
+		//sfl_values[i] = (double *) malloc (state->case_count * sizeof (double));
+	}
 
-				// Copy base lookahead network for this particular lookahead
-				lookahead_net = blbn_util_copy_net (state, lookahead_base_net);
-				blbn_util_net_learn_case_with_lookahead (state, lookahead_net, i, case_index, k);
+	// Score every case (in parallel if state->worker_count > 1)
+	case_values = (double *) malloc (state->case_count * state->nodes_consider[0] * sizeof (double));
+	blbn_loo_prepare (state);
+	blbn_parallel_for (state, state->case_count, state->nodes_consider[0], blbn_util_sfl_case_item, NULL, case_values);
 
-				// Get loss of lookahead network
-				exp_loss = blbn_util_get_log_loss (state, lookahead_net);
+	for (j = 0; j < state->case_count; ++j) {
+		for (i = 0; i < state->nodes_consider[0]; ++i) {
+			sfl_values[i][j] = case_values[j * state->nodes_consider[0] + i];
+		}
+	}
 
-				// Get probability of network (probability of state k)
-				state_prob = blbn_get_node_state_probability_given_learned_states (state, i, case_index, k);
+	free (case_values);
 
-				if (k == 0) {
-					sfl_value = exp_loss * state_prob;
-				} else {
-					sfl_value += exp_loss * state_prob;
+	return sfl_values;
+}
+
+/**
+ * Work function for blbn_util_sfl_top: scores every considered node in the
+ * item-th case of the block starting at the case passed as arg.
+ */
+void blbn_util_sfl_block_item (blbn_state_t *state, int item, void *arg, double *result) {
+	blbn_util_sfl_case_item (state, *((int *) arg) + item, NULL, result);
+}
+
+/**
+ * Pushes the SFL score of every finding for sale onto the heap, scanning the
+ * cases in order and the considered nodes in order within a case.  Cases are
+ * scored BLBN_SFL_BLOCK_CASES at a time (in parallel if state->worker_count >
+ * 1), so only the scores of one block are held at a time instead of the
+ * matrix blbn_util_sfl returns.
+ */
+void blbn_util_sfl_top (blbn_state_t *state, blbn_candidate_heap_t *heap) {
+
+	double *block_values = NULL;
+	int block_start, block_count;
+	int i, j, ii;
+
+	block_values = (double *) malloc (BLBN_SFL_BLOCK_CASES * state->nodes_consider[0] * sizeof (double) + 1);
+	blbn_loo_prepare (state);
+
+	for (block_start = 0; block_start < state->case_count; block_start += BLBN_SFL_BLOCK_CASES) {
+		block_count = state->case_count - block_start;
+		if (block_count > BLBN_SFL_BLOCK_CASES) {
+			block_count = BLBN_SFL_BLOCK_CASES;
+		}
+		blbn_parallel_for (state, block_count, state->nodes_consider[0], blbn_util_sfl_block_item, &block_start, block_values);
+
+		for (j = block_start; j < block_start + block_count; ++j) {
+			for (ii = 0; ii < state->nodes_consider[0]; ii++) {
+				i = state->nodes_consider[1 + ii];
+				if (!blbn_is_available_finding (state, i, j)) {
+					blbn_candidate_heap_push (heap, block_values[(j - block_start) * state->nodes_consider[0] + ii], i, j);
 				}
+			}
+		}
+	}
+
+	free (block_values);
+}
+
+/**
+ * Returns the lowest SFL score of a finding for sale in the case, and sets
+ * node_index to its node (the first considered node with that score).
+ * Returns DBL_MAX (and leaves node_index unchanged) if nothing is for sale.
+ */
+double blbn_util_sfl_case_min (blbn_state_t *state, int case_index, int *node_index) {
 
-				//printf ("CHOSE: (%d,%d) with LOSS = %f\n", min_exp_loss_node_index, min_exp_loss_case_index, min_exp_loss);
+	double *sfl_values = NULL;
+	double min_exp_loss = DBL_MAX;
+	int i, ii;
+
+	// Get SFL values for row
+	sfl_values = blbn_util_sfl_row (state, case_index);
+
+	for (ii = 0; ii < state->nodes_consider[0]; ii++) {
+		i = state->nodes_consider[ii + 1];
 
-				// Deletes copy of the lookahead network
-				DeleteNet_bn (lookahead_net);
+		// Check scores for values that are not for the target node or nodes that are already purchased
+		if (!blbn_is_available_finding (state, i, case_index)) {
+			if (sfl_values[ii] < min_exp_loss) {
+				min_exp_loss = sfl_values[ii];
+				*node_index = i;
 			}
 		}
-		sfl_values[ii] = sfl_value;
 	}
 
-	DeleteNet_bn (lookahead_base_net);
+	free (sfl_values);
 
-	return sfl_values;
+	return min_exp_loss;
 }
 
 /**
- * Returns an array with the SFL score for each node in the specified case.
+ * Returns the lowest SFL score of a finding for sale, scoring every case, and
+ * sets node_index and case_index to the finding (the first case with that
+ * score).  If case_scores is not NULL, the lowest score of each case is
+ * stored in it (DBL_MAX if nothing is for sale), and if case_nodes is not
+ * NULL, the node with that score.
  */
-double** blbn_util_sfl (blbn_state_t *state) {
+double blbn_util_sfl_min (blbn_state_t *state, int *node_index, int *case_index, double *case_scores, int *case_nodes) {
 
-	double **sfl_values = NULL;
-	int i = 0, j = 0, k = 0;
-	int node_state_count = 0;
+	double min_exp_loss = DBL_MAX;
+	double case_min;
+	int case_node = -1;
+	int j;
 
-	net_bn *lookahead_base_net = NULL;
-	net_bn *lookahead_net = NULL;
+	for (j = 0; j < state->case_count; ++j) {
+		case_min = blbn_util_sfl_case_min (state, j, &case_node);
+		if (case_scores != NULL) {
+			case_scores[j] = case_min;
+		}
+		if (case_nodes != NULL) {
+			case_nodes[j] = case_node;
+		}
+		if (case_min < min_exp_loss) {
+			min_exp_loss = case_min;
+			*node_index = case_node;
+			*case_index = j;
+		}
+	}
 
-	double sfl_value;
-	double exp_loss;
-	double state_prob;
+	return min_exp_loss;
+}
 
-	// Initialize SFL values
-	sfl_values = (double **) malloc (state->node_count * sizeof (double *));
-	for (i = 0; i < state->nodes_consider[0]; ++i) {
-		sfl_values[i] = (double *) malloc (state->case_count*sizeof(double));
-		//sfl_values[i] = (double *) malloc (state->case_count * sizeof (double));
+/**
+ * Rescores the specified case for the lazy mode.
+ */
+void blbn_sfl_lazy_rescore (blbn_state_t *state, int case_index) {
+	blbn_sfl_lazy_t *lazy = state->sfl_lazy;
+
+	lazy->scores[case_index] = blbn_util_sfl_case_min (state, case_index, &lazy->nodes[case_index]);
+	lazy->case_versions[case_index] = state->flags->case_versions[case_index];
+	lazy->scored_at[case_index] = lazy->selections;
+	lazy->rescored++;
+}
+
+/**
+ * Lazy ("CELF") version of blbn_util_sfl_min.  The lowest score of each case
+ * from earlier selections is kept as a stale bound.  Cases whose evidence
+ * changed since they were scored (such as the case just purchased) and cases
+ * scored lazy->max_age or more selections ago are rescored first; then, while
+ * one of the lazy->top_k cases with the lowest bounds was not scored in this
+ * selection, it is rescored.  The case chosen is the first with the lowest
+ * score, which is then fresh.
+ *
+ * Purchases change the network slightly, so stale scores are close to the
+ * current ones but are not bounds in the strict sense: the choice can differ
+ * from the exact one.  Requiring the top_k lowest to be fresh instead of only
+ * the lowest catches most cases whose score moved past the winner's, and
+ * max_age bounds how stale any score gets.  With an audit interval, every
+ * audit_interval-th selection is also made exactly and the number of
+ * disagreements is reported; a lazy choice whose exact score ties the exact
+ * minimum (such as an identical case) is not a disagreement.  The exact
+ * scores are not kept as bounds, so auditing does not change the lazy
+ * choices; the lazy choice is returned either way.
+ */
+double blbn_util_sfl_min_lazy (blbn_state_t *state, int *node_index, int *case_index) {
+
+	blbn_sfl_lazy_t *lazy = NULL;
+	double min_exp_loss = DBL_MAX;
+	double exact_min;
+	int exact_node_index = -1, exact_case_index = -1;
+	int j, best, rank, stale;
+
+	if (state->sfl_lazy == NULL) {
+		state->sfl_lazy = blbn_sfl_lazy_new (state, 0);
+	}
+	lazy = state->sfl_lazy;
+	lazy->selections++;
+
+	// Score every case the first time
+	if (lazy->selections == 1) {
+		min_exp_loss = blbn_util_sfl_min (state, node_index, case_index, lazy->scores, lazy->nodes);
+		for (j = 0; j < state->case_count; ++j) {
+			lazy->case_versions[j] = state->flags->case_versions[j];
+			lazy->scored_at[j] = lazy->selections;
+		}
+		return min_exp_loss;
 	}
 
+	// Rescore the cases whose evidence changed or whose score is too old
 	for (j = 0; j < state->case_count; ++j) {
+		if (lazy->case_versions[j] != state->flags->case_versions[j]
+				|| (lazy->max_age > 0 && lazy->scores[j] < DBL_MAX && lazy->selections - lazy->scored_at[j] >= lazy->max_age)) {
+			blbn_sfl_lazy_rescore (state, j);
+		}
+	}
 
-		// Copy base network from which to perform lookahead for this case
-		lookahead_base_net = blbn_util_copy_net_unlearn_case (state, j);
-		int ii=0;
-		for (ii=0; ii<state->nodes_consider[0];ii++){
-			i = state->nodes_consider[1+ii];
+	// Rescore the cases with the top_k lowest bounds until they are all fresh
+	do {
+		// Rank the cases by bound (selection of the top_k lowest, first case on ties)
+		for (rank = 0; rank < lazy->top_k; rank++) {
+			lazy->ranked[rank] = -1;
+			for (j = 0; j < state->case_count; ++j) {
+				if (lazy->scores[j] < DBL_MAX && lazy->rank_of[j] != lazy->selections
+						&& (lazy->ranked[rank] < 0 || lazy->scores[j] < lazy->scores[lazy->ranked[rank]])) {
+					lazy->ranked[rank] = j;
+				}
+			}
+			if (lazy->ranked[rank] < 0) {
+				break;
+			}
+			lazy->rank_of[lazy->ranked[rank]] = lazy->selections;
+		}
 
-			//for (i = 0; i < state->node_count; ++i) {
+		stale = 0;
+		for (j = 0; j < rank; j++) {
+			lazy->rank_of[lazy->ranked[j]] = 0;
+			if (lazy->scored_at[lazy->ranked[j]] != lazy->selections) {
+				blbn_sfl_lazy_rescore (state, lazy->ranked[j]);
+				stale = 1;
+			}
+		}
+	} while (stale);
 
-			node_state_count = blbn_count_node_states (state, i);
+	best = (rank > 0 ? lazy->ranked[0] : -1);
+	if (best >= 0) {
+		min_exp_loss = lazy->scores[best];
+		*node_index = lazy->nodes[best];
+		*case_index = best;
+	}
 
-			sfl_value = DBL_MAX;
-			sfl_values[ii][j] = DBL_MAX; // Initialize SFL score to "infinite"
+	// Compare with the exact choice
+	if (lazy->audit_interval > 0 && lazy->selections % lazy->audit_interval == 0) {
+		exact_min = blbn_util_sfl_min (state, &exact_node_index, &exact_case_index, lazy->audit_scores, NULL);
+		lazy->audits++;
+		if (best >= 0 && lazy->audit_scores[best] > exact_min + BLBN_SFL_LAZY_TIE * fabs (exact_min)) {
+			lazy->disagreements++;
+		}
+		printf ("SFL lazy audit: selection %lu lazy (%d,%d) exact (%d,%d), %lu of %lu audits differ, %.1f cases rescored per selection\n",
+				lazy->selections, (best >= 0 ? *node_index : -1), best, exact_node_index, exact_case_index,
+				lazy->disagreements, lazy->audits, (double) lazy->rescored / (lazy->selections - 1));
+	}
 
-			// Check if node i in case j is NOT a target and is NOT already purchased
-			// i.e., only compute SFL score if it is available for purchase
-			if (!blbn_is_available_finding (state, i, j)) {
+	return min_exp_loss;
+}
 
-				for (k = 0; k < node_state_count; ++k) {
+blbn_sfl_lazy_t* blbn_sfl_lazy_new (blbn_state_t *state, unsigned int audit_interval) {
+	blbn_sfl_lazy_t *lazy = (blbn_sfl_lazy_t *) calloc (1, sizeof (blbn_sfl_lazy_t));
+
+	lazy->scores = (double *) malloc ((state->case_count + 1) * sizeof (double));
+	lazy->audit_scores = (double *) malloc ((state->case_count + 1) * sizeof (double));
+	lazy->nodes = (int *) malloc ((state->case_count + 1) * sizeof (int));
+	lazy->case_versions = (unsigned int *) calloc (state->case_count + 1, sizeof (unsigned int));
+	lazy->scored_at = (unsigned long *) calloc (state->case_count + 1, sizeof (unsigned long));
+	lazy->rank_of = (unsigned long *) calloc (state->case_count + 1, sizeof (unsigned long));
+	lazy->top_k = BLBN_SFL_LAZY_TOP_K;
+	lazy->max_age = BLBN_SFL_LAZY_MAX_AGE;
+	lazy->ranked = (int *) malloc ((lazy->top_k + 1) * sizeof (int));
+	lazy->audit_interval = audit_interval;
+
+	return lazy;
+}
 
-					// Copy base lookahead network for this particular lookahead
-					lookahead_net = blbn_util_copy_net (state, lookahead_base_net);
-					blbn_util_net_learn_case_with_lookahead (state, lookahead_net, i, j, k);
+void blbn_sfl_lazy_free (blbn_sfl_lazy_t *lazy) {
+	if (lazy != NULL) {
+		free (lazy->scores);
+		free (lazy->audit_scores);
+		free (lazy->nodes);
+		free (lazy->case_versions);
+		free (lazy->scored_at);
+		free (lazy->rank_of);
+		free (lazy->ranked);
+		free (lazy);
+	}
+}
 
-					// Get loss of lookahead network
-					exp_loss = blbn_util_get_log_loss (state, lookahead_net);
+blbn_candidate_heap_t* blbn_candidate_heap_new (int capacity) {
+	blbn_candidate_heap_t *heap = (blbn_candidate_heap_t *) calloc (1, sizeof (blbn_candidate_heap_t));
 
-					// Get probability of network (probability of state k)
-					state_prob = blbn_get_node_state_probability_given_learned_states (state, i, j, k);
+	heap->capacity = capacity;
+	heap->entries = (blbn_candidate_t *) malloc ((capacity + 1) * sizeof (blbn_candidate_t));
 
-					if (k == 0) {
-						sfl_value = exp_loss * state_prob;
-					} else {
-						sfl_value += exp_loss * state_prob;
-					}
+	return heap;
+}
 
-					// Deletes copy of the lookahead network
-					DeleteNet_bn (lookahead_net);
-				}
-			}
+void blbn_candidate_heap_free (blbn_candidate_heap_t *heap) {
+	if (heap != NULL) {
+		free (heap->entries);
+		free (heap);
+	}
+}
+
+/**
+ * Returns non-zero if candidate a is worse than candidate b (a higher score,
+ * or the same score pushed later).
+ */
+int blbn_candidate_worse (const blbn_candidate_t *a, const blbn_candidate_t *b) {
+	return (a->score > b->score || (a->score == b->score && a->order > b->order));
+}
 
-			sfl_values[ii][j] = sfl_value;
+/**
+ * Restores the heap property below position i among the first count entries.
+ */
+void blbn_candidate_heap_sift_down (blbn_candidate_t *entries, int count, int i) {
+	blbn_candidate_t entry = entries[i];
+	int child;
 
+	while ((child = 2 * i + 1) < count) {
+		if (child + 1 < count && blbn_candidate_worse (&entries[child + 1], &entries[child])) {
+			child++;
+		}
+		if (!blbn_candidate_worse (&entries[child], &entry)) {
+			break;
 		}
+		entries[i] = entries[child];
+		i = child;
+	}
+	entries[i] = entry;
+}
 
-		DeleteNet_bn (lookahead_base_net);
+/**
+ * Offers a candidate to the heap.  A candidate with score DBL_MAX (not for
+ * sale) or NaN is never kept.
+ */
+void blbn_candidate_heap_push (blbn_candidate_heap_t *heap, double score, int node_index, int case_index) {
+	blbn_candidate_t entry;
+	int i, parent;
+
+	entry.score = score;
+	entry.order = heap->pushed++;
+	entry.node_index = node_index;
+	entry.case_index = case_index;
+
+	if (!(score < DBL_MAX) || heap->capacity <= 0) {
+		return;
 	}
 
-	return sfl_values;
+	if (heap->count < heap->capacity) {
+		// Sift the new entry up from the end
+		i = heap->count++;
+		while (i > 0) {
+			parent = (i - 1) / 2;
+			if (!blbn_candidate_worse (&entry, &heap->entries[parent])) {
+				break;
+			}
+			heap->entries[i] = heap->entries[parent];
+			i = parent;
+		}
+		heap->entries[i] = entry;
+	} else if (blbn_candidate_worse (&heap->entries[0], &entry)) {
+		// Replace the worst kept candidate
+		heap->entries[0] = entry;
+		blbn_candidate_heap_sift_down (heap->entries, heap->count, 0);
+	}
+}
+
+/**
+ * Sorts the kept candidates best first (the heap can no longer be pushed to).
+ */
+void blbn_candidate_heap_sort (blbn_candidate_heap_t *heap) {
+	blbn_candidate_t worst;
+	int count;
+
+	for (count = heap->count; count > 1; count--) {
+		worst = heap->entries[0];
+		heap->entries[0] = heap->entries[count - 1];
+		heap->entries[count - 1] = worst;
+		blbn_candidate_heap_sift_down (heap->entries, count - 1, 0);
+	}
 }
 
 void blbn_util_print_findings (blbn_state_t *state) {
@@ -4186,6 +6623,9 @@ double** blbn_util_merpg (blbn_state_t *state) {
 	double target_probability;
 	double current_target_probability;
 	double expected_target_probability;
+	const uint64_t *reached = NULL;
+	double shared_value;
+	int separated;
 
 	// Initialize MERPG values
 	//percent_diff_values = (double **) malloc (state->node_count * sizeof (double *));
@@ -4202,6 +6642,10 @@ double** blbn_util_merpg (blbn_state_t *state) {
 		// Calculate probability of the target node
 		current_target_probability = blbn_get_target_node_belief_given_learned (state, j);
 
+		// Nodes the target is d-connected to (NULL if candidates are not pruned)
+		reached = blbn_prune_target_reached (state, j);
+		shared_value = DBL_MAX;
+
 		// Iterate over nodes
 		int ii=0;
 		for (ii=0; ii<state->nodes_consider[0];ii++){
@@ -4210,6 +6654,16 @@ double** blbn_util_merpg (blbn_state_t *state) {
 			// Check if the current node is a target node (if so, do not predict a value)
 			if (!blbn_is_available_finding (state, i, j)) {
 
+				// Nodes d-separated from the target don't change its belief
+				// whatever their state, so they all have the score of the first
+				separated = (reached != NULL && !((reached[i / 64] >> (i % 64)) & 0x01));
+				if (separated && shared_value < DBL_MAX) {
+					percent_diff_values[ii][j] = shared_value;
+					blbn_counters.candidates_pruned++;
+					continue;
+				}
+				blbn_counters.candidates_scored++;
+
 				expected_target_probability = 0.0;
 
 				node_state_count = blbn_count_node_states (state, i);
@@ -4219,12 +6673,8 @@ double** blbn_util_merpg (blbn_state_t *state) {
 					// Get probability that node i is in state k (given purchased findings in case j)
 					state_probability = blbn_get_node_state_probability_given_learned_states (state, i, j, k);
 
-					// Set known findings in case except for target
-					blbn_set_net_findings_learned_except_target (state, j);
-
-					// Get probability of the target given the purchased/learned values
-					blbn_assert_node_finding_for_case (state, i, j, k);
-					target_probability = blbn_get_target_node_belief_given_findings (state, j);
+					// Get probability of the target given the purchased/learned values and node i in state k
+					target_probability = blbn_get_target_belief_given_node_state (state, i, j, k);
 
 					// Update calculation of expected probability of predicting correct label
 					if (k == 0) {
@@ -4238,6 +6688,9 @@ double** blbn_util_merpg (blbn_state_t *state) {
 
 				// Calculate percent difference between probability of case being predicted correctly
 				percent_diff_values[ii][j] = (expected_target_probability - current_target_probability) / current_target_probability;
+				if (separated) {
+					shared_value = percent_diff_values[ii][j];
+				}
 
 				//printf ("%f -> %f / %f    ", current_target_probability, expected_target_probability, percent_diff_values[i][j]);
 				//printf ("%f , (%f * %f), %f, %f    ", current_target_probability, target_probability, state_probability, expected_target_probability, percent_diff_values[i][j]);
@@ -4258,11 +6711,26 @@ double** blbn_util_merpg (blbn_state_t *state) {
 /**
  * Returns an array with the additional number of d-separations with the target node
  *
+ * The count for a case is computed with one Bayes ball from the target (see
+ * blbn_dsep_count) given the nodes with findings in the case.  A candidate
+ * node the ball did not reach, none of whose ancestors that are not already
+ * evidence ancestors were reached from a parent, cannot open a new trail
+ * when instantiated, so it only removes itself from the d-separated nodes
+ * (a difference of -1); the ball is rerun only for the other candidates.
+ *
+ * The counts and reached nodes are memoized by evidence pattern
+ * (state->dsep_memo), so over the whole run the ball runs once per distinct
+ * pattern.
  */
 int** blbn_util_dsep (blbn_state_t *state) {
 
 	int **dsep_values = NULL;
-	int i = 0, j = 0;
+	int i = 0, j = 0, w;
+	blbn_graph_t *graph = NULL;
+	uint64_t *evidence, *evidence_ancestors, *candidate_evidence, *candidate_ancestors;
+	const uint64_t *node_ancestors, *reached, *reached_down;
+	int opens_trail;
+	int pattern, candidate_pattern;
 
 	int pre_dsep_num_nodes;
 	int cur_dsep_num_nodes;
@@ -4276,27 +6744,67 @@ int** blbn_util_dsep (blbn_state_t *state) {
 		dsep_values[i] = (int *) malloc (state->case_count * sizeof (int));
 	}
 
+	if (state->graph == NULL) {
+		state->graph = blbn_graph_new (state);
+	}
+	graph = state->graph;
+	if (state->dsep_memo == NULL) {
+		state->dsep_memo = blbn_dsep_memo_new (graph->words);
+	}
+	evidence            = (uint64_t *) calloc (4 * graph->words + 1, sizeof (uint64_t));
+	evidence_ancestors  = evidence + graph->words;
+	candidate_evidence  = evidence + 2 * graph->words;
+	candidate_ancestors = evidence + 3 * graph->words;
+
 	for (j=0; j<state->case_count;j++){
-		// set the findings of only this case
-		blbn_set_net_findings(state,j);
+		// the findings of only this case
+		blbn_dsep_case_evidence (state, j, BLBN_FLAG_AVAILABLE, evidence);
+		blbn_dsep_evidence_ancestors (graph, evidence, evidence_ancestors);
 
 		// then we compute the number of d-separations of the network
-		pre_dsep_num_nodes = blbn_get_d_separated_node_count(state, state->target);
+		pattern = blbn_dsep_memo_find (state->dsep_memo, evidence);
+		if (pattern < 0) {
+			pre_dsep_num_nodes = blbn_dsep_count (graph, state->target, evidence, evidence_ancestors);
+			pattern = blbn_dsep_memo_add (state->dsep_memo, evidence, pre_dsep_num_nodes, graph);
+		}
+		pre_dsep_num_nodes = state->dsep_memo->counts[pattern];
 
 		int ii=0;
 
 		for (ii=0; ii<state->nodes_consider[0];ii++){
 			i = state->nodes_consider[1+ii];
 			if (!blbn_is_available_finding(state, i, j)){
-				// we alays set a new findings with its state to be assigned 0
-				blbn_assert_node_finding_for_case(state,i,j,0);
-				cur_dsep_num_nodes = blbn_get_d_separated_node_count(state,state->target);
+				// we add a finding for the node to the findings of the case
+				reached = &state->dsep_memo->reached[pattern * 2 * graph->words];
+				reached_down = reached + graph->words;
+				node_ancestors = &graph->ancestors[i * graph->words];
+				opens_trail = ((reached[i / 64] >> (i % 64)) & 0x01);
+				for (w = 0; w < graph->words && !opens_trail; w++) {
+					opens_trail = ((node_ancestors[w] & ~evidence_ancestors[w] & reached_down[w]) != 0);
+				}
+				if (opens_trail) {
+					memcpy (candidate_evidence, evidence, graph->words * sizeof (uint64_t));
+					candidate_evidence[i / 64] |= (uint64_t) 1 << (i % 64);
+					candidate_pattern = blbn_dsep_memo_find (state->dsep_memo, candidate_evidence);
+					if (candidate_pattern < 0) {
+						for (w = 0; w < graph->words; w++) {
+							candidate_ancestors[w] = evidence_ancestors[w] | node_ancestors[w];
+						}
+						cur_dsep_num_nodes = blbn_dsep_count (graph, state->target, candidate_evidence, candidate_ancestors);
+						candidate_pattern = blbn_dsep_memo_add (state->dsep_memo, candidate_evidence, cur_dsep_num_nodes, graph);
+					}
+					cur_dsep_num_nodes = state->dsep_memo->counts[candidate_pattern];
+				} else {
+					cur_dsep_num_nodes = pre_dsep_num_nodes - 1;
+				}
 				dsep_difference = cur_dsep_num_nodes - pre_dsep_num_nodes;
 				dsep_values[ii][j] = dsep_difference;
 			}
 			else dsep_values[ii][j]=0;
 		}
 	}
+
+	free (evidence);
 	return dsep_values;
 }
 
@@ -4323,7 +6831,7 @@ double** blbn_util_cheat (blbn_state_t *state) {
 	// Initialize SFL values
 	expected_loss_probability_values = (double **) malloc (state->nodes_consider[0] * sizeof (double *));
 
-	for (i = 0; i < state->node_count; ++i) {
+	for (i = 0; i < state->nodes_consider[0]; ++i) {
 		expected_loss_probability_values[i] = (double *) malloc (state->case_count * sizeof (double));
 	}
 
@@ -4343,6 +6851,8 @@ double** blbn_util_cheat (blbn_state_t *state) {
 			// Check if the current node is a target node (if so, do not predict a value)
 			if (!blbn_is_available_finding (state, i, j)) {
 
+				blbn_counters.candidates_scored++;
+
 				expected_loss_probability = 0.0;
 
 				node_state_count = blbn_count_node_states (state, i);
@@ -4415,7 +6925,9 @@ double** blbn_util_cheat (blbn_state_t *state) {
  * - The result array must be freed by programmer.
  */
 int blbn_get_findings_not_purchased_for_node (blbn_state_t *state, int node_index, int **result) {
-	int i;
+	int i, w;
+	const uint64_t *words = NULL;
+	uint64_t bits;
 	int count = 0; // count of findings not purchased (used for resizing array later)
 	*result = NULL;
 	if (state != NULL) { // check if valid metadata object was specified
@@ -4423,10 +6935,17 @@ int blbn_get_findings_not_purchased_for_node (blbn_state_t *state, int node_inde
 			*result = (int *) malloc (state->case_count * sizeof (int)); // allocates array to store unpurchased findings
 			if (*result != NULL) {
 				count = 0; // initialize count of findings not purchased to zero
-				for (i = 0; i < state->case_count; ++i) {
-					if (!blbn_is_purchased_finding (state, node_index, i)) {
+				words = &state->flags->by_node[BLBN_FLAG_PURCHASED][node_index * state->flags->node_words];
+				for (w = 0; w < state->flags->node_words; ++w) {
+					bits = ~words[w]; // cases not purchased in this word
+					while (bits != 0) {
+						i = w * 64 + __builtin_ctzll (bits);
+						if (i >= state->case_count) {
+							break;
+						}
 						(*result)[count] = i; // store non-purchased finding
 						++count;
+						bits &= bits - 1;
 					}
 				}
 				*result = (int *) realloc ((*result), count * sizeof (int)); // resize array to number of findings not purchased
@@ -4467,18 +6986,12 @@ int blbn_get_findings_not_purchased_in_case (blbn_state_t *state, int case_index
  * purchased.
  */
 int blbn_count_findings_in_node_not_purchased (blbn_state_t *state, int node_index) {
-	int i;
-	int count = 0;
 	if (state != NULL) {
 		if (blbn_is_valid_node (state, node_index)) {
-			for (i = 0; i < state->case_count; ++i) {
-				if (!blbn_is_purchased_finding (state, node_index, i)) {
-					++count;
-				}
-			}
+			return state->case_count - state->flags->node_counts[BLBN_FLAG_PURCHASED][node_index];
 		}
 	}
-	return count;
+	return 0;
 }
 
 /**
@@ -4486,18 +6999,12 @@ int blbn_count_findings_in_node_not_purchased (blbn_state_t *state, int node_ind
  * purchased.
  */
 int blbn_count_findings_in_case_not_purchased (blbn_state_t *state, int case_index) {
-	int i;
-	int count = 0;
 	if (state != NULL) {
 		if (blbn_is_valid_case (state, case_index)) {
-			for (i = 0; i < state->node_count; ++i) {
-				if (!blbn_is_purchased_finding (state, i, case_index)) {
-					++count;
-				}
-			}
+			return state->node_count - state->flags->case_counts[BLBN_FLAG_PURCHASED][case_index];
 		}
 	}
-	return count;
+	return 0;
 }
 
 
@@ -26,9 +26,14 @@
 #include <string.h>
 #include <time.h>
 #include <float.h>
+#include <stdint.h>
 #include <math.h>
 #include <sys/stat.h>
-#include "../netica/Netica.h"
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include "../netica/Netica.h" // Netica library, or the native engine in blbn_engine*.c
 #include "../netica/NeticaEx.h"
 
 // Indicates whether or not to print output to stdout
@@ -40,6 +45,12 @@
 #define BLBN_METADATA_FLAG_PURCHASED 0x02
 #define BLBN_METADATA_FLAG_LEARNED   0x04
 
+#define BLBN_FLAG_TARGET    0 // Bit vector planes of blbn_flags_t
+#define BLBN_FLAG_PURCHASED 1
+#define BLBN_FLAG_LEARNED   2
+#define BLBN_FLAG_AVAILABLE 3 // target or purchased (maintained by blbn_flags_set)
+#define BLBN_FLAG_PLANES    4
+
 #define BLBN_POLICY_ROUND_ROBIN  0 // Round Robin
 #define BLBN_POLICY_BIASED_ROBIN 1 // Biased Robin
 #define BLBN_POLICY_SFL          2 // Single-Feature Lookahead
@@ -53,6 +64,54 @@
 #define BLBN_POLICY_MERPGDSEPW2  38    // MERPG algorithm and d_separation as a log weighting factor
 #define BLBN_POLICY_RANDOM 49
 
+#define BLBN_LEARN_EM          0 // Relearn every learned case from the prior network with EM (blbn_learn_case_v2)
+#define BLBN_LEARN_INCREMENTAL 1 // Continue EM from the previous parameters with the revised case (blbn_learn_case_v3)
+
+// SFL rescoring modes (state->sfl_mode)
+#define BLBN_SFL_EXACT 0 // Rescore every case for every selection (default)
+#define BLBN_SFL_LAZY  1 // Rescore only the cases that can still win (see blbn_util_sfl_min_lazy)
+#define BLBN_SFL_LAZY_TOP_K   4  // Lowest stale scores rescored before a lazy selection
+#define BLBN_SFL_LAZY_MAX_AGE 10 // Selections after which a lazy score is rescored
+#define BLBN_SFL_LAZY_TIE     1e-9 // Relative difference under which audited scores tie
+
+// Candidate pruning modes (state->prune_mode)
+#define BLBN_PRUNE_NONE 0 // Score every finding for sale (default)
+#define BLBN_PRUNE_DSEP 1 // Skip MERPG findings d-separated from the target (see blbn_prune_new)
+
+// Leave-one-out network modes (state->loo_mode, see blbn_util_copy_net_unlearn_case)
+#define BLBN_LOO_RELEARN  0 // Relearn the other learned cases with EM from the prior network (default)
+#define BLBN_LOO_DOWNDATE 1 // Subtract the case's expected counts from those of the working network
+#define BLBN_LOO_DOWNDATE_SWEEPS 1000 // Most EM iterations refining a downdated network (see blbn_loo_downdate)
+#define BLBN_LOO_EM_TOLERANCE 1e-5 // Change in expected counts per case under which the refinement stops
+
+// Cases scored per blbn_parallel_for call when SFL scores are streamed (see blbn_util_sfl_top)
+#define BLBN_SFL_BLOCK_CASES 64
+
+// Defaults for the incremental learner
+#define BLBN_INCREMENTAL_TOLERANCE      0.001 // Maximum log loss difference from a full EM relearn
+#define BLBN_INCREMENTAL_EM_TOLERANCE   1e-5  // Change in expected counts per re-estimated case that ends the refinement
+#define BLBN_INCREMENTAL_MAX_SWEEPS     1000  // Maximum refinement sweeps (EM iterations) per revision
+#define BLBN_INCREMENTAL_CHECK_INTERVAL 10    // Revisions between comparisons with a full EM relearn
+
+// Layouts of the data matrices (state->state and state->cost)
+#define BLBN_LAYOUT_NODE_MAJOR 0 // [node * case_count + case]: scans over the cases of a node are contiguous (default)
+#define BLBN_LAYOUT_CASE_MAJOR 1 // [case * node_count + node]: scans over the nodes of a case are contiguous
+
+// Position of a (node, case) cell in the data matrices of state st
+#define BLBN_CELL(st, node_index, case_index) ((st)->layout == BLBN_LAYOUT_CASE_MAJOR \
+		? (size_t) (case_index) * (st)->node_count + (node_index) \
+		: (size_t) (node_index) * (st)->case_count + (case_index))
+#define BLBN_STATE(st, node_index, case_index) ((st)->state[BLBN_CELL (st, node_index, case_index)])
+#define BLBN_COST(st, node_index, case_index) ((st)->cost[BLBN_CELL (st, node_index, case_index)])
+
+// Node of the working network with the specified static index (see blbn_set_work_net)
+#define BLBN_WORK_NODE(st, node_index) ((st)->work_nodes[node_index])
+
+// Binary case store (see blbn_case_store_write)
+#define BLBN_CBIN_MAGIC   "BLBNCAS1" // First 8 bytes of a case store file
+#define BLBN_CBIN_SUFFIX  ".cbin"    // Appended to the path of the *.cas file it was converted from
+#define BLBN_CBIN_MISSING -1         // State code of a missing value
+
 // The global Netica environment structure
 environ_ns* env;
 
@@ -64,32 +123,306 @@ typedef struct blbn_select_action {
 	unsigned int node_index; // j; // node (column)
 	unsigned int case_index; // i; // case (row)
 	unsigned int filter_node_index; // when there is a filter (e.g. Markov Blanket) to nodes, it indicates the index of the filtered nodes
-	struct blbn_select_action *prev; // previous selection
-	struct blbn_select_action *next; // next selection
 } blbn_select_action_t;
 
+// Selected actions in the order they were taken, stored contiguously
+typedef struct blbn_action_list {
+	blbn_select_action_t *actions; // [0] is the first (head), [length - 1] the latest (tail)
+	unsigned int length;
+	unsigned int capacity;
+} blbn_action_list_t;
+
+// Position in an action list (used by blbn_learn2 to follow another learner)
+typedef struct blbn_action_iter {
+	const blbn_action_list_t *list;
+	unsigned int position; // index of the next action returned
+} blbn_action_iter_t;
+
+// Sufficient statistics (expected counts) kept by the incremental learner
+typedef struct blbn_suff_stats {
+	unsigned int entry_count; // total number of CPT entries over all nodes
+	unsigned int *offset; // offset of each node's CPT entries in the flattened tables (node_count + 1 entries)
+	double *prior_counts; // expected counts of the prior network
+	double *fixed_counts; // expected counts of the prior plus the complete learned cases
+	double *counts; // expected counts of the working network (prior plus learned cases)
+	double **case_counts; // expected counts contributed by each complete learned case (NULL otherwise)
+	unsigned int revisions; // revisions since the last comparison with a full EM relearn
+} blbn_suff_stats_t;
+
+// Findings entered on a network.  New findings are applied as differences
+// from the findings entered before (see blbn_evidence_apply), so stepping
+// between similar evidence vectors changes (and repropagates) only what
+// differs.  The findings of a network with a manager (the working network,
+// and the networks tested by blbn_util_get_test_rates) are only changed
+// through it; other networks (the original network while the cases are
+// read, and the leave-one-out and lookahead copies) have no manager.
+typedef struct blbn_evidence {
+	net_bn *net;
+	int node_count;
+	node_bn **nodes; // [node] node of net with each static index
+	int *entered; // [node] finding entered on the net (NO_FINDING if none)
+	int *pending; // [node] scratch vector used to build the next findings
+	int valid; // entered matches the net (0 until the first findings are applied)
+} blbn_evidence_t;
+
+// Target/purchased/learned flags of every (node, case) finding, packed as bit
+// vectors twice (one vector per node with a bit per case, and one vector per
+// case with a bit per node) so that both rows and columns can be scanned a
+// word at a time.  The number of set bits per node, per case and overall is
+// maintained on every change, so existence and count queries are O(1).
+typedef struct blbn_flags {
+	unsigned int node_count;
+	unsigned int case_count;
+	unsigned int node_words; // 64-bit words in a node vector (bits are cases)
+	unsigned int case_words; // 64-bit words in a case vector (bits are nodes)
+	uint64_t *by_node[BLBN_FLAG_PLANES]; // [plane][node * node_words + case / 64]
+	uint64_t *by_case[BLBN_FLAG_PLANES]; // [plane][case * case_words + node / 64]
+	unsigned int *node_counts[BLBN_FLAG_PLANES]; // [plane][node] cases with the flag set
+	unsigned int *case_counts[BLBN_FLAG_PLANES]; // [plane][case] nodes with the flag set
+	unsigned long total_counts[BLBN_FLAG_PLANES]; // [plane] findings with the flag set
+	unsigned int *case_versions; // [case] incremented whenever a flag of the case changes
+} blbn_flags_t;
+
+// Beliefs of the working network for one case, computed once per network
+// version and evidence (see blbn_get_case_posteriors)
+typedef struct blbn_posterior {
+	unsigned long net_version; // state->net_version the beliefs were computed for (0 = never)
+	unsigned int case_version; // flags->case_versions[case] the beliefs were computed for
+	double *beliefs; // [state_offset[node] + k] P(node = k | learned findings of the case)
+	double *target_beliefs; // [state_offset[node] + k] P(target = label | learned findings except target, node = k), or -1 if not computed
+} blbn_posterior_t;
+
+// Posterior cache of the working network (one entry per case)
+typedef struct blbn_posterior_cache {
+	unsigned int *state_offset; // [node] offset of the node's states in the belief arrays (node_count + 1 entries)
+	blbn_posterior_t *cases; // [case]
+	unsigned long hits; // lookups answered from the cache
+	unsigned long misses; // lookups that propagated the working network
+} blbn_posterior_cache_t;
+
+// Numbers of the expensive Netica operations made by the library (counted
+// since the start of the run; blbn_learn1 and blbn_learn2 report the
+// differences per iteration in the graph file)
+typedef struct blbn_counters {
+	unsigned long em_runs; // LearnCPTs_bn calls
+	unsigned long net_copies; // CopyNet_bn calls
+	unsigned long compiles; // CompileNet_bn calls
+	unsigned long findings_entered; // EnterFinding_bn calls
+	unsigned long stream_bytes; // bytes of case data written to memory streams
+	unsigned long candidates_scored; // (node, case) candidates scored by SFL, MERPG or cheating
+	unsigned long candidates_pruned; // candidates given a score without evaluating them (see blbn_prune_t)
+} blbn_counters_t;
+
+extern blbn_counters_t blbn_counters;
+
+// Structure of the network as compressed adjacency arrays (the parents of
+// node i are parents[parent_offset[i]] ... parents[parent_offset[i + 1] - 1],
+// and likewise for children), with node sets as bit vectors, used for
+// d-separation queries (see blbn_dsep_count)
+typedef struct blbn_graph {
+	unsigned int node_count;
+	unsigned int words; // 64-bit words in a node bit vector
+	int *parent_offset; // [node] (node_count + 1 entries)
+	int *parents;
+	int *child_offset; // [node] (node_count + 1 entries)
+	int *children;
+	uint64_t *ancestors; // [node * words + node / 64] the node and its ancestors
+	uint64_t *visited_up; // nodes the last query's ball reached from a child
+	uint64_t *visited_down; // nodes the last query's ball reached from a parent
+	int *stack; // scratch stack of (node, direction) entries
+} blbn_graph_t;
+
+// Numbers of d-separated nodes of the target per evidence pattern (the set of
+// nodes with findings, as a node bit vector).  The count does not depend on
+// the values of the findings, so cases, iterations and the dsep policies
+// share the entries.
+typedef struct blbn_dsep_memo {
+	unsigned int words; // 64-bit words in a pattern
+	unsigned int pattern_count;
+	unsigned int capacity;
+	uint64_t *patterns; // [pattern * words]
+	int *counts; // [pattern] d-separated nodes given the pattern
+	uint64_t *reached; // [pattern * 2 * words] nodes the ball reached, then those it reached from a parent
+	unsigned int *buckets; // open-addressing hash of patterns (pattern index + 1, 0 = empty)
+	unsigned int bucket_count;
+	unsigned long hits; // lookups answered from the memo
+	unsigned long misses; // lookups that ran the Bayes ball
+} blbn_dsep_memo_t;
+
+// Header of a binary case store file.  It is followed by the state counts of
+// the nodes (uint32_t [node_count]), the node names (null-terminated, in node
+// order, names_size bytes in total), and at codes_offset (a multiple of 8) the
+// state codes (int32_t [node * case_count + case], BLBN_CBIN_MISSING if
+// missing).  Integers are in the byte order of the host that wrote the file.
+typedef struct blbn_cbin_header {
+	char magic[8]; // BLBN_CBIN_MAGIC
+	uint32_t node_count;
+	uint32_t case_count;
+	uint32_t names_size;
+	uint32_t codes_offset;
+} blbn_cbin_header_t;
+
+// Binary case store mapped read-only into memory.  Stores are kept in a list
+// per process, so every state reading the same file shares one mapping (and
+// processes on the host share the pages).
+typedef struct blbn_case_store {
+	char *filepath;
+	void *map;
+	size_t map_size;
+	unsigned int node_count;
+	unsigned int case_count;
+	const uint32_t *state_counts; // [node]
+	const char **node_names; // [node] (point into the mapping)
+	const int32_t *codes; // [node * case_count + case]
+	int references; // states using the store
+	struct blbn_case_store *next;
+} blbn_case_store_t;
+
+// Stale SFL scores kept between selections by the lazy SFL mode
+typedef struct blbn_sfl_lazy {
+	double *scores; // [case] lowest SFL score of a finding for sale in the case when last scored (DBL_MAX if none)
+	int *nodes; // [case] node with that score
+	unsigned int *case_versions; // [case] flags->case_versions when last scored
+	unsigned long *scored_at; // [case] selection in which the case was last scored (0 = never)
+	unsigned long selections; // selections made
+	unsigned long rescored; // cases rescored by lazy selections
+	int top_k; // lowest bounds that must be fresh before a case is chosen
+	unsigned long max_age; // selections after which a score is rescored (0 = never)
+	int *ranked; // [rank] scratch: the cases with the top_k lowest bounds
+	unsigned long *rank_of; // [case] scratch: selection in which the case was last ranked
+	unsigned int audit_interval; // compare with an exact selection every audit_interval selections (0 = never)
+	double *audit_scores; // [case] exact scores of the last audit
+	unsigned long audits; // exact selections compared
+	unsigned long disagreements; // compared selections where the lazy choice scored worse than the exact one
+} blbn_sfl_lazy_t;
+
+// Scratch vectors used to prune MERPG candidates before scoring them.  A node
+// d-separated from the target given a case's learned findings can't change
+// the target belief, so all such nodes in the case share one score.
+typedef struct blbn_prune {
+	uint64_t *evidence; // scratch node bit vectors
+	uint64_t *evidence_ancestors;
+} blbn_prune_t;
+
+// Leave-one-out networks (the working network without one case, used as the
+// base of lookaheads, see blbn_util_copy_net_unlearn_case).  Every case
+// without learned findings has the same leave-one-out network, which is
+// relearned only when the learned findings change.  The downdate mode keeps
+// the expected counts of the working network and those each learned case
+// contributes to it, laid out like blbn_suff_stats_t.
+typedef struct blbn_loo {
+	net_bn *shared_net; // relearned from every learned case (NULL until first used)
+	unsigned long shared_net_version; // state->net_version shared_net was learned for
+	unsigned long shared_flags_version; // blbn_flags_version shared_net was learned for
+	unsigned int *offset; // [node] offset of the node's counts (node_count + 1 entries)
+	unsigned int entry_count;
+	double *prior_counts; // [entry] expected counts of the prior network
+	double *net_counts; // [entry] expected counts of work_net
+	unsigned long net_counts_version; // state->net_version of net_counts (0 = never read)
+	double **case_counts; // [case][entry] expected counts the case contributes to work_net (NULL if not computed)
+	unsigned long *case_net_versions; // [case] state->net_version of case_counts
+	unsigned int *case_versions; // [case] flags->case_versions of case_counts
+} blbn_loo_t;
+
+// Validation set encoded once per run: the distinct evidence patterns (the
+// findings on every node except the target), how many validation cases
+// with each target state share each pattern, and the pattern, target state
+// and weight of each case in file order
+typedef struct blbn_validation {
+	unsigned int case_count; // validation cases with a target value
+	unsigned int pattern_count; // distinct evidence patterns
+	int target_state_count;
+	int *findings; // [pattern * node_count + node] state, or -1 if missing (always -1 for the target)
+	double *target_counts; // [pattern * target_state_count + state] number of cases
+	unsigned int *case_patterns; // [case] pattern of the case
+	int *case_states; // [case] target state of the case
+	double *case_weights; // [case] weight of the case
+} blbn_validation_t;
+
 typedef struct blbn_state {
 	unsigned int node_count; // n; // number of nodes columns
 	unsigned int case_count; // m; // number of cases rows
 	char **nodes; // node names (this is the static ordering used in blbn library)
-	int **state; // state
-	unsigned int **cost; // node costs
+	int *state; // states of the findings, read with BLBN_STATE (points into case_store if it is not NULL, read-only)
+	blbn_case_store_t *case_store; // binary case store the states are mapped from (NULL if they are allocated)
+	unsigned int *cost; // node costs, read with BLBN_COST
+	int layout; // layout of state and cost (see blbn_set_data_layout)
 	unsigned int budget; // budget
 	int target; // target node index
 	int* nodes_consider; // Filter to used to consider all nodes (only Markov Blanket nodes)
 	int cur_chosen_node;
-	unsigned int **flags; // purchased, learned
-	blbn_select_action_t *sel_action_seq; // select action sequence
+	blbn_flags_t *flags; // target, purchased, learned
+	blbn_action_list_t sel_actions; // select action sequence
 	double last_log_loss;
 	double curr_log_loss;
+	int learn_mode; // BLBN_LEARN_EM or BLBN_LEARN_INCREMENTAL
+	double learn_tolerance; // incremental learner: maximum log loss difference from a full EM relearn
+	unsigned int learn_max_sweeps; // incremental learner: maximum refinement sweeps per revision
+	unsigned int learn_check_interval; // incremental learner: revisions between full EM comparisons (0 disables)
+	blbn_suff_stats_t *suff_stats; // incremental learner: expected counts
+	unsigned long net_version; // incremented whenever the CPTs of work_net change (see blbn_work_net_changed)
+	blbn_posterior_cache_t *posteriors; // beliefs of work_net per case (NULL until first used)
+	blbn_graph_t *graph; // structure of work_net (NULL until first used)
+	blbn_dsep_memo_t *dsep_memo; // d-separation counts of the target per evidence pattern (NULL until first used)
+	int worker_count; // number of processes used to score lookahead policies (1 = serial)
+	int sfl_mode; // BLBN_SFL_EXACT or BLBN_SFL_LAZY (used by blbn_select_next_sfl)
+	blbn_sfl_lazy_t *sfl_lazy; // stale scores of the lazy SFL mode (NULL until first used)
+	int prune_mode; // BLBN_PRUNE_NONE or BLBN_PRUNE_DSEP (used by the MERPG scorer)
+	blbn_prune_t *prune; // candidate pruning vectors (NULL until first used)
+	int loo_mode; // BLBN_LOO_RELEARN or BLBN_LOO_DOWNDATE (used by blbn_util_copy_net_unlearn_case)
+	int loo_sweeps; // most EM iterations refining a downdated network (see blbn_loo_downdate)
+	blbn_loo_t *loo; // leave-one-out networks and counts (NULL until first used)
+	int action_out_fd; // pipelined mode: selected actions are also written here (-1 = none)
+	int action_in_fd; // pipelined mode: blbn_learn2 reads the actions to follow from here (-1 = none)
 	// Wrapped Netica-related data structures
 	net_bn *orig_net;
 	net_bn *prior_net;
 	net_bn *work_net;
 	nodelist_bn *nodelist;
+	node_bn **work_nodes; // [node] node of work_net with each static index (rebuilt by blbn_set_work_net)
+	blbn_evidence_t *evidence; // findings entered on work_net (rebuilt by blbn_set_work_net)
+	int *state_counts; // [node] number of states of each node
+	int *name_table; // open-addressing hash of node names (node index + 1, 0 = empty; see blbn_get_node_by_name)
+	unsigned int name_table_size; // power of two
 	caseset_cs* validation_caseset;
+	blbn_validation_t *validation; // encoded validation_caseset (used to compute test rates)
 } blbn_state_t;
 
+// Work function run by blbn_parallel_for for one item, writing its values to result
+typedef void (*blbn_work_fn_t) (blbn_state_t *state, int item, void *arg, double *result);
+
+// Bounded max-heap of the K lowest-scoring (node, case) candidates.  Ties are
+// broken by the order in which candidates were pushed (earlier is better), so
+// the kept candidates, sorted, are those of a stable sorted insertion.
+typedef struct blbn_candidate {
+	double score;
+	long order; // position in the push sequence
+	int node_index;
+	int case_index;
+} blbn_candidate_t;
+
+typedef struct blbn_candidate_heap {
+	blbn_candidate_t *entries; // [0] is the worst kept candidate (until sorted)
+	int count;
+	int capacity; // K
+	long pushed; // candidates pushed so far
+} blbn_candidate_heap_t;
+
+// Argument of the work function used by blbn_util_sfl_row
+typedef struct blbn_sfl_row_arg {
+	int case_index;
+	net_bn *lookahead_base_net;
+} blbn_sfl_row_arg_t;
+
+// Argument of the work function used by blbn_learn_all_cases_counting
+typedef struct blbn_count_arg {
+	int slice_count; // number of case slices counted (one per worker)
+	unsigned int *offset; // offset of each node's CPT entries in the partial tables (node_count + 1 entries)
+	int *state_counts; // [node] number of states
+	int *parent_counts; // [node] number of parents
+	int **parents; // [node] node indices of the parents (in CPT order)
+} blbn_count_arg_t;
+
 // Function prototypes
 int blbn_init ();
 
@@ -102,10 +435,17 @@ char* blbn_get_node_name (blbn_state_t *state, unsigned int node_index);
 void blbn_learn_all_v0 (stream_ns *casefile, net_bn *net, nodelist_bn *nodes, caseposn_bn *case_posn);
 
 // Learn a naive or Bayesian network based on a policy
-blbn_select_action_t* blbn_learn1(blbn_state_t *state, int policy, FILE* graph_fp, FILE* log_fp);
+const blbn_action_list_t* blbn_learn1(blbn_state_t *state, int policy, FILE* graph_fp, FILE* log_fp);
 
 // Learn a naive or Bayesian network based on given choices
-void blbn_learn2(blbn_state_t *state, FILE* graph_fp, FILE* log_fp, blbn_select_action_t* curr_action);
+void blbn_learn2(blbn_state_t *state, FILE* graph_fp, FILE* log_fp, blbn_action_iter_t* following_actions);
+void blbn_write_action (int fd, const blbn_select_action_t *action);
+int blbn_read_action (int fd, blbn_select_action_t *action);
+long blbn_now_ns ();
+long blbn_stream_length (stream_ns *stream);
+void blbn_counters_diff (blbn_counters_t *diff, const blbn_counters_t *end, const blbn_counters_t *begin);
+void blbn_counters_add (blbn_counters_t *sum, const blbn_counters_t *counters);
+void blbn_write_graph_row (FILE *graph_fp, int i, int node_index, int case_index, const double *test_rates, long begin_ns, long selected_ns, long revised_ns, long evaluated_ns, const blbn_counters_t *counters_begin);
 
 blbn_select_action_t* blbn_select_next_rr (blbn_state_t *state);
 blbn_select_action_t* blbn_select_next_br (blbn_state_t *state);
@@ -115,12 +455,22 @@ int blbn_count_findings_in_case_not_purchased (blbn_state_t *state, int case_ind
 int blbn_count_actions (blbn_state_t *state);
 void blbn_learn_targets (blbn_state_t *state, double ess);
 void blbn_revise_by_case_findings_v1 (blbn_state_t *state, int case_index);
+void blbn_revise_by_case_findings_v2 (blbn_state_t *state, int case_index);
+void blbn_revise_by_case_findings_v3 (blbn_state_t *state, int case_index);
+void blbn_revise_by_case_findings (blbn_state_t *state, int case_index);
+void blbn_learn_all_cases (blbn_state_t *state);
+void blbn_learn_all_cases_em (blbn_state_t *state);
+void blbn_learn_all_cases_counting (blbn_state_t *state);
 void blbn_learn_baseline (blbn_state_t *state, FILE* graph_fp);
 void blbn_learn_MBbaseline (blbn_state_t *state, FILE* graph_fp);
 void blbn_learn_case_v1 (blbn_state_t *state, int case_index);
 void blbn_learn_case_v2 (blbn_state_t *state, int case_index);
 void blbn_unlearn_case_v1 (blbn_state_t *state, int case_index);
 void blbn_unlearn_case_v2 (blbn_state_t *state, int case_index);
+void blbn_learn_case_v3 (blbn_state_t *state, int case_index);
+void blbn_unlearn_case_v3 (blbn_state_t *state, int case_index);
+blbn_suff_stats_t* blbn_suff_stats_init (blbn_state_t *state);
+void blbn_suff_stats_free (blbn_state_t *state);
 void blbn_set_net_findings_available (blbn_state_t *state, int case_index);
 void blbn_set_net_findings_learned (blbn_state_t *state, int case_index);
 void blbn_set_net_findings (blbn_state_t *state, int case_index);
@@ -136,13 +486,45 @@ void blbn_set_uniform_prior (blbn_state_t *state, double experience);
 blbn_select_action_t* blbn_get_action_head (blbn_state_t *state);
 blbn_select_action_t* blbn_get_action (blbn_state_t *state, unsigned int index);
 blbn_select_action_t* blbn_get_action_tail (blbn_state_t *state);
+blbn_select_action_t* blbn_append_action (blbn_state_t *state, const blbn_select_action_t *action);
+void blbn_action_iter_init (blbn_action_iter_t *iter, const blbn_action_list_t *list);
+const blbn_select_action_t* blbn_action_iter_next (blbn_action_iter_t *iter);
 int blbn_get_random_finding_not_purchased_in_node (blbn_state_t *state, int node_index);
 int blbn_get_random_finding_not_purchased_in_node_with_label (blbn_state_t *mdata, int node_index, int target_state);
 char* blbn_get_node_name (blbn_state_t *state, unsigned int node_index);
-int blbn_get_node_by_name (blbn_state_t *state, char *name);
+int blbn_get_node_by_name (blbn_state_t *state, const char *name);
+unsigned int blbn_util_hash_name (const char *name);
+void blbn_util_index_nodes (blbn_state_t *state);
+void blbn_set_work_net (blbn_state_t *state, net_bn *net);
+blbn_evidence_t* blbn_evidence_new (blbn_state_t *state, net_bn *net);
+void blbn_evidence_free (blbn_evidence_t *evidence);
+void blbn_evidence_apply (blbn_evidence_t *evidence, const int *findings);
+void blbn_evidence_set (blbn_evidence_t *evidence, int node_index, int finding);
+void blbn_evidence_retract (blbn_evidence_t *evidence);
+void blbn_util_retract_net_findings (blbn_state_t *state, net_bn *net);
+int blbn_get_available_finding (blbn_state_t *state, int node_index, int case_index);
 int blbn_get_finding (blbn_state_t *state, unsigned int node_index, unsigned int case_index);
 double blbn_get_error_rate (blbn_state_t *state);
 double blbn_get_log_loss (blbn_state_t *state);
+double* blbn_get_test_rates (blbn_state_t *state);
+double blbn_util_get_log_loss (blbn_state_t *state, net_bn *net);
+blbn_validation_t* blbn_validation_init (blbn_state_t *state, net_bn *net, stream_ns *validation_stream);
+void blbn_validation_free (blbn_validation_t *validation);
+int blbn_case_store_write (const char *filepath, net_bn *net, stream_ns *data_stream);
+blbn_case_store_t* blbn_case_store_open (const char *filepath);
+void blbn_case_store_release (blbn_case_store_t *store);
+int blbn_case_store_load_states (blbn_state_t *state, const char *data_filepath);
+void blbn_set_data_layout (blbn_state_t *state, int layout);
+void blbn_util_get_test_rates (blbn_state_t *state, net_bn *net, double *test_rates);
+net_bn* blbn_util_copy_net_unlearn_case (blbn_state_t *state, int case_index);
+net_bn* blbn_loo_relearn (blbn_state_t *state, int case_index);
+blbn_loo_t* blbn_loo_get (blbn_state_t *state);
+void blbn_loo_free (blbn_loo_t *loo, unsigned int case_count);
+const net_bn* blbn_loo_shared_net (blbn_state_t *state);
+const double* blbn_loo_case_counts (blbn_state_t *state, int case_index);
+net_bn* blbn_loo_downdate (blbn_state_t *state, int case_index);
+void blbn_loo_prepare (blbn_state_t *state);
+char blbn_has_findings_learned_in_case (blbn_state_t *state, unsigned int case_index);
 int blbn_get_minimum_cost (blbn_state_t *state);
 int blbn_get_minimum_cost_in_node (blbn_state_t *state, unsigned int node_index);
 int blbn_get_minimum_cost_in_case (blbn_state_t *state, unsigned int case_index);
@@ -164,6 +546,12 @@ char blbn_has_cases_purchased (blbn_state_t *state, unsigned int node_index);
 char blbn_has_findings_available_in_case (blbn_state_t *state, unsigned int case_index);
 char blbn_has_cases_available (blbn_state_t *state, unsigned int node_index);
 char blbn_has_parents_with_findings (blbn_state_t *state, int node_index, int case_index);
+blbn_flags_t* blbn_flags_new (unsigned int node_count, unsigned int case_count);
+void blbn_flags_free (blbn_flags_t *flags);
+char blbn_flags_get (const blbn_flags_t *flags, int plane, unsigned int node_index, unsigned int case_index);
+void blbn_flags_set (blbn_flags_t *flags, int plane, unsigned int node_index, unsigned int case_index, char value);
+unsigned int blbn_flags_count_in_case (const blbn_flags_t *flags, int plane, int not_plane, unsigned int case_index);
+unsigned long blbn_flags_version (const blbn_flags_t *flags);
 char blbn_is_learned_finding (blbn_state_t *state, unsigned int node_index, unsigned int case_index);
 char blbn_is_available_finding (blbn_state_t *state, unsigned int node_index, unsigned int case_index);
 char blbn_is_purchased_finding (blbn_state_t *state, unsigned int node_index, unsigned int case_index);
@@ -175,6 +563,19 @@ void blbn_restore_prior_network (blbn_state_t *state);
 
 double** blbn_util_sfl (blbn_state_t *state);
 double* blbn_util_sfl_row (blbn_state_t *state, int case_index);
+void blbn_util_sfl_top (blbn_state_t *state, blbn_candidate_heap_t *heap);
+double blbn_util_sfl_case_min (blbn_state_t *state, int case_index, int *node_index);
+double blbn_util_sfl_min (blbn_state_t *state, int *node_index, int *case_index, double *case_scores, int *case_nodes);
+void blbn_sfl_lazy_rescore (blbn_state_t *state, int case_index);
+double blbn_util_sfl_min_lazy (blbn_state_t *state, int *node_index, int *case_index);
+blbn_sfl_lazy_t* blbn_sfl_lazy_new (blbn_state_t *state, unsigned int audit_interval);
+void blbn_sfl_lazy_free (blbn_sfl_lazy_t *lazy);
+blbn_candidate_heap_t* blbn_candidate_heap_new (int capacity);
+void blbn_candidate_heap_free (blbn_candidate_heap_t *heap);
+void blbn_candidate_heap_push (blbn_candidate_heap_t *heap, double score, int node_index, int case_index);
+void blbn_candidate_heap_sort (blbn_candidate_heap_t *heap);
+double blbn_util_sfl_score (blbn_state_t *state, net_bn *lookahead_base_net, int node_index, int case_index);
+void blbn_parallel_for (blbn_state_t *state, int item_count, int result_count, blbn_work_fn_t fn, void *arg, double *results);
 
 blbn_select_action_t* blbn_select_next_sfl (blbn_state_t *state);
 blbn_select_action_t* blbn_select_next_gsfl (blbn_state_t *state);
@@ -189,10 +590,42 @@ blbn_select_action_t* blbn_select_next_merpgdsepw2 (blbn_state_t *state);
 blbn_select_action_t* blbn_select_next_cheating (blbn_state_t *state, FILE* log_fp);
 blbn_select_action_t* blbn_select_next_random(blbn_state_t *state);
 
+// Joint beliefs of two nodes in one propagation (an extension of the Netica API
+// provided by the native engine; NULL when linked against Netica)
+int blbn_engine_joint_beliefs (node_bn *node1, node_bn *node2, double *joint) __attribute__ ((weak));
+
+// Beliefs of a node in double precision (an extension of the Netica API
+// provided by the native engine; NULL when linked against Netica)
+int blbn_engine_node_beliefs (node_bn *node, double *beliefs) __attribute__ ((weak));
+
+// Posterior cache of the working network
+void blbn_work_net_changed (blbn_state_t *state);
+blbn_posterior_cache_t* blbn_posterior_cache_new (blbn_state_t *state);
+void blbn_posterior_cache_free (blbn_posterior_cache_t *cache, unsigned int case_count);
+const blbn_posterior_t* blbn_get_case_posteriors (blbn_state_t *state, int case_index);
+double blbn_get_node_state_probability_given_learned_states (blbn_state_t *state, int node_index, int case_index, int state_index);
+double blbn_get_target_node_belief_given_learned (blbn_state_t *state, int case_index);
+double blbn_get_target_node_belief_given_findings (blbn_state_t *state, int case_index);
+int blbn_get_target_joint_beliefs (blbn_state_t *state, int node_index, int case_index, double *joint);
+double blbn_get_target_belief_given_node_state (blbn_state_t *state, int node_index, int case_index, int state_index);
+
 double** blbn_util_merpg (blbn_state_t *state);
 int** blbn_util_dsep (blbn_state_t *state);
 int blbn_get_d_separated_nodes (blbn_state_t *state, unsigned int node_index, int **d_separated_node_indices);
 int blbn_get_d_separated_node_count (blbn_state_t *state, unsigned int node_index);
+blbn_graph_t* blbn_graph_new (blbn_state_t *state);
+void blbn_graph_free (blbn_graph_t *graph);
+void blbn_dsep_case_evidence (blbn_state_t *state, int case_index, int plane, uint64_t *evidence);
+void blbn_dsep_evidence_ancestors (const blbn_graph_t *graph, const uint64_t *evidence, uint64_t *evidence_ancestors);
+int blbn_dsep_count (blbn_graph_t *graph, int node_index, const uint64_t *evidence, const uint64_t *evidence_ancestors);
+blbn_dsep_memo_t* blbn_dsep_memo_new (unsigned int words);
+void blbn_dsep_memo_free (blbn_dsep_memo_t *memo);
+int blbn_dsep_memo_find (blbn_dsep_memo_t *memo, const uint64_t *pattern);
+int blbn_dsep_memo_add (blbn_dsep_memo_t *memo, const uint64_t *pattern, int count, const blbn_graph_t *graph);
+blbn_prune_t* blbn_prune_new (blbn_state_t *state);
+void blbn_prune_free (blbn_prune_t *prune);
+blbn_prune_t* blbn_prune_get (blbn_state_t *state);
+const uint64_t* blbn_prune_target_reached (blbn_state_t *state, int case_index);
 int blbn_get_node_index (blbn_state_t *state, char* node_name);
 
 int blbn_has_finding_set (blbn_state_t *state, unsigned node_index);
@@ -0,0 +1,2354 @@
+/*
+ * blbn_engine.c
+ *
+ *  Created: 2026-10-16
+ *
+ * Netica C API subset for the native engine: environment and errors,
+ * streams, node lists, nets, nodes and their tables, findings, node
+ * relations, DNE files, case files and case sets.  See blbn_engine.h.
+ */
+
+#include <stdarg.h>
+#include <ctype.h>
+#include <sys/stat.h>
+#include "blbn_engine.h"
+
+long blbn_engine_table_stamps = 0; // Tables made writable by every net (orders CPT changes)
+
+//------------------------------------------------------------------------------
+// Environment and errors
+//------------------------------------------------------------------------------
+
+double GetUndefDbl_ns () {
+	return NAN;
+}
+
+double GetInfinityDbl_ns () {
+	return INFINITY;
+}
+
+environ_ns* NewNeticaEnviron_ns (const char* license, environ_ns* env, const char* locn) {
+	environ_ns *new_env = (environ_ns *) calloc (1, sizeof (environ_ns));
+	new_env->license_ok = (license != NULL);
+	return new_env;
+}
+
+int InitNetica2_bn (environ_ns* env, char* mesg) {
+	if (mesg != NULL) {
+		sprintf (mesg, "%s initialized", BLBN_ENGINE_VERSION);
+	}
+	return (env != NULL ? 0 : -1);
+}
+
+int CloseNetica_bn (environ_ns* env, char* mesg) {
+	if (env != NULL) {
+		ClearErrors_ns (env, XXX_ERR);
+		free (env);
+	}
+	if (mesg != NULL) {
+		sprintf (mesg, "%s closed", BLBN_ENGINE_VERSION);
+	}
+	return 0;
+}
+
+int GetNeticaVersion_bn (const environ_ns* env, const char** version) {
+	if (version != NULL) {
+		*version = BLBN_ENGINE_VERSION;
+	}
+	return 100;
+}
+
+/**
+ * Records an error in the specified environment (errors are kept until they
+ * are cleared, like Netica).
+ */
+void blbn_engine_error (environ_ns *env, int number, errseverity_ns severity, const char *format, ...) {
+	report_ns *report = NULL;
+	report_ns *last = NULL;
+	va_list args;
+
+	report = (report_ns *) calloc (1, sizeof (report_ns));
+	report->number = number;
+	report->severity = severity;
+	va_start (args, format);
+	vsnprintf (report->mesg, MESG_LEN_ns, format, args);
+	va_end (args);
+
+	if (env == NULL) {
+		fprintf (stderr, "Error %d: %s\n", number, report->mesg);
+		free (report);
+		return;
+	}
+
+	if (env->errors == NULL) {
+		env->errors = report;
+	} else {
+		for (last = env->errors; last->next != NULL; last = last->next);
+		last->next = report;
+	}
+}
+
+report_ns* NewError_ns (environ_ns* env, int number, errseverity_ns severity, const char* mesg) {
+	report_ns *last = NULL;
+
+	blbn_engine_error (env, number, severity, "%s", mesg);
+	if (env == NULL) {
+		return NULL;
+	}
+	for (last = env->errors; last->next != NULL; last = last->next);
+	return last;
+}
+
+report_ns* GetError_ns (environ_ns* env, errseverity_ns severity, const report_ns* after) {
+	report_ns *report = NULL;
+
+	if (env == NULL) {
+		return NULL;
+	}
+	report = (after != NULL ? after->next : env->errors);
+	while (report != NULL && report->severity < severity) {
+		report = report->next;
+	}
+	return report;
+}
+
+int ErrorNumber_ns (const report_ns* error) {
+	return (error != NULL ? error->number : 0);
+}
+
+const char* ErrorMessage_ns (const report_ns* error) {
+	return (error != NULL ? error->mesg : "");
+}
+
+errseverity_ns ErrorSeverity_ns (const report_ns* error) {
+	return (error != NULL ? error->severity : NOTHING_ERR);
+}
+
+void ClearErrors_ns (environ_ns* env, errseverity_ns severity) {
+	report_ns **link = NULL;
+	report_ns *report = NULL;
+
+	if (env == NULL) {
+		return;
+	}
+	link = &env->errors;
+	while (*link != NULL) {
+		report = *link;
+		if (report->severity <= severity) {
+			*link = report->next;
+			free (report);
+		} else {
+			link = &report->next;
+		}
+	}
+}
+
+//------------------------------------------------------------------------------
+// Streams
+//------------------------------------------------------------------------------
+
+stream_ns* NewFileStream_ns (const char* filename, environ_ns* env, const char* access) {
+	stream_ns *stream = NULL;
+
+	if (filename == NULL) {
+		return NULL;
+	}
+	stream = (stream_ns *) calloc (1, sizeof (stream_ns));
+	stream->env = env;
+	stream->filename = strdup (filename);
+	return stream;
+}
+
+stream_ns* NewMemoryStream_ns (const char* name, environ_ns* env, const char* access) {
+	stream_ns *stream = (stream_ns *) calloc (1, sizeof (stream_ns));
+	stream->env = env;
+	stream->loaded = 1;
+	return stream;
+}
+
+void DeleteStream_ns (stream_ns* file) {
+	if (file != NULL) {
+		if (file->out != NULL) {
+			fclose (file->out);
+		}
+		blbn_casetable_free (file->cases);
+		free (file->buffer);
+		free (file->filename);
+		free (file);
+	}
+}
+
+void SetStreamContents_ns (stream_ns* stream, const char* buffer, long length, bool_ns copy) {
+	if (stream == NULL) {
+		return;
+	}
+	free (stream->buffer);
+	stream->buffer = (char *) malloc (length + 1);
+	memcpy (stream->buffer, buffer, length);
+	stream->buffer[length] = '\0';
+	stream->length = length;
+	stream->capacity = length + 1;
+	stream->loaded = 1;
+	blbn_casetable_free (stream->cases);
+	stream->cases = NULL;
+}
+
+/**
+ * Reads the contents of a file stream into its buffer (if not read yet).
+ * Returns 0 on success.
+ */
+int blbn_stream_load (stream_ns *stream) {
+	FILE *fp = NULL;
+	long length;
+
+	if (stream->loaded) {
+		return 0;
+	}
+	if (stream->out != NULL) {
+		fflush (stream->out);
+	}
+
+	fp = fopen (stream->filename, "rb");
+	if (fp == NULL) {
+		blbn_engine_error (stream->env, 1001, ERROR_ERR, "Can't open file '%s'", stream->filename);
+		return -1;
+	}
+	fseek (fp, 0, SEEK_END);
+	length = ftell (fp);
+	fseek (fp, 0, SEEK_SET);
+
+	free (stream->buffer);
+	stream->buffer = (char *) malloc (length + 1);
+	stream->length = fread (stream->buffer, 1, length, fp);
+	stream->buffer[stream->length] = '\0';
+	stream->capacity = length + 1;
+	stream->loaded = 1;
+	fclose (fp);
+
+	return 0;
+}
+
+const char* GetStreamContents_ns (stream_ns* stream, long* length) {
+	if (stream == NULL || blbn_stream_load (stream) != 0) {
+		if (length != NULL) *length = 0;
+		return NULL;
+	}
+	if (length != NULL) {
+		*length = stream->length;
+	}
+	return stream->buffer;
+}
+
+/**
+ * Appends text to a stream.  File streams are appended to on disk (or
+ * truncated first if truncate is set); memory streams grow their buffer.
+ */
+void blbn_stream_write (stream_ns *stream, const char *text, long length, int truncate) {
+	if (stream->filename != NULL) {
+		if (stream->out == NULL || truncate) {
+			if (stream->out != NULL) {
+				fclose (stream->out);
+			}
+			stream->out = fopen (stream->filename, (truncate ? "w" : "a"));
+			if (stream->out == NULL) {
+				blbn_engine_error (stream->env, 1002, ERROR_ERR, "Can't write file '%s'", stream->filename);
+				return;
+			}
+		}
+		fwrite (text, 1, length, stream->out);
+		stream->loaded = 0;
+	} else {
+		if (truncate) {
+			stream->length = 0;
+		}
+		if (stream->length + length + 1 > stream->capacity) {
+			stream->capacity = 2 * (stream->length + length + 1);
+			stream->buffer = (char *) realloc (stream->buffer, stream->capacity);
+		}
+		memcpy (stream->buffer + stream->length, text, length);
+		stream->length += length;
+		stream->buffer[stream->length] = '\0';
+	}
+
+	blbn_casetable_free (stream->cases);
+	stream->cases = NULL;
+}
+
+//------------------------------------------------------------------------------
+// Node lists
+//------------------------------------------------------------------------------
+
+nodelist_bn* NewNodeList2_bn (int length, const net_bn* net) {
+	nodelist_bn *nodes = (nodelist_bn *) calloc (1, sizeof (nodelist_bn));
+
+	nodes->capacity = (length > 4 ? length : 4);
+	nodes->nodes = (node_bn **) calloc (nodes->capacity, sizeof (node_bn *));
+	nodes->length = length;
+	nodes->net = net;
+	return nodes;
+}
+
+nodelist_bn* NewNodeList_bn (int length, environ_ns* env) {
+	return NewNodeList2_bn (length, NULL);
+}
+
+void DeleteNodeList_bn (nodelist_bn* nodes) {
+	if (nodes != NULL) {
+		free (nodes->nodes);
+		free (nodes);
+	}
+}
+
+void ClearNodeList_bn (nodelist_bn* nodes) {
+	if (nodes != NULL) {
+		nodes->length = 0;
+	}
+}
+
+void AddNodeToList_bn (node_bn* node, nodelist_bn* nodes, int index) {
+	if (nodes == NULL) {
+		return;
+	}
+	if (nodes->length == nodes->capacity) {
+		nodes->capacity *= 2;
+		nodes->nodes = (node_bn **) realloc (nodes->nodes, nodes->capacity * sizeof (node_bn *));
+	}
+	if (index == LAST_ENTRY || index < 0 || index >= nodes->length) {
+		nodes->nodes[nodes->length++] = node;
+	} else {
+		memmove (&nodes->nodes[index + 1], &nodes->nodes[index], (nodes->length - index) * sizeof (node_bn *));
+		nodes->nodes[index] = node;
+		nodes->length++;
+	}
+}
+
+node_bn* RemoveNthNode_bn (nodelist_bn* nodes, int index) {
+	node_bn *node = NULL;
+
+	if (nodes == NULL || index < 0 || index >= nodes->length) {
+		return NULL;
+	}
+	node = nodes->nodes[index];
+	memmove (&nodes->nodes[index], &nodes->nodes[index + 1], (nodes->length - index - 1) * sizeof (node_bn *));
+	nodes->length--;
+	return node;
+}
+
+int LengthNodeList_bn (const nodelist_bn* nodes) {
+	return (nodes != NULL ? nodes->length : 0);
+}
+
+node_bn* NthNode_bn (const nodelist_bn* nodes, int index) {
+	if (nodes == NULL || index < 0 || index >= nodes->length) {
+		return NULL;
+	}
+	return nodes->nodes[index];
+}
+
+void SetNthNode_bn (nodelist_bn* nodes, int index, node_bn* node) {
+	if (nodes != NULL && index >= 0 && index < nodes->length) {
+		nodes->nodes[index] = node;
+	}
+}
+
+int IndexOfNodeInList_bn (const node_bn* node, const nodelist_bn* nodes, int start_index) {
+	int i;
+
+	if (nodes == NULL) {
+		return -1;
+	}
+	for (i = (start_index > 0 ? start_index : 0); i < nodes->length; i++) {
+		if (nodes->nodes[i] == node) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+nodelist_bn* DupNodeList_bn (const nodelist_bn* nodes) {
+	nodelist_bn *copy = NULL;
+
+	if (nodes == NULL) {
+		return NULL;
+	}
+	copy = NewNodeList2_bn (nodes->length, nodes->net);
+	memcpy (copy->nodes, nodes->nodes, nodes->length * sizeof (node_bn *));
+	return copy;
+}
+
+//------------------------------------------------------------------------------
+// Nets
+//------------------------------------------------------------------------------
+
+/**
+ * FNV-1a hash of a node name.
+ */
+unsigned int blbn_engine_hash_name (const char *name) {
+	unsigned int hash = 2166136261u;
+
+	while (*name != '\0') {
+		hash ^= (unsigned char) *name++;
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+/**
+ * Rebuilds the net's node name hash table (after nodes were added, removed
+ * or renamed).
+ */
+void blbn_engine_rebuild_names (net_bn *net) {
+	int i;
+	unsigned int slot;
+
+	net->name_table_size = 16;
+	while (net->name_table_size < 2 * net->nodes->length) {
+		net->name_table_size *= 2;
+	}
+	free (net->name_table);
+	net->name_table = (int *) calloc (net->name_table_size, sizeof (int));
+
+	for (i = 0; i < net->nodes->length; i++) {
+		slot = blbn_engine_hash_name (net->nodes->nodes[i]->name) & (net->name_table_size - 1);
+		while (net->name_table[slot] != 0) {
+			slot = (slot + 1) & (net->name_table_size - 1);
+		}
+		net->name_table[slot] = i + 1;
+	}
+}
+
+net_bn* NewNet_bn (const char* name, environ_ns* env) {
+	net_bn *net = (net_bn *) calloc (1, sizeof (net_bn));
+
+	net->env = env;
+	net->name = strdup (name != NULL ? name : "Untitled");
+	net->nodes = NewNodeList2_bn (0, net);
+	net->auto_update = BELIEF_UPDATE;
+	blbn_engine_rebuild_names (net);
+	return net;
+}
+
+/**
+ * Makes the tables of node its own before they are modified, copying them if
+ * they are shared with other nodes.  The node is stamped as changed, so the
+ * junction tree rebuilds the initial potential of its family clique.
+ */
+void blbn_engine_own_tables (node_bn *node) {
+	prob_bn *probs = NULL;
+	double *experience = NULL;
+
+	node->table_stamp = ++blbn_engine_table_stamps;
+	if (node->table_refs == NULL) {
+		return;
+	}
+	if (*node->table_refs == 1) {
+		free (node->table_refs);
+		node->table_refs = NULL;
+		return;
+	}
+
+	(*node->table_refs)--;
+	node->table_refs = NULL;
+	if (node->probs != NULL) {
+		probs = (prob_bn *) malloc (node->config_count * node->state_count * sizeof (prob_bn));
+		memcpy (probs, node->probs, node->config_count * node->state_count * sizeof (prob_bn));
+		node->probs = probs;
+	}
+	if (node->experience != NULL) {
+		experience = (double *) malloc (node->config_count * sizeof (double));
+		memcpy (experience, node->experience, node->config_count * sizeof (double));
+		node->experience = experience;
+	}
+}
+
+/**
+ * Releases the tables of node (freeing them unless other nodes share them).
+ */
+void blbn_engine_release_tables (node_bn *node) {
+	node->table_stamp = ++blbn_engine_table_stamps;
+	if (node->table_refs != NULL && --(*node->table_refs) > 0) {
+		node->table_refs = NULL;
+	} else {
+		free (node->table_refs);
+		node->table_refs = NULL;
+		free (node->probs);
+		free (node->experience);
+	}
+	node->probs = NULL;
+	node->experience = NULL;
+}
+
+/**
+ * Makes copy share the tables of node (copy must have no tables and the
+ * same parents).
+ */
+void blbn_engine_share_tables (const node_bn *node, node_bn *copy) {
+	node_bn *shared = (node_bn *) node; // only the reference count changes
+
+	copy->table_stamp = node->table_stamp;
+	if (node->probs == NULL && node->experience == NULL) {
+		return;
+	}
+	if (shared->table_refs == NULL) {
+		shared->table_refs = (int *) malloc (sizeof (int));
+		*shared->table_refs = 1;
+	}
+	(*shared->table_refs)++;
+	copy->table_refs = shared->table_refs;
+	copy->probs = node->probs;
+	copy->experience = node->experience;
+}
+
+void blbn_engine_free_node (node_bn *node) {
+	int i;
+
+	for (i = 0; i < node->state_count; i++) {
+		free (node->state_names[i]);
+	}
+	free (node->state_names);
+	DeleteNodeList_bn (node->parents);
+	DeleteNodeList_bn (node->children);
+	blbn_engine_release_tables (node);
+	free (node->beliefs);
+	free (node->title);
+	free (node->name);
+	free (node);
+}
+
+void DeleteNet_bn (net_bn* net) {
+	int i;
+
+	if (net == NULL) {
+		return;
+	}
+	for (i = 0; i < net->nodes->length; i++) {
+		blbn_engine_free_node (net->nodes->nodes[i]);
+	}
+	DeleteNodeList_bn (net->nodes);
+	blbn_jt_free (net->jtree);
+	free (net->name_table);
+	free (net->name);
+	free (net);
+}
+
+const char* GetNetName_bn (const net_bn* net) {
+	return (net != NULL ? net->name : NULL);
+}
+
+void SetNetName_bn (net_bn* net, const char* name) {
+	if (net != NULL && name != NULL) {
+		free (net->name);
+		net->name = strdup (name);
+	}
+}
+
+const nodelist_bn* GetNetNodes_bn (const net_bn* net) {
+	return (net != NULL ? net->nodes : NULL);
+}
+
+node_bn* GetNodeNamed_bn (const char* name, const net_bn* net) {
+	unsigned int slot;
+	int entry;
+
+	if (net == NULL || name == NULL) {
+		return NULL;
+	}
+	slot = blbn_engine_hash_name (name) & (net->name_table_size - 1);
+	while ((entry = net->name_table[slot]) != 0) {
+		if (strcmp (net->nodes->nodes[entry - 1]->name, name) == 0) {
+			return net->nodes->nodes[entry - 1];
+		}
+		slot = (slot + 1) & (net->name_table_size - 1);
+	}
+	return NULL;
+}
+
+int SetNetAutoUpdate_bn (net_bn* net, int auto_update) {
+	int previous = 0;
+
+	if (net != NULL) {
+		previous = net->auto_update;
+		net->auto_update = auto_update;
+	}
+	return previous;
+}
+
+int GetNetAutoUpdate_bn (const net_bn* net) {
+	return (net != NULL ? net->auto_update : 0);
+}
+
+/**
+ * Invalidates compiled potentials after a CPT of the net changed.
+ */
+void blbn_engine_table_changed (net_bn *net) {
+	net->table_version++;
+}
+
+/**
+ * Invalidates the junction tree after nodes or links of the net changed.
+ */
+void blbn_engine_structure_changed (net_bn *net) {
+	net->structure_version++;
+	net->table_version++;
+	if (net->jtree != NULL) {
+		blbn_jt_free (net->jtree);
+		net->jtree = NULL;
+	}
+}
+
+//------------------------------------------------------------------------------
+// Nodes
+//------------------------------------------------------------------------------
+
+node_bn* NewNode_bn (const char* name, int num_states, net_bn* net) {
+	node_bn *node = NULL;
+	char state_name[32];
+	int i;
+
+	if (net == NULL || name == NULL || num_states <= 0) {
+		return NULL;
+	}
+	if (GetNodeNamed_bn (name, net) != NULL) {
+		blbn_engine_error (net->env, 1010, ERROR_ERR, "There is already a node named '%s' in net '%s'", name, net->name);
+		return NULL;
+	}
+
+	node = (node_bn *) calloc (1, sizeof (node_bn));
+	node->net = net;
+	node->index = net->nodes->length;
+	node->name = strdup (name);
+	node->state_count = num_states;
+	node->state_names = (char **) malloc (num_states * sizeof (char *));
+	for (i = 0; i < num_states; i++) {
+		sprintf (state_name, "s%d", i);
+		node->state_names[i] = strdup (state_name);
+	}
+	node->parents = NewNodeList2_bn (0, net);
+	node->children = NewNodeList2_bn (0, net);
+	node->config_count = 1;
+	node->finding = NO_FINDING;
+	node->table_stamp = ++blbn_engine_table_stamps;
+	node->beliefs = (prob_bn *) malloc (num_states * sizeof (prob_bn));
+	node->beliefs_version = -1;
+
+	AddNodeToList_bn (node, net->nodes, LAST_ENTRY);
+	blbn_engine_rebuild_names (net);
+	blbn_engine_structure_changed (net);
+
+	return node;
+}
+
+/**
+ * Returns the index of the CPT row (parent configuration) for the specified
+ * parent states (the last parent varies fastest).  Returns -1 if any parent
+ * state is out of range or a wildcard.
+ */
+int blbn_engine_config_index (const node_bn *node, const state_bn *parent_states) {
+	int i;
+	int config = 0;
+	int parent_state_count;
+
+	for (i = 0; i < node->parents->length; i++) {
+		parent_state_count = node->parents->nodes[i]->state_count;
+		if (parent_states == NULL || parent_states[i] < 0 || parent_states[i] >= parent_state_count) {
+			return -1;
+		}
+		config = config * parent_state_count + parent_states[i];
+	}
+	return config;
+}
+
+/**
+ * Returns 1 if the parent configuration config matches parent_states, where
+ * EVERY_STATE matches any state.
+ */
+int blbn_engine_config_matches (const node_bn *node, int config, const state_bn *parent_states) {
+	int i;
+	int parent_state_count;
+
+	for (i = node->parents->length - 1; i >= 0; i--) {
+		parent_state_count = node->parents->nodes[i]->state_count;
+		if (parent_states != NULL && parent_states[i] != EVERY_STATE && parent_states[i] != config % parent_state_count) {
+			return 0;
+		}
+		config /= parent_state_count;
+	}
+	return 1;
+}
+
+void blbn_engine_alloc_probs (node_bn *node) {
+	int i;
+
+	blbn_engine_own_tables (node);
+	if (node->probs == NULL) {
+		node->probs = (prob_bn *) malloc (node->config_count * node->state_count * sizeof (prob_bn));
+		for (i = 0; i < node->config_count * node->state_count; i++) {
+			node->probs[i] = 1.0 / node->state_count;
+		}
+	}
+}
+
+void blbn_engine_alloc_experience (node_bn *node) {
+	int i;
+
+	blbn_engine_own_tables (node);
+	if (node->experience == NULL) {
+		node->experience = (double *) malloc (node->config_count * sizeof (double));
+		for (i = 0; i < node->config_count; i++) {
+			node->experience[i] = 1.0;
+		}
+	}
+}
+
+/**
+ * Adds a link without validating it (used when copying nodes and reading
+ * nets).  The parent is appended after the existing parents, so the node's
+ * tables are expanded by repeating each row for every state of the parent.
+ */
+void blbn_engine_add_link (node_bn *parent, node_bn *child) {
+	int old_config_count = child->config_count;
+	int k = parent->state_count;
+	int config, s;
+	prob_bn *probs = NULL;
+	double *experience = NULL;
+
+	blbn_engine_own_tables (child);
+	AddNodeToList_bn (parent, child->parents, LAST_ENTRY);
+	AddNodeToList_bn (child, parent->children, LAST_ENTRY);
+	child->config_count = old_config_count * k;
+
+	if (child->probs != NULL) {
+		probs = (prob_bn *) malloc (child->config_count * child->state_count * sizeof (prob_bn));
+		for (config = 0; config < child->config_count; config++) {
+			for (s = 0; s < child->state_count; s++) {
+				probs[config * child->state_count + s] = child->probs[(config / k) * child->state_count + s];
+			}
+		}
+		free (child->probs);
+		child->probs = probs;
+	}
+	if (child->experience != NULL) {
+		experience = (double *) malloc (child->config_count * sizeof (double));
+		for (config = 0; config < child->config_count; config++) {
+			experience[config] = child->experience[config / k];
+		}
+		free (child->experience);
+		child->experience = experience;
+	}
+}
+
+/**
+ * Returns 1 if target is an ancestor of (or equal to) node.
+ */
+int blbn_engine_is_ancestor (const node_bn *target, const node_bn *node) {
+	int i;
+
+	if (target == node) {
+		return 1;
+	}
+	for (i = 0; i < node->parents->length; i++) {
+		if (blbn_engine_is_ancestor (target, node->parents->nodes[i])) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+int AddLink_bn (node_bn* parent, node_bn* child) {
+	if (parent == NULL || child == NULL || parent->net != child->net) {
+		return -1;
+	}
+	if (blbn_engine_is_ancestor (child, parent)) {
+		blbn_engine_error (child->net->env, 1011, ERROR_ERR, "Adding link from '%s' to '%s' would create a cycle", parent->name, child->name);
+		return -1;
+	}
+	blbn_engine_add_link (parent, child);
+	blbn_engine_structure_changed (child->net);
+	return child->parents->length - 1;
+}
+
+void DeleteLink_bn (int link_index, node_bn* child) {
+	node_bn *parent = NULL;
+	int old_config_count, k, before, after;
+	int config, s, new_config;
+	prob_bn *probs = NULL;
+	double *experience = NULL;
+
+	if (child == NULL || link_index < 0 || link_index >= child->parents->length) {
+		return;
+	}
+	blbn_engine_own_tables (child);
+	parent = child->parents->nodes[link_index];
+	k = parent->state_count;
+	old_config_count = child->config_count;
+
+	// Number of configurations of the parents after the removed parent
+	after = 1;
+	for (s = link_index + 1; s < child->parents->length; s++) {
+		after *= child->parents->nodes[s]->state_count;
+	}
+	before = old_config_count / (k * after);
+
+	// Keep the rows where the removed parent is in its first state
+	child->config_count = before * after;
+	if (child->probs != NULL) {
+		probs = (prob_bn *) malloc (child->config_count * child->state_count * sizeof (prob_bn));
+	}
+	if (child->experience != NULL) {
+		experience = (double *) malloc (child->config_count * sizeof (double));
+	}
+	for (new_config = 0; new_config < child->config_count; new_config++) {
+		config = (new_config / after) * k * after + (new_config % after);
+		if (probs != NULL) {
+			for (s = 0; s < child->state_count; s++) {
+				probs[new_config * child->state_count + s] = child->probs[config * child->state_count + s];
+			}
+		}
+		if (experience != NULL) {
+			experience[new_config] = child->experience[config];
+		}
+	}
+	if (probs != NULL) {
+		free (child->probs);
+		child->probs = probs;
+	}
+	if (experience != NULL) {
+		free (child->experience);
+		child->experience = experience;
+	}
+
+	RemoveNthNode_bn (child->parents, link_index);
+	RemoveNthNode_bn (parent->children, IndexOfNodeInList_bn (child, parent->children, 0));
+	blbn_engine_structure_changed (child->net);
+}
+
+/**
+ * Creates a node in net with the same name, states and title as node (no
+ * links or tables).
+ */
+node_bn* blbn_engine_copy_node_shell (const node_bn *node, net_bn *net) {
+	node_bn *copy = NULL;
+	int i;
+
+	copy = NewNode_bn (node->name, node->state_count, net);
+	if (copy == NULL) {
+		return NULL;
+	}
+	for (i = 0; i < node->state_count; i++) {
+		free (copy->state_names[i]);
+		copy->state_names[i] = strdup (node->state_names[i]);
+	}
+	if (node->title != NULL) {
+		copy->title = strdup (node->title);
+	}
+	return copy;
+}
+
+nodelist_bn* CopyNodes_bn (const nodelist_bn* nodes, net_bn* new_net, const char* control) {
+	nodelist_bn *copies = NULL;
+	node_bn *node = NULL;
+	node_bn *copy = NULL;
+	node_bn *parent = NULL;
+	int i, j, complete;
+
+	if (nodes == NULL || new_net == NULL) {
+		return NULL;
+	}
+	copies = NewNodeList2_bn (0, new_net);
+
+	for (i = 0; i < nodes->length; i++) {
+		AddNodeToList_bn (blbn_engine_copy_node_shell (nodes->nodes[i], new_net), copies, LAST_ENTRY);
+	}
+
+	// Links to parents with the same name in the new net; tables are only
+	// copied if every parent could be linked
+	for (i = 0; i < nodes->length; i++) {
+		node = nodes->nodes[i];
+		copy = copies->nodes[i];
+		if (copy == NULL) {
+			continue;
+		}
+		complete = 1;
+		for (j = 0; j < node->parents->length; j++) {
+			parent = GetNodeNamed_bn (node->parents->nodes[j]->name, new_net);
+			if (parent != NULL) {
+				blbn_engine_add_link (parent, copy);
+			} else {
+				complete = 0;
+			}
+		}
+		if (complete) {
+			blbn_engine_share_tables (node, copy);
+		}
+	}
+	blbn_engine_structure_changed (new_net);
+
+	return copies;
+}
+
+net_bn* CopyNet_bn (const net_bn* net, const char* new_name, environ_ns* new_env, const char* control) {
+	net_bn *copy = NULL;
+	node_bn *node = NULL;
+	node_bn *node_copy = NULL;
+	int i, j;
+
+	if (net == NULL) {
+		return NULL;
+	}
+	copy = NewNet_bn (new_name != NULL ? new_name : net->name, (new_env != NULL ? new_env : net->env));
+	copy->auto_update = net->auto_update;
+
+	for (i = 0; i < net->nodes->length; i++) {
+		blbn_engine_copy_node_shell (net->nodes->nodes[i], copy);
+	}
+	for (i = 0; i < net->nodes->length; i++) {
+		node = net->nodes->nodes[i];
+		node_copy = copy->nodes->nodes[i];
+		for (j = 0; j < node->parents->length; j++) {
+			blbn_engine_add_link (copy->nodes->nodes[node->parents->nodes[j]->index], node_copy);
+		}
+		blbn_engine_share_tables (node, node_copy);
+	}
+	blbn_engine_structure_changed (copy);
+	if (net->jtree != NULL) {
+		copy->jtree = blbn_jt_share (net->jtree);
+	}
+
+	return copy;
+}
+
+net_bn* GetNodeNet_bn (const node_bn* node) {
+	return (node != NULL ? node->net : NULL);
+}
+
+const char* GetNodeName_bn (const node_bn* node) {
+	return (node != NULL ? node->name : NULL);
+}
+
+const char* GetNodeTitle_bn (const node_bn* node) {
+	return (node != NULL && node->title != NULL ? node->title : "");
+}
+
+nodetype_bn GetNodeType_bn (const node_bn* node) {
+	return DISCRETE_TYPE;
+}
+
+nodekind_bn GetNodeKind_bn (const node_bn* node) {
+	return NATURE_NODE;
+}
+
+int GetNodeNumberStates_bn (const node_bn* node) {
+	return (node != NULL ? node->state_count : 0);
+}
+
+const level_bn* GetNodeLevels_bn (const node_bn* node) {
+	return NULL;
+}
+
+const char* GetNodeStateName_bn (const node_bn* node, state_bn state) {
+	if (node == NULL || state < 0 || state >= node->state_count) {
+		return NULL;
+	}
+	return node->state_names[state];
+}
+
+void SetNodeStateName_bn (node_bn* node, state_bn state, const char* state_name) {
+	if (node != NULL && state >= 0 && state < node->state_count && state_name != NULL) {
+		free (node->state_names[state]);
+		node->state_names[state] = strdup (state_name);
+	}
+}
+
+void SetNodeStateNames_bn (node_bn* node, const char* state_names) {
+	char *names = NULL;
+	char *name = NULL;
+	int state = 0;
+
+	if (node == NULL || state_names == NULL) {
+		return;
+	}
+	names = strdup (state_names);
+	for (name = strtok (names, ", \t"); name != NULL && state < node->state_count; name = strtok (NULL, ", \t")) {
+		SetNodeStateName_bn (node, state++, name);
+	}
+	free (names);
+}
+
+state_bn GetStateNamed_bn (const char* name, const node_bn* node) {
+	int i;
+
+	if (node == NULL || name == NULL) {
+		return UNDEF_STATE;
+	}
+	for (i = 0; i < node->state_count; i++) {
+		if (strcmp (node->state_names[i], name) == 0) {
+			return i;
+		}
+	}
+	return UNDEF_STATE;
+}
+
+const nodelist_bn* GetNodeParents_bn (const node_bn* node) {
+	return (node != NULL ? node->parents : NULL);
+}
+
+const nodelist_bn* GetNodeChildren_bn (const node_bn* node) {
+	return (node != NULL ? node->children : NULL);
+}
+
+const prob_bn* GetNodeProbs_bn (const node_bn* node, const state_bn* parent_states) {
+	int config;
+
+	if (node == NULL || node->probs == NULL) {
+		return NULL;
+	}
+	config = blbn_engine_config_index (node, parent_states);
+	if (config < 0) {
+		return NULL;
+	}
+	return &node->probs[config * node->state_count];
+}
+
+void SetNodeProbs_bn (node_bn* node, const state_bn* parent_states, const prob_bn* probs) {
+	int config;
+
+	if (node == NULL || probs == NULL) {
+		return;
+	}
+	blbn_engine_alloc_probs (node);
+	for (config = 0; config < node->config_count; config++) {
+		if (blbn_engine_config_matches (node, config, parent_states)) {
+			memcpy (&node->probs[config * node->state_count], probs, node->state_count * sizeof (prob_bn));
+		}
+	}
+	blbn_engine_table_changed (node->net);
+}
+
+double GetNodeExperience_bn (const node_bn* node, const state_bn* parent_states) {
+	int config;
+
+	if (node == NULL || node->experience == NULL) {
+		return UNDEF_DBL;
+	}
+	config = blbn_engine_config_index (node, parent_states);
+	if (config < 0) {
+		return UNDEF_DBL;
+	}
+	return node->experience[config];
+}
+
+void SetNodeExperience_bn (node_bn* node, const state_bn* parent_states, double experience) {
+	int config;
+
+	if (node == NULL) {
+		return;
+	}
+	blbn_engine_alloc_experience (node);
+	for (config = 0; config < node->config_count; config++) {
+		if (blbn_engine_config_matches (node, config, parent_states)) {
+			node->experience[config] = experience;
+		}
+	}
+}
+
+void DeleteNodeTables_bn (node_bn* node) {
+	if (node != NULL) {
+		blbn_engine_release_tables (node);
+		blbn_engine_table_changed (node->net);
+	}
+}
+
+bool_ns HasNodeTable_bn (const node_bn* node, bool_ns* complete) {
+	if (complete != NULL) {
+		*complete = (node != NULL && node->probs != NULL);
+	}
+	return (node != NULL && node->probs != NULL);
+}
+
+void SetNodeFuncState_bn (node_bn* node, const state_bn* parent_states, state_bn st) {
+	prob_bn *probs = NULL;
+	int s;
+
+	if (node == NULL || st < 0 || st >= node->state_count) {
+		return;
+	}
+	probs = (prob_bn *) malloc (node->state_count * sizeof (prob_bn));
+	for (s = 0; s < node->state_count; s++) {
+		probs[s] = (s == st ? 1.0 : 0.0);
+	}
+	SetNodeProbs_bn (node, parent_states, probs);
+	free (probs);
+}
+
+void SetNodeFuncReal_bn (node_bn* node, const state_bn* parent_states, double val) {
+	blbn_engine_error (node != NULL ? node->net->env : NULL, 1012, ERROR_ERR, "Continuous nodes are not supported");
+}
+
+void GetNodeVisPosition_bn (const node_bn* node, void* vis, double* x, double* y) {
+	if (x != NULL) *x = 0.0;
+	if (y != NULL) *y = 0.0;
+}
+
+//------------------------------------------------------------------------------
+// Findings
+//------------------------------------------------------------------------------
+
+void EnterFinding_bn (node_bn* node, state_bn state) {
+	if (node == NULL) {
+		return;
+	}
+	if (state < 0 || state >= node->state_count) {
+		blbn_engine_error (node->net->env, 1020, ERROR_ERR, "Illegal state %d for node '%s'", state, node->name);
+		return;
+	}
+	if (node->finding != state) {
+		node->finding = state;
+		node->net->findings_version++;
+	}
+}
+
+state_bn GetNodeFinding_bn (const node_bn* node) {
+	return (node != NULL ? node->finding : NO_FINDING);
+}
+
+void RetractNodeFindings_bn (node_bn* node) {
+	if (node != NULL && node->finding != NO_FINDING) {
+		node->finding = NO_FINDING;
+		node->net->findings_version++;
+	}
+}
+
+void RetractNetFindings_bn (net_bn* net) {
+	int i;
+
+	if (net == NULL) {
+		return;
+	}
+	for (i = 0; i < net->nodes->length; i++) {
+		RetractNodeFindings_bn (net->nodes->nodes[i]);
+	}
+}
+
+//------------------------------------------------------------------------------
+// Node relations
+//------------------------------------------------------------------------------
+
+/**
+ * Marks the ancestors (including the node itself) of node.
+ */
+void blbn_engine_mark_ancestors (const node_bn *node, char *marked) {
+	int i;
+
+	if (marked[node->index]) {
+		return;
+	}
+	marked[node->index] = 1;
+	for (i = 0; i < node->parents->length; i++) {
+		blbn_engine_mark_ancestors (node->parents->nodes[i], marked);
+	}
+}
+
+void blbn_engine_mark_descendants (const node_bn *node, char *marked) {
+	int i;
+
+	if (marked[node->index]) {
+		return;
+	}
+	marked[node->index] = 1;
+	for (i = 0; i < node->children->length; i++) {
+		blbn_engine_mark_descendants (node->children->nodes[i], marked);
+	}
+}
+
+/**
+ * Marks every node that is d-connected to node given the findings presently
+ * entered in the net (the "Bayes ball" reachability algorithm).  The node
+ * itself is included; nodes with findings are not marked.
+ */
+void blbn_engine_mark_d_connected (const node_bn *node, char *marked) {
+	const net_bn *net = node->net;
+	int n = net->nodes->length;
+	char *evidence_ancestor = (char *) calloc (n, 1);
+	char *visited_up = (char *) calloc (n, 1); // visited coming from a child
+	char *visited_down = (char *) calloc (n, 1); // visited coming from a parent
+	int *stack = NULL;
+	int top = 0;
+	int i, index, up, link_count = 0;
+	const node_bn *current = NULL;
+
+	// Each (node, direction) is expanded at most once and pushes at most one
+	// entry per link of the node
+	for (i = 0; i < n; i++) {
+		link_count += net->nodes->nodes[i]->parents->length;
+	}
+	stack = (int *) malloc ((4 * link_count + 1) * sizeof (int));
+
+	for (i = 0; i < n; i++) {
+		if (net->nodes->nodes[i]->finding >= 0) {
+			blbn_engine_mark_ancestors (net->nodes->nodes[i], evidence_ancestor);
+		}
+	}
+
+	stack[top++] = 2 * node->index + 1; // start by going up from node
+	while (top > 0) {
+		top--;
+		index = stack[top] / 2;
+		up = stack[top] % 2;
+		current = net->nodes->nodes[index];
+
+		if (up ? visited_up[index] : visited_down[index]) {
+			continue;
+		}
+		if (up) {
+			visited_up[index] = 1;
+		} else {
+			visited_down[index] = 1;
+		}
+
+		if (current->finding < 0) {
+			marked[index] = 1;
+		}
+
+		if (up && current->finding < 0) {
+			// Trail arrived from a child: continue to parents and children
+			for (i = 0; i < current->parents->length; i++) {
+				stack[top++] = 2 * current->parents->nodes[i]->index + 1;
+			}
+			for (i = 0; i < current->children->length; i++) {
+				stack[top++] = 2 * current->children->nodes[i]->index;
+			}
+		} else if (!up) {
+			// Trail arrived from a parent
+			if (current->finding < 0) {
+				for (i = 0; i < current->children->length; i++) {
+					stack[top++] = 2 * current->children->nodes[i]->index;
+				}
+			}
+			if (evidence_ancestor[index]) {
+				// Active v-structure: continue to the other parents
+				for (i = 0; i < current->parents->length; i++) {
+					stack[top++] = 2 * current->parents->nodes[i]->index + 1;
+				}
+			}
+		}
+	}
+
+	free (stack);
+	free (visited_down);
+	free (visited_up);
+	free (evidence_ancestor);
+}
+
+/**
+ * Marks the nodes related to node by the single relation name (e.g.,
+ * "parents" or "markov_blanket").  Returns 0 if the relation is unknown.
+ */
+int blbn_engine_mark_relation (const node_bn *node, const char *relation, int length, char *marked) {
+	int i, j;
+	const node_bn *child = NULL;
+
+	if (strncmp (relation, "parent", (length < 6 ? 6 : length)) == 0 || strncmp (relation, "parents", length) == 0) {
+		for (i = 0; i < node->parents->length; i++) {
+			marked[node->parents->nodes[i]->index] = 1;
+		}
+	} else if (strncmp (relation, "child", (length < 5 ? 5 : length)) == 0 || strncmp (relation, "children", length) == 0) {
+		for (i = 0; i < node->children->length; i++) {
+			marked[node->children->nodes[i]->index] = 1;
+		}
+	} else if (strncmp (relation, "ancestors", length) == 0) {
+		blbn_engine_mark_ancestors (node, marked);
+		marked[node->index] = 0;
+		for (i = 0; i < node->parents->length; i++) {
+			blbn_engine_mark_ancestors (node->parents->nodes[i], marked);
+		}
+	} else if (strncmp (relation, "descendents", length) == 0 || strncmp (relation, "descendants", length) == 0) {
+		for (i = 0; i < node->children->length; i++) {
+			blbn_engine_mark_descendants (node->children->nodes[i], marked);
+		}
+	} else if (strncmp (relation, "markov_blanket", length) == 0) {
+		for (i = 0; i < node->parents->length; i++) {
+			marked[node->parents->nodes[i]->index] = 1;
+		}
+		for (i = 0; i < node->children->length; i++) {
+			child = node->children->nodes[i];
+			marked[child->index] = 1;
+			for (j = 0; j < child->parents->length; j++) {
+				if (child->parents->nodes[j] != node) {
+					marked[child->parents->nodes[j]->index] = 1;
+				}
+			}
+		}
+	} else if (strncmp (relation, "d_connected", length) == 0) {
+		blbn_engine_mark_d_connected (node, marked);
+	} else if (strncmp (relation, "connected", length) == 0) {
+		char *up = (char *) calloc (node->net->nodes->length, 1);
+		int changed = 1;
+		marked[node->index] = 1;
+		while (changed) {
+			changed = 0;
+			for (i = 0; i < node->net->nodes->length; i++) {
+				if (marked[i] && !up[i]) {
+					const node_bn *current = node->net->nodes->nodes[i];
+					up[i] = 1;
+					changed = 1;
+					for (j = 0; j < current->parents->length; j++) marked[current->parents->nodes[j]->index] = 1;
+					for (j = 0; j < current->children->length; j++) marked[current->children->nodes[j]->index] = 1;
+				}
+			}
+		}
+		free (up);
+	} else {
+		return 0;
+	}
+	return 1;
+}
+
+/**
+ * Computes the nodes related to node by a Netica relation string, e.g.,
+ * "d_connected,subtract" or "markov_blanket, include_evidence_nodes".
+ * Returns the marked node set and the list operation (0 = replace, 'a' =
+ * append, 'u' = union, 'i' = intersection, 's' = subtract).
+ */
+char* blbn_engine_related (const node_bn *node, const char *relation, int *operation) {
+	int n = node->net->nodes->length;
+	char *marked = (char *) calloc (n, 1);
+	int include_evidence = 0, exclude_self = 0, include_self = 0;
+	int evidence_relation = 0;
+	const char *token = relation;
+	int length, i;
+
+	*operation = 0;
+	while (*token != '\0') {
+		while (*token == ',' || *token == ' ') token++;
+		for (length = 0; token[length] != '\0' && token[length] != ',' && token[length] != ' '; length++);
+		if (length == 0) break;
+
+		if (strncmp (token, "include_evidence_nodes", length) == 0) include_evidence = 1;
+		else if (strncmp (token, "exclude_self", length) == 0) exclude_self = 1;
+		else if (strncmp (token, "include_self", length) == 0) include_self = 1;
+		else if (strncmp (token, "append", length) == 0) *operation = 'a';
+		else if (strncmp (token, "union", length) == 0) *operation = 'u';
+		else if (strncmp (token, "intersection", length) == 0) *operation = 'i';
+		else if (strncmp (token, "subtract", length) == 0) *operation = 's';
+		else if (blbn_engine_mark_relation (node, token, length, marked)) {
+			if (strncmp (token, "markov_blanket", length) == 0 || strncmp (token, "d_connected", length) == 0) {
+				evidence_relation = 1;
+			}
+		} else {
+			blbn_engine_error (node->net->env, 1030, ERROR_ERR, "Unknown relation '%s'", relation);
+		}
+		token += length;
+	}
+
+	if (evidence_relation && !include_evidence) {
+		for (i = 0; i < n; i++) {
+			if (node->net->nodes->nodes[i]->finding >= 0) marked[i] = 0;
+		}
+	}
+	if (exclude_self) marked[node->index] = 0;
+	if (include_self) marked[node->index] = 1;
+
+	return marked;
+}
+
+void GetRelatedNodes_bn (nodelist_bn* related_nodes, const char* relation, const node_bn* node) {
+	char *marked = NULL;
+	char *in_list = NULL;
+	int operation;
+	int i, n;
+
+	if (related_nodes == NULL || relation == NULL || node == NULL) {
+		return;
+	}
+	n = node->net->nodes->length;
+	marked = blbn_engine_related (node, relation, &operation);
+
+	if (operation == 's' || operation == 'i') {
+		// Keep (or drop) list entries that are related
+		int kept = 0;
+		for (i = 0; i < related_nodes->length; i++) {
+			node_bn *entry = related_nodes->nodes[i];
+			int related = (entry != NULL && entry->net == node->net && marked[entry->index]);
+			if ((operation == 's' && !related) || (operation == 'i' && related)) {
+				related_nodes->nodes[kept++] = entry;
+			}
+		}
+		related_nodes->length = kept;
+	} else {
+		if (operation == 0) {
+			related_nodes->length = 0;
+		}
+		in_list = (char *) calloc (n, 1);
+		if (operation == 'u') {
+			for (i = 0; i < related_nodes->length; i++) {
+				if (related_nodes->nodes[i] != NULL && related_nodes->nodes[i]->net == node->net) {
+					in_list[related_nodes->nodes[i]->index] = 1;
+				}
+			}
+		}
+		for (i = 0; i < n; i++) {
+			if (marked[i] && !in_list[i]) {
+				AddNodeToList_bn (node->net->nodes->nodes[i], related_nodes, LAST_ENTRY);
+			}
+		}
+		free (in_list);
+	}
+
+	free (marked);
+}
+
+bool_ns IsNodeRelated_bn (const node_bn* related_node, const char* relation, const node_bn* node) {
+	char *marked = NULL;
+	int operation;
+	bool_ns related;
+
+	if (related_node == NULL || node == NULL || relation == NULL || related_node->net != node->net) {
+		return FALSE;
+	}
+	marked = blbn_engine_related (node, relation, &operation);
+	related = marked[related_node->index];
+	free (marked);
+	return related;
+}
+
+//------------------------------------------------------------------------------
+// DNE files
+//------------------------------------------------------------------------------
+
+#define BLBN_DNE_TOKEN_END    0
+#define BLBN_DNE_TOKEN_WORD   1 // identifier or number
+#define BLBN_DNE_TOKEN_STRING 2
+#define BLBN_DNE_TOKEN_PUNCT  3
+
+typedef struct blbn_dne_parser {
+	const char *text;
+	long pos;
+	long length;
+	int type;
+	char *token;
+	int token_capacity;
+} blbn_dne_parser_t;
+
+// Raw definition of a node read from a DNE file
+typedef struct blbn_dne_node {
+	char *name;
+	char *title;
+	int state_count;
+	char **states;
+	int parent_count;
+	char **parents;
+	int prob_count;
+	double *probs;
+	int experience_count;
+	double *experience;
+	int func_count;
+	char **func;
+} blbn_dne_node_t;
+
+void blbn_dne_token_append (blbn_dne_parser_t *parser, int *length, char c) {
+	if (*length + 2 > parser->token_capacity) {
+		parser->token_capacity = 2 * (*length + 2);
+		parser->token = (char *) realloc (parser->token, parser->token_capacity);
+	}
+	parser->token[(*length)++] = c;
+	parser->token[*length] = '\0';
+}
+
+/**
+ * Reads the next token of a DNE file, skipping white space and comments.
+ */
+int blbn_dne_next (blbn_dne_parser_t *parser) {
+	const char *text = parser->text;
+	int length = 0;
+	char c;
+
+	blbn_dne_token_append (parser, &length, '\0');
+	length = 0;
+	parser->token[0] = '\0';
+
+	while (parser->pos < parser->length) {
+		c = text[parser->pos];
+		if (isspace ((unsigned char) c)) {
+			parser->pos++;
+		} else if (c == '/' && parser->pos + 1 < parser->length && text[parser->pos + 1] == '/') {
+			while (parser->pos < parser->length && text[parser->pos] != '\n') parser->pos++;
+		} else if (c == '/' && parser->pos + 1 < parser->length && text[parser->pos + 1] == '*') {
+			parser->pos += 2;
+			while (parser->pos + 1 < parser->length && !(text[parser->pos] == '*' && text[parser->pos + 1] == '/')) parser->pos++;
+			parser->pos += 2;
+		} else {
+			break;
+		}
+	}
+	if (parser->pos >= parser->length) {
+		return (parser->type = BLBN_DNE_TOKEN_END);
+	}
+
+	c = text[parser->pos];
+	if (strchr ("{}(),;=", c) != NULL) {
+		blbn_dne_token_append (parser, &length, c);
+		parser->pos++;
+		return (parser->type = BLBN_DNE_TOKEN_PUNCT);
+	}
+	if (c == '"') {
+		parser->pos++;
+		while (parser->pos < parser->length && text[parser->pos] != '"') {
+			if (text[parser->pos] == '\\' && parser->pos + 1 < parser->length) {
+				parser->pos++;
+			}
+			blbn_dne_token_append (parser, &length, text[parser->pos++]);
+		}
+		parser->pos++;
+		return (parser->type = BLBN_DNE_TOKEN_STRING);
+	}
+	while (parser->pos < parser->length) {
+		c = text[parser->pos];
+		if (isspace ((unsigned char) c) || strchr ("{}(),;=\"", c) != NULL) {
+			break;
+		}
+		blbn_dne_token_append (parser, &length, c);
+		parser->pos++;
+	}
+	return (parser->type = BLBN_DNE_TOKEN_WORD);
+}
+
+int blbn_dne_is (blbn_dne_parser_t *parser, const char *punct) {
+	return (parser->type == BLBN_DNE_TOKEN_PUNCT && strcmp (parser->token, punct) == 0);
+}
+
+/**
+ * Reads the value of an assignment (up to and including the terminating ';')
+ * and returns its atoms flattened, e.g., "((0.1, 0.9), (0.5, 0.5))" gives
+ * the four numbers in order.
+ */
+char** blbn_dne_read_value (blbn_dne_parser_t *parser, int *count) {
+	char **atoms = NULL;
+	int capacity = 0;
+	int depth = 0;
+
+	*count = 0;
+	while (blbn_dne_next (parser) != BLBN_DNE_TOKEN_END) {
+		if (blbn_dne_is (parser, "(")) {
+			depth++;
+		} else if (blbn_dne_is (parser, ")")) {
+			depth--;
+		} else if (blbn_dne_is (parser, ";") && depth <= 0) {
+			break;
+		} else if (parser->type == BLBN_DNE_TOKEN_WORD || parser->type == BLBN_DNE_TOKEN_STRING) {
+			if (*count == capacity) {
+				capacity = (capacity == 0 ? 16 : 2 * capacity);
+				atoms = (char **) realloc (atoms, capacity * sizeof (char *));
+			}
+			atoms[(*count)++] = strdup (parser->token);
+		}
+	}
+	return atoms;
+}
+
+void blbn_dne_free_atoms (char **atoms, int count) {
+	int i;
+
+	if (atoms == NULL) {
+		return;
+	}
+	for (i = 0; i < count; i++) {
+		free (atoms[i]);
+	}
+	free (atoms);
+}
+
+/**
+ * Skips the remainder of a block whose '{' has just been read.
+ */
+void blbn_dne_skip_block (blbn_dne_parser_t *parser) {
+	int depth = 1;
+
+	while (depth > 0 && blbn_dne_next (parser) != BLBN_DNE_TOKEN_END) {
+		if (blbn_dne_is (parser, "{")) depth++;
+		else if (blbn_dne_is (parser, "}")) depth--;
+	}
+	blbn_dne_next (parser);
+	if (!blbn_dne_is (parser, ";")) {
+		parser->pos -= strlen (parser->token); // not a terminator; push back
+	}
+}
+
+/**
+ * Reads the body of a node block (after '{') into def.
+ */
+void blbn_dne_read_node (blbn_dne_parser_t *parser, blbn_dne_node_t *def) {
+	char field[64];
+	char **atoms = NULL;
+	int count, i;
+
+	while (blbn_dne_next (parser) != BLBN_DNE_TOKEN_END) {
+		if (blbn_dne_is (parser, "}")) {
+			blbn_dne_next (parser);
+			if (!blbn_dne_is (parser, ";")) {
+				parser->pos -= strlen (parser->token);
+			}
+			return;
+		}
+		if (parser->type != BLBN_DNE_TOKEN_WORD) {
+			continue;
+		}
+		strncpy (field, parser->token, sizeof (field) - 1);
+		field[sizeof (field) - 1] = '\0';
+
+		blbn_dne_next (parser);
+		if (blbn_dne_is (parser, "{")) {
+			blbn_dne_skip_block (parser);
+			continue;
+		}
+		if (parser->type == BLBN_DNE_TOKEN_WORD) {
+			// Named sub-block (e.g., "visual V1 { ... }")
+			blbn_dne_next (parser);
+			if (blbn_dne_is (parser, "{")) {
+				blbn_dne_skip_block (parser);
+			}
+			continue;
+		}
+		if (!blbn_dne_is (parser, "=")) {
+			continue;
+		}
+
+		atoms = blbn_dne_read_value (parser, &count);
+		if (strcmp (field, "states") == 0) {
+			def->state_count = count;
+			def->states = atoms;
+			atoms = NULL;
+		} else if (strcmp (field, "parents") == 0) {
+			def->parent_count = count;
+			def->parents = atoms;
+			atoms = NULL;
+		} else if (strcmp (field, "probs") == 0) {
+			def->prob_count = count;
+			def->probs = (double *) malloc ((count > 0 ? count : 1) * sizeof (double));
+			for (i = 0; i < count; i++) {
+				def->probs[i] = atof (atoms[i]);
+			}
+		} else if (strcmp (field, "numcases") == 0 || strcmp (field, "experience") == 0) {
+			def->experience_count = count;
+			def->experience = (double *) malloc ((count > 0 ? count : 1) * sizeof (double));
+			for (i = 0; i < count; i++) {
+				def->experience[i] = atof (atoms[i]);
+			}
+		} else if (strcmp (field, "functable") == 0) {
+			def->func_count = count;
+			def->func = atoms;
+			atoms = NULL;
+		} else if (strcmp (field, "title") == 0 && count > 0) {
+			def->title = strdup (atoms[0]);
+		}
+		blbn_dne_free_atoms (atoms, count);
+	}
+}
+
+void blbn_dne_free_node (blbn_dne_node_t *def) {
+	blbn_dne_free_atoms (def->states, def->state_count);
+	blbn_dne_free_atoms (def->parents, def->parent_count);
+	blbn_dne_free_atoms (def->func, def->func_count);
+	free (def->probs);
+	free (def->experience);
+	free (def->title);
+	free (def->name);
+}
+
+/**
+ * Builds a net from the node definitions of a DNE file (links are added once
+ * every node exists, since parents may be defined after their children).
+ */
+net_bn* blbn_dne_build_net (environ_ns *env, const char *net_name, blbn_dne_node_t *defs, int def_count) {
+	net_bn *net = NULL;
+	node_bn *node = NULL;
+	node_bn *parent = NULL;
+	int i, j, k, s;
+
+	net = NewNet_bn (net_name, env);
+
+	for (i = 0; i < def_count; i++) {
+		if (defs[i].state_count <= 0) {
+			blbn_engine_error (env, 1040, ERROR_ERR, "Node '%s' has no states (only discrete nodes are supported)", defs[i].name);
+			DeleteNet_bn (net);
+			return NULL;
+		}
+		node = NewNode_bn (defs[i].name, defs[i].state_count, net);
+		if (node == NULL) {
+			DeleteNet_bn (net);
+			return NULL;
+		}
+		for (s = 0; s < defs[i].state_count; s++) {
+			SetNodeStateName_bn (node, s, defs[i].states[s]);
+		}
+		if (defs[i].title != NULL) {
+			node->title = strdup (defs[i].title);
+		}
+	}
+
+	for (i = 0; i < def_count; i++) {
+		node = net->nodes->nodes[i];
+		for (j = 0; j < defs[i].parent_count; j++) {
+			parent = GetNodeNamed_bn (defs[i].parents[j], net);
+			if (parent == NULL) {
+				blbn_engine_error (env, 1041, ERROR_ERR, "Parent '%s' of node '%s' is not defined", defs[i].parents[j], node->name);
+				DeleteNet_bn (net);
+				return NULL;
+			}
+			blbn_engine_add_link (parent, node);
+		}
+	}
+
+	for (i = 0; i < def_count; i++) {
+		node = net->nodes->nodes[i];
+		if (defs[i].prob_count == node->config_count * node->state_count) {
+			blbn_engine_alloc_probs (node);
+			for (k = 0; k < defs[i].prob_count; k++) {
+				node->probs[k] = defs[i].probs[k];
+			}
+		} else if (defs[i].func_count == node->config_count) {
+			// Deterministic node: one state per parent configuration
+			blbn_engine_alloc_probs (node);
+			for (k = 0; k < node->config_count; k++) {
+				s = GetStateNamed_bn (defs[i].func[k], node);
+				if (s < 0) {
+					s = atoi (defs[i].func[k]);
+				}
+				for (j = 0; j < node->state_count; j++) {
+					node->probs[k * node->state_count + j] = (j == s ? 1.0 : 0.0);
+				}
+			}
+		} else if (defs[i].prob_count > 0) {
+			blbn_engine_error (env, 1042, WARNING_ERR, "CPT of node '%s' has %d entries instead of %d; ignored", node->name, defs[i].prob_count, node->config_count * node->state_count);
+		}
+
+		if (defs[i].experience_count == 1) {
+			blbn_engine_alloc_experience (node);
+			for (k = 0; k < node->config_count; k++) {
+				node->experience[k] = defs[i].experience[0];
+			}
+		} else if (defs[i].experience_count == node->config_count) {
+			blbn_engine_alloc_experience (node);
+			memcpy (node->experience, defs[i].experience, node->config_count * sizeof (double));
+		}
+	}
+
+	blbn_engine_structure_changed (net);
+	return net;
+}
+
+net_bn* ReadNet_bn (stream_ns* file, int visual) {
+	blbn_dne_parser_t parser;
+	blbn_dne_node_t *defs = NULL;
+	int def_count = 0, def_capacity = 0;
+	char *net_name = NULL;
+	char keyword[64];
+	net_bn *net = NULL;
+	int i;
+
+	if (file == NULL || blbn_stream_load (file) != 0) {
+		return NULL;
+	}
+
+	memset (&parser, 0, sizeof (parser));
+	parser.text = file->buffer;
+	parser.length = file->length;
+
+	// Find the net block ("bnet <name> {")
+	while (blbn_dne_next (&parser) != BLBN_DNE_TOKEN_END) {
+		if (parser.type == BLBN_DNE_TOKEN_WORD && (strcmp (parser.token, "bnet") == 0 || strcmp (parser.token, "net") == 0)) {
+			blbn_dne_next (&parser);
+			net_name = strdup (parser.token);
+			blbn_dne_next (&parser);
+			break;
+		}
+	}
+	if (net_name == NULL || !blbn_dne_is (&parser, "{")) {
+		blbn_engine_error (file->env, 1043, ERROR_ERR, "File '%s' is not a DNE file", (file->filename != NULL ? file->filename : "(memory)"));
+		free (net_name);
+		free (parser.token);
+		return NULL;
+	}
+
+	while (blbn_dne_next (&parser) != BLBN_DNE_TOKEN_END) {
+		if (blbn_dne_is (&parser, "}")) {
+			break;
+		}
+		if (parser.type != BLBN_DNE_TOKEN_WORD) {
+			continue;
+		}
+		strncpy (keyword, parser.token, sizeof (keyword) - 1);
+		keyword[sizeof (keyword) - 1] = '\0';
+
+		blbn_dne_next (&parser);
+		if (blbn_dne_is (&parser, "=")) {
+			char **atoms = blbn_dne_read_value (&parser, &i);
+			blbn_dne_free_atoms (atoms, i);
+		} else if (blbn_dne_is (&parser, "{")) {
+			blbn_dne_skip_block (&parser);
+		} else if (parser.type == BLBN_DNE_TOKEN_WORD) {
+			char *name = strdup (parser.token);
+			blbn_dne_next (&parser);
+			if (blbn_dne_is (&parser, "{")) {
+				if (strcmp (keyword, "node") == 0) {
+					if (def_count == def_capacity) {
+						def_capacity = (def_capacity == 0 ? 16 : 2 * def_capacity);
+						defs = (blbn_dne_node_t *) realloc (defs, def_capacity * sizeof (blbn_dne_node_t));
+					}
+					memset (&defs[def_count], 0, sizeof (blbn_dne_node_t));
+					defs[def_count].name = name;
+					name = NULL;
+					blbn_dne_read_node (&parser, &defs[def_count]);
+					def_count++;
+				} else {
+					blbn_dne_skip_block (&parser);
+				}
+			}
+			free (name);
+		}
+	}
+
+	net = blbn_dne_build_net (file->env, net_name, defs, def_count);
+
+	for (i = 0; i < def_count; i++) {
+		blbn_dne_free_node (&defs[i]);
+	}
+	free (defs);
+	free (net_name);
+	free (parser.token);
+
+	return net;
+}
+
+/**
+ * Appends printf-style formatted text to a growable string.
+ */
+void blbn_engine_appendf (char **text, long *length, long *capacity, const char *format, ...) {
+	va_list args;
+	int needed;
+
+	va_start (args, format);
+	needed = vsnprintf (NULL, 0, format, args);
+	va_end (args);
+
+	if (*length + needed + 1 > *capacity) {
+		*capacity = 2 * (*length + needed + 1);
+		*text = (char *) realloc (*text, *capacity);
+	}
+	va_start (args, format);
+	vsnprintf (*text + *length, needed + 1, format, args);
+	va_end (args);
+	*length += needed;
+}
+
+/**
+ * Writes the rows of a table nested by parent (one level of parentheses per
+ * parent, like Netica).
+ */
+void blbn_dne_write_table (char **text, long *length, long *capacity, const node_bn *node, int parent, int *row, int values_per_row, const prob_bn *probs, const double *experience) {
+	int s, count;
+
+	if (parent == node->parents->length) {
+		if (probs != NULL) {
+			blbn_engine_appendf (text, length, capacity, "(");
+			for (s = 0; s < values_per_row; s++) {
+				blbn_engine_appendf (text, length, capacity, "%s%.9g", (s > 0 ? ", " : ""), probs[*row * values_per_row + s]);
+			}
+			blbn_engine_appendf (text, length, capacity, ")");
+		} else {
+			blbn_engine_appendf (text, length, capacity, "%.9g", experience[*row]);
+		}
+		(*row)++;
+		return;
+	}
+
+	count = node->parents->nodes[parent]->state_count;
+	blbn_engine_appendf (text, length, capacity, "(");
+	for (s = 0; s < count; s++) {
+		if (s > 0) {
+			blbn_engine_appendf (text, length, capacity, ",\n\t\t ");
+		}
+		blbn_dne_write_table (text, length, capacity, node, parent + 1, row, values_per_row, probs, experience);
+	}
+	blbn_engine_appendf (text, length, capacity, ")");
+}
+
+void WriteNet_bn (const net_bn* net, stream_ns* file) {
+	char *text = NULL;
+	long length = 0, capacity = 0;
+	const node_bn *node = NULL;
+	int i, s, row;
+
+	if (net == NULL || file == NULL) {
+		return;
+	}
+
+	blbn_engine_appendf (&text, &length, &capacity, "// ~->[DNET-1]->~\n\n// File created by %s.\n\nbnet %s {\nautoupdate = %s;\n", BLBN_ENGINE_VERSION, net->name, (net->auto_update ? "TRUE" : "FALSE"));
+
+	for (i = 0; i < net->nodes->length; i++) {
+		node = net->nodes->nodes[i];
+		blbn_engine_appendf (&text, &length, &capacity, "\nnode %s {\n\tkind = NATURE;\n\tdiscrete = TRUE;\n\tchance = CHANCE;\n\tstates = (", node->name);
+		for (s = 0; s < node->state_count; s++) {
+			blbn_engine_appendf (&text, &length, &capacity, "%s%s", (s > 0 ? ", " : ""), node->state_names[s]);
+		}
+		blbn_engine_appendf (&text, &length, &capacity, ");\n\tparents = (");
+		for (s = 0; s < node->parents->length; s++) {
+			blbn_engine_appendf (&text, &length, &capacity, "%s%s", (s > 0 ? ", " : ""), node->parents->nodes[s]->name);
+		}
+		blbn_engine_appendf (&text, &length, &capacity, ");\n");
+		if (node->probs != NULL) {
+			blbn_engine_appendf (&text, &length, &capacity, "\tprobs = \n\t\t");
+			row = 0;
+			blbn_dne_write_table (&text, &length, &capacity, node, 0, &row, node->state_count, node->probs, NULL);
+			blbn_engine_appendf (&text, &length, &capacity, ";\n");
+		}
+		if (node->experience != NULL) {
+			blbn_engine_appendf (&text, &length, &capacity, "\tnumcases = \n\t\t");
+			row = 0;
+			if (node->parents->length == 0) {
+				blbn_engine_appendf (&text, &length, &capacity, "%.9g", node->experience[0]);
+			} else {
+				blbn_dne_write_table (&text, &length, &capacity, node, 0, &row, 1, NULL, node->experience);
+			}
+			blbn_engine_appendf (&text, &length, &capacity, ";\n");
+		}
+		if (node->title != NULL) {
+			blbn_engine_appendf (&text, &length, &capacity, "\ttitle = \"%s\";\n", node->title);
+		}
+		blbn_engine_appendf (&text, &length, &capacity, "\t};\n");
+	}
+	blbn_engine_appendf (&text, &length, &capacity, "};\n");
+
+	blbn_stream_write (file, text, length, 1);
+	if (file->out != NULL) {
+		fflush (file->out);
+	}
+	free (text);
+}
+
+//------------------------------------------------------------------------------
+// Case files
+//------------------------------------------------------------------------------
+
+blbn_casetable_t* blbn_casetable_new () {
+	return (blbn_casetable_t *) calloc (1, sizeof (blbn_casetable_t));
+}
+
+void blbn_casetable_free (blbn_casetable_t *table) {
+	int c, v;
+
+	if (table == NULL) {
+		return;
+	}
+	for (c = 0; c < table->column_count; c++) {
+		for (v = 0; v < table->value_counts[c]; v++) {
+			free (table->values[c][v]);
+		}
+		free (table->values[c]);
+		free (table->column_names[c]);
+	}
+	free (table->values);
+	free (table->value_counts);
+	free (table->value_capacities);
+	free (table->column_names);
+	free (table->data);
+	free (table->freq);
+	free (table->ids);
+	free (table);
+}
+
+/**
+ * Returns the index of the column with the specified name, adding the
+ * column (missing in every existing case) if it doesn't exist.
+ */
+int blbn_casetable_column (blbn_casetable_t *table, const char *name, int length) {
+	int c, j;
+	int *data = NULL;
+
+	for (c = 0; c < table->column_count; c++) {
+		if (strncmp (table->column_names[c], name, length) == 0 && table->column_names[c][length] == '\0') {
+			return c;
+		}
+	}
+
+	c = table->column_count;
+	table->column_names = (char **) realloc (table->column_names, (c + 1) * sizeof (char *));
+	table->column_names[c] = strndup (name, length);
+	table->value_counts = (int *) realloc (table->value_counts, (c + 1) * sizeof (int));
+	table->value_capacities = (int *) realloc (table->value_capacities, (c + 1) * sizeof (int));
+	table->values = (char ***) realloc (table->values, (c + 1) * sizeof (char **));
+	table->value_counts[c] = 0;
+	table->value_capacities[c] = 0;
+	table->values[c] = NULL;
+	table->column_count = c + 1;
+
+	// Widen the case data
+	if (table->case_capacity > 0) {
+		data = (int *) malloc (table->case_capacity * table->column_count * sizeof (int));
+		for (j = 0; j < table->case_count; j++) {
+			memcpy (&data[j * table->column_count], &table->data[j * c], c * sizeof (int));
+			data[j * table->column_count + c] = -1;
+		}
+		free (table->data);
+		table->data = data;
+	}
+
+	return c;
+}
+
+/**
+ * Returns the interned index of a value in a column (adding it if new).
+ */
+int blbn_casetable_value (blbn_casetable_t *table, int column, const char *value, int length) {
+	int v;
+
+	for (v = 0; v < table->value_counts[column]; v++) {
+		if (strncmp (table->values[column][v], value, length) == 0 && table->values[column][v][length] == '\0') {
+			return v;
+		}
+	}
+	if (v == table->value_capacities[column]) {
+		table->value_capacities[column] = (v == 0 ? 4 : 2 * v);
+		table->values[column] = (char **) realloc (table->values[column], table->value_capacities[column] * sizeof (char *));
+	}
+	table->values[column][v] = strndup (value, length);
+	table->value_counts[column]++;
+	return v;
+}
+
+void blbn_casetable_reserve (blbn_casetable_t *table, int case_count) {
+	if (case_count > table->case_capacity) {
+		table->case_capacity = (2 * table->case_capacity > case_count ? 2 * table->case_capacity : case_count);
+		table->data = (int *) realloc (table->data, table->case_capacity * (table->column_count > 0 ? table->column_count : 1) * sizeof (int));
+		table->freq = (double *) realloc (table->freq, table->case_capacity * sizeof (double));
+		table->ids = (long *) realloc (table->ids, table->case_capacity * sizeof (long));
+	}
+}
+
+/**
+ * Returns the length of the field starting at text (fields are separated
+ * by white space or commas).
+ */
+int blbn_casetable_field (const char *text, const char *end) {
+	int length = 0;
+
+	while (text + length < end && text[length] != ' ' && text[length] != '\t' && text[length] != ',' && text[length] != '\n' && text[length] != '\r') {
+		length++;
+	}
+	return length;
+}
+
+/**
+ * Parses case file text (a header line of column names followed by one line
+ * per case; "*" or "?" is a missing value, "//" starts a comment) and
+ * appends the cases to the table.  The optional IDnum and NumCases columns
+ * give each case's ID and frequency; every frequency is multiplied by
+ * degree.  Returns the number of cases added, or -1 on error.
+ */
+int blbn_casetable_parse (blbn_casetable_t *table, const char *text, long length, double degree, environ_ns *env) {
+	const char *end = text + length;
+	const char *line = text;
+	const char *line_end = NULL;
+	const char *field = NULL;
+	int *columns = NULL; // file column -> table column (-1 = IDnum, -2 = NumCases)
+	int file_column_count = 0;
+	int field_length;
+	int added = 0;
+	int c, j, row;
+
+	while (line < end) {
+		for (line_end = line; line_end < end && *line_end != '\n'; line_end++);
+
+		// Skip leading white space, blank lines and comments
+		for (field = line; field < line_end && (*field == ' ' || *field == '\t' || *field == '\r'); field++);
+		if (field == line_end || (field + 1 < line_end && field[0] == '/' && field[1] == '/')) {
+			line = line_end + 1;
+			continue;
+		}
+
+		if (columns == NULL) {
+			// Header line
+			columns = (int *) malloc ((line_end - line + 1) * sizeof (int));
+			while (field < line_end) {
+				field_length = blbn_casetable_field (field, line_end);
+				if (field_length > 0) {
+					if (field_length == 5 && strncmp (field, "IDnum", 5) == 0) {
+						columns[file_column_count++] = -1;
+					} else if (field_length == 8 && strncmp (field, "NumCases", 8) == 0) {
+						columns[file_column_count++] = -2;
+					} else {
+						columns[file_column_count++] = blbn_casetable_column (table, field, field_length);
+					}
+				}
+				field += (field_length > 0 ? field_length : 1);
+			}
+			blbn_casetable_reserve (table, 1); // allocate data with the final column count
+		} else {
+			row = table->case_count;
+			blbn_casetable_reserve (table, row + 1);
+			for (c = 0; c < table->column_count; c++) {
+				table->data[row * table->column_count + c] = -1;
+			}
+			table->freq[row] = degree;
+			table->ids[row] = -1;
+
+			for (c = 0; c < file_column_count && field < line_end; c++) {
+				while (field < line_end && (*field == ' ' || *field == '\t' || *field == ',' || *field == '\r')) field++;
+				field_length = blbn_casetable_field (field, line_end);
+				if (field_length == 0) {
+					break;
+				}
+				if (columns[c] == -1) {
+					table->ids[row] = atol (field);
+				} else if (columns[c] == -2) {
+					table->freq[row] = degree * atof (field);
+				} else if (!(field_length == 1 && (field[0] == '*' || field[0] == '?'))) {
+					table->data[row * table->column_count + columns[c]] = blbn_casetable_value (table, columns[c], field, field_length);
+				}
+				field += field_length;
+			}
+			if (c < file_column_count) {
+				blbn_engine_error (env, 1050, WARNING_ERR, "Case %d has %d values instead of %d", row, c, file_column_count);
+			}
+			table->case_count++;
+			added++;
+		}
+
+		line = line_end + 1;
+	}
+
+	free (columns);
+	(void) j;
+	return added;
+}
+
+/**
+ * Maps each column of a case table to the index of the node with the same
+ * name in nodes (or -1).
+ */
+int* blbn_casetable_column_nodes (const blbn_casetable_t *table, const nodelist_bn *nodes) {
+	int *column_nodes = (int *) malloc ((table->column_count + 1) * sizeof (int));
+	const net_bn *net = NULL;
+	node_bn *node = NULL;
+	int c;
+
+	if (nodes->length > 0) {
+		net = nodes->nodes[0]->net;
+	}
+	for (c = 0; c < table->column_count; c++) {
+		column_nodes[c] = -1;
+		node = (net != NULL ? GetNodeNamed_bn (table->column_names[c], net) : NULL);
+		if (node != NULL) {
+			if (node->index < nodes->length && nodes->nodes[node->index] == node) {
+				column_nodes[c] = node->index;
+			} else {
+				column_nodes[c] = IndexOfNodeInList_bn (node, nodes, 0);
+			}
+		}
+	}
+	return column_nodes;
+}
+
+/**
+ * Maps each interned value of each mapped column to a state of its node
+ * (value_states[column][value], -1 if the node has no such state).
+ */
+int** blbn_casetable_value_states (const blbn_casetable_t *table, const nodelist_bn *nodes, const int *column_nodes) {
+	int **value_states = (int **) calloc (table->column_count + 1, sizeof (int *));
+	const node_bn *node = NULL;
+	int c, v;
+
+	for (c = 0; c < table->column_count; c++) {
+		if (column_nodes[c] < 0) {
+			continue;
+		}
+		node = nodes->nodes[column_nodes[c]];
+		value_states[c] = (int *) malloc ((table->value_counts[c] + 1) * sizeof (int));
+		for (v = 0; v < table->value_counts[c]; v++) {
+			value_states[c][v] = GetStateNamed_bn (table->values[c][v], node);
+			if (value_states[c][v] < 0) {
+				blbn_engine_error (node->net->env, 1051, ERROR_ERR, "Node '%s' has no state named '%s'", node->name, table->values[c][v]);
+				value_states[c][v] = -1;
+			}
+		}
+	}
+	return value_states;
+}
+
+void blbn_casetable_free_value_states (const blbn_casetable_t *table, int **value_states) {
+	int c;
+
+	for (c = 0; c < table->column_count; c++) {
+		free (value_states[c]);
+	}
+	free (value_states);
+}
+
+/**
+ * Returns the parsed cases of a stream (parsed on first use).
+ */
+blbn_casetable_t* blbn_stream_cases (stream_ns *stream) {
+	if (stream->cases == NULL) {
+		if (blbn_stream_load (stream) != 0) {
+			return NULL;
+		}
+		stream->cases = blbn_casetable_new ();
+		blbn_casetable_parse (stream->cases, stream->buffer, stream->length, 1.0, stream->env);
+	}
+	return stream->cases;
+}
+
+void ReadNetFindings_bn (caseposn_bn* case_posn, stream_ns* file, const nodelist_bn* nodes, long* ID_num, double* freq) {
+	blbn_casetable_t *table = NULL;
+	node_bn *node = NULL;
+	long row;
+	int c, value;
+	state_bn state;
+
+	if (case_posn == NULL || file == NULL || nodes == NULL) {
+		return;
+	}
+	table = blbn_stream_cases (file);
+	if (table == NULL) {
+		*case_posn = NO_MORE_CASES;
+		return;
+	}
+
+	if (*case_posn == FIRST_CASE) {
+		row = 0;
+	} else if (*case_posn == NEXT_CASE) {
+		row = file->next_case;
+	} else {
+		row = *case_posn;
+	}
+	if (row < 0 || row >= table->case_count) {
+		*case_posn = NO_MORE_CASES;
+		return;
+	}
+
+	for (c = 0; c < nodes->length; c++) {
+		RetractNodeFindings_bn (nodes->nodes[c]);
+	}
+	for (c = 0; c < table->column_count; c++) {
+		value = table->data[row * table->column_count + c];
+		if (value < 0 || nodes->length == 0) {
+			continue;
+		}
+		node = GetNodeNamed_bn (table->column_names[c], nodes->nodes[0]->net);
+		if (node == NULL || (nodes->nodes[node->index < nodes->length ? node->index : 0] != node && IndexOfNodeInList_bn (node, nodes, 0) < 0)) {
+			continue;
+		}
+		state = GetStateNamed_bn (table->values[c][value], node);
+		if (state >= 0) {
+			EnterFinding_bn (node, state);
+		} else {
+			blbn_engine_error (node->net->env, 1051, ERROR_ERR, "Node '%s' has no state named '%s'", node->name, table->values[c][value]);
+		}
+	}
+
+	if (ID_num != NULL) *ID_num = table->ids[row];
+	if (freq != NULL) *freq = table->freq[row];
+	*case_posn = row;
+	file->next_case = row + 1;
+}
+
+/**
+ * Reads the header of an existing case file so that further cases are
+ * appended with the same columns.
+ */
+void blbn_stream_read_header (stream_ns *stream) {
+	FILE *fp = NULL;
+	char line[4096];
+	struct stat info;
+
+	if (stream->filename == NULL || stat (stream->filename, &info) != 0 || info.st_size == 0) {
+		return;
+	}
+	fp = fopen (stream->filename, "r");
+	if (fp == NULL) {
+		return;
+	}
+	while (fgets (line, sizeof (line), fp) != NULL) {
+		if (line[0] == '\n' || line[0] == '\r' || strncmp (line, "//", 2) == 0) {
+			continue;
+		}
+		stream->header_written = 1;
+		stream->write_ids = (strstr (line, "IDnum") != NULL);
+		stream->write_freq = (strstr (line, "NumCases") != NULL);
+		break;
+	}
+	fclose (fp);
+}
+
+caseposn_bn WriteNetFindings_bn (const nodelist_bn* nodes, stream_ns* file, long ID_num, double freq) {
+	char *text = NULL;
+	long length = 0, capacity = 0;
+	const node_bn *node = NULL;
+	caseposn_bn posn;
+	int i;
+
+	if (nodes == NULL || file == NULL) {
+		return -1;
+	}
+
+	if (!file->header_written) {
+		if (file->filename != NULL) {
+			blbn_stream_read_header (file);
+		}
+		if (!file->header_written) {
+			file->write_ids = (ID_num >= 0);
+			file->write_freq = (freq >= 0);
+			if (file->write_ids) blbn_engine_appendf (&text, &length, &capacity, "IDnum\t");
+			if (file->write_freq) blbn_engine_appendf (&text, &length, &capacity, "NumCases\t");
+			for (i = 0; i < nodes->length; i++) {
+				blbn_engine_appendf (&text, &length, &capacity, "%s%c", nodes->nodes[i]->name, (i + 1 < nodes->length ? '\t' : '\n'));
+			}
+			file->header_written = 1;
+		}
+	}
+
+	if (file->write_ids) blbn_engine_appendf (&text, &length, &capacity, "%ld\t", ID_num);
+	if (file->write_freq) blbn_engine_appendf (&text, &length, &capacity, "%g\t", (freq >= 0 ? freq : 1.0));
+	for (i = 0; i < nodes->length; i++) {
+		node = nodes->nodes[i];
+		blbn_engine_appendf (&text, &length, &capacity, "%s%c", (node->finding >= 0 ? node->state_names[node->finding] : "*"), (i + 1 < nodes->length ? '\t' : '\n'));
+	}
+
+	posn = file->next_case++;
+	blbn_stream_write (file, text, length, 0);
+	if (file->out != NULL) {
+		fflush (file->out);
+	}
+	free (text);
+
+	return posn;
+}
+
+//------------------------------------------------------------------------------
+// Case sets
+//------------------------------------------------------------------------------
+
+caseset_cs* NewCaseset_cs (const char* name, environ_ns* env) {
+	caseset_cs *cases = (caseset_cs *) calloc (1, sizeof (caseset_cs));
+
+	cases->env = env;
+	cases->name = (name != NULL ? strdup (name) : NULL);
+	cases->table = blbn_casetable_new ();
+	return cases;
+}
+
+void DeleteCaseset_cs (caseset_cs* cases) {
+	if (cases != NULL) {
+		blbn_casetable_free (cases->table);
+		free (cases->name);
+		free (cases);
+	}
+}
+
+void AddFileToCaseset_cs (caseset_cs* cases, const stream_ns* file, double degree, const char* control) {
+	stream_ns *stream = (stream_ns *) file;
+
+	if (cases == NULL || stream == NULL || blbn_stream_load (stream) != 0) {
+		return;
+	}
+	blbn_casetable_parse (cases->table, stream->buffer, stream->length, degree, cases->env);
+}
@@ -0,0 +1,224 @@
+/*
+ * blbn_engine.h
+ *
+ *  Created: 2026-10-16
+ *
+ * In-tree discrete Bayesian network engine implementing the subset of the
+ * Netica C API (see ../netica/Netica.h) used by the blbn library.  Linking
+ * the engine instead of the Netica library runs the blbn_* API (and all of
+ * the selection policies) unchanged, without the proprietary library or a
+ * license string:
+ *
+ *   gcc -O2 -fcommon -o blbn_learner src/blbn_learner.c \
+ *       src/blbn/blbn.c src/blbn/blbn_engine.c src/blbn/blbn_engine_jt.c \
+ *       src/blbn/blbn_engine_learn.c -lm
+ *
+ * whereas building against Netica is unchanged:
+ *
+ *   gcc -O2 -fcommon -o blbn_learner src/blbn_learner.c src/blbn/blbn.c \
+ *       -L<netica_lib_dir> -lnetica -lm
+ *
+ * The engine consists of:
+ *
+ * - blbn_engine.c       environment and errors, streams, node lists, nets,
+ *                       nodes and tables, findings, node relations, DNE and
+ *                       case file reading/writing, case sets
+ * - blbn_engine_jt.c    junction tree compilation (moralization, min-fill
+ *                       triangulation, maximum spanning join tree) and Hugin
+ *                       propagation over flat potential tables, joint
+ *                       beliefs of node pairs (blbn_engine_joint_beliefs),
+ *                       double precision beliefs (blbn_engine_node_beliefs)
+ * - blbn_engine_learn.c counting and EM learning, ReviseCPTsByFindings_bn,
+ *                       net testers, random case generation
+ *
+ * Potentials are flat, contiguous arrays of doubles indexed in mixed radix
+ * order (the variable with the highest node index varies fastest).  The maps
+ * from clique entries to separator and family entries are computed once at
+ * compile time, so marginalization and absorption are single linear passes
+ * over the clique table.
+ *
+ * blbn_generator.c still needs Netica (it uses NeticaEx.c and case file
+ * functions outside this subset).
+ *
+ * CopyNet_bn and CopyNodes_bn take snapshots: a copied node shares the CPT
+ * and experience table storage of the original until either of them
+ * modifies its tables (copy-on-write), and a copied net shares the compiled
+ * junction tree structure of the original (only the potentials are per net).
+ * Copying a net for a lookahead therefore costs memory in proportion to the
+ * tables the lookahead changes rather than to the size of the net.
+ *
+ * Only discrete nature nodes are supported.  Probabilities are reported as
+ * prob_bn (float) like Netica, but all inference and learning is done in
+ * double precision.  Log loss uses the natural logarithm.
+ */
+
+#ifndef BLBN_ENGINE_H_
+#define BLBN_ENGINE_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include "../netica/Netica.h"
+
+#define BLBN_ENGINE_VERSION "blbn native engine 1.0"
+
+#define BLBN_ENGINE_EM_MAX_ITERS 1000  // Default maximum number of EM iterations
+#define BLBN_ENGINE_EM_TOLERANCE 1e-5  // Default EM tolerance (change in mean log likelihood per case)
+
+typedef struct blbn_jtree blbn_jtree_t;
+
+struct report_ins {
+	int number;
+	errseverity_ns severity;
+	char mesg[MESG_LEN_ns];
+	report_ns *next;
+};
+
+struct environ_ins {
+	report_ns *errors; // oldest first
+	int license_ok;
+};
+
+// Parsed case data (used by case files and case sets).  Values are interned
+// per column: data[case * column_count + column] indexes values[column], or
+// is -1 if the value is missing.
+typedef struct blbn_casetable {
+	int column_count;
+	char **column_names;
+	int *value_counts; // [column] number of distinct values
+	int *value_capacities;
+	char ***values; // [column][value] distinct value strings
+	int case_count;
+	int case_capacity;
+	int *data;
+	double *freq; // [case] number of cases represented (NumCases column or 1)
+	long *ids; // [case] case ID (IDnum column or -1)
+} blbn_casetable_t;
+
+struct stream_ins {
+	environ_ns *env;
+	char *filename; // NULL for memory streams
+	char *buffer; // file contents (read lazily) or memory stream contents
+	long length;
+	long capacity;
+	int loaded; // file contents have been read into buffer
+	FILE *out; // file opened for writing by WriteNetFindings_bn/WriteNet_bn
+	blbn_casetable_t *cases; // parsed case file (discarded when the stream is written)
+	long next_case; // next case read by ReadNetFindings_bn with NEXT_CASE
+	int header_written; // case file header has been written to this stream
+	int write_ids; // case file has an IDnum column
+	int write_freq; // case file has a NumCases column
+};
+
+struct nodelist_ibn {
+	node_bn **nodes;
+	int length;
+	int capacity;
+	const net_bn *net;
+};
+
+struct node_ibn {
+	net_bn *net;
+	int index; // position in the net's node list
+	char *name;
+	char *title;
+	int state_count;
+	char **state_names;
+	nodelist_bn *parents;
+	nodelist_bn *children;
+	int config_count; // number of parent configurations
+	prob_bn *probs; // CPT [config * state_count + state], NULL if none
+	double *experience; // experience table [config], NULL if none
+	int *table_refs; // nodes sharing probs and experience (copy-on-write), NULL if not shared
+	long table_stamp; // blbn_engine_table_stamps when the tables were last made writable
+	state_bn finding; // entered finding or NO_FINDING
+	prob_bn *beliefs; // beliefs returned by GetNodeBeliefs_bn
+	long beliefs_version; // propagation the beliefs were computed for
+};
+
+struct net_ibn {
+	environ_ns *env;
+	char *name;
+	nodelist_bn *nodes;
+	int auto_update;
+	int *name_table; // open-addressing hash of node names (node index + 1, 0 = empty)
+	int name_table_size;
+	long structure_version; // incremented when nodes or links change
+	long table_version; // incremented when any CPT changes
+	long findings_version; // incremented when any finding changes
+	blbn_jtree_t *jtree; // compiled junction tree (NULL if not compiled)
+};
+
+struct caseset_ics {
+	environ_ns *env;
+	char *name;
+	blbn_casetable_t *table;
+};
+
+struct learner_ibn {
+	environ_ns *env;
+	learn_method_bn method;
+	int max_iters;
+	double max_tol;
+};
+
+struct test_ibn {
+	nodelist_bn *test_nodes;
+	nodelist_bn *unobsv_nodes;
+	double **confusion; // [test node][predicted * state_count + actual]
+	double *log_loss; // [test node] summed -ln P(actual)
+	double *quadratic_loss; // [test node] summed quadratic loss
+	double *count; // [test node] number of cases tested
+};
+
+extern long blbn_engine_table_stamps; // Tables made writable by every net (orders CPT changes)
+
+// Errors (blbn_engine.c)
+void blbn_engine_error (environ_ns *env, int number, errseverity_ns severity, const char *format, ...);
+
+// Tables (blbn_engine.c)
+int blbn_engine_config_index (const node_bn *node, const state_bn *parent_states);
+void blbn_engine_own_tables (node_bn *node);
+void blbn_engine_release_tables (node_bn *node);
+void blbn_engine_share_tables (const node_bn *node, node_bn *copy);
+void blbn_engine_alloc_probs (node_bn *node);
+void blbn_engine_alloc_experience (node_bn *node);
+void blbn_engine_table_changed (net_bn *net);
+void blbn_engine_structure_changed (net_bn *net);
+
+// Case tables (blbn_engine.c)
+blbn_casetable_t* blbn_casetable_new ();
+void blbn_casetable_free (blbn_casetable_t *table);
+int blbn_casetable_parse (blbn_casetable_t *table, const char *text, long length, double degree, environ_ns *env);
+int* blbn_casetable_column_nodes (const blbn_casetable_t *table, const nodelist_bn *nodes);
+int** blbn_casetable_value_states (const blbn_casetable_t *table, const nodelist_bn *nodes, const int *column_nodes);
+void blbn_casetable_free_value_states (const blbn_casetable_t *table, int **value_states);
+
+// Streams (blbn_engine.c)
+int blbn_stream_load (stream_ns *stream);
+void blbn_stream_write (stream_ns *stream, const char *text, long length, int truncate);
+blbn_casetable_t* blbn_stream_cases (stream_ns *stream);
+
+// Learning (blbn_engine_learn.c)
+state_bn* blbn_casetable_decode (const blbn_casetable_t *table, const net_bn *net);
+int blbn_engine_family_entry (const node_bn *node, const state_bn *findings);
+
+// Junction tree (blbn_engine_jt.c)
+blbn_jtree_t* blbn_jt_compile (net_bn *net);
+blbn_jtree_t* blbn_jt_share (blbn_jtree_t *jt);
+void blbn_jt_free (blbn_jtree_t *jt);
+int blbn_jt_propagate (net_bn *net, const state_bn *findings, int root_node);
+double blbn_jt_findings_log_probability (const net_bn *net);
+void blbn_jt_node_marginal (const net_bn *net, const node_bn *node, double *marginal);
+void blbn_jt_family_marginal (const net_bn *net, const node_bn *node, double *marginal);
+void blbn_jt_joint_marginal (const net_bn *net, const node_bn *a, const node_bn *b, double *joint);
+void blbn_engine_ensure_compiled (net_bn *net);
+int blbn_engine_update (net_bn *net);
+
+// Extensions of the Netica API (blbn_engine_jt.c)
+int blbn_engine_joint_beliefs (node_bn *node1, node_bn *node2, double *joint);
+int blbn_engine_node_beliefs (node_bn *node, double *beliefs);
+
+#endif /* BLBN_ENGINE_H_ */
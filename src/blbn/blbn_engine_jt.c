@@ -0,0 +1,1060 @@
+/*
+ * blbn_engine_jt.c
+ *
+ *  Created: 2026-10-16
+ *
+ * Junction tree compilation and Hugin propagation for the native engine
+ * (see blbn_engine.h), and the inference part of the Netica API.
+ */
+
+#include "blbn_engine.h"
+
+#define BLBN_JT_MAX_TABLE_SIZE (1 << 26) // Largest clique table allowed (entries)
+
+long blbn_jt_propagations = 0; // Propagations by every net (identifies cached beliefs)
+
+struct blbn_jtree {
+	int node_count;
+	int clique_count;
+	int *clique_sizes; // [clique] number of nodes
+	int **clique_nodes; // [clique] node indices, ascending
+	int *table_sizes; // [clique] number of entries in the potential
+	double **potentials; // [clique] working potentials (allocated on first propagation)
+	double **initial; // [clique] products of the assigned CPTs (NULL until built)
+	int **initial_refs; // [clique] junction trees sharing initial[clique] (copy-on-write), NULL if not shared
+	long *initial_stamps; // [clique] blbn_engine_table_stamps when initial[clique] was built
+	long initial_version; // table_version of the net the initial potentials were built for
+
+	int *order; // cliques in breadth-first order (parents before children)
+	int *parent; // [clique] parent clique, -1 for roots
+	int *sep_sizes; // [clique] entries in the separator with the parent
+	double **separators; // [clique] separator potential (allocated on first propagation)
+	int **sep_maps; // [clique] clique entry -> separator entry
+	int **parent_sep_maps; // [clique] parent clique entry -> separator entry
+
+	int *home_clique; // [node] smallest clique containing the node
+	int *home_strides; // [node] stride of the node in its home clique
+	int *family_clique; // [node] clique the node's CPT is assigned to
+	int **family_maps; // [node] family clique entry -> CPT entry (config * states + state)
+	int *skeleton_refs; // junction trees sharing everything above but the potentials and separators
+
+	double log_probability; // ln P(findings) of the last propagation
+	int consistent; // findings of the last propagation have non-zero probability
+	long propagated_findings; // findings_version of the last propagation (-1 = none)
+	long propagated_tables; // table_version of the last propagation
+	int distributed; // last propagation reached every clique
+	long propagation_count; // blbn_jt_propagations at the last propagation
+};
+
+/**
+ * Builds the map from the entries of a table over vars (ascending node
+ * indices, the last varying fastest) to the entries of another table, given
+ * the stride of each var in the other table (0 if absent).
+ */
+int* blbn_jt_build_map (const net_bn *net, const int *vars, int var_count, int table_size, const int *strides) {
+	int *map = (int *) malloc (table_size * sizeof (int));
+	int *states = (int *) calloc (var_count + 1, sizeof (int));
+	int e, i, index = 0;
+	int k;
+
+	for (e = 0; e < table_size; e++) {
+		map[e] = index;
+		// Odometer increment, last var fastest
+		for (i = var_count - 1; i >= 0; i--) {
+			k = net->nodes->nodes[vars[i]]->state_count;
+			states[i]++;
+			index += strides[i];
+			if (states[i] < k) {
+				break;
+			}
+			index -= k * strides[i];
+			states[i] = 0;
+		}
+	}
+
+	free (states);
+	return map;
+}
+
+/**
+ * Returns the stride of node in the clique table (0 if absent).
+ */
+int blbn_jt_stride (const net_bn *net, const blbn_jtree_t *jt, int clique, int node) {
+	int stride = 1;
+	int i;
+
+	for (i = jt->clique_sizes[clique] - 1; i >= 0; i--) {
+		if (jt->clique_nodes[clique][i] == node) {
+			return stride;
+		}
+		stride *= net->nodes->nodes[jt->clique_nodes[clique][i]]->state_count;
+	}
+	return 0;
+}
+
+int blbn_jt_contains (const blbn_jtree_t *jt, int clique, int node) {
+	int i;
+
+	for (i = 0; i < jt->clique_sizes[clique]; i++) {
+		if (jt->clique_nodes[clique][i] == node) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+void blbn_jt_free (blbn_jtree_t *jt) {
+	int i;
+
+	if (jt == NULL) {
+		return;
+	}
+	for (i = 0; i < jt->clique_count; i++) {
+		free (jt->potentials[i]);
+		if (jt->initial_refs[i] != NULL && --(*jt->initial_refs[i]) > 0) {
+			jt->initial[i] = NULL;
+		} else {
+			free (jt->initial_refs[i]);
+			free (jt->initial[i]);
+		}
+		free (jt->separators[i]);
+	}
+	free (jt->potentials);
+	free (jt->initial);
+	free (jt->initial_refs);
+	free (jt->initial_stamps);
+	free (jt->separators);
+	if (--(*jt->skeleton_refs) > 0) {
+		free (jt);
+		return;
+	}
+
+	for (i = 0; i < jt->clique_count; i++) {
+		free (jt->clique_nodes[i]);
+		free (jt->sep_maps[i]);
+		free (jt->parent_sep_maps[i]);
+	}
+	for (i = 0; i < jt->node_count; i++) {
+		free (jt->family_maps[i]);
+	}
+	free (jt->clique_sizes);
+	free (jt->clique_nodes);
+	free (jt->table_sizes);
+	free (jt->order);
+	free (jt->parent);
+	free (jt->sep_sizes);
+	free (jt->sep_maps);
+	free (jt->parent_sep_maps);
+	free (jt->home_clique);
+	free (jt->home_strides);
+	free (jt->family_clique);
+	free (jt->family_maps);
+	free (jt->skeleton_refs);
+	free (jt);
+}
+
+/**
+ * Triangulates the moral graph of the net by min-fill elimination (ties go
+ * to the smallest clique weight) and returns the maximal cliques.
+ */
+void blbn_jt_triangulate (const net_bn *net, blbn_jtree_t *jt) {
+	int n = net->nodes->length;
+	char *adjacent = (char *) calloc (n * n, 1);
+	char *eliminated = (char *) calloc (n, 1);
+	int *clique = (int *) malloc (n * sizeof (int));
+	int capacity = n;
+	int step, v, u, w, i, j, size;
+	int best, best_fill, fill;
+	double best_weight, weight;
+	const node_bn *node = NULL;
+
+	// Moral graph: links plus "marriages" between parents
+	for (v = 0; v < n; v++) {
+		node = net->nodes->nodes[v];
+		for (i = 0; i < node->parents->length; i++) {
+			u = node->parents->nodes[i]->index;
+			adjacent[u * n + v] = adjacent[v * n + u] = 1;
+			for (j = i + 1; j < node->parents->length; j++) {
+				w = node->parents->nodes[j]->index;
+				adjacent[u * n + w] = adjacent[w * n + u] = 1;
+			}
+		}
+	}
+
+	jt->clique_count = 0;
+	jt->clique_sizes = (int *) malloc (capacity * sizeof (int));
+	jt->clique_nodes = (int **) malloc (capacity * sizeof (int *));
+
+	for (step = 0; step < n; step++) {
+		best = -1;
+		best_fill = 0;
+		best_weight = 0.0;
+		for (v = 0; v < n; v++) {
+			if (eliminated[v]) {
+				continue;
+			}
+			size = 0;
+			weight = net->nodes->nodes[v]->state_count;
+			for (u = 0; u < n; u++) {
+				if (u != v && !eliminated[u] && adjacent[v * n + u]) {
+					clique[size++] = u;
+					weight *= net->nodes->nodes[u]->state_count;
+				}
+			}
+			fill = 0;
+			for (i = 0; i < size; i++) {
+				for (j = i + 1; j < size; j++) {
+					fill += !adjacent[clique[i] * n + clique[j]];
+				}
+			}
+			if (best < 0 || fill < best_fill || (fill == best_fill && weight < best_weight)) {
+				best = v;
+				best_fill = fill;
+				best_weight = weight;
+			}
+		}
+
+		// Clique of the eliminated node and its remaining neighbours
+		size = 0;
+		for (u = 0; u < n; u++) {
+			if (u == best || (!eliminated[u] && adjacent[best * n + u])) {
+				clique[size++] = u;
+			}
+		}
+		for (i = 0; i < size; i++) {
+			for (j = i + 1; j < size; j++) {
+				adjacent[clique[i] * n + clique[j]] = adjacent[clique[j] * n + clique[i]] = 1;
+			}
+		}
+		eliminated[best] = 1;
+
+		// Keep the clique only if it isn't contained in an earlier one
+		for (i = 0; i < jt->clique_count; i++) {
+			for (j = 0; j < size && blbn_jt_contains (jt, i, clique[j]); j++);
+			if (j == size) {
+				break;
+			}
+		}
+		if (i == jt->clique_count) {
+			jt->clique_sizes[jt->clique_count] = size;
+			jt->clique_nodes[jt->clique_count] = (int *) malloc (size * sizeof (int));
+			memcpy (jt->clique_nodes[jt->clique_count], clique, size * sizeof (int));
+			jt->clique_count++;
+		}
+	}
+
+	free (clique);
+	free (eliminated);
+	free (adjacent);
+}
+
+/**
+ * Connects the cliques into a join tree (a forest if the net is not
+ * connected) by a maximum spanning tree on separator sizes, and orders the
+ * cliques breadth first from each root.
+ */
+void blbn_jt_connect (blbn_jtree_t *jt) {
+	int m = jt->clique_count;
+	int *component = (int *) malloc (m * sizeof (int));
+	int *edges = (int *) malloc ((m * (m - 1) / 2 + 1) * 3 * sizeof (int));
+	int **neighbours = (int **) malloc (m * sizeof (int *));
+	int *neighbour_counts = (int *) calloc (m, sizeof (int));
+	char *visited = (char *) calloc (m, 1);
+	int edge_count = 0;
+	int a, b, i, j, k, weight, head, tail, from, to, old;
+
+	for (a = 0; a < m; a++) {
+		component[a] = a;
+		neighbours[a] = (int *) malloc (m * sizeof (int));
+		for (b = a + 1; b < m; b++) {
+			weight = 0;
+			for (i = 0; i < jt->clique_sizes[a]; i++) {
+				weight += blbn_jt_contains (jt, b, jt->clique_nodes[a][i]);
+			}
+			if (weight > 0) {
+				edges[3 * edge_count] = weight;
+				edges[3 * edge_count + 1] = a;
+				edges[3 * edge_count + 2] = b;
+				edge_count++;
+			}
+		}
+	}
+
+	// Kruskal: heaviest separators first (insertion sort, cliques are few)
+	for (i = 1; i < edge_count; i++) {
+		for (j = i; j > 0 && edges[3 * (j - 1)] < edges[3 * j]; j--) {
+			for (k = 0; k < 3; k++) {
+				weight = edges[3 * j + k];
+				edges[3 * j + k] = edges[3 * (j - 1) + k];
+				edges[3 * (j - 1) + k] = weight;
+			}
+		}
+	}
+	for (i = 0; i < edge_count; i++) {
+		from = edges[3 * i + 1];
+		to = edges[3 * i + 2];
+		if (component[from] != component[to]) {
+			old = component[to];
+			for (j = 0; j < m; j++) {
+				if (component[j] == old) {
+					component[j] = component[from];
+				}
+			}
+			neighbours[from][neighbour_counts[from]++] = to;
+			neighbours[to][neighbour_counts[to]++] = from;
+		}
+	}
+
+	jt->order = (int *) malloc (m * sizeof (int));
+	jt->parent = (int *) malloc (m * sizeof (int));
+	tail = 0;
+	for (a = 0; a < m; a++) {
+		if (visited[a]) {
+			continue;
+		}
+		visited[a] = 1;
+		jt->parent[a] = -1;
+		head = tail;
+		jt->order[tail++] = a;
+		while (head < tail) {
+			from = jt->order[head++];
+			for (i = 0; i < neighbour_counts[from]; i++) {
+				to = neighbours[from][i];
+				if (!visited[to]) {
+					visited[to] = 1;
+					jt->parent[to] = from;
+					jt->order[tail++] = to;
+				}
+			}
+		}
+	}
+
+	for (a = 0; a < m; a++) {
+		free (neighbours[a]);
+	}
+	free (neighbours);
+	free (neighbour_counts);
+	free (visited);
+	free (edges);
+	free (component);
+}
+
+blbn_jtree_t* blbn_jt_compile (net_bn *net) {
+	blbn_jtree_t *jt = NULL;
+	const node_bn *node = NULL;
+	int n = net->nodes->length;
+	int *strides = NULL;
+	int *sep_nodes = NULL;
+	int c, p, i, j, v, size, sep_count, stride;
+	double table_size;
+
+	jt = (blbn_jtree_t *) calloc (1, sizeof (blbn_jtree_t));
+	jt->node_count = n;
+	blbn_jt_triangulate (net, jt);
+	blbn_jt_connect (jt);
+
+	// Clique tables
+	jt->table_sizes = (int *) malloc (jt->clique_count * sizeof (int));
+	jt->potentials = (double **) calloc (jt->clique_count, sizeof (double *));
+	jt->initial = (double **) calloc (jt->clique_count, sizeof (double *));
+	jt->initial_refs = (int **) calloc (jt->clique_count, sizeof (int *));
+	jt->initial_stamps = (long *) malloc (jt->clique_count * sizeof (long));
+	jt->separators = (double **) calloc (jt->clique_count, sizeof (double *));
+	for (c = 0; c < jt->clique_count; c++) {
+		jt->initial_stamps[c] = -1;
+		table_size = 1.0;
+		for (i = 0; i < jt->clique_sizes[c]; i++) {
+			table_size *= net->nodes->nodes[jt->clique_nodes[c][i]]->state_count;
+		}
+		if (table_size > BLBN_JT_MAX_TABLE_SIZE) {
+			blbn_engine_error (net->env, 1100, ERROR_ERR, "Net '%s' is too complex to compile (clique of %g entries)", net->name, table_size);
+			jt->table_sizes[c] = 0;
+			jt->clique_count = c;
+			blbn_jt_free (jt);
+			return NULL;
+		}
+		jt->table_sizes[c] = (int) table_size;
+	}
+
+	// Separators and their maps
+	strides = (int *) malloc ((n + 1) * sizeof (int));
+	sep_nodes = (int *) malloc ((n + 1) * sizeof (int));
+	jt->sep_sizes = (int *) calloc (jt->clique_count, sizeof (int));
+	jt->sep_maps = (int **) calloc (jt->clique_count, sizeof (int *));
+	jt->parent_sep_maps = (int **) calloc (jt->clique_count, sizeof (int *));
+	for (c = 0; c < jt->clique_count; c++) {
+		p = jt->parent[c];
+		if (p < 0) {
+			continue;
+		}
+		sep_count = 0;
+		for (i = 0; i < jt->clique_sizes[c]; i++) {
+			if (blbn_jt_contains (jt, p, jt->clique_nodes[c][i])) {
+				sep_nodes[sep_count++] = jt->clique_nodes[c][i];
+			}
+		}
+		size = 1;
+		for (i = 0; i < sep_count; i++) {
+			size *= net->nodes->nodes[sep_nodes[i]]->state_count;
+		}
+		jt->sep_sizes[c] = size;
+
+		// Clique var -> separator stride
+		for (j = 0; j < 2; j++) {
+			int clique = (j == 0 ? c : p);
+			for (i = 0; i < jt->clique_sizes[clique]; i++) {
+				v = jt->clique_nodes[clique][i];
+				strides[i] = 0;
+				stride = 1;
+				for (size = sep_count - 1; size >= 0; size--) {
+					if (sep_nodes[size] == v) {
+						strides[i] = stride;
+						break;
+					}
+					stride *= net->nodes->nodes[sep_nodes[size]]->state_count;
+				}
+			}
+			if (j == 0) {
+				jt->sep_maps[c] = blbn_jt_build_map (net, jt->clique_nodes[c], jt->clique_sizes[c], jt->table_sizes[c], strides);
+			} else {
+				jt->parent_sep_maps[c] = blbn_jt_build_map (net, jt->clique_nodes[p], jt->clique_sizes[p], jt->table_sizes[p], strides);
+			}
+		}
+	}
+
+	// Home and family cliques (the smallest containing the node / family)
+	jt->home_clique = (int *) malloc ((n + 1) * sizeof (int));
+	jt->home_strides = (int *) malloc ((n + 1) * sizeof (int));
+	jt->family_clique = (int *) malloc ((n + 1) * sizeof (int));
+	jt->family_maps = (int **) calloc (n + 1, sizeof (int *));
+	for (v = 0; v < n; v++) {
+		node = net->nodes->nodes[v];
+		jt->home_clique[v] = -1;
+		jt->family_clique[v] = -1;
+		for (c = 0; c < jt->clique_count; c++) {
+			if (!blbn_jt_contains (jt, c, v)) {
+				continue;
+			}
+			if (jt->home_clique[v] < 0 || jt->table_sizes[c] < jt->table_sizes[jt->home_clique[v]]) {
+				jt->home_clique[v] = c;
+			}
+			for (i = 0; i < node->parents->length && blbn_jt_contains (jt, c, node->parents->nodes[i]->index); i++);
+			if (i == node->parents->length && (jt->family_clique[v] < 0 || jt->table_sizes[c] < jt->table_sizes[jt->family_clique[v]])) {
+				jt->family_clique[v] = c;
+			}
+		}
+		jt->home_strides[v] = blbn_jt_stride (net, jt, jt->home_clique[v], v);
+
+		// Clique var -> CPT stride (parents in parent order, the node fastest)
+		c = jt->family_clique[v];
+		for (i = 0; i < jt->clique_sizes[c]; i++) {
+			strides[i] = 0;
+			if (jt->clique_nodes[c][i] == v) {
+				strides[i] = 1;
+			}
+			stride = node->state_count;
+			for (j = node->parents->length - 1; j >= 0; j--) {
+				if (node->parents->nodes[j]->index == jt->clique_nodes[c][i]) {
+					strides[i] = stride;
+				}
+				stride *= node->parents->nodes[j]->state_count;
+			}
+		}
+		jt->family_maps[v] = blbn_jt_build_map (net, jt->clique_nodes[c], jt->clique_sizes[c], jt->table_sizes[c], strides);
+	}
+
+	jt->skeleton_refs = (int *) malloc (sizeof (int));
+	*jt->skeleton_refs = 1;
+	jt->initial_version = -1;
+	jt->propagated_findings = -1;
+	jt->propagated_tables = -1;
+
+	free (sep_nodes);
+	free (strides);
+	return jt;
+}
+
+/**
+ * Returns a junction tree for a copy of the net jt was compiled for.  The
+ * cliques, separators and maps are shared with jt, and so are the initial
+ * potentials until a CPT assigned to their clique changes in either net
+ * (only those cliques are rebuilt).  The working potentials are allocated on
+ * the copy's first propagation.
+ */
+blbn_jtree_t* blbn_jt_share (blbn_jtree_t *jt) {
+	blbn_jtree_t *copy = NULL;
+	int c;
+
+	copy = (blbn_jtree_t *) malloc (sizeof (blbn_jtree_t));
+	*copy = *jt;
+	(*copy->skeleton_refs)++;
+	copy->potentials = (double **) calloc (jt->clique_count, sizeof (double *));
+	copy->initial = (double **) calloc (jt->clique_count, sizeof (double *));
+	copy->initial_refs = (int **) calloc (jt->clique_count, sizeof (int *));
+	copy->initial_stamps = (long *) malloc (jt->clique_count * sizeof (long));
+	copy->separators = (double **) calloc (jt->clique_count, sizeof (double *));
+	for (c = 0; c < jt->clique_count; c++) {
+		copy->initial_stamps[c] = -1;
+		if (jt->initial[c] == NULL) {
+			continue;
+		}
+		if (jt->initial_refs[c] == NULL) {
+			jt->initial_refs[c] = (int *) malloc (sizeof (int));
+			*jt->initial_refs[c] = 1;
+		}
+		(*jt->initial_refs[c])++;
+		copy->initial_refs[c] = jt->initial_refs[c];
+		copy->initial[c] = jt->initial[c];
+		copy->initial_stamps[c] = jt->initial_stamps[c];
+	}
+	copy->log_probability = 0.0;
+	copy->consistent = 0;
+	copy->initial_version = -1;
+	copy->propagated_findings = -1;
+	copy->propagated_tables = -1;
+	copy->distributed = 0;
+	copy->propagation_count = 0;
+
+	return copy;
+}
+
+/**
+ * Compiles the net's junction tree if needed, and rebuilds the initial
+ * potentials of the cliques whose assigned CPTs changed since they were
+ * built (a potential shared with another junction tree is copied first).
+ */
+void blbn_engine_ensure_compiled (net_bn *net) {
+	blbn_jtree_t *jt = NULL;
+	const node_bn *node = NULL;
+	const int *map = NULL;
+	double *potential = NULL;
+	char *dirty = NULL;
+	int c, v, e, size;
+
+	if (net->jtree == NULL) {
+		net->jtree = blbn_jt_compile (net);
+		if (net->jtree == NULL) {
+			return;
+		}
+	}
+	jt = net->jtree;
+	if (jt->initial_version == net->table_version) {
+		return;
+	}
+
+	dirty = (char *) calloc (jt->clique_count, 1);
+	for (c = 0; c < jt->clique_count; c++) {
+		dirty[c] = (jt->initial[c] == NULL);
+	}
+	for (v = 0; v < jt->node_count; v++) {
+		c = jt->family_clique[v];
+		if (net->nodes->nodes[v]->table_stamp > jt->initial_stamps[c]) {
+			dirty[c] = 1;
+		}
+	}
+	for (c = 0; c < jt->clique_count; c++) {
+		if (!dirty[c]) {
+			continue;
+		}
+		if (jt->initial_refs[c] != NULL) {
+			if (--(*jt->initial_refs[c]) == 0) {
+				free (jt->initial_refs[c]);
+				free (jt->initial[c]);
+			}
+			jt->initial_refs[c] = NULL;
+			jt->initial[c] = NULL;
+		}
+		if (jt->initial[c] == NULL) {
+			jt->initial[c] = (double *) malloc (jt->table_sizes[c] * sizeof (double));
+		}
+		for (e = 0; e < jt->table_sizes[c]; e++) {
+			jt->initial[c][e] = 1.0;
+		}
+		jt->initial_stamps[c] = blbn_engine_table_stamps;
+	}
+	for (v = 0; v < jt->node_count; v++) {
+		node = net->nodes->nodes[v];
+		c = jt->family_clique[v];
+		if (!dirty[c]) {
+			continue;
+		}
+		potential = jt->initial[c];
+		map = jt->family_maps[v];
+		size = jt->table_sizes[c];
+		if (node->probs != NULL) {
+			for (e = 0; e < size; e++) {
+				potential[e] *= node->probs[map[e]];
+			}
+		} else {
+			for (e = 0; e < size; e++) {
+				potential[e] *= 1.0 / node->state_count;
+			}
+		}
+	}
+	jt->initial_version = net->table_version;
+	free (dirty);
+}
+
+/**
+ * Marginalizes a clique potential onto a separator.
+ */
+void blbn_jt_marginalize (const double *potential, int size, const int *map, double *separator, int sep_size) {
+	int e;
+
+	memset (separator, 0, sep_size * sizeof (double));
+	for (e = 0; e < size; e++) {
+		separator[map[e]] += potential[e];
+	}
+}
+
+/**
+ * Propagates findings through the junction tree (findings[node] is a state
+ * or negative for none).  Collects evidence to every root (tracking the
+ * probability of the findings), then distributes it to every clique, or
+ * only along the path to the home clique of root_node if it is >= 0.
+ * Returns 0 on success, -1 if the findings are inconsistent.
+ */
+int blbn_jt_propagate (net_bn *net, const state_bn *findings, int root_node) {
+	blbn_jtree_t *jt = NULL;
+	double *potential = NULL;
+	double *separator = NULL;
+	double *parent_potential = NULL;
+	const int *map = NULL;
+	char *on_path = NULL;
+	double sum, log_scale = 0.0;
+	int i, c, p, e, v, k, stride, size;
+
+	blbn_engine_ensure_compiled (net);
+	jt = net->jtree;
+	if (jt == NULL) {
+		return -1;
+	}
+
+	for (c = 0; c < jt->clique_count; c++) {
+		if (jt->potentials[c] == NULL) {
+			jt->potentials[c] = (double *) malloc (jt->table_sizes[c] * sizeof (double));
+		}
+		if (jt->parent[c] >= 0 && jt->separators[c] == NULL) {
+			jt->separators[c] = (double *) malloc (jt->sep_sizes[c] * sizeof (double));
+		}
+		memcpy (jt->potentials[c], jt->initial[c], jt->table_sizes[c] * sizeof (double));
+	}
+
+	// Enter findings into home cliques
+	for (v = 0; v < jt->node_count; v++) {
+		if (findings[v] < 0) {
+			continue;
+		}
+		c = jt->home_clique[v];
+		potential = jt->potentials[c];
+		stride = jt->home_strides[v];
+		k = net->nodes->nodes[v]->state_count;
+		for (e = 0; e < jt->table_sizes[c]; e++) {
+			if ((e / stride) % k != findings[v]) {
+				potential[e] = 0.0;
+			}
+		}
+	}
+
+	// Collect (children before parents); messages are normalized and their
+	// sums kept in log_scale
+	jt->consistent = 1;
+	for (i = jt->clique_count - 1; i >= 0; i--) {
+		c = jt->order[i];
+		p = jt->parent[c];
+		if (p < 0) {
+			continue;
+		}
+		separator = jt->separators[c];
+		blbn_jt_marginalize (jt->potentials[c], jt->table_sizes[c], jt->sep_maps[c], separator, jt->sep_sizes[c]);
+		sum = 0.0;
+		for (e = 0; e < jt->sep_sizes[c]; e++) {
+			sum += separator[e];
+		}
+		if (sum <= 0.0) {
+			jt->consistent = 0;
+			break;
+		}
+		for (e = 0; e < jt->sep_sizes[c]; e++) {
+			separator[e] /= sum;
+		}
+		log_scale += log (sum);
+
+		parent_potential = jt->potentials[p];
+		map = jt->parent_sep_maps[c];
+		for (e = 0; e < jt->table_sizes[p]; e++) {
+			parent_potential[e] *= separator[map[e]];
+		}
+	}
+
+	// Probability of the findings, and normalize the roots
+	if (jt->consistent) {
+		for (i = 0; i < jt->clique_count; i++) {
+			c = jt->order[i];
+			if (jt->parent[c] >= 0) {
+				continue;
+			}
+			potential = jt->potentials[c];
+			sum = 0.0;
+			for (e = 0; e < jt->table_sizes[c]; e++) {
+				sum += potential[e];
+			}
+			if (sum <= 0.0) {
+				jt->consistent = 0;
+				break;
+			}
+			for (e = 0; e < jt->table_sizes[c]; e++) {
+				potential[e] /= sum;
+			}
+			log_scale += log (sum);
+		}
+	}
+	jt->log_probability = (jt->consistent ? log_scale : -INFINITY);
+	jt->propagated_findings = -1; // set by blbn_engine_update if findings are the net's own
+	jt->propagated_tables = net->table_version;
+	jt->propagation_count = ++blbn_jt_propagations;
+	if (!jt->consistent) {
+		jt->distributed = 0;
+		return -1;
+	}
+
+	// Distribute (parents before children)
+	if (root_node >= 0) {
+		on_path = (char *) calloc (jt->clique_count, 1);
+		for (c = jt->home_clique[root_node]; c >= 0; c = jt->parent[c]) {
+			on_path[c] = 1;
+		}
+	}
+	for (i = 0; i < jt->clique_count; i++) {
+		c = jt->order[i];
+		p = jt->parent[c];
+		if (p < 0 || (on_path != NULL && !on_path[c])) {
+			continue;
+		}
+		size = jt->sep_sizes[c];
+		separator = (double *) malloc (size * sizeof (double));
+		blbn_jt_marginalize (jt->potentials[p], jt->table_sizes[p], jt->parent_sep_maps[c], separator, size);
+		for (e = 0; e < size; e++) {
+			// Ratio of the new to the old separator (0/0 = 0)
+			separator[e] = (jt->separators[c][e] > 0.0 ? separator[e] / jt->separators[c][e] : 0.0);
+		}
+		potential = jt->potentials[c];
+		map = jt->sep_maps[c];
+		for (e = 0; e < jt->table_sizes[c]; e++) {
+			potential[e] *= separator[map[e]];
+		}
+		free (separator);
+	}
+	jt->distributed = (on_path == NULL);
+	free (on_path);
+
+	return 0;
+}
+
+double blbn_jt_findings_log_probability (const net_bn *net) {
+	return (net->jtree != NULL ? net->jtree->log_probability : -INFINITY);
+}
+
+/**
+ * Computes the posterior marginal of node from its home clique (the last
+ * propagation must have reached it).
+ */
+void blbn_jt_node_marginal (const net_bn *net, const node_bn *node, double *marginal) {
+	const blbn_jtree_t *jt = net->jtree;
+	int c = jt->home_clique[node->index];
+	int stride = jt->home_strides[node->index];
+	int k = node->state_count;
+	const double *potential = jt->potentials[c];
+	double sum = 0.0;
+	int e, s;
+
+	for (s = 0; s < k; s++) {
+		marginal[s] = 0.0;
+	}
+	for (e = 0; e < jt->table_sizes[c]; e++) {
+		marginal[(e / stride) % k] += potential[e];
+	}
+	for (s = 0; s < k; s++) {
+		sum += marginal[s];
+	}
+	for (s = 0; s < k; s++) {
+		marginal[s] = (sum > 0.0 ? marginal[s] / sum : 1.0 / k);
+	}
+}
+
+/**
+ * Computes the posterior joint marginal of node and its parents, indexed like
+ * its CPT (config * state_count + state).
+ */
+void blbn_jt_family_marginal (const net_bn *net, const node_bn *node, double *marginal) {
+	const blbn_jtree_t *jt = net->jtree;
+	int c = jt->family_clique[node->index];
+	const int *map = jt->family_maps[node->index];
+	const double *potential = jt->potentials[c];
+	int size = node->config_count * node->state_count;
+	double sum = 0.0;
+	int e;
+
+	memset (marginal, 0, size * sizeof (double));
+	for (e = 0; e < jt->table_sizes[c]; e++) {
+		marginal[map[e]] += potential[e];
+		sum += potential[e];
+	}
+	if (sum > 0.0) {
+		for (e = 0; e < size; e++) {
+			marginal[e] /= sum;
+		}
+	}
+}
+
+/**
+ * Computes the posterior joint marginal of nodes a and b (a distinct from b),
+ * indexed joint[state of a * states of b + state of b] (the last propagation
+ * must have reached every clique).  If a clique contains both nodes the joint
+ * is read from it; otherwise b is carried as an extra variable along the tree
+ * path from its home clique to the home clique of a, each step multiplying
+ * the next clique by the ratio of the message over (b, separator) to the
+ * separator marginal.  Nodes in different trees of the forest are
+ * independent.
+ */
+void blbn_jt_joint_marginal (const net_bn *net, const node_bn *a, const node_bn *b, double *joint) {
+	const blbn_jtree_t *jt = net->jtree;
+	int ka = a->state_count, kb = b->state_count;
+	int *path = NULL;
+	int *ancestors = NULL;
+	double *table = NULL, *next = NULL, *message = NULL, *sep_marginal = NULL;
+	double *marginal_a = NULL, *marginal_b = NULL;
+	const int *out_map = NULL, *in_map = NULL;
+	int path_length, ancestor_count, child, sep_size;
+	int c, d, e, s, i, x, y, stride_a, stride_b;
+	double sum = 0.0;
+
+	memset (joint, 0, ka * kb * sizeof (double));
+
+	// The smallest clique containing both nodes
+	c = -1;
+	for (d = 0; d < jt->clique_count; d++) {
+		if (blbn_jt_contains (jt, d, a->index) && blbn_jt_contains (jt, d, b->index) && (c < 0 || jt->table_sizes[d] < jt->table_sizes[c])) {
+			c = d;
+		}
+	}
+	if (c >= 0) {
+		stride_a = blbn_jt_stride (net, jt, c, a->index);
+		stride_b = blbn_jt_stride (net, jt, c, b->index);
+		for (e = 0; e < jt->table_sizes[c]; e++) {
+			joint[((e / stride_a) % ka) * kb + (e / stride_b) % kb] += jt->potentials[c][e];
+		}
+	} else {
+		// Path from the home clique of b up to the first common ancestor with
+		// the home clique of a, then down to it
+		path = (int *) malloc (2 * jt->clique_count * sizeof (int));
+		ancestors = (int *) malloc (jt->clique_count * sizeof (int));
+		ancestor_count = 0;
+		for (y = jt->home_clique[a->index]; y >= 0; y = jt->parent[y]) {
+			ancestors[ancestor_count++] = y;
+		}
+		path_length = 0;
+		for (x = jt->home_clique[b->index]; x >= 0; x = jt->parent[x]) {
+			path[path_length++] = x;
+			for (i = 0; i < ancestor_count && ancestors[i] != x; i++);
+			if (i < ancestor_count) {
+				break;
+			}
+		}
+
+		if (x < 0) {
+			// Different trees: independent
+			marginal_a = (double *) malloc (ka * sizeof (double));
+			marginal_b = (double *) malloc (kb * sizeof (double));
+			blbn_jt_node_marginal (net, a, marginal_a);
+			blbn_jt_node_marginal (net, b, marginal_b);
+			for (x = 0; x < ka; x++) {
+				for (y = 0; y < kb; y++) {
+					joint[x * kb + y] = marginal_a[x] * marginal_b[y];
+				}
+			}
+			free (marginal_a);
+			free (marginal_b);
+			free (ancestors);
+			free (path);
+			return;
+		}
+		for (i = i - 1; i >= 0; i--) {
+			path[path_length++] = ancestors[i];
+		}
+		free (ancestors);
+
+		// table[s * size + e] = P(b = s, clique = e)
+		c = path[0];
+		stride_b = blbn_jt_stride (net, jt, c, b->index);
+		table = (double *) calloc ((size_t) kb * jt->table_sizes[c], sizeof (double));
+		for (e = 0; e < jt->table_sizes[c]; e++) {
+			table[((e / stride_b) % kb) * jt->table_sizes[c] + e] = jt->potentials[c][e];
+		}
+		for (i = 1; i < path_length; i++) {
+			x = path[i - 1];
+			y = path[i];
+			child = (jt->parent[x] == y ? x : y);
+			out_map = (child == x ? jt->sep_maps[child] : jt->parent_sep_maps[child]);
+			in_map = (child == y ? jt->sep_maps[child] : jt->parent_sep_maps[child]);
+			sep_size = jt->sep_sizes[child];
+
+			message = (double *) calloc ((size_t) kb * sep_size, sizeof (double));
+			sep_marginal = (double *) calloc (sep_size, sizeof (double));
+			for (s = 0; s < kb; s++) {
+				for (e = 0; e < jt->table_sizes[x]; e++) {
+					message[s * sep_size + out_map[e]] += table[s * jt->table_sizes[x] + e];
+				}
+				for (e = 0; e < sep_size; e++) {
+					sep_marginal[e] += message[s * sep_size + e];
+				}
+			}
+
+			next = (double *) malloc ((size_t) kb * jt->table_sizes[y] * sizeof (double));
+			for (s = 0; s < kb; s++) {
+				for (e = 0; e < jt->table_sizes[y]; e++) {
+					d = in_map[e];
+					// Ratio of the message to the separator marginal (0/0 = 0)
+					next[s * jt->table_sizes[y] + e] = (sep_marginal[d] > 0.0 ? jt->potentials[y][e] * message[s * sep_size + d] / sep_marginal[d] : 0.0);
+				}
+			}
+			free (message);
+			free (sep_marginal);
+			free (table);
+			table = next;
+		}
+
+		c = path[path_length - 1];
+		stride_a = blbn_jt_stride (net, jt, c, a->index);
+		for (s = 0; s < kb; s++) {
+			for (e = 0; e < jt->table_sizes[c]; e++) {
+				joint[((e / stride_a) % ka) * kb + s] += table[s * jt->table_sizes[c] + e];
+			}
+		}
+		free (table);
+		free (path);
+	}
+
+	for (e = 0; e < ka * kb; e++) {
+		sum += joint[e];
+	}
+	if (sum > 0.0) {
+		for (e = 0; e < ka * kb; e++) {
+			joint[e] /= sum;
+		}
+	}
+}
+
+/**
+ * Computes the joint beliefs of two nodes of the same net given the net's
+ * findings (see blbn_jt_joint_marginal) with a single propagation, instead of
+ * one propagation per state of node2 with GetNodeBeliefs_bn.  This is an
+ * extension of the Netica API.  Returns 0 on success, -1 if the findings are
+ * inconsistent.
+ */
+int blbn_engine_joint_beliefs (node_bn *node1, node_bn *node2, double *joint) {
+	if (node1 == NULL || node2 == NULL || node1 == node2 || node1->net != node2->net) {
+		return -1;
+	}
+	if (blbn_engine_update (node1->net) != 0) {
+		return -1;
+	}
+	blbn_jt_joint_marginal (node1->net, node1, node2, joint);
+	return 0;
+}
+
+/**
+ * Computes the beliefs of node given the findings of its net in double
+ * precision (GetNodeBeliefs_bn reports them as prob_bn), as the net testers
+ * do.  This is an extension of the Netica API.  Returns 0 on success, -1 if
+ * the findings are inconsistent.
+ */
+int blbn_engine_node_beliefs (node_bn *node, double *beliefs) {
+	if (node == NULL || blbn_engine_update (node->net) != 0) {
+		return -1;
+	}
+	blbn_jt_node_marginal (node->net, node, beliefs);
+	return 0;
+}
+
+/**
+ * Propagates the net's own findings if they (or its CPTs) changed since the
+ * last propagation, or if the last propagation didn't reach every clique.
+ * Returns 0 on success, -1 if the findings are inconsistent.
+ */
+int blbn_engine_update (net_bn *net) {
+	blbn_jtree_t *jt = NULL;
+	state_bn *findings = NULL;
+	int i, result;
+
+	blbn_engine_ensure_compiled (net);
+	jt = net->jtree;
+	if (jt == NULL) {
+		return -1;
+	}
+	if (jt->propagated_findings == net->findings_version && jt->propagated_tables == net->table_version && jt->distributed) {
+		return (jt->consistent ? 0 : -1);
+	}
+
+	findings = (state_bn *) malloc ((net->nodes->length + 1) * sizeof (state_bn));
+	for (i = 0; i < net->nodes->length; i++) {
+		findings[i] = net->nodes->nodes[i]->finding;
+	}
+	result = blbn_jt_propagate (net, findings, -1);
+	jt->propagated_findings = net->findings_version;
+	free (findings);
+
+	if (result != 0) {
+		blbn_engine_error (net->env, 1101, ERROR_ERR, "Findings in net '%s' are inconsistent", net->name);
+	}
+	return result;
+}
+
+void CompileNet_bn (net_bn* net) {
+	if (net != NULL) {
+		blbn_engine_ensure_compiled (net);
+	}
+}
+
+void UncompileNet_bn (net_bn* net) {
+	if (net != NULL && net->jtree != NULL) {
+		blbn_jt_free (net->jtree);
+		net->jtree = NULL;
+	}
+}
+
+const prob_bn* GetNodeBeliefs_bn (node_bn* node) {
+	net_bn *net = NULL;
+	double *marginal = NULL;
+	int s;
+
+	if (node == NULL) {
+		return NULL;
+	}
+	net = node->net;
+	if (blbn_engine_update (net) != 0) {
+		return NULL;
+	}
+	if (node->beliefs_version != net->jtree->propagation_count) {
+		marginal = (double *) malloc (node->state_count * sizeof (double));
+		blbn_jt_node_marginal (net, node, marginal);
+		for (s = 0; s < node->state_count; s++) {
+			node->beliefs[s] = (prob_bn) marginal[s];
+		}
+		free (marginal);
+		node->beliefs_version = net->jtree->propagation_count;
+	}
+	return node->beliefs;
+}
+
+double FindingsProbability_bn (net_bn* net) {
+	if (net == NULL || blbn_engine_update (net) != 0) {
+		return 0.0;
+	}
+	return exp (blbn_jt_findings_log_probability (net));
+}
+
+double GetNodeExpectedValue_bn (node_bn* node, double* std_dev, double* x3, double* x4) {
+	blbn_engine_error (node != NULL ? node->net->env : NULL, 1102, ERROR_ERR, "GetNodeExpectedValue_bn is not supported (nodes have no levels)");
+	return UNDEF_DBL;
+}
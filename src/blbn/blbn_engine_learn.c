@@ -0,0 +1,591 @@
+/*
+ * blbn_engine_learn.c
+ *
+ *  Created: 2026-10-16
+ *
+ * Learning and testing for the native engine (see blbn_engine.h): counting
+ * and EM learning from case sets, ReviseCPTsByFindings_bn, net testers and
+ * random case generation.
+ */
+
+#include "blbn_engine.h"
+
+/**
+ * Decodes the cases of a case table into findings for every node of the net
+ * (findings[case * node_count + node], -1 if missing).
+ */
+state_bn* blbn_casetable_decode (const blbn_casetable_t *table, const net_bn *net) {
+	int n = net->nodes->length;
+	state_bn *findings = (state_bn *) malloc (((long) table->case_count * n + 1) * sizeof (state_bn));
+	int *column_nodes = blbn_casetable_column_nodes (table, net->nodes);
+	int **value_states = blbn_casetable_value_states (table, net->nodes, column_nodes);
+	int c, j, value;
+
+	for (j = 0; j < table->case_count; j++) {
+		for (c = 0; c < n; c++) {
+			findings[(long) j * n + c] = -1;
+		}
+		for (c = 0; c < table->column_count; c++) {
+			value = table->data[j * table->column_count + c];
+			if (column_nodes[c] >= 0 && value >= 0) {
+				findings[(long) j * n + column_nodes[c]] = value_states[c][value];
+			}
+		}
+	}
+
+	blbn_casetable_free_value_states (table, value_states);
+	free (column_nodes);
+	return findings;
+}
+
+/**
+ * Returns the CPT entry (config * state_count + state) of node for the
+ * findings, or -1 if the node or any parent is unobserved.
+ */
+int blbn_engine_family_entry (const node_bn *node, const state_bn *findings) {
+	int i, entry = 0;
+
+	for (i = 0; i < node->parents->length; i++) {
+		if (findings[node->parents->nodes[i]->index] < 0) {
+			return -1;
+		}
+		entry = entry * node->parents->nodes[i]->state_count + findings[node->parents->nodes[i]->index];
+	}
+	if (findings[node->index] < 0) {
+		return -1;
+	}
+	return entry * node->state_count + findings[node->index];
+}
+
+//------------------------------------------------------------------------------
+// Learners
+//------------------------------------------------------------------------------
+
+learner_bn* NewLearner_bn (learn_method_bn method, const char* info, environ_ns* env) {
+	learner_bn *learner = NULL;
+
+	if (method != COUNTING_LEARNING && method != EM_LEARNING) {
+		blbn_engine_error (env, 1200, ERROR_ERR, "Learning method %d is not supported", method);
+		return NULL;
+	}
+	learner = (learner_bn *) calloc (1, sizeof (learner_bn));
+	learner->env = env;
+	learner->method = method;
+	learner->max_iters = BLBN_ENGINE_EM_MAX_ITERS;
+	learner->max_tol = BLBN_ENGINE_EM_TOLERANCE;
+	return learner;
+}
+
+void DeleteLearner_bn (learner_bn* algo) {
+	free (algo);
+}
+
+int SetLearnerMaxIters_bn (learner_bn* algo, int max_iters) {
+	int previous = 0;
+
+	if (algo != NULL) {
+		previous = algo->max_iters;
+		if (max_iters > 0) {
+			algo->max_iters = max_iters;
+		}
+	}
+	return previous;
+}
+
+double SetLearnerMaxTol_bn (learner_bn* algo, double log_likeli_tol) {
+	double previous = 0.0;
+
+	if (algo != NULL) {
+		previous = algo->max_tol;
+		if (log_likeli_tol > 0.0) {
+			algo->max_tol = log_likeli_tol;
+		}
+	}
+	return previous;
+}
+
+/**
+ * Sets the CPT and experience of node from prior counts plus counts (both
+ * indexed like the CPT).  Rows with no counts at all are left uniform.
+ */
+void blbn_engine_set_counts (node_bn *node, const double *prior, const double *counts) {
+	int k = node->state_count;
+	int config, s;
+	double total;
+
+	blbn_engine_own_tables (node);
+	if (node->probs == NULL) {
+		node->probs = (prob_bn *) malloc (node->config_count * k * sizeof (prob_bn));
+	}
+	if (node->experience == NULL) {
+		node->experience = (double *) malloc (node->config_count * sizeof (double));
+	}
+	for (config = 0; config < node->config_count; config++) {
+		total = 0.0;
+		for (s = 0; s < k; s++) {
+			total += prior[config * k + s] + counts[config * k + s];
+		}
+		for (s = 0; s < k; s++) {
+			node->probs[config * k + s] = (total > 0.0 ? (prior[config * k + s] + counts[config * k + s]) / total : 1.0 / k);
+		}
+		node->experience[config] = total;
+	}
+}
+
+/**
+ * Returns the prior counts of node (its CPT times its experience, which is
+ * taken as 1 if the node has no experience table).
+ */
+double* blbn_engine_prior_counts (const node_bn *node) {
+	int k = node->state_count;
+	double *prior = (double *) malloc (node->config_count * k * sizeof (double));
+	double experience;
+	int config, s;
+
+	for (config = 0; config < node->config_count; config++) {
+		experience = (node->experience != NULL ? node->experience[config] : 1.0);
+		if (!(experience >= 0.0)) {
+			experience = 1.0;
+		}
+		for (s = 0; s < k; s++) {
+			prior[config * k + s] = (node->probs != NULL ? node->probs[config * k + s] : 1.0 / k) * experience;
+		}
+	}
+	return prior;
+}
+
+void LearnCPTs_bn (learner_bn* algo, const nodelist_bn* nodes, const caseset_cs* cases, double degree) {
+	net_bn *net = NULL;
+	node_bn *node = NULL;
+	const blbn_casetable_t *table = NULL;
+	state_bn *findings = NULL;
+	const state_bn *row = NULL;
+	double **prior = NULL;
+	double **counts = NULL;
+	double *marginal = NULL;
+	char *learn = NULL;
+	char *complete = NULL; // [case] every node observed
+	double weight, total_weight, log_likelihood, previous_log_likelihood = 0.0;
+	int n, i, j, v, e, entry, iteration, size, max_size = 1, needs_inference = 0;
+
+	if (algo == NULL || nodes == NULL || cases == NULL || nodes->length == 0 || degree <= 0.0) {
+		return;
+	}
+	net = nodes->nodes[0]->net;
+	n = net->nodes->length;
+	table = cases->table;
+	findings = blbn_casetable_decode (table, net);
+
+	learn = (char *) calloc (n, 1);
+	prior = (double **) calloc (n, sizeof (double *));
+	counts = (double **) calloc (n, sizeof (double *));
+	for (i = 0; i < nodes->length; i++) {
+		node = nodes->nodes[i];
+		if (node == NULL || node->net != net || learn[node->index]) {
+			continue;
+		}
+		learn[node->index] = 1;
+		size = node->config_count * node->state_count;
+		prior[node->index] = blbn_engine_prior_counts (node);
+		counts[node->index] = (double *) calloc (size, sizeof (double));
+		if (size > max_size) {
+			max_size = size;
+		}
+	}
+	marginal = (double *) malloc (max_size * sizeof (double));
+
+	complete = (char *) malloc (table->case_count + 1);
+	for (j = 0; j < table->case_count; j++) {
+		complete[j] = 1;
+		for (v = 0; v < n; v++) {
+			if (findings[(long) j * n + v] < 0) {
+				complete[j] = 0;
+				needs_inference = 1;
+				break;
+			}
+		}
+	}
+
+	for (iteration = 0; iteration < (algo->method == EM_LEARNING ? algo->max_iters : 1); iteration++) {
+		for (v = 0; v < n; v++) {
+			if (learn[v]) {
+				memset (counts[v], 0, net->nodes->nodes[v]->config_count * net->nodes->nodes[v]->state_count * sizeof (double));
+			}
+		}
+		log_likelihood = 0.0;
+		total_weight = 0.0;
+
+		for (j = 0; j < table->case_count; j++) {
+			row = &findings[(long) j * n];
+			weight = table->freq[j] * degree;
+			if (weight <= 0.0) {
+				continue;
+			}
+
+			if (complete[j] || algo->method == COUNTING_LEARNING) {
+				// Count the families that are fully observed
+				for (v = 0; v < n; v++) {
+					node = net->nodes->nodes[v];
+					entry = blbn_engine_family_entry (node, row);
+					if (entry < 0) {
+						continue;
+					}
+					if (learn[v]) {
+						counts[v][entry] += weight;
+					}
+					if (complete[j] && node->probs != NULL) {
+						log_likelihood += weight * log (node->probs[entry]);
+					}
+				}
+				if (complete[j]) {
+					total_weight += weight;
+				}
+				continue;
+			}
+
+			// Expected counts from the posterior family marginals
+			if (blbn_jt_propagate (net, row, -1) != 0) {
+				continue;
+			}
+			log_likelihood += weight * blbn_jt_findings_log_probability (net);
+			total_weight += weight;
+			for (v = 0; v < n; v++) {
+				if (!learn[v]) {
+					continue;
+				}
+				node = net->nodes->nodes[v];
+				size = node->config_count * node->state_count;
+				blbn_jt_family_marginal (net, node, marginal);
+				for (e = 0; e < size; e++) {
+					counts[v][e] += weight * marginal[e];
+				}
+			}
+		}
+
+		for (v = 0; v < n; v++) {
+			if (learn[v]) {
+				blbn_engine_set_counts (net->nodes->nodes[v], prior[v], counts[v]);
+			}
+		}
+		blbn_engine_table_changed (net);
+
+		if (algo->method != EM_LEARNING || !needs_inference) {
+			break;
+		}
+		if (iteration > 0 && total_weight > 0.0 && fabs (log_likelihood - previous_log_likelihood) / total_weight < algo->max_tol) {
+			break;
+		}
+		previous_log_likelihood = log_likelihood;
+	}
+
+	for (v = 0; v < n; v++) {
+		free (prior[v]);
+		free (counts[v]);
+	}
+	free (prior);
+	free (counts);
+	free (marginal);
+	free (complete);
+	free (learn);
+	free (findings);
+}
+
+void ReviseCPTsByFindings_bn (const nodelist_bn* nodes, int updating, double degree) {
+	const net_bn *net = NULL;
+	node_bn *node = NULL;
+	state_bn *findings = NULL;
+	double experience, total;
+	int i, s, k, entry, config;
+
+	if (nodes == NULL || nodes->length == 0 || degree == 0.0) {
+		return;
+	}
+	net = nodes->nodes[0]->net;
+	findings = (state_bn *) malloc ((net->nodes->length + 1) * sizeof (state_bn));
+	for (i = 0; i < net->nodes->length; i++) {
+		findings[i] = net->nodes->nodes[i]->finding;
+	}
+
+	// Add (or, with a negative degree, remove) one case for every node whose
+	// family is fully observed
+	for (i = 0; i < nodes->length; i++) {
+		node = nodes->nodes[i];
+		entry = blbn_engine_family_entry (node, findings);
+		if (entry < 0) {
+			continue;
+		}
+		k = node->state_count;
+		config = entry / k;
+		blbn_engine_alloc_probs (node);
+		blbn_engine_alloc_experience (node);
+		experience = node->experience[config];
+		if (!(experience >= 0.0)) {
+			experience = 1.0;
+		}
+		total = experience + degree;
+		if (total <= 0.0) {
+			blbn_engine_error (net->env, 1201, WARNING_ERR, "Removing a case from node '%s' would leave no experience", node->name);
+			continue;
+		}
+		for (s = 0; s < k; s++) {
+			node->probs[config * k + s] = (node->probs[config * k + s] * experience + (s == findings[node->index] ? degree : 0.0)) / total;
+			if (node->probs[config * k + s] < 0.0) {
+				node->probs[config * k + s] = 0.0;
+			}
+		}
+		node->experience[config] = total;
+	}
+	blbn_engine_table_changed ((net_bn *) net);
+
+	free (findings);
+}
+
+//------------------------------------------------------------------------------
+// Net testers
+//------------------------------------------------------------------------------
+
+tester_bn* NewNetTester_bn (const nodelist_bn* test_nodes, const nodelist_bn* unobsv_nodes, int tests) {
+	tester_bn *test = NULL;
+	int i;
+
+	if (test_nodes == NULL || test_nodes->length == 0) {
+		return NULL;
+	}
+	test = (tester_bn *) calloc (1, sizeof (tester_bn));
+	test->test_nodes = DupNodeList_bn (test_nodes);
+	test->unobsv_nodes = (unobsv_nodes != NULL ? DupNodeList_bn (unobsv_nodes) : NewNodeList2_bn (0, test_nodes->net));
+	test->confusion = (double **) calloc (test_nodes->length, sizeof (double *));
+	test->log_loss = (double *) calloc (test_nodes->length, sizeof (double));
+	test->quadratic_loss = (double *) calloc (test_nodes->length, sizeof (double));
+	test->count = (double *) calloc (test_nodes->length, sizeof (double));
+	for (i = 0; i < test_nodes->length; i++) {
+		test->confusion[i] = (double *) calloc (test_nodes->nodes[i]->state_count * test_nodes->nodes[i]->state_count, sizeof (double));
+	}
+	return test;
+}
+
+void DeleteNetTester_bn (tester_bn* test) {
+	int i;
+
+	if (test == NULL) {
+		return;
+	}
+	for (i = 0; i < test->test_nodes->length; i++) {
+		free (test->confusion[i]);
+	}
+	free (test->confusion);
+	free (test->log_loss);
+	free (test->quadratic_loss);
+	free (test->count);
+	DeleteNodeList_bn (test->unobsv_nodes);
+	DeleteNodeList_bn (test->test_nodes);
+	free (test);
+}
+
+void TestWithCaseset_bn (tester_bn* test, const caseset_cs* cases) {
+	net_bn *net = NULL;
+	const node_bn *node = NULL;
+	const blbn_casetable_t *table = NULL;
+	state_bn *findings = NULL;
+	state_bn *row = NULL;
+	char *hidden = NULL;
+	double *marginal = NULL;
+	double weight, p, quadratic;
+	int n, i, j, v, s, predicted, actual, max_states = 1;
+
+	if (test == NULL || cases == NULL) {
+		return;
+	}
+	net = test->test_nodes->nodes[0]->net;
+	n = net->nodes->length;
+	table = cases->table;
+	findings = blbn_casetable_decode (table, net);
+
+	hidden = (char *) calloc (n, 1);
+	for (i = 0; i < test->test_nodes->length; i++) {
+		hidden[test->test_nodes->nodes[i]->index] = 1;
+		if (test->test_nodes->nodes[i]->state_count > max_states) {
+			max_states = test->test_nodes->nodes[i]->state_count;
+		}
+	}
+	for (i = 0; i < test->unobsv_nodes->length; i++) {
+		hidden[test->unobsv_nodes->nodes[i]->index] = 1;
+	}
+	row = (state_bn *) malloc ((n + 1) * sizeof (state_bn));
+	marginal = (double *) malloc (max_states * sizeof (double));
+
+	for (j = 0; j < table->case_count; j++) {
+		weight = table->freq[j];
+		for (v = 0; v < n; v++) {
+			row[v] = (hidden[v] ? -1 : findings[(long) j * n + v]);
+		}
+		// With a single test node only the path to its home clique is needed
+		if (blbn_jt_propagate (net, row, (test->test_nodes->length == 1 ? test->test_nodes->nodes[0]->index : -1)) != 0) {
+			continue;
+		}
+
+		for (i = 0; i < test->test_nodes->length; i++) {
+			node = test->test_nodes->nodes[i];
+			actual = findings[(long) j * n + node->index];
+			if (actual < 0) {
+				continue;
+			}
+			blbn_jt_node_marginal (net, node, marginal);
+			predicted = 0;
+			quadratic = 1.0;
+			for (s = 0; s < node->state_count; s++) {
+				if (marginal[s] > marginal[predicted]) {
+					predicted = s;
+				}
+				quadratic += marginal[s] * marginal[s];
+			}
+			p = marginal[actual];
+			test->confusion[i][predicted * node->state_count + actual] += weight;
+			test->log_loss[i] += weight * (p > 0.0 ? -log (p) : -log (DBL_MIN));
+			test->quadratic_loss[i] += weight * (quadratic - 2.0 * p);
+			test->count[i] += weight;
+		}
+	}
+
+	free (marginal);
+	free (row);
+	free (hidden);
+	free (findings);
+}
+
+/**
+ * Returns the position of node in the tester's test nodes (-1 if absent).
+ */
+int blbn_engine_test_index (const tester_bn *test, const node_bn *node) {
+	int i = (test != NULL ? IndexOfNodeInList_bn (node, test->test_nodes, 0) : -1);
+
+	if (i < 0 && node != NULL) {
+		blbn_engine_error (node->net->env, 1210, ERROR_ERR, "Node '%s' is not a test node of the net tester", node->name);
+	}
+	return i;
+}
+
+double GetTestConfusion_bn (const tester_bn* test, const node_bn* node, state_bn predicted, state_bn actual) {
+	int i = blbn_engine_test_index (test, node);
+
+	if (i < 0 || predicted < 0 || actual < 0 || predicted >= node->state_count || actual >= node->state_count) {
+		return UNDEF_DBL;
+	}
+	return test->confusion[i][predicted * node->state_count + actual];
+}
+
+double GetTestErrorRate_bn (const tester_bn* test, const node_bn* node) {
+	int i = blbn_engine_test_index (test, node);
+	double correct = 0.0;
+	int s;
+
+	if (i < 0 || test->count[i] <= 0.0) {
+		return UNDEF_DBL;
+	}
+	for (s = 0; s < node->state_count; s++) {
+		correct += test->confusion[i][s * node->state_count + s];
+	}
+	return 1.0 - correct / test->count[i];
+}
+
+double GetTestLogLoss_bn (const tester_bn* test, const node_bn* node) {
+	int i = blbn_engine_test_index (test, node);
+
+	if (i < 0 || test->count[i] <= 0.0) {
+		return UNDEF_DBL;
+	}
+	return test->log_loss[i] / test->count[i];
+}
+
+double GetTestQuadraticLoss_bn (const tester_bn* test, const node_bn* node) {
+	int i = blbn_engine_test_index (test, node);
+
+	if (i < 0 || test->count[i] <= 0.0) {
+		return UNDEF_DBL;
+	}
+	return test->quadratic_loss[i] / test->count[i];
+}
+
+//------------------------------------------------------------------------------
+// Random cases
+//------------------------------------------------------------------------------
+
+/**
+ * Appends node and its ancestors to order, parents first.
+ */
+void blbn_engine_topological (const node_bn *node, char *visited, int *order, int *count) {
+	int i;
+
+	if (visited[node->index]) {
+		return;
+	}
+	visited[node->index] = 1;
+	for (i = 0; i < node->parents->length; i++) {
+		blbn_engine_topological (node->parents->nodes[i], visited, order, count);
+	}
+	order[(*count)++] = node->index;
+}
+
+/**
+ * Generates a random case by forward sampling and enters it as findings for
+ * nodes.  Findings already entered in the net are respected by rejection
+ * (up to num tries per node of the net).  Returns 0 on success, -1 if no
+ * consistent case was found.
+ */
+int GenerateRandomCase_bn (const nodelist_bn* nodes, int method, double num, void* gen) {
+	net_bn *net = NULL;
+	const node_bn *node = NULL;
+	state_bn *sample = NULL;
+	int *order = NULL;
+	char *visited = NULL;
+	long tries, max_tries;
+	int n, count = 0, i, v, s, config, rejected = 1;
+	double u, cumulative;
+
+	if (nodes == NULL || nodes->length == 0) {
+		return -1;
+	}
+	net = nodes->nodes[0]->net;
+	n = net->nodes->length;
+	order = (int *) malloc ((n + 1) * sizeof (int));
+	visited = (char *) calloc (n, 1);
+	sample = (state_bn *) malloc ((n + 1) * sizeof (state_bn));
+	for (v = 0; v < n; v++) {
+		blbn_engine_topological (net->nodes->nodes[v], visited, order, &count);
+	}
+
+	max_tries = (long) ((num > 1.0 ? num : 1.0) * n);
+	for (tries = 0; tries < max_tries && rejected; tries++) {
+		rejected = 0;
+		for (i = 0; i < n && !rejected; i++) {
+			node = net->nodes->nodes[order[i]];
+			config = 0;
+			for (v = 0; v < node->parents->length; v++) {
+				config = config * node->parents->nodes[v]->state_count + sample[node->parents->nodes[v]->index];
+			}
+			u = rand () / (RAND_MAX + 1.0);
+			cumulative = 0.0;
+			for (s = 0; s < node->state_count - 1; s++) {
+				cumulative += (node->probs != NULL ? node->probs[config * node->state_count + s] : 1.0 / node->state_count);
+				if (u < cumulative) {
+					break;
+				}
+			}
+			sample[node->index] = s;
+			if (node->finding >= 0 && node->finding != s) {
+				rejected = 1;
+			}
+		}
+	}
+
+	if (!rejected) {
+		for (i = 0; i < nodes->length; i++) {
+			EnterFinding_bn (nodes->nodes[i], sample[nodes->nodes[i]->index]);
+		}
+	}
+
+	free (sample);
+	free (visited);
+	free (order);
+	return (rejected ? -1 : 0);
+}
@@ -0,0 +1,341 @@
+/*
+ *  blbn_bench.c
+ *
+ *  Microbenchmarks for the blbn learning primitives and selection policies.
+ *
+ *  blbn_bench
+ *  -m "./data/Asia/Asia.dne.normal" -d "./data/Asia/Asia.cas.0" -v "./data/Asia/Asia.cas.0v"
+ *  -t "TbOrCa" -n 20 -s 10 -o "./results/bench.tsv"
+ *
+ *  -m, -d, -v and -t are the model, training data, validation data and target
+ *  node (as for blbn_learner; -m is the full path of the network file).
+ *  -s <purchases> round robin purchases are made first so that the learned
+ *  network and the flags are in a realistic mid-run state (default 10), and
+ *  every benchmark is then called -n <calls> times (default 20).  -w
+ *  <worker_count> scores the lookahead policies with that many processes,
+ *  -c "case-major" benchmarks with case-major data matrices (see
+ *  blbn_set_data_layout), and -j "downdate" derives leave-one-out networks
+ *  by downdating expected counts (see blbn_util_copy_net_unlearn_case).
+ *  The cheating policy is not benchmarked (it is an oracle, not a selection
+ *  policy).
+ *
+ *  For every benchmark one line is written to the output file (-o, default
+ *  "blbn_bench.tsv"), tab separated:
+ *
+ *    benchmark  calls  median_ns  p95_ns  mean_ns  allocations_per_call
+ *
+ *  Times are wall clock (CLOCK_MONOTONIC).  Allocations count the calls to
+ *  malloc, calloc and realloc made during the benchmarked call; they are
+ *  counted by interposing those functions over the glibc allocator, so the
+ *  counts are 0 when not linking against glibc or when building with
+ *  -fsanitize=address.
+ *
+ *  Build with the same sources as blbn_learner, e.g. with the native engine:
+ *
+ *  gcc -O2 -fcommon -o blbn_bench src/blbn_bench.c src/blbn/blbn.c \
+ *      src/blbn/blbn_engine.c src/blbn/blbn_engine_jt.c src/blbn/blbn_engine_learn.c -lm
+ */
+
+# include <stdio.h>
+# include <stdlib.h>
+# include <string.h>
+# include <time.h>
+# include <sys/stat.h>
+# include "blbn/blbn.h"
+
+#define BLBN_BENCH_CALLS     20 // Default number of timed calls per benchmark
+#define BLBN_BENCH_PURCHASES 10 // Default number of purchases made before timing
+
+// A benchmarked call (returns nothing; results are freed by the function)
+typedef void (*blbn_bench_fn_t) (blbn_state_t *state, int case_index);
+
+typedef struct blbn_bench {
+	const char *name;
+	blbn_bench_fn_t fn;
+	blbn_bench_fn_t before; // untimed setup before each call (or NULL)
+	blbn_bench_fn_t after; // untimed cleanup after each call (or NULL)
+} blbn_bench_t;
+
+int file_exists(char *filename);
+
+//------------------------------------------------------------------------------
+// Allocation counting
+//------------------------------------------------------------------------------
+
+static long blbn_bench_allocations = 0; // calls to malloc, calloc and realloc
+
+// The glibc allocator is wrapped unless the build already replaces it
+#if defined(__GLIBC__) && !defined(__SANITIZE_ADDRESS__)
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *pointer, size_t size);
+
+void *malloc(size_t size) {
+	blbn_bench_allocations++;
+	return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+	blbn_bench_allocations++;
+	return __libc_calloc(count, size);
+}
+
+void *realloc(void *pointer, size_t size) {
+	blbn_bench_allocations++;
+	return __libc_realloc(pointer, size);
+}
+#endif
+
+//------------------------------------------------------------------------------
+// Benchmarked calls
+//------------------------------------------------------------------------------
+
+void blbn_bench_learn_case(blbn_state_t *state, int case_index) {
+	blbn_learn_case_v2(state, case_index);
+}
+
+void blbn_bench_unlearn_case(blbn_state_t *state, int case_index) {
+	blbn_unlearn_case_v2(state, case_index);
+}
+
+void blbn_bench_test_rates(blbn_state_t *state, int case_index) {
+	free(blbn_get_test_rates(state));
+}
+
+void blbn_bench_copy_net_unlearn_case(blbn_state_t *state, int case_index) {
+	DeleteNet_bn(blbn_util_copy_net_unlearn_case(state, case_index));
+}
+
+void blbn_bench_sfl_row(blbn_state_t *state, int case_index) {
+	free(blbn_util_sfl_row(state, case_index));
+}
+
+void blbn_bench_merpg(blbn_state_t *state, int case_index) {
+	double **values = blbn_util_merpg(state);
+	int i;
+	for (i = 0; i < state->nodes_consider[0]; i++) {
+		free(values[i]);
+	}
+	free(values);
+}
+
+void blbn_bench_dsep(blbn_state_t *state, int case_index) {
+	int **values = blbn_util_dsep(state);
+	int i;
+	for (i = 0; i < state->nodes_consider[0]; i++) {
+		free(values[i]);
+	}
+	free(values);
+}
+
+void blbn_bench_random(blbn_state_t *state, int case_index) { free(blbn_select_next_random(state)); }
+void blbn_bench_rr(blbn_state_t *state, int case_index) { free(blbn_select_next_rr(state)); }
+void blbn_bench_br(blbn_state_t *state, int case_index) { free(blbn_select_next_br(state)); }
+void blbn_bench_sfl(blbn_state_t *state, int case_index) { free(blbn_select_next_sfl(state)); }
+void blbn_bench_gsfl(blbn_state_t *state, int case_index) { free(blbn_select_next_gsfl(state)); }
+void blbn_bench_rsfl(blbn_state_t *state, int case_index) { free(blbn_select_next_rsfl(state, 10, 1)); }
+void blbn_bench_grsfl(blbn_state_t *state, int case_index) { free(blbn_select_next_grsfl(state, 10, 1)); }
+void blbn_bench_merpg_select(blbn_state_t *state, int case_index) { free(blbn_select_next_merpg(state)); }
+void blbn_bench_merpgdsep(blbn_state_t *state, int case_index) { free(blbn_select_next_merpgdsep(state)); }
+void blbn_bench_merpgdsepw1(blbn_state_t *state, int case_index) { free(blbn_select_next_merpgdsepw1(state)); }
+void blbn_bench_merpgdsepw2(blbn_state_t *state, int case_index) { free(blbn_select_next_merpgdsepw2(state)); }
+
+blbn_bench_t benchmarks[] = {
+	{ "blbn_learn_case_v2", blbn_bench_learn_case, blbn_bench_unlearn_case, NULL },
+	{ "blbn_unlearn_case_v2", blbn_bench_unlearn_case, NULL, blbn_bench_learn_case },
+	{ "blbn_get_test_rates", blbn_bench_test_rates, NULL, NULL },
+	{ "blbn_util_copy_net_unlearn_case", blbn_bench_copy_net_unlearn_case, NULL, NULL },
+	{ "blbn_util_sfl_row", blbn_bench_sfl_row, NULL, NULL },
+	{ "blbn_util_merpg", blbn_bench_merpg, NULL, NULL },
+	{ "blbn_util_dsep", blbn_bench_dsep, NULL, NULL },
+	{ "blbn_select_next_random", blbn_bench_random, NULL, NULL },
+	{ "blbn_select_next_rr", blbn_bench_rr, NULL, NULL },
+	{ "blbn_select_next_br", blbn_bench_br, NULL, NULL },
+	{ "blbn_select_next_sfl", blbn_bench_sfl, NULL, NULL },
+	{ "blbn_select_next_gsfl", blbn_bench_gsfl, NULL, NULL },
+	{ "blbn_select_next_rsfl", blbn_bench_rsfl, NULL, NULL },
+	{ "blbn_select_next_grsfl", blbn_bench_grsfl, NULL, NULL },
+	{ "blbn_select_next_merpg", blbn_bench_merpg_select, NULL, NULL },
+	{ "blbn_select_next_merpgdsep", blbn_bench_merpgdsep, NULL, NULL },
+	{ "blbn_select_next_merpgdsepw1", blbn_bench_merpgdsepw1, NULL, NULL },
+	{ "blbn_select_next_merpgdsepw2", blbn_bench_merpgdsepw2, NULL, NULL },
+};
+
+//------------------------------------------------------------------------------
+// Harness
+//------------------------------------------------------------------------------
+
+long blbn_bench_now_ns() {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (long) now.tv_sec * 1000000000L + now.tv_nsec;
+}
+
+int blbn_bench_compare_ns(const void *a, const void *b) {
+	long x = *(const long *) a, y = *(const long *) b;
+	return (x > y) - (x < y);
+}
+
+/*
+ * Purchases the specified number of findings with the round robin policy (as
+ * blbn_learn1 does) and returns the case of the last purchase, or -1 if
+ * nothing could be purchased.
+ */
+int blbn_bench_advance(blbn_state_t *state, int purchases) {
+	blbn_select_action_t *action = NULL;
+	int case_index = -1;
+	int i;
+
+	for (i = 0; i < purchases && blbn_has_findings_not_available(state); i++) {
+		action = blbn_select_next_rr(state);
+		if (action == NULL) {
+			break;
+		}
+		blbn_append_action(state, action);
+		blbn_set_finding_purchased(state, action->node_index, action->case_index);
+		blbn_revise_by_case_findings(state, action->case_index);
+		case_index = action->case_index;
+		free(action);
+	}
+
+	return case_index;
+}
+
+/*
+ * Calls the benchmark the specified number of times and writes its line to
+ * out_fp.
+ */
+void blbn_bench_run(blbn_state_t *state, const blbn_bench_t *bench, int case_index, int calls, FILE *out_fp) {
+	long *samples = (long *) malloc(calls * sizeof(long));
+	long allocations = 0;
+	long begin;
+	double mean = 0.0;
+	int i;
+
+	for (i = 0; i < calls; i++) {
+		if (bench->before != NULL) {
+			bench->before(state, case_index);
+		}
+		allocations -= blbn_bench_allocations;
+		begin = blbn_bench_now_ns();
+		bench->fn(state, case_index);
+		samples[i] = blbn_bench_now_ns() - begin;
+		allocations += blbn_bench_allocations;
+		if (bench->after != NULL) {
+			bench->after(state, case_index);
+		}
+		mean += samples[i];
+	}
+
+	qsort(samples, calls, sizeof(long), blbn_bench_compare_ns);
+	fprintf(out_fp, "%s\t%d\t%ld\t%ld\t%.0f\t%.1f\n", bench->name, calls,
+			samples[calls / 2], samples[(int) (0.95 * (calls - 1) + 0.5)],
+			mean / calls, (double) allocations / calls);
+	fflush(out_fp);
+
+	free(samples);
+}
+
+int main(int argc, char *argv[]) {
+
+	char data_filepath[512] = { 0 }; // data file path (-d <data_filepath>)
+	char test_data_filepath[512] = { 0 }; // test data file path (-v <test_data_filepath>)
+	char model_filepath[512] = { 0 }; // model/network file path (-m <model_filepath>)
+	char target_node_name[512] = { 0 }; // target node name (-t <target_node_name>)
+	char output_filepath[512] = "blbn_bench.tsv"; // results file (-o <output_filepath>)
+	int calls = BLBN_BENCH_CALLS; // timed calls per benchmark (-n <calls>)
+	int purchases = BLBN_BENCH_PURCHASES; // purchases made before timing (-s <purchases>)
+	int worker_count = 1; // number of lookahead scoring processes (-w <worker_count>)
+	char layout[32] = { 0 }; // data matrix layout (-c <node-major|case-major>)
+	char unlearning[32] = { 0 }; // leave-one-out network mode (-j <relearn|downdate>)
+	blbn_state_t *state = NULL;
+	FILE *out_fp = NULL;
+	int case_index;
+	int i;
+
+	for (i = 1; i + 1 < argc; i++) {
+		if (strcmp(argv[i], "-m") == 0) {
+			strcpy(&model_filepath[0], argv[++i]);
+		} else if (strcmp(argv[i], "-d") == 0) {
+			strcpy(&data_filepath[0], argv[++i]);
+		} else if (strcmp(argv[i], "-v") == 0) {
+			strcpy(&test_data_filepath[0], argv[++i]);
+		} else if (strcmp(argv[i], "-t") == 0) {
+			strcpy(&target_node_name[0], argv[++i]);
+		} else if (strcmp(argv[i], "-o") == 0) {
+			strcpy(&output_filepath[0], argv[++i]);
+		} else if (strcmp(argv[i], "-n") == 0) {
+			calls = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-s") == 0) {
+			purchases = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-w") == 0) {
+			worker_count = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-c") == 0) {
+			strncpy(&layout[0], argv[++i], sizeof(layout) - 1);
+		} else if (strcmp(argv[i], "-j") == 0) {
+			strncpy(&unlearning[0], argv[++i], sizeof(unlearning) - 1);
+		}
+	}
+
+	if (!file_exists(model_filepath) || !file_exists(data_filepath)
+			|| !file_exists(test_data_filepath) || strlen(target_node_name) == 0) {
+		printf("Usage: blbn_bench -m <model> -d <data> -v <validation data> -t <target>"
+				" [-n <calls>] [-s <purchases>] [-w <worker_count>] [-c <layout>] [-j <unlearning>] [-o <output>]\n");
+		exit(1);
+	}
+	if (calls < 1 || purchases < 1 || worker_count < 1) {
+		printf("Error: -n, -s and -w must be positive. Exiting.\n");
+		exit(1);
+	}
+
+	if (blbn_init() != 0) {
+		exit(1);
+	}
+
+	state = blbn_init_state("Bayesian", "Bayesian", data_filepath,
+			test_data_filepath, model_filepath, target_node_name, 0xFFFFFFFF,
+			".", "rr", 10, 0);
+	if (state == NULL) {
+		printf("Error: Could not load the network or data. Exiting.\n");
+		exit(1);
+	}
+	blbn_set_uniform_prior(state, 1.0);
+	state->worker_count = worker_count;
+	if (strcmp(layout, "case-major") == 0) {
+		blbn_set_data_layout(state, BLBN_LAYOUT_CASE_MAJOR);
+	}
+	if (strcmp(unlearning, "downdate") == 0) {
+		state->loo_mode = BLBN_LOO_DOWNDATE;
+	}
+
+	srand(100);
+	case_index = blbn_bench_advance(state, purchases);
+	if (case_index < 0) {
+		printf("Error: No findings could be purchased. Exiting.\n");
+		exit(1);
+	}
+
+	out_fp = fopen(output_filepath, "w");
+	if (out_fp == NULL) {
+		printf("Error: Could not open %s. Exiting.\n", output_filepath);
+		exit(1);
+	}
+	fprintf(out_fp, "benchmark\tcalls\tmedian_ns\tp95_ns\tmean_ns\tallocations_per_call\n");
+
+	for (i = 0; i < sizeof(benchmarks) / sizeof(benchmarks[0]); i++) {
+		printf("Benchmarking %s ...\n", benchmarks[i].name);
+		srand(100);
+		blbn_bench_run(state, &benchmarks[i], case_index, calls, out_fp);
+	}
+
+	fclose(out_fp);
+	blbn_free_state(state);
+
+	return 0;
+}
+
+//return 0 if the file exist, < 0 the file does not exist
+int file_exists(char *filename) {
+	struct stat buffer;
+	return (stat(filename, &buffer) == 0);
+}
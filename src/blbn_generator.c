@@ -21,10 +21,17 @@
  *   ./blbn_generator -m ALARM.dne -t Press
  *
  * - Creates training and validation subsets for k-fold based on a specified
- *   data set (or case set) file:
+ *   data set (or case set) file (and converts each training subset to a
+ *   binary case store, which blbn_learner maps instead of reading the *.cas
+ *   file):
  *
  *   ./blbn_generator -m ALARM.dne -d ALARM.cas -k 10
  *
+ * - Converts a data set (or case set) file to a binary case store (written
+ *   next to it, with the suffix .cbin):
+ *
+ *   ./blbn_generator -m ALARM.dne -b ALARM.cas.0
+ *
  * The experiment file infrastructure is structured as follows (illustrated
  * using the ALARM example, continued from the above examples):
  *
@@ -36,6 +43,7 @@
  * ./data/ALARM/ALARM.1000.cas		Simulated data/case file
  *
  * ./data/ALARM/ALARM.cas.0			k-fold cross validation data/case files
+ * ./data/ALARM/ALARM.cas.0.cbin		(training subsets as binary case stores)
  * ./data/ALARM/ALARM.cas.0v
  * ./data/ALARM/ALARM.cas.1
  * ./data/ALARM/ALARM.cas.1v
@@ -97,6 +105,7 @@ int main (int argc, char *argv[]) {
 	char data_filepath[256]    = { 0 }; // data file path (-d <data_filepath>)
 	char model_filepath[256]   = { 0 }; // model/network file path (-m <model_filepath>)
 	char target_node_name[256] = { 0 }; // target node name (-t <target_node_name>)
+	char convert_filepath[256] = { 0 }; // data file path to convert to a binary case store (-b <data_filepath>)
 	int case_count             = -1;    // case count (-c <case_count>)
 	int fold_count             = -1;    // fold count (-f <fold_count>)
 
@@ -138,6 +147,12 @@ int main (int argc, char *argv[]) {
 
 					printf ("Target node name: %s\n", &target_node_name[0]);
 				}
+			} else if (strcmp (argv[i], "-b") == 0) {
+				if (i < argc) {
+					strcpy (&convert_filepath[0], argv[i + 1]);
+
+					printf ("Data file path to convert: %s\n", &convert_filepath[0]);
+				}
 			}
 		}
 	}
@@ -370,6 +385,38 @@ int main (int argc, char *argv[]) {
 			caseposn = NEXT_CASE;                           // set it back to NEXT_CASE each time
 		}
 		DeleteStream_ns (input_casefile);
+
+		//------------------------------------------------------------------------------
+		// Convert training subsets to binary case stores
+		//------------------------------------------------------------------------------
+
+		for (j = 0; j < fold_count; ++j) {
+			sprintf (fold_filepath, "./data/%s/%s.cas.%d", orig_model_name, orig_model_name, j);
+			sprintf (convert_filepath, "%s%s", fold_filepath, BLBN_CBIN_SUFFIX);
+			casefile = NewFileStream_ns (fold_filepath, env, NULL);
+			if (blbn_case_store_write (convert_filepath, orig_net, casefile) < 0) {
+				printf ("Error: Could not write binary case store %s.\n", convert_filepath);
+			}
+			DeleteStream_ns (casefile);
+		}
+		convert_filepath[0] = '\0';
+		casefile = NULL;
+	}
+
+	//------------------------------------------------------------------------------
+	// Convert a data set (case set) file to a binary case store
+	//------------------------------------------------------------------------------
+
+	if (strlen (convert_filepath) > 0) {
+		sprintf (fold_filepath, "%s%s", convert_filepath, BLBN_CBIN_SUFFIX);
+		casefile = NewFileStream_ns (convert_filepath, env, NULL);
+		result = blbn_case_store_write (fold_filepath, orig_net, casefile);
+		DeleteStream_ns (casefile);
+		casefile = NULL;
+		if (result < 0) {
+			goto error;
+		}
+		printf ("Wrote %d cases to %s\n", result, fold_filepath);
 	}
 
 